@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+// Cache-line alignment for the per-atom columns: SIMD loops over atoms start on
+// an aligned boundary and no two threads' slices share a line at the start
+constexpr size_t COLUMN_ALIGNMENT = 64;
+
+// Allocates whole, aligned cache lines, so a vectorized loop may load the last
+// (partial) block of a column without reading past its allocation
+template <typename T, size_t Alignment = COLUMN_ALIGNMENT>
+struct AlignedAllocator {
+    static_assert(Alignment >= alignof(T) && (Alignment & (Alignment - 1)) == 0, "Alignment must be a power of two");
+
+    using value_type = T;
+    template <typename U>
+    struct rebind {
+        using other = AlignedAllocator<U, Alignment>;
+    };
+
+    AlignedAllocator() = default;
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment> &)
+    {
+    }
+
+    T *allocate(size_t count)
+    {
+        if (count > (static_cast<size_t>(-1) - Alignment) / sizeof(T))
+        {
+            throw std::bad_array_new_length();
+        }
+        size_t bytes = (count * sizeof(T) + Alignment - 1) / Alignment * Alignment;
+        return static_cast<T *>(::operator new(bytes, std::align_val_t(Alignment)));
+    }
+    void deallocate(T *pointer, size_t)
+    {
+        ::operator delete(pointer, std::align_val_t(Alignment));
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, Alignment> &) const
+    {
+        return true;
+    }
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U, Alignment> &) const
+    {
+        return false;
+    }
+};
+
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
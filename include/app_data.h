@@ -0,0 +1,18 @@
+#pragma once
+
+// Shared application state, reachable from GLFW callbacks through the window user pointer
+class UIManager;
+class Renderer;
+class ImGuiManager;
+class FramePacer;
+class FrameStats;
+
+struct AppData
+{
+    UIManager *uiManager;
+    Renderer *renderer;
+    ImGuiManager *imguiManager;
+    FramePacer *framePacer = nullptr;
+    FrameStats *frameStats = nullptr;
+    bool mousePressed = false;
+};
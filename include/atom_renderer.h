@@ -0,0 +1,88 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "shader.h"
+#include "gl_state.h"
+#include "molecule.h"
+
+// Draws every atom as a ray-cast sphere impostor. All atoms go out in one
+// instanced draw of a 4-vertex quad; per-atom data comes from two instanced
+// attribute buffers: positions (rewritten per trajectory frame) and a static
+// radius/color-index buffer. The fragment shader intersects the view ray with
+// the sphere and writes the true depth, so impostors intersect correctly.
+class AtomRenderer {
+public:
+    // Submit the impostor program for compilation ahead of init(), next to the other programs
+    void beginShader(ShaderCache *cache);
+    bool init();
+    void destroy();
+
+    // Upload a new set of atoms
+    void setAtoms(const Molecule &molecule);
+
+    // Replace the positions only (same atom count), e.g. for a new trajectory frame
+    void updatePositions(const glm::vec4 *positions, size_t count);
+
+    // Upload of a new set of atoms spread over several frames: beginUpload() sets aside
+    // new buffers, uploadNext() fills them a slice at a time and commitUpload() swaps them
+    // in. The atoms drawn don't change until then. The molecule must outlive the upload.
+    void beginUpload(const Molecule &molecule);
+    // Upload at most maxBytes more (at least one atom); returns the bytes uploaded
+    size_t uploadNext(size_t maxBytes);
+    bool isUploadDone() const { return stagedPositions == stagedCount && stagedAttributes == stagedCount; }
+    void commitUpload();
+    void cancelUpload();
+    size_t getUploadTotalBytes() const { return stagedCount * ATOM_UPLOAD_BYTES; }
+    size_t getUploadedBytes() const
+    {
+        return stagedPositions * sizeof(glm::vec4) + stagedAttributes * sizeof(AtomAttributes);
+    }
+
+    // Draw all atoms; the camera block must already be bound for the view.
+    // radiusScale multiplies the van der Waals radius (1 for space filling).
+    void draw(GLStateCache &state, float radiusScale);
+
+    size_t getAtomCount() const { return atomCount; }
+    GLuint getPositionBuffer() const { return positionBuffer; }
+    GLuint getAttributeBuffer() const { return attributeBuffer; }
+    GLuint getPaletteBuffer() const { return paletteBuffer; }
+    // CPU copy of the palette buffer (color per color index)
+    const std::vector<glm::vec4> &getPalette() const { return palette; }
+
+    // Default colors: one per element, indexed by atomic number
+    static std::vector<glm::vec4> elementPalette();
+
+    // Per-atom static data, 8 bytes per atom
+    struct AtomAttributes {
+        float radius;
+        uint32_t colorIndex;
+    };
+    static constexpr size_t ATOM_UPLOAD_BYTES = sizeof(glm::vec4) + sizeof(AtomAttributes);
+
+private:
+    void allocateBuffers(size_t count);
+    static void fillAttributes(const Molecule &molecule, size_t first, size_t count, AtomAttributes *attributes);
+
+    Shader shader;
+    Uniform<float> radiusScaleUniform;
+
+    GLuint vao = 0;
+    GLuint positionBuffer = 0;
+    GLuint attributeBuffer = 0;
+    GLuint paletteBuffer = 0;
+    std::vector<glm::vec4> palette;
+    size_t atomCount = 0;
+    size_t capacity = 0;
+
+    // Staged upload: buffers filled so far, in atoms
+    const Molecule *staged = nullptr;
+    GLuint stagedPositionBuffer = 0;
+    GLuint stagedAttributeBuffer = 0;
+    size_t stagedCount = 0;
+    size_t stagedPositions = 0;
+    size_t stagedAttributes = 0;
+};
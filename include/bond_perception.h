@@ -0,0 +1,17 @@
+#pragma once
+
+#include "load_progress.h"
+#include "molecule.h"
+
+// Atoms closer than the sum of their covalent radii plus this tolerance are bonded (Angstrom)
+constexpr float BOND_TOLERANCE = 0.45f;
+// Closer pairs are treated as overlapping positions (alternate locations, bad input), not bonds
+constexpr float MIN_BOND_LENGTH = 0.4f;
+
+// Replace molecule.bonds with bonds inferred from interatomic distances. Atoms
+// are binned in a uniform grid of cells as wide as the longest possible bond, so
+// each atom is only compared with the atoms of its own and adjacent cells (linear
+// in the atom count); large structures are split over worker threads by cell
+// range. The bond order depends only on the input. With `progress`, the fraction
+// done is reported; a cancelled run stops early and leaves the bonds incomplete.
+void perceiveBonds(Molecule &molecule, LoadProgress *progress = nullptr);
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "aligned_allocator.h"
+#include "shader.h"
+#include "gl_state.h"
+
+// Draws bonds as ray-cast cylinder impostors. The only per-bond data is a pair
+// of atom indices; endpoints and colors are fetched in the vertex shader from
+// the atom renderer's position and attribute buffers. Moving atoms therefore
+// never touches bond data, and all bonds go out in a single instanced draw.
+// Each half of a bond takes the color of the atom it is attached to.
+class BondRenderer {
+public:
+    // Submit the impostor program for compilation ahead of init(), next to the other programs
+    void beginShader(ShaderCache *cache);
+    bool init();
+    void destroy();
+
+    // Upload the bond list (two atom indices per bond)
+    void setBonds(const AlignedVector<uint32_t> &bonds);
+
+    // Bond list uploaded over several frames, swapped in by commitUpload() (see
+    // AtomRenderer::beginUpload). The list must outlive the upload.
+    void beginUpload(const AlignedVector<uint32_t> &bonds);
+    // Upload at most maxBytes more (at least one bond); returns the bytes uploaded
+    size_t uploadNext(size_t maxBytes);
+    bool isUploadDone() const { return stagedDone == stagedCount; }
+    void commitUpload();
+    void cancelUpload();
+    size_t getUploadTotalBytes() const { return stagedCount * BOND_BYTES; }
+    size_t getUploadedBytes() const { return stagedDone * BOND_BYTES; }
+
+    static constexpr size_t BOND_BYTES = 2 * sizeof(uint32_t);
+
+    // Draw all bonds; the camera block must be bound. Takes the atom buffers so
+    // the bonds always follow the current positions.
+    void draw(GLStateCache &state, GLuint positionBuffer, GLuint attributeBuffer, GLuint paletteBuffer, float radius);
+
+    size_t getBondCount() const { return bondCount; }
+
+private:
+    Shader shader;
+    Uniform<float> radiusUniform;
+
+    GLuint vao = 0;
+    GLuint bondBuffer = 0;
+    size_t bondCount = 0;
+    size_t capacity = 0;
+
+    // Staged upload, in bonds
+    const AlignedVector<uint32_t> *staged = nullptr;
+    GLuint stagedBuffer = 0;
+    size_t stagedCount = 0;
+    size_t stagedDone = 0;
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Orbit camera for a single view
+struct Camera {
+    glm::vec3 target = glm::vec3(0.0f);
+    float distance = 10.0f;
+    float yaw = 0.0f;   // Radians around the up axis
+    float pitch = 0.0f; // Radians above the horizon
+    float fovY = 0.785398f; // 45 degrees
+    float nearPlane = 0.1f;
+    float farPlane = 1000.0f;
+
+    glm::vec3 getPosition() const;
+    glm::mat4 getViewMatrix() const;
+    glm::mat4 getProjectionMatrix(float aspect) const;
+    // Off-axis projection of the sub-rectangle [ndcMin, ndcMax] of the full view, for tiled rendering
+    glm::mat4 getTileProjectionMatrix(float aspect, glm::vec2 ndcMin, glm::vec2 ndcMax) const;
+
+    // Aim at the center of a box of atom centers and back off until all of it (with room
+    // for atom radii) is in view; keeps the viewing direction
+    void frame(const glm::vec3 &minCorner, const glm::vec3 &maxCorner);
+};
+
+// std140 mirror of the CameraBlock uniform block declared in the shaders
+struct CameraUniforms {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+    glm::vec4 viewport; // x, y, width, height in pixels
+};
+
+// GLSL declaration matching CameraUniforms; prepend to shaders that need the camera
+extern const char *cameraBlockGlsl;
+
+// One uniform buffer holding the camera block of every view. Each view owns a
+// slot, and drawing a view binds that slot's range to CAMERA_BLOCK_BINDING so
+// every program reads the same data without per-program uniform uploads.
+class CameraBuffer {
+public:
+    void init(int initialSlots = 8);
+    void destroy();
+
+    // Slot for a view, allocated on first use
+    int getSlot(const std::string &viewName);
+
+    // Stage new camera data for a slot; identical data is not re-uploaded
+    void update(int slot, const CameraUniforms &uniforms);
+
+    // Upload the slot if it changed and bind it for the following draws
+    void bind(int slot);
+
+private:
+    void reallocate(int slots);
+
+    GLuint ubo = 0;
+    GLsizeiptr slotStride = 0;
+    int capacity = 0;
+    std::vector<CameraUniforms> staged;
+    std::vector<bool> dirty;
+    std::unordered_map<std::string, int> slots;
+};
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// Scoped CPU zones recorded into per-thread ring buffers. Recording never
+// locks: each thread owns its ring and publishes it through an atomic head
+// index. Readers (the flame view, trace export) copy the rings and drop any
+// slot that was overwritten while copying. Slot fields are atomics, so a slot
+// read while it is being rewritten is a dropped value, not a data race.
+//
+// A thread's ring goes back to a free list when the thread exits and is reused
+// by the next new thread, so short-lived workers (per-call thread pools, loader
+// threads) don't add a ring each; exited threads' events stay visible until then.
+//
+// Zone names must outlive the profiler: string literals, or intern() for
+// names built at runtime.
+//
+// Instrument code with the PROFILE_* macros below; building without
+// MOLVIEW_PROFILING (CMake option ENABLE_PROFILING) compiles them out.
+class CpuProfiler {
+public:
+    struct Event {
+        const char *name;
+        uint64_t startNs;
+        uint64_t endNs;
+        uint32_t depth; // Nesting level within the thread
+    };
+
+    struct ThreadEvents {
+        uint32_t threadId;
+        std::string threadName;
+        std::vector<Event> events; // Oldest first
+    };
+
+    // Events kept per thread (about 2-3 seconds of a busy main loop)
+    static constexpr size_t RING_CAPACITY = 1 << 15;
+
+    static CpuProfiler &instance();
+
+    // Nanoseconds since the profiler was created (steady clock)
+    static uint64_t now();
+
+    void setThreadName(const char *name);
+    // Start of a main loop iteration; the flame view shows the last complete frame
+    void markFrame();
+    // Stable copy of a runtime string, for use as a zone name
+    const char *intern(const std::string &name);
+
+    // Copies of every thread's buffered events
+    std::vector<ThreadEvents> snapshot() const;
+    // Events of the thread that calls markFrame() between the last two frame marks.
+    // Call from that thread.
+    std::vector<Event> getLastFrame(uint64_t &frameStartNs, uint64_t &frameEndNs) const;
+
+    // Chrome trace event format (chrome://tracing, Perfetto)
+    bool writeChromeTrace(const std::string &path) const;
+
+    // Used by ScopedCpuZone
+    struct ThreadBuffer;
+    ThreadBuffer &threadBuffer();
+    static uint32_t enterZone(ThreadBuffer &buffer);
+    static void leaveZone(ThreadBuffer &buffer, const char *name, uint64_t startNs, uint32_t depth);
+    // Called when the owning thread exits
+    void releaseThreadBuffer(ThreadBuffer &buffer);
+
+private:
+    CpuProfiler() = default;
+    static void copyEvents(const ThreadBuffer &buffer, std::vector<Event> &events);
+
+    mutable std::mutex registryMutex; // Thread registration and snapshots, never taken while recording
+    std::vector<std::unique_ptr<ThreadBuffer>> threads; // Kept after their thread exits
+    std::vector<ThreadBuffer *> freeThreads;            // Of exited threads, for reuse
+    uint32_t nextThreadId = 1;
+    std::mutex internMutex;
+    std::unordered_set<std::string> internedNames;
+
+    std::atomic<ThreadBuffer *> frameThread{nullptr};
+    std::atomic<uint64_t> previousFrameStart{0};
+    std::atomic<uint64_t> currentFrameStart{0};
+};
+
+struct CpuProfiler::ThreadBuffer {
+    // One ring entry; written by the owning thread, read by any
+    struct Slot {
+        std::atomic<const char *> name{nullptr};
+        std::atomic<uint64_t> startNs{0};
+        std::atomic<uint64_t> endNs{0};
+        std::atomic<uint32_t> depth{0};
+
+        void store(const Event &event);
+        Event load() const;
+    };
+
+    std::unique_ptr<Slot[]> ring{new Slot[RING_CAPACITY]};
+    std::atomic<uint64_t> head{0}; // Events ever written; slot = head % RING_CAPACITY
+    uint32_t threadId = 0;
+    std::string threadName;
+    uint32_t depth = 0; // Only touched by the owning thread
+};
+
+// Records one zone from construction to destruction
+class ScopedCpuZone {
+public:
+    explicit ScopedCpuZone(const char *name)
+        : name(name), buffer(CpuProfiler::instance().threadBuffer()),
+          depth(CpuProfiler::enterZone(buffer)), startNs(CpuProfiler::now())
+    {
+    }
+    ~ScopedCpuZone() { CpuProfiler::leaveZone(buffer, name, startNs, depth); }
+
+    ScopedCpuZone(const ScopedCpuZone &) = delete;
+    ScopedCpuZone &operator=(const ScopedCpuZone &) = delete;
+
+private:
+    const char *name;
+    CpuProfiler::ThreadBuffer &buffer;
+    uint32_t depth;
+    uint64_t startNs;
+};
+
+#ifdef MOLVIEW_PROFILING
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name) ScopedCpuZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_FRAME() CpuProfiler::instance().markFrame()
+#define PROFILE_THREAD(name) CpuProfiler::instance().setThreadName(name)
+#else
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_FRAME() ((void)0)
+#define PROFILE_THREAD(name) ((void)0)
+#endif
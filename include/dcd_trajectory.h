@@ -0,0 +1,33 @@
+#pragma once
+
+#include "mapped_file.h"
+#include "trajectory.h"
+#include <cstdint>
+#include <string>
+
+// CHARMM, NAMD and X-PLOR DCD trajectory, in either byte order. All frames
+// have the same size, so a frame's offset is computed instead of indexed.
+// Files with fixed atoms (only the free atoms stored after the first frame)
+// are not supported.
+class DcdTrajectory : public Trajectory {
+public:
+    bool open(const std::string &path);
+    void close();
+
+    const std::string &getPath() const override { return file.getPath(); }
+    size_t getFrameCount() const override { return frameCount; }
+    size_t getAtomCount(size_t) const override { return atomCount; }
+    bool readPositions(size_t frame, glm::vec4 *positions) const override;
+
+private:
+    // Fortran record marker or value in the file's byte order
+    uint32_t readInt(size_t offset) const;
+
+    MappedFile file;
+    bool swapBytes = false;
+    bool hasUnitCell = false;
+    size_t atomCount = 0;
+    size_t frameCount = 0;
+    size_t firstFrame = 0; // Offset of the first frame
+    size_t frameBytes = 0;
+};
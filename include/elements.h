@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+// Per-element constants used for rendering and bond perception.
+// Index 0 is the "unknown" element, 1..118 are atomic numbers.
+struct ElementInfo {
+    const char *symbol;
+    float covalentRadius; // Angstrom (Cordero et al. 2008)
+    float vdwRadius;      // Angstrom (Bondi, 2.0 where unavailable)
+    uint32_t color;       // 0xRRGGBB, Jmol CPK colors
+};
+
+constexpr int ELEMENT_COUNT = 119;
+
+const ElementInfo &getElementInfo(int atomicNumber);
+
+// Atomic number for an element symbol (case-insensitive), 0 if unknown
+int elementFromSymbol(std::string_view symbol);
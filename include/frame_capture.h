@@ -0,0 +1,101 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "thread_pool.h"
+
+// Asynchronous readback of rendered images to PNG files. Each capture copies
+// region color textures into a persistently mapped pixel-pack buffer from a
+// ring and fences it; update() hands buffers whose fence has signaled to
+// encoder threads, which write the PNG straight from the mapping. The render
+// loop never waits on the GPU unless every buffer in the ring is busy.
+class FrameCapture {
+public:
+    // One region texture placed into the captured image
+    struct Source {
+        GLuint texture;  // 2D array texture
+        int layer;
+        int x, y;        // Placement in the image, from its top-left corner
+        int width, height;
+    };
+
+    struct Stats {
+        uint64_t requested = 0;
+        uint64_t written = 0;
+        uint64_t failed = 0;
+        uint64_t stalls = 0;     // Captures that had to wait for a free buffer
+        float lastEncodeMs = 0.0f;
+    };
+
+    // Buffers in flight beyond one per encoder thread (covers the GPU latency)
+    static constexpr int EXTRA_SLOTS = 3;
+
+    ~FrameCapture();
+    // Write out pending captures and release the buffers (needs the GL context)
+    void destroy();
+
+    // Queue a width x height image composed of `sources` over an opaque `background`.
+    // Blocks only when all buffers are still being read or encoded; never drops a capture.
+    bool capture(const std::string &path, int width, int height, const std::vector<Source> &sources,
+                 const glm::vec3 &background);
+
+    // Pass finished readbacks to the encoders; call once per frame
+    void update();
+    // Wait until every queued capture is written
+    void flush();
+    bool hasPendingReadbacks() const;
+
+    // Numbered image sequence: every frame captured while recording becomes <directory>/frame_000000.png, ...
+    bool startSequence(const std::string &directory);
+    void stopSequence();
+    bool isRecording() const { return recording; }
+    std::string nextSequencePath();
+    const std::string &getSequenceDirectory() const { return sequenceDirectory; }
+    uint64_t getSequenceFrames() const { return sequenceFrame; }
+
+    // zlib level for the encoders; movie frames favour speed
+    int compressionLevel = 1;
+
+    Stats getStats() const;
+
+private:
+    enum SlotState : int { Free, Reading, Encoding };
+
+    struct Slot {
+        GLuint buffer = 0;
+        size_t capacity = 0;
+        const uint8_t *mapped = nullptr;
+        GLsync fence = nullptr;
+        std::atomic<int> state{Free};
+        std::string path;
+        int width = 0;
+        int height = 0;
+        uint64_t sequence = 0; // Capture order, to hand readbacks over oldest first
+    };
+
+    Slot *acquireSlot();
+    void ensureCapacity(Slot &slot, size_t size);
+    void encode(Slot &slot);
+    void startEncoding(Slot &slot);
+    // Wait for the slot's fence, then encode it (or free it if the GPU never finished)
+    void completeReadback(Slot &slot);
+
+    std::vector<std::unique_ptr<Slot>> slots;
+    std::unique_ptr<ThreadPool> encoders;
+    uint64_t captureCount = 0;
+
+    bool recording = false;
+    std::string sequenceDirectory;
+    uint64_t sequenceFrame = 0;
+
+    std::atomic<uint64_t> requested{0};
+    std::atomic<uint64_t> written{0};
+    std::atomic<uint64_t> failed{0};
+    std::atomic<uint64_t> stalls{0};
+    std::atomic<float> lastEncodeMs{0.0f};
+};
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Trajectories smaller than this are scanned on every open; the sidecar isn't worth a file
+constexpr uint64_t FRAME_INDEX_MIN_FILE_BYTES = 64ull << 20;
+
+// Frame offsets of a trajectory file, saved next to it as "<file>.mvidx" so
+// later opens seek straight to any frame instead of scanning the file again.
+// A saved index is only used while the trajectory's size and modification
+// time match the ones it was built from, and only by the same reader (format).
+struct FrameIndex {
+    std::vector<uint64_t> offsets; // Start of each frame, then the end of the last one
+    uint64_t atomCount = 0;        // Atoms per frame
+
+    size_t getFrameCount() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+
+    // False without a matching index (a missing or stale sidecar is not an error)
+    bool load(const std::string &trajectoryPath, const std::string &format);
+    // Best effort: read-only directories simply get no sidecar
+    void save(const std::string &trajectoryPath, const std::string &format) const;
+
+    static std::string sidecarPath(const std::string &trajectoryPath);
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+
+struct GLFWwindow;
+
+// Decides when the main loop renders. Idle, it blocks in glfwWaitEventsTimeout
+// and only draws when input, a background job or a heartbeat asks for it.
+// While something is animating (playback, a drag, ...) it renders every frame.
+class FramePacer {
+public:
+    // Reasons to render continuously; combined as a bit mask
+    enum Reason : unsigned int {
+        Interaction = 1 << 0, // Mouse button held: drags, sliders, ...
+        Playback = 1 << 1,    // Trajectory playback
+        Animation = 1 << 2,   // Animated content in a view
+    };
+
+    explicit FramePacer(GLFWwindow *window);
+
+    // Install GLFW input callbacks that request redraws. Call before ImGui
+    // installs its own callbacks so ImGui chains to these.
+    void installCallbacks();
+
+    // Render the next `frames` frames (ImGui needs a couple to settle after input)
+    void requestRedraw(int frames = INPUT_SETTLE_FRAMES);
+
+    // Render one frame once `seconds` have passed; for content that animates at a
+    // low rate without keeping the loop continuous. Call again for the next frame.
+    void scheduleRedraw(double seconds);
+
+    // Thread-safe wake-up for background jobs that produced new data
+    void wake();
+
+    void setContinuous(Reason reason, bool active);
+    bool isContinuous() const { return continuousReasons != 0; }
+
+    // Replaces glfwPollEvents at the end of a frame; returns once the next frame should be drawn
+    void waitForEvents();
+
+    // Human-readable mode for the status bar
+    std::string getModeDescription() const;
+
+    // Longest idle sleep before a heartbeat frame
+    double idleTimeout = 1.0;
+
+    static constexpr int INPUT_SETTLE_FRAMES = 3;
+    // CPU profiler zone covering the idle sleep (excluded from frame costs)
+    static constexpr const char *IDLE_ZONE = "idle";
+
+private:
+    GLFWwindow *window;
+    unsigned int continuousReasons = 0;
+    int pendingFrames = INPUT_SETTLE_FRAMES;
+    double scheduledRedrawTime = 0.0; // glfwGetTime() of the scheduled frame, 0 for none
+    std::atomic<bool> wakeRequested{false};
+};
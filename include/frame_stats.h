@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Frame-time history with percentiles, a frame budget and stutter detection.
+// A stutter is a frame over budget and well above the recent median; it is
+// attributed to the CPU zone with the most self time in that frame (when
+// built with MOLVIEW_PROFILING). The summary can be written periodically in
+// the Prometheus text format for a node-exporter style textfile scraper.
+class FrameStats {
+public:
+    // Frames kept for the percentiles (about 10 seconds at 60 Hz)
+    static constexpr size_t HISTORY_LENGTH = 600;
+    // Stutter events kept for display
+    static constexpr size_t STUTTER_HISTORY = 32;
+
+    struct Summary {
+        float p50 = 0.0f;
+        float p95 = 0.0f;
+        float p99 = 0.0f;
+        float max = 0.0f;
+        size_t samples = 0;
+    };
+
+    struct Stutter {
+        uint64_t frame;
+        float ms;
+        std::string cause;
+        double time; // Seconds since start (glfwGetTime)
+    };
+
+    // Record one frame; `ms` is the time spent producing it, up to the buffer swap
+    // (waiting for vsync or for events is not part of a frame's cost)
+    void addFrame(float ms, double time);
+
+    const Summary &getSummary() const { return summary; }
+    const std::vector<float> &getHistory() const { return history; }
+    size_t getHistoryOffset() const { return static_cast<size_t>(frameCount % HISTORY_LENGTH); }
+    uint64_t getFrameCount() const { return frameCount; }
+    uint64_t getOverBudgetCount() const { return overBudgetCount; }
+    uint64_t getStutterCount() const { return stutterCount; }
+    const std::vector<Stutter> &getStutters() const { return stutters; } // Oldest first
+
+    // Budget for one frame (default 60 Hz)
+    float budgetMs = 1000.0f / 60.0f;
+    // Fraction a frame may exceed the budget and still count as on time
+    // (a 59.94 Hz display reports 60 Hz)
+    float budgetTolerance = 0.05f;
+    // Budget of one refresh interval of a display running at `hz`
+    void setRefreshRate(double hz);
+    bool isOverBudget(float ms) const { return ms > budgetMs * (1.0f + budgetTolerance); }
+    // A frame is a stutter if it exceeds the budget and this multiple of the median
+    float stutterFactor = 2.0f;
+
+    // Write the summary to `path` every `intervalSeconds` (empty path disables)
+    void setMetricsFile(const std::string &path, double intervalSeconds = 5.0);
+    bool writeMetrics(const std::string &path) const;
+
+private:
+    void updateSummary();
+    static std::string findStutterCause();
+
+    std::vector<float> history = std::vector<float>(HISTORY_LENGTH, 0.0f);
+    std::vector<float> sorted; // Scratch for the percentiles
+    Summary summary;
+    uint64_t frameCount = 0;
+    double totalMs = 0.0; // Of every frame, for the summary's _sum
+    uint64_t overBudgetCount = 0;
+    uint64_t stutterCount = 0;
+    std::vector<Stutter> stutters;
+
+    std::string metricsPath;
+    double metricsInterval = 5.0;
+    double lastMetricsTime = 0.0;
+};
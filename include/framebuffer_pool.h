@@ -0,0 +1,65 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "gl_state.h"
+
+// Region framebuffers backed by one immutable (glTextureStorage3D) color and
+// depth texture array. Each region renders into a layer, so the compositor can
+// sample every region from a single texture in one draw. All layers share the
+// same bucket-rounded size; a region uses the top-left corner of its layer.
+class FramebufferPool {
+public:
+    struct Attachment {
+        unsigned int fbo = 0; // Framebuffer with this layer attached
+        int layer = -1;
+    };
+
+    // Granularity of the size buckets in pixels
+    static constexpr int BUCKET_SIZE = 128;
+
+    // A free layer; adds layers (recreating the storage) when none is left
+    Attachment acquire();
+
+    // Return a layer for reuse
+    void release(const Attachment &attachment);
+
+    // Make the layers at least width x height. Returns true if the storage was
+    // recreated, in which case every layer's content is lost.
+    bool reserve(int width, int height);
+
+    // Set the layer size to the bucket fitting width x height, shrinking if needed
+    bool resize(int width, int height);
+
+    // Destroy everything owned by the pool
+    void clear();
+
+    // State cache told about textures and framebuffers before the pool deletes them
+    void setStateCache(GLStateCache *cache) { stateCache = cache; }
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    unsigned int getColorArray() const { return colorArray; }
+    size_t getLayerCount() const { return layerFbos.size(); }
+    size_t getUsedLayerCount() const { return layerFbos.size() - freeLayers.size(); }
+
+    // Bumped whenever the storage is recreated (and layer content lost)
+    uint64_t getGeneration() const { return generation; }
+
+    static int roundToBucket(int pixels);
+
+private:
+    void recreate(int newWidth, int newHeight, size_t layerCount);
+    void deleteArrays();
+
+    unsigned int colorArray = 0;
+    unsigned int depthArray = 0;
+    int width = BUCKET_SIZE;
+    int height = BUCKET_SIZE;
+    std::vector<unsigned int> layerFbos; // One framebuffer per layer, index = layer
+    std::vector<int> freeLayers;
+    uint64_t generation = 0;
+    GLStateCache *stateCache = nullptr;
+};
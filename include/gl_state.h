@@ -0,0 +1,92 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <cstdint>
+
+// Shadow copy of the pipeline state the renderer touches. Every change goes
+// through here, so redundant calls are filtered out and the current state is
+// known without querying the driver (glGet* can stall the pipeline).
+//
+// Code outside the renderer that changes this state must either restore it
+// (the ImGui backend does) or call invalidate() afterwards.
+class GLStateCache {
+public:
+    // Changes issued to the driver and changes filtered out as redundant
+    struct Counters {
+        uint64_t applied = 0;
+        uint64_t skipped = 0;
+    };
+
+    // Forget the shadow copy; the next call for every piece of state is applied
+    void invalidate();
+
+    // Start a new frame: the running counters become getLastFrame()
+    void beginFrame();
+    const Counters &getLastFrame() const { return lastFrame; }
+
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint vao);
+    void bindFramebuffer(GLuint fbo);
+    void bindTexture(GLuint unit, GLuint texture); // Via glBindTextureUnit
+    // Call before deleting an object: GL rebinds 0 wherever it was bound, and the
+    // driver may hand the same name to the next object created
+    void forgetTexture(GLuint texture);
+    void forgetFramebuffer(GLuint fbo);
+    void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+    void setDepthTest(bool enabled);
+    void setBlend(bool enabled);
+    void setCullFace(bool enabled);
+    void setLineSmooth(bool enabled);
+    void blendFunc(GLenum source, GLenum destination);
+    void lineWidth(float width);
+    void clearColor(float r, float g, float b, float a);
+
+    bool isDepthTestEnabled() const { return depthTest == ON; }
+    bool isBlendEnabled() const { return blend == ON; }
+
+    static constexpr int TEXTURE_UNITS = 8;
+
+private:
+    // Capability shadow; UNKNOWN after invalidate()
+    enum Toggle : uint8_t { UNKNOWN, OFF, ON };
+
+    bool apply(bool changed)
+    {
+        (changed ? frame.applied : frame.skipped)++;
+        return changed;
+    }
+    void setCapability(Toggle &current, GLenum capability, bool enabled);
+
+    GLuint program = 0;
+    GLuint vertexArray = 0;
+    GLuint framebuffer = 0;
+    GLuint textures[TEXTURE_UNITS] = {};
+    GLint viewportRect[4] = {};
+    GLenum blendSource = GL_ONE;
+    GLenum blendDestination = GL_ZERO;
+    float currentLineWidth = 1.0f;
+    float clearRgba[4] = {};
+
+    // Which non-toggle state is valid, one bit each
+    enum : uint32_t {
+        PROGRAM_BIT = 1u << 0,
+        VERTEX_ARRAY_BIT = 1u << 1,
+        FRAMEBUFFER_BIT = 1u << 2,
+        VIEWPORT_BIT = 1u << 3,
+        BLEND_FUNC_BIT = 1u << 4,
+        LINE_WIDTH_BIT = 1u << 5,
+        CLEAR_COLOR_BIT = 1u << 6,
+        TEXTURE_BIT = 1u << 7, // TEXTURE_UNITS bits from here
+    };
+    uint32_t validBits = 0;
+    bool isValid(uint32_t bit) const { return (validBits & bit) != 0; }
+
+    Toggle depthTest = UNKNOWN;
+    Toggle blend = UNKNOWN;
+    Toggle cullFace = UNKNOWN;
+    Toggle lineSmooth = UNKNOWN;
+
+    Counters frame;
+    Counters lastFrame;
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// GPU time per named zone (a region render, the composite, ImGui, ...) from
+// GL_TIME_ELAPSED queries. Queries are read back FRAME_LATENCY frames later,
+// and only once the driver reports them available, so collecting never stalls.
+// Zones cannot nest (one TIME_ELAPSED query may be active at a time).
+class GpuProfiler {
+public:
+    // Query sets in flight; results of frame N are collected at frame N + FRAME_LATENCY
+    static constexpr int FRAME_LATENCY = 3;
+    // Frames of history kept per zone
+    static constexpr int HISTORY_LENGTH = 300;
+
+    struct Zone {
+        std::string name;
+        std::vector<float> history; // Milliseconds per collected frame, ring buffer of HISTORY_LENGTH
+        float lastMs = 0.0f;
+        float averageMs = 0.0f; // Exponential moving average over frames that ran the zone
+    };
+
+    void destroy();
+
+    // Collect finished queries and start recording a new frame
+    void beginFrame();
+    void begin(const std::string &zoneName);
+    void end();
+
+    bool enabled = true;
+
+    const std::vector<Zone> &getZones() const { return zones; }
+    // Total GPU time per collected frame, same ring layout as Zone::history
+    const std::vector<float> &getFrameHistory() const { return frameHistory; }
+    // Ring index of the oldest sample (pass as ImPlot's offset)
+    int getHistoryOffset() const { return static_cast<int>(collectedFrames % HISTORY_LENGTH); }
+    int getHistoryCount() const;
+    // Frames whose queries were not ready in time and were discarded
+    uint64_t getDroppedFrames() const { return droppedFrames; }
+
+    // Write the history as CSV: frame, one column per zone and the total (ms)
+    bool exportCsv(const std::string &path) const;
+
+private:
+    struct PendingQuery {
+        int zone;
+        GLuint query;
+    };
+    struct FrameQueries {
+        std::vector<PendingQuery> queries;
+        uint64_t frame = 0;
+    };
+
+    int findZone(const std::string &zoneName);
+    GLuint takeQuery();
+    void collect(FrameQueries &frame);
+
+    std::vector<Zone> zones;
+    std::unordered_map<std::string, int> zoneIndices;
+    std::vector<float> frameHistory = std::vector<float>(HISTORY_LENGTH, 0.0f);
+    std::vector<uint64_t> frameNumbers = std::vector<uint64_t>(HISTORY_LENGTH, 0);
+
+    FrameQueries frames[FRAME_LATENCY];
+    std::vector<GLuint> freeQueries;
+    uint64_t frameCounter = 0;
+    uint64_t collectedFrames = 0;
+    uint64_t droppedFrames = 0;
+    int activeZone = -1;
+    bool frameOpen = false;
+};
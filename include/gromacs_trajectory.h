@@ -0,0 +1,51 @@
+#pragma once
+
+#include "mapped_file.h"
+#include "trajectory.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// GROMACS trajectories. Both formats are sequences of XDR (big-endian)
+// frames of varying size; open() walks the frame headers once to find every
+// frame, and big files keep the offsets in a sidecar (see FrameIndex) so
+// later opens seek straight to any frame. Coordinates are converted from nm.
+
+// Compressed coordinates (.xtc), including the 64-bit frame sizes of magic 2023
+class XtcTrajectory : public Trajectory {
+public:
+    bool open(const std::string &path);
+    void close();
+
+    const std::string &getPath() const override { return file.getPath(); }
+    size_t getFrameCount() const override { return offsets.empty() ? 0 : offsets.size() - 1; }
+    size_t getAtomCount(size_t) const override { return atomCount; }
+    bool readPositions(size_t frame, glm::vec4 *positions) const override;
+
+private:
+    bool buildIndex();
+
+    MappedFile file;
+    std::vector<uint64_t> offsets; // Frame starts, then the end of the last frame
+    size_t atomCount = 0;
+};
+
+// Full-precision frames (.trr), single or double precision. Frames without
+// coordinates (velocities or forces only) are skipped.
+class TrrTrajectory : public Trajectory {
+public:
+    bool open(const std::string &path);
+    void close();
+
+    const std::string &getPath() const override { return file.getPath(); }
+    size_t getFrameCount() const override { return offsets.empty() ? 0 : offsets.size() - 1; }
+    size_t getAtomCount(size_t) const override { return atomCount; }
+    bool readPositions(size_t frame, glm::vec4 *positions) const override;
+
+private:
+    bool buildIndex();
+
+    MappedFile file;
+    std::vector<uint64_t> offsets; // Starts of the frames with coordinates, then the end of the file's last frame
+    size_t atomCount = 0;
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+#include "renderer.h"
+
+// Batch rendering without UI: every input structure is rendered offscreen and
+// written as <outputDirectory>/<name>.png (or ray traced on the CPU). One GL context, renderer and set of
+// framebuffers is reused for all inputs; readback and PNG encoding run
+// asynchronously and overlap loading and drawing the next structure.
+struct HeadlessOptions {
+    std::vector<std::string> inputs;
+    std::string outputDirectory = ".";
+    int width = 512;
+    int height = 512;
+
+    // "single": one view over the whole image; "quad": front, side, top and perspective views
+    std::string layout = "single";
+    // Write only this region of the layout (e.g. "quad_tr"); empty writes the whole layout
+    std::string region;
+
+    RenderMode mode = RenderMode::BallAndStick;
+    glm::vec3 background = glm::vec3(0.1f, 0.1f, 0.1f);
+
+    // "auto", "hidden" (invisible window on the desktop platform), "egl" or "osmesa".
+    // Without a display, auto tries EGL and then OSMesa on GLFW's null platform.
+    std::string context = "auto";
+
+    // Render each structure as a tiled poster at the full --size (beyond GL's texture limits)
+    // instead of through the window-sized framebuffers; "png" or "tiff"
+    bool poster = false;
+    std::string format = "png";
+
+    // Ray trace each structure on the CPU instead, without a GL context (render farms without GPUs):
+    // `samples` per pixel, or as many as fit in `timeLimit` seconds, on `threads` cores (0: all)
+    bool rayTrace = false;
+    int samples = 64;
+    float timeLimit = 0.0f;
+    int threads = 0;
+
+    int compressionLevel = 1;   // zlib level; thumbnails favour speed
+    bool skipExisting = false;  // Resume an interrupted batch
+};
+
+// Parse the headless command line (arguments after the program name, "--headless" included).
+// Inputs are positional; "--list <file>" adds one path per line ("-" reads stdin).
+bool parseHeadlessArguments(const std::vector<std::string> &arguments, HeadlessOptions &options);
+void printHeadlessUsage();
+
+// Returns the process exit code: 0 if every structure was written
+int runHeadless(const HeadlessOptions &options);
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+// 8-bit RGBA image, rows stored top to bottom
+struct Image {
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> pixels;
+
+    void resize(int newWidth, int newHeight)
+    {
+        width = newWidth;
+        height = newHeight;
+        pixels.assign(static_cast<size_t>(width) * height * 4, 0);
+    }
+    uint8_t *row(int y) { return pixels.data() + static_cast<size_t>(y) * width * 4; }
+    const uint8_t *row(int y) const { return pixels.data() + static_cast<size_t>(y) * width * 4; }
+};
+
+// Row-streaming image file writer: open, append rows top to bottom, close.
+// The whole image never has to be in memory at once.
+class ImageStreamWriter {
+public:
+    virtual ~ImageStreamWriter() = default;
+
+    // channels: 3 (RGB) or 4 (RGBA)
+    virtual bool open(const std::string &path, int width, int height, int channels = 4) = 0;
+    // Append rows (top to bottom, tightly packed, `channels` bytes per pixel)
+    virtual bool writeRows(const uint8_t *rows, int rowCount) = 0;
+    // Finish the file; fails if fewer rows than the height were written
+    virtual bool close() = 0;
+};
+
+// PNG: rows are compressed as they arrive. Uses zlib when built with
+// MOLVIEW_HAVE_ZLIB, otherwise stored (uncompressed) deflate blocks.
+class PngWriter : public ImageStreamWriter {
+public:
+    PngWriter() = default;
+    ~PngWriter() override;
+    PngWriter(const PngWriter &) = delete;
+    PngWriter &operator=(const PngWriter &) = delete;
+
+    bool open(const std::string &path, int width, int height, int channels = 4) override;
+    bool writeRows(const uint8_t *rows, int rowCount) override;
+    bool close() override;
+
+    // zlib level (0-9), ignored without zlib. Low levels keep batch rendering CPU-light.
+    int compressionLevel = 3;
+
+private:
+    bool writeChunk(const char type[4], const uint8_t *data, size_t size);
+    bool deflateRow(const uint8_t *filtered, size_t size, bool last);
+    bool flushIdat();
+
+    std::FILE *file = nullptr;
+    std::string path;
+    int width = 0;
+    int height = 0;
+    int channels = 4;
+    int rowsWritten = 0;
+    bool failed = false;
+    std::vector<uint8_t> filteredRow;
+    std::vector<uint8_t> idat; // Pending compressed bytes
+    void *zstream = nullptr;   // z_stream when built with zlib
+    uint32_t adler = 1;        // Running Adler-32 for stored blocks
+};
+
+// Uncompressed baseline TIFF, written strip by strip. Switches to BigTIFF
+// (64-bit offsets) when the pixel data exceeds what classic TIFF can address,
+// e.g. a 32k x 32k RGBA poster.
+class TiffWriter : public ImageStreamWriter {
+public:
+    TiffWriter() = default;
+    ~TiffWriter() override;
+    TiffWriter(const TiffWriter &) = delete;
+    TiffWriter &operator=(const TiffWriter &) = delete;
+
+    bool open(const std::string &path, int width, int height, int channels = 4) override;
+    bool writeRows(const uint8_t *rows, int rowCount) override;
+    bool close() override;
+
+    // Stored as the XResolution/YResolution tags (print size of posters)
+    float dotsPerInch = 300.0f;
+
+private:
+    bool writeDirectory();
+    int getRowsPerStrip() const;
+
+    std::FILE *file = nullptr;
+    std::string path;
+    int width = 0;
+    int height = 0;
+    int channels = 4;
+    int rowsWritten = 0;
+    bool bigTiff = false;
+    bool failed = false;
+};
+
+// Writer for the path's extension: .tif/.tiff gives TIFF, anything else PNG (at the given zlib level)
+std::unique_ptr<ImageStreamWriter> createImageWriter(const std::string &path, int compressionLevel = 3);
+
+// Write a whole image as PNG (RGBA)
+bool writePng(const std::string &path, const Image &image);
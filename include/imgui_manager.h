@@ -5,12 +5,17 @@
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_opengl3.h>
 #include <implot.h>
+#include <glm/glm.hpp>
+#include "molecule_loader.h"
+#include "trajectory_streamer.h"
+#include <memory>
 #include <string>
 #include <functional>
 #include <vector>
 
 // Forward declarations
 class UIManager;
+class GpuProfiler;
 
 class ImGuiManager {
 public:
@@ -32,11 +37,32 @@ public:
     // Add UI panels for different regions
     void renderSidebarUI();
     void renderStatusUI();
+
+    // GPU timing table, timeline and histogram (Performance section of the sidebar)
+    void renderGpuTimings(GpuProfiler &profiler);
+    // Flame view of the CPU zones of the last frame
+    void renderCpuFlameView();
     
     // Property getters/setters (example for molecule viewer)
     void setMoleculeInfo(const std::string& name, int atoms, float radius);
     void setAppStatus(const std::string& status);
 
+    // Start loading a structure file in the background; once loaded it is shown in every view and
+    // multi-frame files stay open for the frame slider. Trajectory files (DCD, XTC, TRR) are played
+    // over the structure on screen instead. False if another file is still loading.
+    bool openMolecule(const std::string &path);
+    // Once per frame before the views render: report load progress, take a finished load and
+    // continue its GPU upload, swapping the new structure in when all of it is uploaded
+    void updateLoading();
+    // A file is being read or uploaded
+    bool isLoading() const;
+    // Move the playhead of the open trajectory; the frame appears once the streamer has it.
+    // direction is where the playhead goes next (prefetching follows it).
+    bool showTrajectoryFrame(size_t frame, int direction = 1);
+    // Once per frame before the views render: apply the newest streamed frame and advance
+    // playback. Never waits for the file.
+    void updateTrajectoryPlayback();
+
     // Add these to the public section of ImGuiManager class
     static void ImGuiMouseButtonCallback(GLFWwindow *window, int button, int action, int mods);
     static void ImGuiCursorPosCallback(GLFWwindow *window, double xpos, double ypos);
@@ -78,7 +104,30 @@ public:
     const BoundaryLineSettings &getBoundaryLineSettings() const { return boundaryLineSettings; }
 
     std::string appStatus = "Ready";
+
+    // Background loading; the loaded trajectory waits here while the molecule uploads
+    MoleculeLoader moleculeLoader;
+    std::unique_ptr<Trajectory> pendingTrajectory;
+    std::string pendingPath;
+
+    // Trajectory of the open file, streamed on its own thread, and the playhead
+    TrajectoryStreamer trajectoryStreamer;
+    int trajectoryFrame = 0;
+    bool framePending = false; // The playhead frame hasn't arrived yet
+    bool playing = false;
+    bool playBackwards = false;
+    float playbackFps = 30.0f;
+    double lastFrameAdvance = 0.0;
+    int frameCacheMegabytes = static_cast<int>(TrajectoryStreamer::DEFAULT_MEMORY_BUDGET >> 20);
+    char openPath[1024] = "";
     
     // UI colors and style
     void setupStyle();
+
+private:
+    void applyTrajectoryFrame(const StreamedFrame &frame);
+    // Continue the status bar line; false when text would run past rightEdge
+    bool placeStatusItem(const char *text, float rightEdge);
+    void publishLoad(MoleculeLoader::Result &result);
+    void finishMoleculeUpload();
 };
\ No newline at end of file
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+
+// Progress and cancellation of one file load, shared by the thread doing the
+// work and the UI showing it. Readers take an optional pointer: they report
+// their stage and the fraction done, and give up (returning false without an
+// error message) once isCancelled() is set.
+class LoadProgress {
+public:
+    enum class Stage {
+        Map,    // Open and map the file (or its binary cache)
+        Index,  // Find frame or chunk boundaries
+        Parse,
+        Bonds,  // Bond perception
+        Upload, // GPU buffers, spread over several frames
+    };
+
+    void begin(Stage next)
+    {
+        stage.store(next, std::memory_order_relaxed);
+        fraction.store(0.0f, std::memory_order_relaxed);
+        notify();
+    }
+    // Fraction of the current stage done, 0 to 1; may be called from several threads
+    void update(float done)
+    {
+        fraction.store(done, std::memory_order_relaxed);
+        notify();
+    }
+
+    void cancel() { cancelled.store(true, std::memory_order_relaxed); }
+    bool isCancelled() const { return cancelled.load(std::memory_order_relaxed); }
+    void reset()
+    {
+        cancelled.store(false, std::memory_order_relaxed);
+        begin(Stage::Map);
+    }
+
+    Stage getStage() const { return stage.load(std::memory_order_relaxed); }
+    float getFraction() const { return fraction.load(std::memory_order_relaxed); }
+
+    static const char *stageName(Stage stage)
+    {
+        switch (stage)
+        {
+        case Stage::Map:
+            return "map";
+        case Stage::Index:
+            return "index";
+        case Stage::Parse:
+            return "parse";
+        case Stage::Bonds:
+            return "bond perception";
+        case Stage::Upload:
+            return "GPU upload";
+        }
+        return "";
+    }
+
+    // Called on every change, from whichever thread made it (e.g. to wake the UI)
+    std::function<void()> onChange;
+
+private:
+    void notify()
+    {
+        if (onChange)
+        {
+            onChange();
+        }
+    }
+
+    std::atomic<Stage> stage{Stage::Map};
+    std::atomic<float> fraction{0.0f};
+    std::atomic<bool> cancelled{false};
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file. Readers parse straight out of the
+// mapping, so multi-gigabyte trajectories are paged in by the OS on demand
+// instead of being copied through stream buffers.
+class MappedFile {
+public:
+    // Access pattern hints passed on to the kernel (madvise / PrefetchVirtualMemory)
+    enum class Access {
+        Normal,
+        Sequential,
+        Random,
+    };
+
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+
+    // Returns false (after printing the reason) if the file can't be mapped. Empty files map to no data.
+    bool open(const std::string &path);
+    void close();
+
+    bool isOpen() const { return opened; }
+    const char *data() const { return bytes; }
+    size_t size() const { return length; }
+    const std::string &getPath() const { return path; }
+
+    void advise(Access access) const;
+    // Hint that a byte range is about to be read
+    void willNeed(size_t offset, size_t count) const;
+
+private:
+    std::string path;
+    const char *bytes = nullptr;
+    size_t length = 0;
+    bool opened = false;
+#if defined(_WIN32)
+    void *fileHandle = nullptr;
+    void *mappingHandle = nullptr;
+#endif
+};
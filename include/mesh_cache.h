@@ -0,0 +1,58 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Retained GPU geometry. Each mesh is keyed by a name (usually "<region>/<pass>")
+// and a content version; its VAO/VBO live across frames and the vertex data is
+// only re-uploaded when the caller hands in a different version.
+class MeshCache {
+public:
+    // A float vertex attribute inside an interleaved vertex
+    struct Attribute {
+        unsigned int location;
+        int components;
+        int offset; // in floats
+    };
+
+    struct Mesh {
+        unsigned int vao = 0;
+        unsigned int vbo = 0;
+        size_t capacityBytes = 0; // Size of the VBO storage
+        int vertexCount = 0;
+        uint64_t version = 0;
+    };
+
+    MeshCache() = default;
+    MeshCache(const MeshCache &) = delete;
+    MeshCache &operator=(const MeshCache &) = delete;
+
+    // Returns the cached mesh if it holds exactly this content version, nullptr otherwise.
+    // Lets callers skip building vertex data when nothing changed.
+    const Mesh *find(const std::string &key, uint64_t version) const;
+
+    // Returns the mesh for key, (re)uploading the vertices only if the cached version differs.
+    // stride is the number of floats per vertex.
+    const Mesh &upload(const std::string &key, uint64_t version,
+                       const float *vertices, int vertexCount, int stride,
+                       std::initializer_list<Attribute> layout);
+
+    // Free a single mesh or everything (needs a current GL context)
+    void release(const std::string &key);
+    void clear();
+
+    // Content hash for geometry that has no natural version counter (e.g. lines derived from the layout)
+    static uint64_t hashContent(const void *data, size_t bytes, uint64_t seed = 1469598103934665603ull);
+
+    // Number of buffer uploads since the cache was created (for diagnostics)
+    uint64_t getUploadCount() const { return uploadCount; }
+
+private:
+    std::unordered_map<std::string, Mesh> meshes;
+    uint64_t uploadCount = 0;
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "aligned_allocator.h"
+
+// Residue names (up to 5 characters in the CCD) stored inline, zero padded
+using ResidueName = std::array<char, 8>;
+
+inline ResidueName makeResidueName(std::string_view text)
+{
+    ResidueName name{};
+    for (size_t i = 0; i < text.size() && i + 1 < name.size(); ++i)
+    {
+        name[i] = text[i];
+    }
+    return name;
+}
+
+// Atoms of a loaded structure, one column per property. The per-atom columns are
+// cache-line aligned (AlignedVector) for the bandwidth-bound loops over all atoms.
+// Trajectory frames carry positions only; the rest is the topology, read once
+// with the structure and kept while frames play over it.
+struct Molecule {
+    std::string name;
+    AlignedVector<glm::vec4> positions; // xyz in Angstrom, w unused (16-byte stride matches the GPU buffer)
+    AlignedVector<uint8_t> elements;    // Atomic number per atom
+    AlignedVector<uint32_t> bonds;      // Pairs of atom indices, two entries per bond
+
+    // Residues and chains of macromolecular formats; all empty for formats without them (XYZ).
+    // The atoms of a residue and the residues of a chain are contiguous.
+    AlignedVector<uint32_t> atomResidues;    // Residue index per atom
+    std::vector<ResidueName> residueNames;   // Per residue
+    std::vector<int32_t> residueNumbers;     // Author numbering, per residue
+    std::vector<uint32_t> residueChains;     // Chain index per residue
+    std::vector<std::string> chainNames;     // Per chain
+
+    size_t getAtomCount() const { return positions.size(); }
+    size_t getBondCount() const { return bonds.size() / 2; }
+    size_t getResidueCount() const { return residueNames.size(); }
+    size_t getChainCount() const { return chainNames.size(); }
+
+    // Chain of an atom through its residue; only valid when the structure has residues
+    uint32_t getAtomChain(size_t atom) const { return residueChains[atomResidues[atom]]; }
+
+    // Axis-aligned box around the atom centers; false (and a zero box) without atoms
+    bool getBounds(glm::vec3 &minCorner, glm::vec3 &maxCorner) const
+    {
+        minCorner = maxCorner = positions.empty() ? glm::vec3(0.0f) : glm::vec3(positions[0]);
+        for (const glm::vec4 &position : positions)
+        {
+            minCorner = glm::min(minCorner, glm::vec3(position));
+            maxCorner = glm::max(maxCorner, glm::vec3(position));
+        }
+        return !positions.empty();
+    }
+};
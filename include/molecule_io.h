@@ -0,0 +1,29 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include "load_progress.h"
+#include "molecule.h"
+#include "trajectory.h"
+
+class XyzTrajectory;
+
+// Load the first structure of a file into `molecule`, choosing the reader from
+// the extension. Bonds are perceived from covalent radii when the format has
+// none. Returns false (after printing the reason) if the file can't be read.
+// Large structures are saved to a binary cache next to the file and loaded from
+// it while it is current (see structure_cache.h).
+// With `trajectory`, multi-frame formats are indexed in full and left open
+// there for random access to the other frames; it is closed for the rest.
+// With `progress`, stages are reported there and a cancelled load returns false.
+bool loadMolecule(const std::string &path, Molecule &molecule, XyzTrajectory *trajectory = nullptr,
+                  LoadProgress *progress = nullptr);
+
+// XYZ and extended XYZ: atom count, comment line, then "symbol x y z" per atom (first frame only)
+bool readXyz(const std::string &path, Molecule &molecule);
+
+// Coordinate-only trajectory (DCD, XTC, TRR) to play over a loaded structure with the same atoms,
+// chosen by extension. Returns nullptr (after printing the reason) if the file can't be opened.
+std::unique_ptr<Trajectory> openTrajectory(const std::string &path);
+// True for the extensions openTrajectory handles
+bool isTrajectoryFile(const std::string &path);
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "load_progress.h"
+#include "molecule.h"
+#include "trajectory.h"
+
+// Runs "Open Molecule" on a background thread so the window keeps drawing. A
+// structure file yields the molecule, with its trajectory if it has several
+// frames; a coordinate trajectory file (DCD, XTC, TRR) yields only the
+// trajectory, to be played over the structure on screen. The render thread
+// takes the result at a frame boundary and uploads it (Renderer::beginMoleculeUpload).
+class MoleculeLoader {
+public:
+    struct Result {
+        std::string path;
+        bool succeeded = false;
+        bool cancelled = false;
+        bool trajectoryOnly = false;            // A trajectory file: no molecule
+        Molecule molecule;
+        std::unique_ptr<Trajectory> trajectory; // Multi-frame structure, or the trajectory file
+    };
+
+    ~MoleculeLoader();
+
+    // Fails if a load is running
+    bool start(const std::string &path);
+    // Ask the running load to stop; returns at once and the result reports the cancellation
+    void cancel();
+    // Cancel and wait for the thread (before the window it wakes goes away)
+    void stop();
+    bool isRunning() const { return running.load(); }
+    const std::string &getPath() const { return path; }
+
+    // The finished load, once; nullptr while loading or idle
+    std::unique_ptr<Result> takeResult();
+
+    LoadProgress &getProgress() { return progress; }
+    const LoadProgress &getProgress() const { return progress; }
+
+private:
+    std::unique_ptr<Result> load(const std::string &filePath);
+
+    std::thread thread;
+    std::string path;
+    std::atomic<bool> running{false};
+    LoadProgress progress;
+    std::mutex resultMutex;
+    std::unique_ptr<Result> result;
+};
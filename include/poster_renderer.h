@@ -0,0 +1,41 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <string>
+#include "ui_region.h"
+
+class Renderer;
+
+struct PosterOptions {
+    int width = 16384;
+    int height = 16384;
+    // Tile size before the guard band; clamped to the GL texture and viewport limits.
+    // Tiles are wide and short so a band (one row of tiles) stays small in memory.
+    int tileWidth = 2048;
+    int tileHeight = 512;
+    // Extra pixels rendered around each tile and discarded, so screen-space effects
+    // that sample neighbours see the same surroundings as in a single large image
+    int guardBand = 16;
+    int compressionLevel = 1; // PNG only
+    float dotsPerInch = 300.0f; // TIFF only
+};
+
+// Renders one view at sizes no single framebuffer can hold (16k-32k pixel
+// figures). The view frustum is cut into off-axis sub-frusta, one per tile; each
+// tile is drawn into a reusable framebuffer, and complete bands of tiles are
+// streamed to a PNG or TIFF writer (by extension) on a worker thread while the
+// next band renders. At most two bands are ever held in memory.
+class PosterRenderer {
+public:
+    bool render(Renderer &renderer, const UIRegion &region, const std::string &path, const PosterOptions &options);
+    void destroy();
+
+private:
+    void ensureTarget(int width, int height);
+
+    GLuint framebuffer = 0;
+    GLuint colorTexture = 0;
+    GLuint depthTexture = 0;
+    int targetWidth = 0;
+    int targetHeight = 0;
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "camera.h"
+#include "molecule.h"
+
+struct RayTraceOptions {
+    int width = 1920;
+    int height = 1080;
+    // Samples per pixel; every progressive pass adds one sample to each pixel
+    int samples = 64;
+    // Stop refining after this many seconds and write what has converged (0: no limit)
+    float timeLimit = 0.0f;
+    int aoSamples = 1;           // Ambient occlusion rays per sample
+    float aoDistance = 5.0f;     // Angstrom; occluders farther away don't darken
+    float lightAngle = 0.08f;    // Angular radius of the key light in radians; 0 gives hard shadows
+    int tileSize = 32;
+    size_t threadCount = 0;      // 0: ThreadPool::defaultThreadCount()
+    int compressionLevel = 3;    // PNG only
+    float dotsPerInch = 300.0f;  // TIFF only
+};
+
+// Everything a render needs, captured when it starts so the interactive view can keep changing
+struct RayTraceScene {
+    Molecule molecule;
+    float atomRadiusScale = 0.25f;  // Fraction of the van der Waals radius; 0 hides the atoms
+    float bondRadius = 0.15f;       // Angstrom; 0 hides the bonds
+    std::vector<glm::vec4> palette; // Color per color index, as used by the GL renderers
+    Camera camera;
+    glm::vec3 background = glm::vec3(0.1f, 0.1f, 0.1f);
+};
+
+// Offline CPU renderer for publication images, independent of the GL context.
+// Atoms become spheres and bonds capped cylinders (colored by half, as in the
+// impostor shaders) in a binned-SAH BVH. The image is cut into tiles; each
+// worker starts on its own contiguous share and steals tiles from the others'
+// shares once it runs dry. Every pass adds one jittered sample per pixel with a
+// soft-shadow ray and ambient occlusion rays, so the image converges
+// progressively and a time limit still yields a complete picture.
+class RayTracer {
+public:
+    struct Progress {
+        bool running = false;
+        bool succeeded = false;
+        int samplesDone = 0;
+        int samples = 0;
+        float seconds = 0.0f;
+        std::string path;
+    };
+
+    ~RayTracer();
+
+    // Render to a PNG or TIFF file (by extension) and block until it is written
+    bool render(const RayTraceScene &scene, const RayTraceOptions &options, const std::string &path);
+    // Same on a background thread; fails if a render is already running
+    bool start(RayTraceScene scene, const RayTraceOptions &options, const std::string &path);
+    // Abandon the running render without writing it; returns once it stopped
+    void cancel();
+
+    bool isRunning() const;
+    Progress getProgress() const;
+
+    // Called on the render thread after every pass and when a render ends (e.g. to wake the UI)
+    std::function<void()> onProgress;
+
+private:
+    bool run(const RayTraceScene &scene, const RayTraceOptions &options, const std::string &path);
+    void reportProgress(int samplesDone, float seconds);
+
+    std::thread thread;
+    std::atomic<bool> cancelRequested{false};
+    mutable std::mutex progressMutex;
+    Progress progress;
+};
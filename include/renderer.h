@@ -9,6 +9,33 @@
 #include <map>
 #include "ui_region.h"
 #include "ui_manager.h"
+#include "mesh_cache.h"
+#include "framebuffer_pool.h"
+#include "shader.h"
+#include "gl_state.h"
+#include "gpu_profiler.h"
+#include "camera.h"
+#include "atom_renderer.h"
+#include "bond_renderer.h"
+#include "molecule.h"
+#include "frame_capture.h"
+#include "poster_renderer.h"
+#include "ray_tracer.h"
+
+// Molecular representations offered in the sidebar
+enum class RenderMode {
+    BallAndStick,
+    SpaceFilling,
+    Wireframe,
+    Ribbon
+};
+
+// Sizes a representation draws atoms and bonds at; shared by the GL view and the ray tracer
+struct RepresentationStyle {
+    float atomRadiusScale = 0.0f; // Fraction of the van der Waals radius, 0 hides the atoms
+    float bondRadius = 0.0f;      // Angstrom, 0 hides the bonds
+};
+RepresentationStyle getRepresentationStyle(RenderMode mode);
 
 class Renderer {
 public:
@@ -18,29 +45,118 @@ public:
 
     void setUIManager(UIManager *manager) { uiManager = manager; }
 
+    // Renders the region into its framebuffer, unless the cached image is still current
     void renderRegion(const UIRegion& region);
 
+    // Invalidation: a region is re-rendered only when its content, its camera,
+    // the shared scene or its framebuffer size changed since the last render
+    void invalidateRegion(const std::string &regionName);
+    void invalidateCamera(const std::string &regionName);
+    void invalidateAll();
+
     // Framebuffer methods and type
     void createFramebufferForRegion(const UIRegion &region);
     void bindFramebufferForRegion(const std::string &regionName);
     void unbindFramebuffer();
-    void renderFramebufferToScreen(const UIRegion &region);
     void resizeFramebuffer(const UIRegion* region, int width, int height);
     void cleanupFramebuffers();
+
+    // Draw every region's framebuffer layer to the window in a single draw call
+    void compositeRegions();
+
+    // Queue an asynchronous PNG capture of the region images at their layout positions, window-sized;
+    // areas without a framebuffer (sidebar, status bar) get the background color
+    bool captureLayout(const std::string &path);
+    // Queue a capture of a single region's last rendered image
+    bool captureRegion(const std::string &regionName, const std::string &path);
+
+    // Render a region's view at poster size, tile by tile, straight to a PNG or TIFF file (blocks until written)
+    bool savePoster(const std::string &regionName, const std::string &path, const PosterOptions &options);
+    // Draw a region's scene as one tile of an imageWidth x imageHeight image into the bound framebuffer;
+    // (tileX, tileY) is the tile's bottom-left pixel in the image
+    void renderRegionTile(const UIRegion &region, int imageWidth, int imageHeight,
+                          int tileX, int tileY, int tileWidth, int tileHeight);
+
+    // Ray trace a region's view of the current structure on the CPU, in the background;
+    // progress and the result are reported by rayTracer
+    bool startRayTrace(const std::string &regionName, const std::string &path, const RayTraceOptions &options);
+
+    // While a boundary is dragged, resizes only move the sub-viewport inside the
+    // pooled storage (growing it with headroom when needed); storage is settled
+    // to a tight bucket when the drag ends.
+    void beginDeferredResize();
+    void endDeferredResize();
     // Draw boundary lines between UI regions
     void renderBoundaryLines(const std::vector<UIRegion> &regions, float lineWidth = 2.0f, glm::vec3 lineColor = glm::vec3(0.3f, 0.3f, 0.3f));
 
     struct FramebufferObject {
-        unsigned int fbo;          // Framebuffer object
-        unsigned int colorTexture; // Color attachment
-        unsigned int depthRbo;     // Depth renderbuffer
-        int width;                 // Width in pixels
-        int height;                // Height in pixels
+        FramebufferPool::Attachment storage; // Layer of the pooled array, at least as large as the region
+        int width;                           // Rendered width in pixels
+        int height;                          // Rendered height in pixels
     };
     std::map<std::string, FramebufferObject> framebuffers;
+    FramebufferPool framebufferPool;
+
+    // What each region's framebuffer currently shows
+    struct RegionRenderState {
+        uint64_t contentVersion = 1;
+        uint64_t cameraVersion = 1;
+        uint64_t renderedContentVersion = 0;
+        uint64_t renderedCameraVersion = 0;
+        uint64_t renderedSceneVersion = 0;
+        int renderedLayer = -1;
+        uint64_t renderedStorageGeneration = 0;
+        int renderedWidth = 0;
+        int renderedHeight = 0;
+        const char *profileZoneName = nullptr; // Interned "renderRegion <name>"
+        std::string gpuZoneName;               // "region <name>"
+    };
+    std::map<std::string, RegionRenderState> regionStates;
+    uint64_t sceneVersion = 1; // Bumped by changes that affect every region
+    bool needsRender(const UIRegion &region);
+    bool deferResize = false;
+
+    // Growth headroom during drags (1/N of the size) and shrink hysteresis in buckets
+    static constexpr int FRAMEBUFFER_DRAG_HEADROOM = 4;
+    static constexpr int FRAMEBUFFER_SHRINK_SLACK = 2;
+    bool isWastingStorage() const;
+    // Resize the shared layer storage to a tight bucket around the largest region
+    void fitFramebufferStorage();
+
+    // Molecule rendering
+    // Atoms and bonds with the camera the caller bound
+    void renderMolecule();
+    // Replace the structure; the cameras stay where they are
+    void setMolecule(const Molecule &molecule);
+    // Point every view's camera at the current structure
+    void frameMolecule();
+
+    // Replace the structure without a long frame: beginMoleculeUpload() keeps the molecule
+    // and sets aside new GPU buffers, continueMoleculeUpload() fills them with at most
+    // maxBytes per call (once per frame), and the call that finishes swaps buffers and
+    // currentMolecule in one step. Until then the old structure stays on screen.
+    void beginMoleculeUpload(Molecule molecule);
+    // True once the new molecule is on screen
+    bool continueMoleculeUpload(size_t maxBytes);
+    void cancelMoleculeUpload();
+    bool isUploadingMolecule() const { return moleculeUploading; }
+    float getMoleculeUploadProgress() const;
+    Molecule pendingMolecule;
+    bool moleculeUploading = false;
+    // Upload per frame; a few milliseconds of copying on current drivers
+    static constexpr size_t MOLECULE_UPLOAD_BYTES_PER_FRAME = 16 << 20;
+
+    // New coordinates for the current structure (e.g. a trajectory frame); bonds follow automatically
+    void updateAtomPositions(const glm::vec4 *positions, size_t count);
+    bool hasMolecule() const { return atomRenderer.getAtomCount() > 0; }
+    // CPU copy of the structure on the GPU, for renderers that don't go through GL
+    Molecule currentMolecule;
+    void setRenderMode(RenderMode mode);
+    RenderMode renderMode = RenderMode::BallAndStick;
+    AtomRenderer atomRenderer;
+    BondRenderer bondRenderer;
 
     // Future methods for specialized rendering
-    void renderMolecule(const UIRegion& region); /* Molecule data */
     void renderGraph(const UIRegion& region); /* Graph data */
     void renderControls(const UIRegion& region);
     
@@ -51,13 +167,43 @@ public:
     void setBackgroundColor(float r, float g, float b);
 
     // Shaders
-    unsigned int basicShaderProgram;
-    unsigned int triangleShaderProgram;
-    unsigned int framebufferShaderProgram;
-    unsigned int lineShaderProgram = 0;
+    ShaderCache shaderCache;
+    Shader basicShader;
+    Shader triangleShader;
+    Shader framebufferShader;
+    Shader lineShader;
+
+    // Uniform handles, resolved once in initShaders()
+    Uniform<glm::vec4> triangleColorUniform;
+    Uniform<int> framebufferTextureUniform;
+    Uniform<glm::vec4> lineColorUniform;
+
+    // Per-view camera data, shared by all programs through CameraBlock
+    std::map<std::string, Camera> cameras;
+    CameraBuffer cameraBuffer;
+    void bindCameraForRegion(const UIRegion &region, int width, int height);
+    void bindScreenCamera(int width, int height);
 
     void drawGridLines();
 
+    // Retained VAO/VBOs for region content and overlay lines
+    MeshCache meshCache;
+
+    // All pipeline state changes go through here (no glGet* on the render path)
+    GLStateCache glState;
+
+    // GPU time per region render and per pass
+    GpuProfiler gpuProfiler;
+
+    // Readback ring and PNG encoder threads for screenshots and image sequences
+    FrameCapture frameCapture;
+
+    // Reusable tile framebuffer for posters
+    PosterRenderer posterRenderer;
+
+    // Offline CPU renderer for ray traced images
+    RayTracer rayTracer;
+
     // Reference to the window
     GLFWwindow *window = nullptr;
 
@@ -68,8 +214,7 @@ public:
     void initShaders();
     
     // Utility methods
-    unsigned int compileShader(unsigned int type, const char* source);
-    unsigned int createShaderProgram(const char* vertexSource, const char* fragmentSource);
+    void drawPlaceholderTriangle(const std::string &regionName, const float (&vertices)[9], const glm::vec4 &color);
     
     // Background color
     glm::vec3 backgroundColor = glm::vec3(0.1f, 0.1f, 0.1f);
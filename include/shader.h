@@ -0,0 +1,133 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "gl_state.h"
+#include "shader_cache.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Uniform block binding points shared by every program
+enum UniformBlockBinding : unsigned int {
+    CAMERA_BLOCK_BINDING = 0,
+};
+
+// Shader storage block binding points (fixed with layout(binding = N) in GLSL)
+enum StorageBlockBinding : unsigned int {
+    COLOR_PALETTE_BINDING = 0,
+    ATOM_POSITION_BINDING = 1,
+    ATOM_ATTRIBUTE_BINDING = 2,
+};
+
+// Typed handle to an active uniform. Resolved once after linking, so setting a
+// uniform never goes through glGetUniformLocation again.
+template <typename T>
+struct Uniform {
+    GLint location = -1;
+    int slot = -1; // Index into the program's shadow copy of uniform values
+
+    bool isValid() const { return location >= 0; }
+};
+
+class Shader {
+public:
+    // Reflection data for one active uniform
+    struct UniformInfo {
+        std::string name;
+        GLint location;
+        GLenum type;
+        GLint size;
+    };
+
+    Shader() = default;
+    Shader(const Shader &) = delete;
+    Shader &operator=(const Shader &) = delete;
+
+    // Compile, link and reflect the program. Returns false (and logs) on failure.
+    bool create(const std::string &name, const char *vertexSource, const char *fragmentSource,
+                ShaderCache *cache = nullptr);
+    void destroy();
+
+    // create() in two steps, so several programs build at once: begin() takes the program from
+    // the cache or submits compile and link without waiting for them; finish() waits for the
+    // result, reports errors, reflects and stores new binaries in the cache.
+    void begin(const std::string &name, const char *vertexSource, const char *fragmentSource,
+               ShaderCache *cache = nullptr);
+    bool finish();
+    bool isPending() const { return pending; }
+
+    unsigned int getId() const { return program; }
+    const std::string &getName() const { return name; }
+    bool isValid() const { return program != 0; }
+
+    void use(GLStateCache &state) const { state.useProgram(program); }
+
+    // Typed handle for an active uniform. Missing uniforms and type mismatches
+    // are reported here, once, instead of silently failing every frame.
+    template <typename T>
+    Uniform<T> uniform(const std::string &uniformName) const;
+
+    // Upload a uniform value. Values equal to the last upload are skipped.
+    // Uses glProgramUniform*, so the program does not need to be bound.
+    void set(const Uniform<int> &handle, int value);
+    void set(const Uniform<float> &handle, float value);
+    void set(const Uniform<glm::vec2> &handle, const glm::vec2 &value);
+    void set(const Uniform<glm::vec3> &handle, const glm::vec3 &value);
+    void set(const Uniform<glm::vec4> &handle, const glm::vec4 &value);
+    void set(const Uniform<glm::mat4> &handle, const glm::mat4 &value);
+
+    // Index of an active uniform block, or GL_INVALID_INDEX
+    GLuint uniformBlock(const std::string &blockName) const;
+    const std::vector<UniformInfo> &getUniforms() const { return uniforms; }
+
+    // Compile a single stage, returns 0 on failure
+    static unsigned int compileStage(unsigned int type, const char *source);
+
+private:
+    void reflect();
+    const UniformInfo *findUniform(const std::string &uniformName, GLenum expectedType) const;
+    // True if the value differs from the shadow copy (and updates the copy)
+    bool changed(int slot, const float *value, int count);
+
+    std::string name;
+    unsigned int program = 0;
+
+    // Between begin() and finish()
+    bool pending = false;
+    bool fromCache = false;
+    unsigned int vertexShader = 0;
+    unsigned int fragmentShader = 0;
+    ShaderCache *cache = nullptr;
+    uint64_t sourceHash = 0;
+
+    std::vector<UniformInfo> uniforms;
+    std::unordered_map<std::string, size_t> uniformIndex;
+    std::unordered_map<std::string, GLuint> blocks;
+
+    // Last uploaded value per uniform (16 floats fits a mat4)
+    std::vector<float> shadowValues;
+    std::vector<bool> shadowValid;
+};
+
+// Map C++ types to GL uniform types for the typed handles
+template <typename T> struct UniformType;
+template <> struct UniformType<int> { static constexpr GLenum value = GL_INT; };
+template <> struct UniformType<float> { static constexpr GLenum value = GL_FLOAT; };
+template <> struct UniformType<glm::vec2> { static constexpr GLenum value = GL_FLOAT_VEC2; };
+template <> struct UniformType<glm::vec3> { static constexpr GLenum value = GL_FLOAT_VEC3; };
+template <> struct UniformType<glm::vec4> { static constexpr GLenum value = GL_FLOAT_VEC4; };
+template <> struct UniformType<glm::mat4> { static constexpr GLenum value = GL_FLOAT_MAT4; };
+
+template <typename T>
+Uniform<T> Shader::uniform(const std::string &uniformName) const
+{
+    Uniform<T> handle;
+    const UniformInfo *info = findUniform(uniformName, UniformType<T>::value);
+    if (info)
+    {
+        handle.location = info->location;
+        handle.slot = static_cast<int>(info - uniforms.data());
+    }
+    return handle;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <cstdint>
+#include <string>
+
+// On-disk cache of linked program binaries (glGetProgramBinary). Entries are
+// keyed by a hash of the program's sources together with the driver's vendor,
+// renderer and version strings, so an edited shader or an updated driver
+// simply misses and the program is compiled from source again. Binaries the
+// driver refuses to load are treated as misses and overwritten.
+class ShaderCache {
+public:
+    struct Stats {
+        int hits = 0;
+        int misses = 0;
+        int stores = 0;
+    };
+
+    // Query binary and parallel compile support; needs the GL context. An empty directory disables the cache.
+    void init(const std::string &cacheDirectory);
+    bool isEnabled() const { return enabled; }
+    // KHR/ARB_parallel_shader_compile: compiles and links run on driver threads until their status is queried
+    bool hasParallelCompile() const { return parallelCompile; }
+
+    // A program linked from the cached binary of these sources, or 0 on a miss
+    GLuint load(const std::string &programName, uint64_t sourceHash);
+    // Save a successfully linked program (linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT)
+    void store(const std::string &programName, uint64_t sourceHash, GLuint program);
+
+    static uint64_t hashSources(const char *vertexSource, const char *fragmentSource);
+    // Per-user cache location for the platform, empty if there is none
+    static std::string defaultDirectory();
+
+    const Stats &getStats() const { return stats; }
+
+private:
+    std::string entryPath(const std::string &programName, uint64_t sourceHash) const;
+
+    std::string directory;
+    uint64_t driverHash = 0;
+    bool enabled = false;
+    bool parallelCompile = false;
+    Stats stats;
+};
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "molecule.h"
+
+// Structures smaller than this parse about as fast as a cache loads; they get no cache file
+constexpr uint64_t STRUCTURE_CACHE_MIN_FILE_BYTES = 16ull << 20;
+
+// Parsed structures (atoms, bonds, residues, chains) saved next to the source file as
+// "<file>.mvmol", so later loads skip parsing and bond perception. The file is
+// little-endian and versioned: a header, a section table, then one section per
+// Molecule column in its in-memory layout, each 64-byte aligned, so loading maps
+// the file and copies every column in a single block. A cache is only used while
+// the source's size, modification time and a hash of its first and last
+// megabyte match the ones it was written from.
+
+// False without a valid cache for the source (a missing or stale cache is not an error)
+bool loadStructureCache(const std::string &sourcePath, Molecule &molecule);
+// Best effort: read-only directories simply get no cache
+void saveStructureCache(const std::string &sourcePath, const Molecule &molecule);
+
+std::string structureCachePath(const std::string &sourcePath);
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include "load_progress.h"
+#include "molecule.h"
+
+// Readers for macromolecular structure files. The file is mapped and split
+// into line-aligned chunks that are parsed in parallel, each into its own
+// atom columns and residue table; the residue and chain tables are merged in
+// file order afterwards. Only the first model is read. Both return false
+// (after printing the reason) if the file can't be read.
+//
+// threadCount 0 uses ThreadPool::defaultThreadCount(). With `progress`, the
+// stages and parsed chunks are reported and a cancelled load returns false.
+
+// PDB: ATOM/HETATM records (hybrid-36 residue numbers), chains split at TER
+bool readPdb(const std::string &path, Molecule &molecule, size_t threadCount = 0, LoadProgress *progress = nullptr);
+
+// PDBx/mmCIF: the _atom_site loop, one row per line as written by the PDB and
+// common tools. Rows are parsed column by column in place, without tokenizing.
+bool readMmcif(const std::string &path, Molecule &molecule, size_t threadCount = 0,
+               LoadProgress *progress = nullptr);
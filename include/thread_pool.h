@@ -0,0 +1,44 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads running queued jobs in submission order.
+// Jobs must not touch GL; anything GL stays on the thread owning the context.
+class ThreadPool {
+public:
+    // threadCount 0 uses defaultThreadCount()
+    explicit ThreadPool(size_t threadCount = 0, const std::string &name = "worker");
+    ~ThreadPool();
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    void submit(std::function<void()> job);
+    // Block until the queue is empty and no job is running
+    void waitIdle();
+
+    size_t getThreadCount() const { return threads.size(); }
+    // Queued plus running jobs
+    size_t getPendingCount();
+
+    // All hardware threads but one (left to the render loop), at least one
+    static size_t defaultThreadCount();
+
+private:
+    void workerLoop();
+
+    std::vector<std::thread> threads;
+    std::vector<std::string> threadNames; // Kept alive for the profiler
+    std::deque<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable jobAvailable;
+    std::condition_variable jobsDone;
+    size_t runningJobs = 0;
+    bool stopping = false;
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <string>
+#include "molecule.h"
+
+// Coordinate frames of a trajectory file with random access to any frame.
+// Readers parse straight out of a memory mapping and keep no per-read state,
+// so frames may be read from several threads at once.
+class Trajectory {
+public:
+    virtual ~Trajectory() = default;
+
+    virtual const std::string &getPath() const = 0;
+    virtual size_t getFrameCount() const = 0;
+    virtual size_t getAtomCount(size_t frame) const = 0;
+
+    // Positions of a frame in Angstrom (getAtomCount(frame) entries, w = 0).
+    // Returns false (after printing the reason) if the frame is damaged.
+    virtual bool readPositions(size_t frame, glm::vec4 *positions) const = 0;
+
+    // Positions and elements of a frame, for trajectories whose atoms change between
+    // frames; no bonds. Coordinate-only formats leave the elements unknown (0).
+    // Returns false (after printing the reason) if the frame is damaged.
+    virtual bool readFrame(size_t frame, Molecule &molecule) const
+    {
+        molecule = Molecule();
+        molecule.positions.resize(getAtomCount(frame));
+        molecule.elements.assign(molecule.positions.size(), 0);
+        return readPositions(frame, molecule.positions.data());
+    }
+};
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "aligned_allocator.h"
+#include "trajectory.h"
+
+// Positions of one decoded trajectory frame, shared by the frame cache and the renderer
+struct StreamedFrame {
+    size_t index = 0;
+    AlignedVector<glm::vec4> positions;
+    // Elements and bonds of the frame (no positions), for trajectories whose atom count
+    // changes between frames; nullptr when all frames have the same atoms
+    std::shared_ptr<const Molecule> topology;
+    bool failed = false; // The frame could not be read (the reader printed why)
+};
+
+// Plays a trajectory without the render loop ever reading the file. A dedicated
+// thread decodes the requested frame, then prefetches around the playhead in both
+// directions (most of the window in the playback direction, wrapping at the ends).
+// Decoded frames live in an LRU cache bounded by a memory budget; the cache belongs
+// to the streaming thread alone. Finished frames reach the render thread through a
+// single atomic slot, so takeFrame() never waits. When the atom count varies
+// between frames (grand canonical runs), each frame's topology is read and its
+// bonds perceived on the streaming thread as well.
+class TrajectoryStreamer {
+public:
+    struct Stats {
+        uint64_t requests = 0;
+        uint64_t hits = 0;         // Requests served from the cache
+        uint64_t decoded = 0;      // Frames decoded, requested or prefetched
+        float decodeMs = 0.0f;     // Moving average over recent decodes
+        float lastDecodeMs = 0.0f;
+        size_t cachedFrames = 0;
+        size_t cachedBytes = 0;
+        size_t memoryBudget = 0;
+
+        float getHitRate() const { return requests > 0 ? static_cast<float>(hits) / requests : 0.0f; }
+    };
+
+    TrajectoryStreamer() = default;
+    ~TrajectoryStreamer();
+    TrajectoryStreamer(const TrajectoryStreamer &) = delete;
+    TrajectoryStreamer &operator=(const TrajectoryStreamer &) = delete;
+
+    // Stream frames of this trajectory (replaces the previous one and empties the cache)
+    void open(std::unique_ptr<Trajectory> trajectory);
+    void close();
+    const Trajectory *getTrajectory() const { return trajectory.get(); }
+    size_t getFrameCount() const { return trajectory ? trajectory->getFrameCount() : 0; }
+
+    // Ask for a frame; returns at once. direction (+1 or -1) is where the playhead
+    // moves next, so prefetching favors it.
+    void request(size_t frame, int direction = 1);
+    // Newest frame finished since the last call, or nullptr. Lock-free.
+    std::shared_ptr<const StreamedFrame> takeFrame();
+
+    void setMemoryBudget(size_t bytes);
+    size_t getMemoryBudget() const { return memoryBudget.load(std::memory_order_relaxed); }
+
+    Stats getStats() const;
+
+    // Called on the streaming thread whenever a frame is ready for takeFrame() (e.g. to wake the UI)
+    std::function<void()> onFrameReady;
+
+    static constexpr size_t DEFAULT_MEMORY_BUDGET = size_t(512) << 20;
+    // Share of the prefetch window ahead of the playhead; the rest goes behind it
+    static constexpr float AHEAD_FRACTION = 0.75f;
+    // Upper bound on the prefetch window; frames beyond it are cached only once visited
+    static constexpr size_t MAX_PREFETCH_FRAMES = 1024;
+
+private:
+    struct CacheEntry {
+        std::shared_ptr<const StreamedFrame> frame;
+        std::list<size_t>::iterator recent;
+        uint64_t pass = 0; // Request serial the frame was last used for
+    };
+
+    void run();
+    // From the cache (counts as most recently used) or decoded and cached
+    std::shared_ptr<const StreamedFrame> fetch(size_t frame, bool *hit);
+    std::shared_ptr<const StreamedFrame> decode(size_t frame);
+    void touch(CacheEntry &entry);
+    void insert(const std::shared_ptr<const StreamedFrame> &frame);
+    // Drop least recently used frames until the cache fits the budget
+    void evict(size_t budget);
+    // Decode the nearest frame of the prefetch window that is not cached; false once all are
+    bool prefetchNext(size_t playhead, int direction);
+    void publish(std::shared_ptr<const StreamedFrame> frame);
+
+    std::unique_ptr<Trajectory> trajectory;
+    std::thread thread;
+
+    // Request state, written by the render thread
+    std::mutex mutex;
+    std::condition_variable workAvailable;
+    size_t requestedFrame = 0;
+    int requestedDirection = 1;
+    uint64_t requestSerial = 0;
+    bool budgetChanged = false;
+    bool stopping = false;
+    std::atomic<size_t> memoryBudget{DEFAULT_MEMORY_BUDGET};
+
+    // Handoff slot: owned pointer, exchanged in by the streaming thread and out by takeFrame()
+    std::atomic<std::shared_ptr<const StreamedFrame> *> ready{nullptr};
+
+    // Frame cache, streaming thread only
+    std::unordered_map<size_t, CacheEntry> cache;
+    std::list<size_t> recentFrames; // Most recently used first
+    size_t cachedBytes = 0;
+    uint64_t currentPass = 0;
+    bool variableAtomCount = false; // Frames carry their own topology
+    size_t prefetchStep = 1; // Where the window scan of the current pass resumes
+    // Set when eviction dropped a frame of the current pass: the window outgrew the budget
+    bool windowFull = false;
+
+    // Statistics, published by the streaming thread
+    std::atomic<uint64_t> requestCount{0};
+    std::atomic<uint64_t> hitCount{0};
+    std::atomic<uint64_t> decodedCount{0};
+    std::atomic<float> averageDecodeMs{0.0f};
+    std::atomic<float> lastDecodeMs{0.0f};
+    std::atomic<size_t> cachedFrameCount{0};
+    std::atomic<size_t> cachedByteCount{0};
+};
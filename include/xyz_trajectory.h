@@ -0,0 +1,72 @@
+#pragma once
+
+#include "load_progress.h"
+#include "mapped_file.h"
+#include "molecule.h"
+#include "trajectory.h"
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Multi-frame XYZ and extended XYZ file with random access to every frame.
+// open() maps the file and records where each frame starts in one pass that
+// counts newlines 64 bytes at a time; reading a frame then parses only that
+// frame's lines, straight from the mapping with std::from_chars. Big files
+// with a fixed atom count keep this index in a sidecar (see FrameIndex).
+//
+// Frames may have different atom counts. The extended XYZ "Properties=" key in
+// a frame's comment line selects the species (S) or atomic number (Z:I) column
+// and the pos:R:3 columns; without it the columns are "symbol x y z".
+class XyzTrajectory : public Trajectory {
+public:
+    // Index at most frameLimit frames (loading a single structure only needs the first).
+    // With `progress`, indexing is reported and a cancelled open returns false.
+    bool open(const std::string &path, size_t frameLimit = std::numeric_limits<size_t>::max(),
+              LoadProgress *progress = nullptr);
+    void close();
+
+    bool isOpen() const { return file.isOpen(); }
+    const std::string &getPath() const override { return file.getPath(); }
+    size_t getFrameCount() const override { return frames.size(); }
+    size_t getAtomCount(size_t frame) const override { return frames[frame].atomCount; }
+    // Bytes of the mapped file, for progress and status display
+    size_t getFileSize() const { return file.size(); }
+
+    // The frame's comment line, without the line break
+    std::string_view getComment(size_t frame) const;
+
+    // Elements and positions of a frame (bonds are left empty). Returns false
+    // (after printing the reason) if the frame is malformed.
+    bool readFrame(size_t frame, Molecule &molecule) const override;
+    // Positions only, into `positions` (getAtomCount(frame) entries, w = 0)
+    bool readPositions(size_t frame, glm::vec4 *positions) const override;
+
+private:
+    struct Frame {
+        uint64_t offset;    // First byte of the atom count line
+        uint64_t atomCount;
+    };
+
+    // Where the columns of one frame are, in whitespace-separated fields
+    struct Columns {
+        int species = 0;
+        int position = 1;
+        bool atomicNumbers = false; // Species column holds Z instead of symbols
+    };
+
+    // Scan the mapped file for frame starts
+    void buildIndex(size_t frameLimit, LoadProgress *progress);
+    bool parseColumns(size_t frame, Columns &columns) const;
+    bool readAtoms(size_t frame, glm::vec4 *positions, uint8_t *elements) const;
+    // Offset of the first atom line of a frame
+    size_t atomsOffset(size_t frame) const;
+    size_t frameEnd(size_t frame) const;
+
+    MappedFile file;
+    std::vector<Frame> frames;
+    // End of the last indexed frame
+    size_t indexedEnd = 0;
+};
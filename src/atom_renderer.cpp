@@ -0,0 +1,300 @@
+#include "atom_renderer.h"
+#include "camera.h"
+#include "elements.h"
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Sphere impostor vertex shader: one camera-facing quad per instance
+const std::string atomVertexShaderSource = std::string(R"(
+    #version 460 core
+    layout (location = 0) in vec3 aCenter;
+    layout (location = 1) in float aRadius;
+    layout (location = 2) in uint aColorIndex;
+)") + cameraBlockGlsl + R"(
+    layout (std430, binding = 0) readonly buffer ColorPalette
+    {
+        vec4 palette[];
+    };
+
+    uniform float uRadiusScale;
+
+    out vec3 vViewPosition;
+    flat out vec3 vCenter;
+    flat out float vRadius;
+    flat out vec3 vColor;
+
+    void main()
+    {
+        // Corner of the quad from the vertex index (triangle strip order)
+        vec2 corner = vec2(float(gl_VertexID & 1), float(gl_VertexID >> 1)) * 2.0 - 1.0;
+
+        float radius = aRadius * uRadiusScale;
+        vec3 center = (camera.view * vec4(aCenter, 1.0)).xyz;
+        float dist = max(length(center), 1e-4);
+
+        // The quad sits in the plane through the center, perpendicular to the eye ray,
+        // and is exactly as large as the sphere's silhouette cone at that distance.
+        vec3 forward = center / dist;
+        vec3 helper = abs(forward.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0);
+        vec3 right = normalize(cross(forward, helper));
+        vec3 up = cross(right, forward);
+        float halfSize = radius * dist / sqrt(max(dist * dist - radius * radius, 1e-6));
+
+        vec3 position = center + (right * corner.x + up * corner.y) * halfSize;
+
+        vViewPosition = position;
+        vCenter = center;
+        vRadius = radius;
+        vColor = palette[aColorIndex].rgb;
+        gl_Position = camera.projection * vec4(position, 1.0);
+    }
+)";
+
+// Sphere impostor fragment shader: ray/sphere intersection in view space
+const std::string atomFragmentShaderSource = std::string(R"(
+    #version 460 core
+)") + cameraBlockGlsl + R"(
+    in vec3 vViewPosition;
+    flat in vec3 vCenter;
+    flat in float vRadius;
+    flat in vec3 vColor;
+
+    // The visible cap is always in front of the quad, so depth only ever decreases
+    layout (depth_less) out float gl_FragDepth;
+    out vec4 FragColor;
+
+    void main()
+    {
+        vec3 rayDirection = normalize(vViewPosition);
+
+        // |t * d - c|^2 = r^2 with the eye at the origin
+        float b = dot(rayDirection, vCenter);
+        float discriminant = b * b - dot(vCenter, vCenter) + vRadius * vRadius;
+        if (discriminant < 0.0)
+            discard;
+
+        vec3 hit = rayDirection * (b - sqrt(discriminant));
+        vec3 normal = (hit - vCenter) / vRadius;
+
+        vec4 clip = camera.projection * vec4(hit, 1.0);
+        gl_FragDepth = (clip.z / clip.w) * 0.5 + 0.5;
+
+        // Headlight shading
+        vec3 lightDirection = -rayDirection;
+        float diffuse = max(dot(normal, lightDirection), 0.0);
+        float specular = pow(max(dot(reflect(-lightDirection, normal), -rayDirection), 0.0), 32.0);
+        FragColor = vec4(vColor * (0.25 + 0.75 * diffuse) + vec3(0.3) * specular, 1.0);
+    }
+)";
+
+std::vector<glm::vec4> AtomRenderer::elementPalette()
+{
+    std::vector<glm::vec4> colors(ELEMENT_COUNT);
+    for (int z = 0; z < ELEMENT_COUNT; ++z)
+    {
+        uint32_t rgb = getElementInfo(z).color;
+        colors[z] = glm::vec4(((rgb >> 16) & 0xFF) / 255.0f, ((rgb >> 8) & 0xFF) / 255.0f,
+                              (rgb & 0xFF) / 255.0f, 1.0f);
+    }
+    return colors;
+}
+
+void AtomRenderer::beginShader(ShaderCache *cache)
+{
+    shader.begin("atom_impostor", atomVertexShaderSource.c_str(), atomFragmentShaderSource.c_str(), cache);
+}
+
+bool AtomRenderer::init()
+{
+    if (!shader.isPending())
+    {
+        beginShader(nullptr);
+    }
+    if (!shader.finish())
+    {
+        return false;
+    }
+    radiusScaleUniform = shader.uniform<float>("uRadiusScale");
+
+    // Element colors, indexed by the per-atom color index
+    palette = elementPalette();
+    glCreateBuffers(1, &paletteBuffer);
+    glNamedBufferStorage(paletteBuffer, palette.size() * sizeof(glm::vec4), palette.data(), GL_DYNAMIC_STORAGE_BIT);
+
+    // Vertex format is fixed; the buffers are attached in allocateBuffers()
+    glCreateVertexArrays(1, &vao);
+
+    glEnableVertexArrayAttrib(vao, 0);
+    glVertexArrayAttribFormat(vao, 0, 3, GL_FLOAT, GL_FALSE, 0);
+    glVertexArrayAttribBinding(vao, 0, 0);
+    glVertexArrayBindingDivisor(vao, 0, 1);
+
+    glEnableVertexArrayAttrib(vao, 1);
+    glVertexArrayAttribFormat(vao, 1, 1, GL_FLOAT, GL_FALSE, offsetof(AtomAttributes, radius));
+    glVertexArrayAttribBinding(vao, 1, 1);
+
+    glEnableVertexArrayAttrib(vao, 2);
+    glVertexArrayAttribIFormat(vao, 2, 1, GL_UNSIGNED_INT, offsetof(AtomAttributes, colorIndex));
+    glVertexArrayAttribBinding(vao, 2, 1);
+    glVertexArrayBindingDivisor(vao, 1, 1);
+
+    return true;
+}
+
+void AtomRenderer::destroy()
+{
+    cancelUpload();
+    shader.destroy();
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &positionBuffer);
+    glDeleteBuffers(1, &attributeBuffer);
+    glDeleteBuffers(1, &paletteBuffer);
+    vao = positionBuffer = attributeBuffer = paletteBuffer = 0;
+    atomCount = capacity = 0;
+}
+
+void AtomRenderer::allocateBuffers(size_t count)
+{
+    // Immutable storage; only grows, so reloading a smaller structure reuses it
+    glDeleteBuffers(1, &positionBuffer);
+    glDeleteBuffers(1, &attributeBuffer);
+
+    glCreateBuffers(1, &positionBuffer);
+    glNamedBufferStorage(positionBuffer, count * sizeof(glm::vec4), nullptr, GL_DYNAMIC_STORAGE_BIT);
+    glCreateBuffers(1, &attributeBuffer);
+    glNamedBufferStorage(attributeBuffer, count * sizeof(AtomAttributes), nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+    glVertexArrayVertexBuffer(vao, 0, positionBuffer, 0, sizeof(glm::vec4));
+    glVertexArrayVertexBuffer(vao, 1, attributeBuffer, 0, sizeof(AtomAttributes));
+    capacity = count;
+}
+
+void AtomRenderer::fillAttributes(const Molecule &molecule, size_t first, size_t count, AtomAttributes *attributes)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        size_t atom = first + i;
+        int element = atom < molecule.elements.size() ? molecule.elements[atom] : 0;
+        attributes[i].radius = getElementInfo(element).vdwRadius;
+        attributes[i].colorIndex = static_cast<uint32_t>(element);
+    }
+}
+
+void AtomRenderer::setAtoms(const Molecule &molecule)
+{
+    size_t count = molecule.getAtomCount();
+    if (count > capacity)
+    {
+        allocateBuffers(count);
+    }
+    atomCount = count;
+    if (count == 0)
+    {
+        return;
+    }
+
+    std::vector<AtomAttributes> attributes(count);
+    fillAttributes(molecule, 0, count, attributes.data());
+
+    glNamedBufferSubData(positionBuffer, 0, count * sizeof(glm::vec4), molecule.positions.data());
+    glNamedBufferSubData(attributeBuffer, 0, count * sizeof(AtomAttributes), attributes.data());
+}
+
+void AtomRenderer::beginUpload(const Molecule &molecule)
+{
+    cancelUpload();
+    staged = &molecule;
+    stagedCount = molecule.getAtomCount();
+    if (stagedCount == 0)
+    {
+        return;
+    }
+    glCreateBuffers(1, &stagedPositionBuffer);
+    glNamedBufferStorage(stagedPositionBuffer, stagedCount * sizeof(glm::vec4), nullptr, GL_DYNAMIC_STORAGE_BIT);
+    glCreateBuffers(1, &stagedAttributeBuffer);
+    glNamedBufferStorage(stagedAttributeBuffer, stagedCount * sizeof(AtomAttributes), nullptr, GL_DYNAMIC_STORAGE_BIT);
+}
+
+size_t AtomRenderer::uploadNext(size_t maxBytes)
+{
+    // Positions first, then the attributes, which are built one slice at a time
+    size_t uploaded = 0;
+    if (staged && stagedPositions < stagedCount)
+    {
+        size_t count = std::min(stagedCount - stagedPositions, std::max<size_t>(1, maxBytes / sizeof(glm::vec4)));
+        glNamedBufferSubData(stagedPositionBuffer, stagedPositions * sizeof(glm::vec4), count * sizeof(glm::vec4),
+                             staged->positions.data() + stagedPositions);
+        stagedPositions += count;
+        uploaded += count * sizeof(glm::vec4);
+    }
+    if (staged && stagedPositions == stagedCount && stagedAttributes < stagedCount && uploaded < maxBytes)
+    {
+        size_t count = std::min(stagedCount - stagedAttributes,
+                                std::max<size_t>(1, (maxBytes - uploaded) / sizeof(AtomAttributes)));
+        std::vector<AtomAttributes> attributes(count);
+        fillAttributes(*staged, stagedAttributes, count, attributes.data());
+        glNamedBufferSubData(stagedAttributeBuffer, stagedAttributes * sizeof(AtomAttributes),
+                             count * sizeof(AtomAttributes), attributes.data());
+        stagedAttributes += count;
+        uploaded += count * sizeof(AtomAttributes);
+    }
+    return uploaded;
+}
+
+void AtomRenderer::commitUpload()
+{
+    if (!staged)
+    {
+        return;
+    }
+    atomCount = stagedCount;
+    if (stagedCount > 0)
+    {
+        // The staged buffers fit exactly; they become the storage that later loads reuse
+        glDeleteBuffers(1, &positionBuffer);
+        glDeleteBuffers(1, &attributeBuffer);
+        positionBuffer = stagedPositionBuffer;
+        attributeBuffer = stagedAttributeBuffer;
+        capacity = stagedCount;
+        glVertexArrayVertexBuffer(vao, 0, positionBuffer, 0, sizeof(glm::vec4));
+        glVertexArrayVertexBuffer(vao, 1, attributeBuffer, 0, sizeof(AtomAttributes));
+        stagedPositionBuffer = stagedAttributeBuffer = 0;
+    }
+    cancelUpload();
+}
+
+void AtomRenderer::cancelUpload()
+{
+    glDeleteBuffers(1, &stagedPositionBuffer);
+    glDeleteBuffers(1, &stagedAttributeBuffer);
+    stagedPositionBuffer = stagedAttributeBuffer = 0;
+    staged = nullptr;
+    stagedCount = stagedPositions = stagedAttributes = 0;
+}
+
+void AtomRenderer::updatePositions(const glm::vec4 *positions, size_t count)
+{
+    if (count != atomCount)
+    {
+        std::cerr << "Position update has " << count << " atoms, expected " << atomCount << std::endl;
+        return;
+    }
+    glNamedBufferSubData(positionBuffer, 0, count * sizeof(glm::vec4), positions);
+}
+
+void AtomRenderer::draw(GLStateCache &state, float radiusScale)
+{
+    if (atomCount == 0 || !shader.isValid())
+    {
+        return;
+    }
+
+    shader.use(state);
+    shader.set(radiusScaleUniform, radiusScale);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COLOR_PALETTE_BINDING, paletteBuffer);
+    state.bindVertexArray(vao);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(atomCount));
+}
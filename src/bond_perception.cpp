@@ -0,0 +1,339 @@
+#include "bond_perception.h"
+#include "cpu_profiler.h"
+#include "elements.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+
+namespace {
+
+// Smaller structures are done on the calling thread; starting workers would cost more
+constexpr size_t MIN_PARALLEL_ATOMS = 1 << 15;
+// Cell ranges per worker, so uneven density still balances
+constexpr size_t JOBS_PER_THREAD = 8;
+// Atoms per cell range at most, so cancellation and progress stay responsive on one thread
+constexpr size_t MAX_JOB_ATOMS = 1 << 16;
+// Cells per atom at most; sparse or flat structures get coarser cells instead
+constexpr size_t MAX_CELLS_PER_ATOM = 2;
+
+// Cells are this fraction of the longest bond wide, and bonded atoms this many cells apart
+// at most. Narrower cells test fewer pairs, but at the density of real structures the
+// extra neighbor ranges cost more than they save.
+constexpr int CELL_REACH = 1;
+
+// Uniform grid with cells at least 1 / CELL_REACH of the longest possible bond wide,
+// so bonded atoms are at most CELL_REACH cells apart on each axis. Atoms are sorted
+// by cell (x fastest), so the cells of one row are contiguous, each with w = its
+// covalent radius plus half the tolerance (two of them add up to the bond length).
+struct CellGrid {
+    float origin[3];
+    float inverseCellSize;
+    int dimensions[3];
+    std::vector<uint32_t> cellStarts; // Into `atoms`, one past the last cell at the end
+    std::vector<uint32_t> atoms;      // Atom indices by cell
+    AlignedVector<glm::vec4> points;  // Position and half bond length, in `atoms` order
+
+    size_t getCellCount() const { return cellStarts.size() - 1; }
+
+    int cellCoordinate(float value, int axis) const
+    {
+        // Written so NaN lands in the first cell
+        float cell = (value - origin[axis]) * inverseCellSize;
+        return cell > 0.0f ? (cell < dimensions[axis] ? static_cast<int>(cell) : dimensions[axis] - 1) : 0;
+    }
+    uint32_t cellOf(const glm::vec4 &position) const
+    {
+        size_t x = cellCoordinate(position.x, 0);
+        size_t y = cellCoordinate(position.y, 1);
+        size_t z = cellCoordinate(position.z, 2);
+        return static_cast<uint32_t>((z * dimensions[1] + y) * dimensions[0] + x);
+    }
+};
+
+template <typename Job>
+void forEachJob(ThreadPool *pool, size_t count, const Job &job)
+{
+    if (!pool)
+    {
+        for (size_t i = 0; i < count; ++i)
+            job(i);
+        return;
+    }
+    for (size_t i = 0; i < count; ++i)
+        pool->submit([&job, i]() { job(i); });
+    pool->waitIdle();
+}
+
+void buildGrid(const Molecule &molecule, float maxBond, ThreadPool *pool, size_t jobCount, CellGrid &grid)
+{
+    size_t count = molecule.getAtomCount();
+    glm::vec3 minCorner, maxCorner;
+    molecule.getBounds(minCorner, maxCorner);
+    glm::vec3 extent = maxCorner - minCorner;
+
+    // Grow the cells until the grid is no larger than the atoms warrant
+    float cellSize = std::max(maxBond / CELL_REACH, 1e-3f);
+    uint64_t maxCells = std::max<uint64_t>(count * MAX_CELLS_PER_ATOM, 1);
+    while (true)
+    {
+        uint64_t cells = 1;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            float cellsOnAxis = std::isfinite(extent[axis]) ? extent[axis] / cellSize : 0.0f;
+            grid.dimensions[axis] = static_cast<int>(std::min(cellsOnAxis, static_cast<float>(maxCells))) + 1;
+            cells *= static_cast<uint64_t>(grid.dimensions[axis]);
+        }
+        if (cells <= maxCells)
+            break;
+        cellSize *= 1.5f;
+    }
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        grid.origin[axis] = minCorner[axis];
+    }
+    grid.inverseCellSize = 1.0f / cellSize;
+
+    float radii[256];
+    for (int element = 0; element < 256; ++element)
+    {
+        radii[element] = getElementInfo(element).covalentRadius + 0.5f * BOND_TOLERANCE;
+    }
+
+    // Stable parallel counting sort by cell in two passes: atoms go to buckets of
+    // contiguous cells (each job writing its own slots), then each bucket is sorted
+    // on its own, touching only its part of the arrays
+    size_t cellCount = static_cast<size_t>(grid.dimensions[0]) * grid.dimensions[1] * grid.dimensions[2];
+    size_t bucketCount = jobCount;
+    size_t bucketCells = (cellCount + bucketCount - 1) / bucketCount;
+    size_t jobAtoms = (count + jobCount - 1) / jobCount;
+    std::vector<uint32_t> atomCells(count);
+    std::vector<uint32_t> jobBucketSlots(jobCount * bucketCount, 0);
+    forEachJob(pool, jobCount, [&](size_t job) {
+        uint32_t *counts = jobBucketSlots.data() + job * bucketCount;
+        size_t end = std::min(count, (job + 1) * jobAtoms);
+        for (size_t atom = job * jobAtoms; atom < end; ++atom)
+        {
+            atomCells[atom] = grid.cellOf(molecule.positions[atom]);
+            ++counts[atomCells[atom] / bucketCells];
+        }
+    });
+
+    std::vector<uint32_t> bucketStarts(bucketCount + 1, 0);
+    uint32_t slot = 0;
+    for (size_t bucket = 0; bucket < bucketCount; ++bucket)
+    {
+        bucketStarts[bucket] = slot;
+        for (size_t job = 0; job < jobCount; ++job)
+        {
+            uint32_t jobAtomsInBucket = jobBucketSlots[job * bucketCount + bucket];
+            jobBucketSlots[job * bucketCount + bucket] = slot;
+            slot += jobAtomsInBucket;
+        }
+    }
+    bucketStarts[bucketCount] = slot;
+
+    std::vector<uint32_t> bucketAtoms(count);
+    forEachJob(pool, jobCount, [&](size_t job) {
+        uint32_t *slots = jobBucketSlots.data() + job * bucketCount;
+        size_t end = std::min(count, (job + 1) * jobAtoms);
+        for (size_t atom = job * jobAtoms; atom < end; ++atom)
+        {
+            bucketAtoms[slots[atomCells[atom] / bucketCells]++] = static_cast<uint32_t>(atom);
+        }
+    });
+
+    grid.cellStarts.resize(cellCount + 1);
+    grid.cellStarts[cellCount] = static_cast<uint32_t>(count);
+    grid.atoms.resize(count);
+    grid.points.resize(count);
+    forEachJob(pool, bucketCount, [&](size_t bucket) {
+        size_t firstCell = std::min(cellCount, bucket * bucketCells);
+        size_t lastCell = std::min(cellCount, firstCell + bucketCells);
+        uint32_t *starts = grid.cellStarts.data();
+        std::fill(starts + firstCell, starts + lastCell, 0);
+        for (uint32_t i = bucketStarts[bucket]; i < bucketStarts[bucket + 1]; ++i)
+        {
+            ++starts[atomCells[bucketAtoms[i]]];
+        }
+        uint32_t start = bucketStarts[bucket];
+        for (size_t cell = firstCell; cell < lastCell; ++cell)
+        {
+            uint32_t cellAtoms = starts[cell];
+            starts[cell] = start;
+            start += cellAtoms;
+        }
+
+        std::vector<uint32_t> next(starts + firstCell, starts + lastCell);
+        for (uint32_t i = bucketStarts[bucket]; i < bucketStarts[bucket + 1]; ++i)
+        {
+            uint32_t atom = bucketAtoms[i];
+            uint32_t target = next[atomCells[atom] - firstCell]++;
+            grid.atoms[target] = atom;
+            const glm::vec4 &position = molecule.positions[atom];
+            grid.points[target] = glm::vec4(position.x, position.y, position.z, radii[molecule.elements[atom]]);
+        }
+    });
+}
+
+// Bonds of atom `i` with the atoms of [first, last), appended to `bonds`
+void bondAtom(const CellGrid &grid, uint32_t i, uint32_t first, uint32_t last, std::vector<uint32_t> &bonds)
+{
+    const float minLengthSquared = MIN_BOND_LENGTH * MIN_BOND_LENGTH;
+    const glm::vec4 &a = grid.points[i];
+    for (uint32_t j = first; j < last; ++j)
+    {
+        const glm::vec4 &b = grid.points[j];
+        float dx = b.x - a.x;
+        float dy = b.y - a.y;
+        float dz = b.z - a.z;
+        float distanceSquared = dx * dx + dy * dy + dz * dz;
+        float bondLength = a.w + b.w;
+        if (distanceSquared <= bondLength * bondLength && distanceSquared >= minLengthSquared)
+        {
+            uint32_t atomA = grid.atoms[i];
+            uint32_t atomB = grid.atoms[j];
+            bonds.push_back(std::min(atomA, atomB));
+            bonds.push_back(std::max(atomA, atomB));
+        }
+    }
+}
+
+// Bonds of the atoms in cells [firstCell, lastCell) with the atoms after them in their
+// own cell and row, and in the rows ahead of theirs (higher y, then higher z): every
+// pair within reach is visited once. Each neighbor row is one contiguous atom range.
+void bondCells(const CellGrid &grid, size_t firstCell, size_t lastCell, std::vector<uint32_t> &bonds)
+{
+    const int nx = grid.dimensions[0];
+    const int ny = grid.dimensions[1];
+    const int nz = grid.dimensions[2];
+    constexpr int MAX_ROWS = (2 * CELL_REACH + 1) * (2 * CELL_REACH + 1);
+    uint32_t rowFirst[MAX_ROWS];
+    uint32_t rowLast[MAX_ROWS];
+    for (size_t cell = firstCell; cell < lastCell; ++cell)
+    {
+        uint32_t first = grid.cellStarts[cell];
+        uint32_t last = grid.cellStarts[cell + 1];
+        if (first == last)
+            continue;
+
+        int x = static_cast<int>(cell % nx);
+        int y = static_cast<int>(cell / nx % ny);
+        int z = static_cast<int>(cell / nx / ny);
+        size_t rowStart = cell - x;
+        uint32_t ownRowLast = grid.cellStarts[rowStart + std::min(x + CELL_REACH, nx - 1) + 1];
+
+        int rowCount = 0;
+        int lowX = std::max(x - CELL_REACH, 0);
+        int highX = std::min(x + CELL_REACH, nx - 1);
+        for (int rowZ = z; rowZ <= std::min(z + CELL_REACH, nz - 1); ++rowZ)
+        {
+            for (int rowY = std::max(y - CELL_REACH, 0); rowY <= std::min(y + CELL_REACH, ny - 1); ++rowY)
+            {
+                if (rowZ == z && rowY <= y)
+                    continue;
+                size_t row = (static_cast<size_t>(rowZ) * ny + rowY) * nx;
+                rowFirst[rowCount] = grid.cellStarts[row + lowX];
+                rowLast[rowCount] = grid.cellStarts[row + highX + 1];
+                if (rowFirst[rowCount] < rowLast[rowCount])
+                    ++rowCount;
+            }
+        }
+
+        for (uint32_t i = first; i < last; ++i)
+        {
+            bondAtom(grid, i, i + 1, ownRowLast, bonds);
+            for (int row = 0; row < rowCount; ++row)
+            {
+                bondAtom(grid, i, rowFirst[row], rowLast[row], bonds);
+            }
+        }
+    }
+}
+
+} // namespace
+
+void perceiveBonds(Molecule &molecule, LoadProgress *progress)
+{
+    PROFILE_ZONE("perceive bonds");
+    molecule.bonds.clear();
+    size_t count = molecule.getAtomCount();
+    if (count < 2)
+    {
+        return;
+    }
+
+    // Longest possible bond sets the cell size
+    bool present[256] = {};
+    for (uint8_t element : molecule.elements)
+    {
+        present[element] = true;
+    }
+    float maxRadius = 0.0f;
+    for (int element = 0; element < 256; ++element)
+    {
+        if (present[element])
+            maxRadius = std::max(maxRadius, getElementInfo(element).covalentRadius);
+    }
+    float maxBond = 2.0f * maxRadius + BOND_TOLERANCE;
+
+    size_t threads = count >= MIN_PARALLEL_ATOMS ? ThreadPool::defaultThreadCount() : 1;
+    std::unique_ptr<ThreadPool> pool = threads > 1 ? std::make_unique<ThreadPool>(threads, "bond perception") : nullptr;
+    size_t jobCount = std::max(threads * JOBS_PER_THREAD, (count + MAX_JOB_ATOMS - 1) / MAX_JOB_ATOMS);
+
+    CellGrid grid;
+    buildGrid(molecule, maxBond, pool.get(), std::min(jobCount, count), grid);
+    if (progress && progress->isCancelled())
+    {
+        return;
+    }
+
+    // Cell ranges holding about the same number of atoms, each with its own bond buffer.
+    // The buffers are joined in cell order, so the result does not depend on the thread count.
+    std::vector<size_t> rangeStarts;
+    for (size_t job = 0; job < jobCount; ++job)
+    {
+        uint32_t firstAtom = static_cast<uint32_t>(job * count / jobCount);
+        size_t cell = std::upper_bound(grid.cellStarts.begin(), grid.cellStarts.end(), firstAtom) -
+                      grid.cellStarts.begin() - 1;
+        if (rangeStarts.empty() || cell > rangeStarts.back())
+            rangeStarts.push_back(cell);
+    }
+    rangeStarts.push_back(grid.getCellCount());
+
+    size_t rangeCount = rangeStarts.size() - 1;
+    std::vector<std::vector<uint32_t>> rangeBonds(rangeCount);
+    std::atomic<size_t> rangesDone{0};
+    forEachJob(pool.get(), rangeCount, [&](size_t range) {
+        if (progress && progress->isCancelled())
+            return;
+        std::vector<uint32_t> &bonds = rangeBonds[range];
+        // About two bonds per atom in organic matter
+        bonds.reserve(4 * (grid.cellStarts[rangeStarts[range + 1]] - grid.cellStarts[rangeStarts[range]]));
+        bondCells(grid, rangeStarts[range], rangeStarts[range + 1], bonds);
+        if (progress)
+            progress->update(static_cast<float>(++rangesDone) / rangeCount);
+    });
+    if (progress && progress->isCancelled())
+    {
+        return;
+    }
+
+    size_t total = 0;
+    for (const std::vector<uint32_t> &bonds : rangeBonds)
+    {
+        total += bonds.size();
+    }
+    molecule.bonds.resize(total);
+    size_t offset = 0;
+    std::vector<size_t> offsets(rangeCount);
+    for (size_t range = 0; range < rangeCount; ++range)
+    {
+        offsets[range] = offset;
+        offset += rangeBonds[range].size();
+    }
+    forEachJob(pool.get(), rangeCount, [&](size_t range) {
+        std::copy(rangeBonds[range].begin(), rangeBonds[range].end(), molecule.bonds.begin() + offsets[range]);
+    });
+}
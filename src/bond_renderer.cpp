@@ -0,0 +1,256 @@
+#include "bond_renderer.h"
+#include "camera.h"
+#include <algorithm>
+#include <string>
+
+// Cylinder impostor vertex shader: a bounding box around each bond, built from the atom positions
+const std::string bondVertexShaderSource = std::string(R"(
+    #version 460 core
+    layout (location = 0) in uvec2 aAtoms;
+)") + cameraBlockGlsl + R"(
+    struct AtomAttributes
+    {
+        float radius;
+        uint colorIndex;
+    };
+
+    layout (std430, binding = 0) readonly buffer ColorPalette
+    {
+        vec4 palette[];
+    };
+    layout (std430, binding = 1) readonly buffer AtomPositions
+    {
+        vec4 positions[];
+    };
+    layout (std430, binding = 2) readonly buffer AtomAttributeBuffer
+    {
+        AtomAttributes attributes[];
+    };
+
+    uniform float uRadius;
+
+    out vec3 vViewPosition;
+    flat out vec3 vStart;
+    flat out vec3 vEnd;
+    flat out vec3 vStartColor;
+    flat out vec3 vEndColor;
+
+    void main()
+    {
+        // Corner of a unit cube from the vertex index (14-vertex triangle strip)
+        int bit = 1 << gl_VertexID;
+        vec3 corner = vec3((0x287a & bit) != 0, (0x02af & bit) != 0, (0x31e3 & bit) != 0);
+
+        vec3 start = (camera.view * vec4(positions[aAtoms.x].xyz, 1.0)).xyz;
+        vec3 end = (camera.view * vec4(positions[aAtoms.y].xyz, 1.0)).xyz;
+
+        // Box spanning the bond axis, uRadius wide in both perpendicular directions
+        vec3 axis = end - start;
+        vec3 direction = axis / max(length(axis), 1e-6);
+        vec3 helper = abs(direction.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0);
+        vec3 side = normalize(cross(direction, helper));
+        vec3 up = cross(direction, side);
+        vec3 position = start + axis * corner.z +
+                        (side * (corner.x * 2.0 - 1.0) + up * (corner.y * 2.0 - 1.0)) * uRadius;
+
+        vViewPosition = position;
+        vStart = start;
+        vEnd = end;
+        vStartColor = palette[attributes[aAtoms.x].colorIndex].rgb;
+        vEndColor = palette[attributes[aAtoms.y].colorIndex].rgb;
+        gl_Position = camera.projection * vec4(position, 1.0);
+    }
+)";
+
+// Cylinder impostor fragment shader: ray/capped-cylinder intersection in view space
+const std::string bondFragmentShaderSource = std::string(R"(
+    #version 460 core
+)") + cameraBlockGlsl + R"(
+    in vec3 vViewPosition;
+    flat in vec3 vStart;
+    flat in vec3 vEnd;
+    flat in vec3 vStartColor;
+    flat in vec3 vEndColor;
+
+    uniform float uRadius;
+
+    out vec4 FragColor;
+
+    void main()
+    {
+        vec3 rayDirection = normalize(vViewPosition);
+
+        // Eye is at the origin in view space
+        vec3 axis = vEnd - vStart;
+        vec3 originToStart = -vStart;
+        float axisLengthSq = dot(axis, axis);
+        float axisDotRay = dot(axis, rayDirection);
+        float axisDotOrigin = dot(axis, originToStart);
+
+        float k2 = axisLengthSq - axisDotRay * axisDotRay;
+        float k1 = axisLengthSq * dot(originToStart, rayDirection) - axisDotOrigin * axisDotRay;
+        float k0 = axisLengthSq * dot(originToStart, originToStart) - axisDotOrigin * axisDotOrigin -
+                   uRadius * uRadius * axisLengthSq;
+        float h = k1 * k1 - k2 * k0;
+        if (h < 0.0)
+            discard;
+        h = sqrt(h);
+
+        float t = (-k1 - h) / k2;
+        float y = axisDotOrigin + t * axisDotRay; // Position along the axis, scaled by |axis|^2
+        vec3 normal;
+        if (y > 0.0 && y < axisLengthSq)
+        {
+            // Hit the body
+            normal = (originToStart + t * rayDirection - axis * y / axisLengthSq) / uRadius;
+        }
+        else
+        {
+            // Hit one of the flat caps (hidden inside the atoms in ball-and-stick)
+            t = ((y < 0.0 ? 0.0 : axisLengthSq) - axisDotOrigin) / axisDotRay;
+            if (abs(k1 + k2 * t) >= h)
+                discard;
+            y = clamp(y, 0.0, axisLengthSq);
+            normal = axis * sign(y - 0.5 * axisLengthSq) / sqrt(axisLengthSq);
+        }
+
+        vec3 hit = rayDirection * t;
+        vec4 clip = camera.projection * vec4(hit, 1.0);
+        gl_FragDepth = (clip.z / clip.w) * 0.5 + 0.5;
+
+        // Each half takes the color of its atom
+        vec3 color = (y < 0.5 * axisLengthSq) ? vStartColor : vEndColor;
+
+        vec3 lightDirection = -rayDirection;
+        float diffuse = max(dot(normal, lightDirection), 0.0);
+        float specular = pow(max(dot(reflect(-lightDirection, normal), -rayDirection), 0.0), 32.0);
+        FragColor = vec4(color * (0.25 + 0.75 * diffuse) + vec3(0.3) * specular, 1.0);
+    }
+)";
+
+void BondRenderer::beginShader(ShaderCache *cache)
+{
+    shader.begin("bond_impostor", bondVertexShaderSource.c_str(), bondFragmentShaderSource.c_str(), cache);
+}
+
+bool BondRenderer::init()
+{
+    if (!shader.isPending())
+    {
+        beginShader(nullptr);
+    }
+    if (!shader.finish())
+    {
+        return false;
+    }
+    radiusUniform = shader.uniform<float>("uRadius");
+
+    // One uvec2 of atom indices per instance
+    glCreateVertexArrays(1, &vao);
+    glEnableVertexArrayAttrib(vao, 0);
+    glVertexArrayAttribIFormat(vao, 0, 2, GL_UNSIGNED_INT, 0);
+    glVertexArrayAttribBinding(vao, 0, 0);
+    glVertexArrayBindingDivisor(vao, 0, 1);
+
+    return true;
+}
+
+void BondRenderer::destroy()
+{
+    cancelUpload();
+    shader.destroy();
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &bondBuffer);
+    vao = bondBuffer = 0;
+    bondCount = capacity = 0;
+}
+
+void BondRenderer::setBonds(const AlignedVector<uint32_t> &bonds)
+{
+    size_t count = bonds.size() / 2;
+    if (count > capacity)
+    {
+        glDeleteBuffers(1, &bondBuffer);
+        glCreateBuffers(1, &bondBuffer);
+        glNamedBufferStorage(bondBuffer, count * 2 * sizeof(uint32_t), nullptr, GL_DYNAMIC_STORAGE_BIT);
+        glVertexArrayVertexBuffer(vao, 0, bondBuffer, 0, 2 * sizeof(uint32_t));
+        capacity = count;
+    }
+
+    bondCount = count;
+    if (count > 0)
+    {
+        glNamedBufferSubData(bondBuffer, 0, count * 2 * sizeof(uint32_t), bonds.data());
+    }
+}
+
+void BondRenderer::beginUpload(const AlignedVector<uint32_t> &bonds)
+{
+    cancelUpload();
+    staged = &bonds;
+    stagedCount = bonds.size() / 2;
+    if (stagedCount > 0)
+    {
+        glCreateBuffers(1, &stagedBuffer);
+        glNamedBufferStorage(stagedBuffer, stagedCount * BOND_BYTES, nullptr, GL_DYNAMIC_STORAGE_BIT);
+    }
+}
+
+size_t BondRenderer::uploadNext(size_t maxBytes)
+{
+    if (!staged || stagedDone == stagedCount)
+    {
+        return 0;
+    }
+    size_t count = std::min(stagedCount - stagedDone, std::max<size_t>(1, maxBytes / BOND_BYTES));
+    glNamedBufferSubData(stagedBuffer, stagedDone * BOND_BYTES, count * BOND_BYTES, staged->data() + stagedDone * 2);
+    stagedDone += count;
+    return count * BOND_BYTES;
+}
+
+void BondRenderer::commitUpload()
+{
+    if (!staged)
+    {
+        return;
+    }
+    bondCount = stagedCount;
+    if (stagedCount > 0)
+    {
+        glDeleteBuffers(1, &bondBuffer);
+        bondBuffer = stagedBuffer;
+        capacity = stagedCount;
+        glVertexArrayVertexBuffer(vao, 0, bondBuffer, 0, BOND_BYTES);
+        stagedBuffer = 0;
+    }
+    cancelUpload();
+}
+
+void BondRenderer::cancelUpload()
+{
+    glDeleteBuffers(1, &stagedBuffer);
+    stagedBuffer = 0;
+    staged = nullptr;
+    stagedCount = stagedDone = 0;
+}
+
+void BondRenderer::draw(GLStateCache &state, GLuint positionBuffer, GLuint attributeBuffer, GLuint paletteBuffer, float radius)
+{
+    if (bondCount == 0 || !shader.isValid())
+    {
+        return;
+    }
+
+    shader.use(state);
+    shader.set(radiusUniform, radius);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COLOR_PALETTE_BINDING, paletteBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ATOM_POSITION_BINDING, positionBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ATOM_ATTRIBUTE_BINDING, attributeBuffer);
+
+    // Only the front faces of each box need ray casting
+    state.setCullFace(true);
+    state.bindVertexArray(vao);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 14, static_cast<GLsizei>(bondCount));
+    state.setCullFace(false);
+}
@@ -0,0 +1,121 @@
+#include "camera.h"
+#include "shader.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+const char *cameraBlockGlsl = R"(
+    layout (std140) uniform CameraBlock
+    {
+        mat4 view;
+        mat4 projection;
+        mat4 viewProjection;
+        vec4 viewport;
+    } camera;
+)";
+
+glm::vec3 Camera::getPosition() const
+{
+    glm::vec3 offset(std::cos(pitch) * std::sin(yaw),
+                     std::sin(pitch),
+                     std::cos(pitch) * std::cos(yaw));
+    return target + offset * distance;
+}
+
+glm::mat4 Camera::getViewMatrix() const
+{
+    return glm::lookAt(getPosition(), target, glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+glm::mat4 Camera::getProjectionMatrix(float aspect) const
+{
+    return glm::perspective(fovY, aspect, nearPlane, farPlane);
+}
+
+glm::mat4 Camera::getTileProjectionMatrix(float aspect, glm::vec2 ndcMin, glm::vec2 ndcMax) const
+{
+    // Same near plane window as getProjectionMatrix, cut down to the tile
+    float top = nearPlane * std::tan(fovY * 0.5f);
+    float right = top * aspect;
+    return glm::frustum(right * ndcMin.x, right * ndcMax.x, top * ndcMin.y, top * ndcMax.y, nearPlane, farPlane);
+}
+
+void Camera::frame(const glm::vec3 &minCorner, const glm::vec3 &maxCorner)
+{
+    float radius = std::max(glm::length(maxCorner - minCorner) * 0.5f, 1.0f) + 2.0f; // Room for atom radii
+    target = (minCorner + maxCorner) * 0.5f;
+    distance = radius / std::sin(fovY * 0.5f);
+    nearPlane = std::max(0.01f, distance - radius * 1.5f);
+    farPlane = distance + radius * 1.5f;
+}
+
+void CameraBuffer::init(int initialSlots)
+{
+    // Ranges bound with glBindBufferRange must respect the offset alignment
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    slotStride = ((sizeof(CameraUniforms) + alignment - 1) / alignment) * alignment;
+
+    glCreateBuffers(1, &ubo);
+    reallocate(initialSlots);
+}
+
+void CameraBuffer::destroy()
+{
+    if (ubo != 0)
+    {
+        glDeleteBuffers(1, &ubo);
+        ubo = 0;
+    }
+    capacity = 0;
+    staged.clear();
+    dirty.clear();
+    slots.clear();
+}
+
+void CameraBuffer::reallocate(int slotCount)
+{
+    capacity = slotCount;
+    staged.resize(capacity);
+    dirty.assign(capacity, true);
+    glNamedBufferData(ubo, slotStride * capacity, nullptr, GL_DYNAMIC_DRAW);
+}
+
+int CameraBuffer::getSlot(const std::string &viewName)
+{
+    auto it = slots.find(viewName);
+    if (it != slots.end())
+    {
+        return it->second;
+    }
+
+    int slot = static_cast<int>(slots.size());
+    if (slot >= capacity)
+    {
+        reallocate(capacity * 2);
+    }
+    slots[viewName] = slot;
+    return slot;
+}
+
+void CameraBuffer::update(int slot, const CameraUniforms &uniforms)
+{
+    if (std::memcmp(&staged[slot], &uniforms, sizeof(CameraUniforms)) == 0)
+    {
+        return;
+    }
+    staged[slot] = uniforms;
+    dirty[slot] = true;
+}
+
+void CameraBuffer::bind(int slot)
+{
+    GLintptr offset = slotStride * slot;
+    if (dirty[slot])
+    {
+        glNamedBufferSubData(ubo, offset, sizeof(CameraUniforms), &staged[slot]);
+        dirty[slot] = false;
+    }
+    glBindBufferRange(GL_UNIFORM_BUFFER, CAMERA_BLOCK_BINDING, ubo, offset, sizeof(CameraUniforms));
+}
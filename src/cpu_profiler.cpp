@@ -0,0 +1,249 @@
+#include "cpu_profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+const auto profilerEpoch = std::chrono::steady_clock::now();
+
+thread_local CpuProfiler::ThreadBuffer *currentThreadBuffer = nullptr;
+
+// Hands the thread's ring back to the profiler when the thread exits
+struct ThreadBufferRelease {
+    CpuProfiler::ThreadBuffer *buffer = nullptr;
+    ~ThreadBufferRelease()
+    {
+        if (buffer)
+        {
+            CpuProfiler::instance().releaseThreadBuffer(*buffer);
+        }
+    }
+};
+thread_local ThreadBufferRelease threadBufferRelease;
+
+void writeJsonString(std::ostream &out, const std::string &text)
+{
+    out << '"';
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+            out << '\\' << c;
+        else if (static_cast<unsigned char>(c) < 0x20)
+            out << ' ';
+        else
+            out << c;
+    }
+    out << '"';
+}
+
+} // namespace
+
+CpuProfiler &CpuProfiler::instance()
+{
+    static CpuProfiler profiler;
+    return profiler;
+}
+
+uint64_t CpuProfiler::now()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                     std::chrono::steady_clock::now() - profilerEpoch)
+                                     .count());
+}
+
+CpuProfiler::ThreadBuffer &CpuProfiler::threadBuffer()
+{
+    if (!currentThreadBuffer)
+    {
+        // First zone on this thread: take the ring of an exited thread or register a new
+        // one (the only locking on the recording side). Snapshots hold the same lock, so
+        // none sees a reused ring half reset.
+        std::lock_guard<std::mutex> lock(registryMutex);
+        if (freeThreads.empty())
+        {
+            threads.push_back(std::make_unique<ThreadBuffer>());
+            currentThreadBuffer = threads.back().get();
+        }
+        else
+        {
+            currentThreadBuffer = freeThreads.back();
+            freeThreads.pop_back();
+            currentThreadBuffer->head.store(0, std::memory_order_relaxed);
+            currentThreadBuffer->depth = 0;
+        }
+        currentThreadBuffer->threadId = nextThreadId++;
+        currentThreadBuffer->threadName = "thread " + std::to_string(currentThreadBuffer->threadId);
+        threadBufferRelease.buffer = currentThreadBuffer;
+    }
+    return *currentThreadBuffer;
+}
+
+void CpuProfiler::releaseThreadBuffer(ThreadBuffer &buffer)
+{
+    if (frameThread.load(std::memory_order_relaxed) == &buffer)
+    {
+        frameThread.store(nullptr, std::memory_order_relaxed);
+    }
+    std::lock_guard<std::mutex> lock(registryMutex);
+    freeThreads.push_back(&buffer);
+}
+
+uint32_t CpuProfiler::enterZone(ThreadBuffer &buffer)
+{
+    return buffer.depth++;
+}
+
+// Release stores and acquire loads (plain moves on x86): a reader that sees any field of a
+// new event also sees the head published before that event was written
+void CpuProfiler::ThreadBuffer::Slot::store(const Event &event)
+{
+    name.store(event.name, std::memory_order_release);
+    startNs.store(event.startNs, std::memory_order_release);
+    endNs.store(event.endNs, std::memory_order_release);
+    depth.store(event.depth, std::memory_order_release);
+}
+
+CpuProfiler::Event CpuProfiler::ThreadBuffer::Slot::load() const
+{
+    return Event{name.load(std::memory_order_acquire), startNs.load(std::memory_order_acquire),
+                 endNs.load(std::memory_order_acquire), depth.load(std::memory_order_acquire)};
+}
+
+void CpuProfiler::leaveZone(ThreadBuffer &buffer, const char *name, uint64_t startNs, uint32_t depth)
+{
+    buffer.depth--;
+
+    // Single writer: fill the slot, then publish it with the new head
+    uint64_t head = buffer.head.load(std::memory_order_relaxed);
+    buffer.ring[head % RING_CAPACITY].store(Event{name, startNs, now(), depth});
+    buffer.head.store(head + 1, std::memory_order_release);
+}
+
+void CpuProfiler::setThreadName(const char *name)
+{
+    ThreadBuffer &buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(registryMutex);
+    buffer.threadName = name;
+}
+
+void CpuProfiler::markFrame()
+{
+    frameThread.store(&threadBuffer(), std::memory_order_relaxed);
+    previousFrameStart.store(currentFrameStart.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    currentFrameStart.store(now(), std::memory_order_relaxed);
+}
+
+const char *CpuProfiler::intern(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(internMutex);
+    return internedNames.insert(name).first->c_str();
+}
+
+void CpuProfiler::copyEvents(const ThreadBuffer &buffer, std::vector<Event> &events)
+{
+    uint64_t head = buffer.head.load(std::memory_order_acquire);
+    uint64_t first = head > RING_CAPACITY ? head - RING_CAPACITY : 0;
+    events.clear();
+    events.reserve(static_cast<size_t>(head - first));
+    for (uint64_t i = first; i < head; ++i)
+    {
+        events.push_back(buffer.ring[i % RING_CAPACITY].load());
+    }
+
+    // The owner kept writing while we copied; slots it reached again are torn. Having read
+    // any field of event n means this head load sees at least n, so the slot that may be
+    // half written (event `after`) is dropped as well.
+    uint64_t after = buffer.head.load(std::memory_order_acquire);
+    uint64_t overwritten = after + 1 > RING_CAPACITY ? after + 1 - RING_CAPACITY : 0;
+    if (overwritten > first)
+    {
+        size_t drop = static_cast<size_t>(std::min<uint64_t>(overwritten - first, events.size()));
+        events.erase(events.begin(), events.begin() + drop);
+    }
+}
+
+std::vector<CpuProfiler::ThreadEvents> CpuProfiler::snapshot() const
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    std::vector<ThreadEvents> result;
+    result.reserve(threads.size());
+    for (const auto &buffer : threads)
+    {
+        ThreadEvents thread;
+        thread.threadId = buffer->threadId;
+        thread.threadName = buffer->threadName;
+        copyEvents(*buffer, thread.events);
+        result.push_back(std::move(thread));
+    }
+    return result;
+}
+
+std::vector<CpuProfiler::Event> CpuProfiler::getLastFrame(uint64_t &frameStartNs, uint64_t &frameEndNs) const
+{
+    frameStartNs = previousFrameStart.load(std::memory_order_relaxed);
+    frameEndNs = currentFrameStart.load(std::memory_order_relaxed);
+
+    std::vector<Event> frame;
+    const ThreadBuffer *buffer = frameThread.load(std::memory_order_relaxed);
+    if (!buffer || frameStartNs == 0)
+    {
+        return frame;
+    }
+
+    // Walk back from the newest event; zones are written when they end, so stop
+    // once events end before the frame began
+    uint64_t head = buffer->head.load(std::memory_order_acquire);
+    uint64_t first = head > RING_CAPACITY ? head - RING_CAPACITY : 0;
+    for (uint64_t i = head; i > first; --i)
+    {
+        Event event = buffer->ring[(i - 1) % RING_CAPACITY].load();
+        if (event.endNs < frameStartNs)
+        {
+            break;
+        }
+        if (event.startNs >= frameStartNs && event.endNs <= frameEndNs)
+        {
+            frame.push_back(event);
+        }
+    }
+    return frame;
+}
+
+bool CpuProfiler::writeChromeTrace(const std::string &path) const
+{
+    std::ofstream file(path);
+    if (!file)
+    {
+        std::cerr << "Failed to open " << path << " for writing" << std::endl;
+        return false;
+    }
+
+    size_t eventCount = 0;
+    bool first = true;
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    for (const ThreadEvents &thread : snapshot())
+    {
+        // Thread name metadata
+        file << (first ? "" : ",\n") << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << thread.threadId
+             << ",\"args\":{\"name\":";
+        writeJsonString(file, thread.threadName);
+        file << "}}";
+        first = false;
+
+        // Complete events, timestamps in microseconds
+        for (const Event &event : thread.events)
+        {
+            file << ",\n{\"ph\":\"X\",\"name\":";
+            writeJsonString(file, event.name);
+            file << ",\"pid\":1,\"tid\":" << thread.threadId << ",\"ts\":" << event.startNs / 1000.0
+                 << ",\"dur\":" << (event.endNs - event.startNs) / 1000.0 << "}";
+        }
+        eventCount += thread.events.size();
+    }
+    file << "\n]}\n";
+
+    std::cout << "Wrote " << eventCount << " CPU zones to " << path << std::endl;
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,121 @@
+#include "dcd_trajectory.h"
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+constexpr uint32_t HEADER_RECORD_BYTES = 84;
+constexpr size_t UNIT_CELL_RECORD_BYTES = 4 + 6 * sizeof(double) + 4;
+
+uint32_t byteSwap(uint32_t value)
+{
+    return (value >> 24) | ((value >> 8) & 0xFF00u) | ((value << 8) & 0xFF0000u) | (value << 24);
+}
+
+} // namespace
+
+uint32_t DcdTrajectory::readInt(size_t offset) const
+{
+    uint32_t value;
+    std::memcpy(&value, file.data() + offset, sizeof(value));
+    return swapBytes ? byteSwap(value) : value;
+}
+
+bool DcdTrajectory::open(const std::string &path)
+{
+    close();
+    if (!file.open(path))
+    {
+        return false;
+    }
+
+    // Header record: "CORD" and 20 control words
+    if (file.size() < HEADER_RECORD_BYTES + 8 || std::memcmp(file.data() + 4, "CORD", 4) != 0)
+    {
+        std::cerr << "Not a DCD file: " << path << std::endl;
+        close();
+        return false;
+    }
+    swapBytes = readInt(0) != HEADER_RECORD_BYTES;
+    if (readInt(0) != HEADER_RECORD_BYTES || readInt(HEADER_RECORD_BYTES + 4) != HEADER_RECORD_BYTES)
+    {
+        std::cerr << "Unsupported DCD record markers (64-bit Fortran records?) in " << path << std::endl;
+        close();
+        return false;
+    }
+    auto control = [this](int word) { return readInt(8 + 4 * word); };
+    uint32_t fixedAtoms = control(8);
+    bool charmm = control(19) != 0;
+    hasUnitCell = charmm && control(10) != 0;
+    bool fourDimensions = charmm && control(11) != 0;
+    if (fixedAtoms != 0)
+    {
+        std::cerr << "DCD files with fixed atoms are not supported: " << path << std::endl;
+        close();
+        return false;
+    }
+
+    // Title record, then the atom count record
+    size_t offset = HEADER_RECORD_BYTES + 8;
+    uint32_t titleBytes = offset + 4 <= file.size() ? readInt(offset) : 0;
+    offset += 4 + static_cast<size_t>(titleBytes) + 4;
+    if (offset + 12 > file.size() || readInt(offset) != 4 || readInt(offset + 8) != 4)
+    {
+        std::cerr << "Truncated DCD header in " << path << std::endl;
+        close();
+        return false;
+    }
+    atomCount = readInt(offset + 4);
+    firstFrame = offset + 12;
+
+    size_t coordinateRecord = 4 + 4 * atomCount + 4;
+    frameBytes = (hasUnitCell ? UNIT_CELL_RECORD_BYTES : 0) + (fourDimensions ? 4 : 3) * coordinateRecord;
+    frameCount = atomCount > 0 ? (file.size() - firstFrame) / frameBytes : 0;
+    if (frameCount == 0)
+    {
+        std::cerr << "No frames in " << path << std::endl;
+        close();
+        return false;
+    }
+    if ((file.size() - firstFrame) % frameBytes != 0)
+    {
+        // The header's frame count is often stale; the file size is what counts
+        std::cerr << "Frame " << frameCount + 1 << " of " << path << " is incomplete" << std::endl;
+    }
+    return true;
+}
+
+void DcdTrajectory::close()
+{
+    file.close();
+    atomCount = frameCount = firstFrame = frameBytes = 0;
+}
+
+bool DcdTrajectory::readPositions(size_t frame, glm::vec4 *positions) const
+{
+    // X, Y and Z are separate records of atomCount floats each
+    size_t offset = firstFrame + frame * frameBytes + (hasUnitCell ? UNIT_CELL_RECORD_BYTES : 0);
+    uint32_t recordBytes = static_cast<uint32_t>(4 * atomCount);
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        if (readInt(offset) != recordBytes || readInt(offset + 4 + recordBytes) != recordBytes)
+        {
+            std::cerr << "Damaged frame " << frame + 1 << " in " << getPath() << std::endl;
+            return false;
+        }
+        const char *values = file.data() + offset + 4;
+        for (size_t atom = 0; atom < atomCount; ++atom)
+        {
+            uint32_t bits;
+            std::memcpy(&bits, values + 4 * atom, sizeof(bits));
+            bits = swapBytes ? byteSwap(bits) : bits;
+            std::memcpy(&positions[atom][axis], &bits, sizeof(bits));
+        }
+        offset += 4 + recordBytes + 4;
+    }
+    for (size_t atom = 0; atom < atomCount; ++atom)
+    {
+        positions[atom].w = 0.0f;
+    }
+    return true;
+}
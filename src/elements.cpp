@@ -0,0 +1,172 @@
+#include "elements.h"
+#include <cctype>
+
+namespace {
+
+const ElementInfo elementTable[ELEMENT_COUNT] = {
+    {"X", 0.00f, 1.50f, 0xFF1493},
+    {"H", 0.31f, 1.20f, 0xFFFFFF},
+    {"He", 0.28f, 1.40f, 0xD9FFFF},
+    {"Li", 1.28f, 1.82f, 0xCC80FF},
+    {"Be", 0.96f, 1.53f, 0xC2FF00},
+    {"B", 0.84f, 1.92f, 0xFFB5B5},
+    {"C", 0.76f, 1.70f, 0x909090},
+    {"N", 0.71f, 1.55f, 0x3050F8},
+    {"O", 0.66f, 1.52f, 0xFF0D0D},
+    {"F", 0.57f, 1.47f, 0x90E050},
+    {"Ne", 0.58f, 1.54f, 0xB3E3F5},
+    {"Na", 1.66f, 2.27f, 0xAB5CF2},
+    {"Mg", 1.41f, 1.73f, 0x8AFF00},
+    {"Al", 1.21f, 1.84f, 0xBFA6A6},
+    {"Si", 1.11f, 2.10f, 0xF0C8A0},
+    {"P", 1.07f, 1.80f, 0xFF8000},
+    {"S", 1.05f, 1.80f, 0xFFFF30},
+    {"Cl", 1.02f, 1.75f, 0x1FF01F},
+    {"Ar", 1.06f, 1.88f, 0x80D1E3},
+    {"K", 2.03f, 2.75f, 0x8F40D4},
+    {"Ca", 1.76f, 2.31f, 0x3DFF00},
+    {"Sc", 1.70f, 2.11f, 0xE6E6E6},
+    {"Ti", 1.60f, 2.00f, 0xBFC2C7},
+    {"V", 1.53f, 2.00f, 0xA6A6AB},
+    {"Cr", 1.39f, 2.00f, 0x8A99C7},
+    {"Mn", 1.39f, 2.00f, 0x9C7AC7},
+    {"Fe", 1.32f, 2.00f, 0xE06633},
+    {"Co", 1.26f, 2.00f, 0xF090A0},
+    {"Ni", 1.24f, 1.63f, 0x50D050},
+    {"Cu", 1.32f, 1.40f, 0xC88033},
+    {"Zn", 1.22f, 1.39f, 0x7D80B0},
+    {"Ga", 1.22f, 1.87f, 0xC28F8F},
+    {"Ge", 1.20f, 2.11f, 0x668F8F},
+    {"As", 1.19f, 1.85f, 0xBD80E3},
+    {"Se", 1.20f, 1.90f, 0xFFA100},
+    {"Br", 1.20f, 1.85f, 0xA62929},
+    {"Kr", 1.16f, 2.02f, 0x5CB8D1},
+    {"Rb", 2.20f, 3.03f, 0x702EB0},
+    {"Sr", 1.95f, 2.49f, 0x00FF00},
+    {"Y", 1.90f, 2.00f, 0x94FFFF},
+    {"Zr", 1.75f, 2.00f, 0x94E0E0},
+    {"Nb", 1.64f, 2.00f, 0x73C2C9},
+    {"Mo", 1.54f, 2.00f, 0x54B5B5},
+    {"Tc", 1.47f, 2.00f, 0x3B9E9E},
+    {"Ru", 1.46f, 2.00f, 0x248F8F},
+    {"Rh", 1.42f, 2.00f, 0x0A7D8C},
+    {"Pd", 1.39f, 1.63f, 0x006985},
+    {"Ag", 1.45f, 1.72f, 0xC0C0C0},
+    {"Cd", 1.44f, 1.58f, 0xFFD98F},
+    {"In", 1.42f, 1.93f, 0xA67573},
+    {"Sn", 1.39f, 2.17f, 0x668080},
+    {"Sb", 1.39f, 2.06f, 0x9E63B5},
+    {"Te", 1.38f, 2.06f, 0xD47A00},
+    {"I", 1.39f, 1.98f, 0x940094},
+    {"Xe", 1.40f, 2.16f, 0x429EB0},
+    {"Cs", 2.44f, 3.43f, 0x57178F},
+    {"Ba", 2.15f, 2.68f, 0x00C900},
+    {"La", 2.07f, 2.00f, 0x70D4FF},
+    {"Ce", 2.04f, 2.00f, 0xFFFFC7},
+    {"Pr", 2.03f, 2.00f, 0xD9FFC7},
+    {"Nd", 2.01f, 2.00f, 0xC7FFC7},
+    {"Pm", 1.99f, 2.00f, 0xA3FFC7},
+    {"Sm", 1.98f, 2.00f, 0x8FFFC7},
+    {"Eu", 1.98f, 2.00f, 0x61FFC7},
+    {"Gd", 1.96f, 2.00f, 0x45FFC7},
+    {"Tb", 1.94f, 2.00f, 0x30FFC7},
+    {"Dy", 1.92f, 2.00f, 0x1FFFC7},
+    {"Ho", 1.92f, 2.00f, 0x00FF9C},
+    {"Er", 1.89f, 2.00f, 0x00E675},
+    {"Tm", 1.90f, 2.00f, 0x00D452},
+    {"Yb", 1.87f, 2.00f, 0x00BF38},
+    {"Lu", 1.87f, 2.00f, 0x00AB24},
+    {"Hf", 1.75f, 2.00f, 0x4DC2FF},
+    {"Ta", 1.70f, 2.00f, 0x4DA6FF},
+    {"W", 1.62f, 2.00f, 0x2194D6},
+    {"Re", 1.51f, 2.00f, 0x267DAB},
+    {"Os", 1.44f, 2.00f, 0x266696},
+    {"Ir", 1.41f, 2.00f, 0x175487},
+    {"Pt", 1.36f, 1.75f, 0xD0D0E0},
+    {"Au", 1.36f, 1.66f, 0xFFD123},
+    {"Hg", 1.32f, 1.55f, 0xB8B8D0},
+    {"Tl", 1.45f, 1.96f, 0xA6544D},
+    {"Pb", 1.46f, 2.02f, 0x575961},
+    {"Bi", 1.48f, 2.07f, 0x9E4FB5},
+    {"Po", 1.40f, 1.97f, 0xAB5C00},
+    {"At", 1.50f, 2.02f, 0x754F45},
+    {"Rn", 1.50f, 2.20f, 0x428296},
+    {"Fr", 2.60f, 3.48f, 0x420066},
+    {"Ra", 2.21f, 2.83f, 0x007D00},
+    {"Ac", 2.15f, 2.00f, 0x70ABFA},
+    {"Th", 2.06f, 2.00f, 0x00BAFF},
+    {"Pa", 2.00f, 2.00f, 0x00A1FF},
+    {"U", 1.96f, 1.86f, 0x008FFF},
+    {"Np", 1.90f, 2.00f, 0x0080FF},
+    {"Pu", 1.87f, 2.00f, 0x006BFF},
+    {"Am", 1.80f, 2.00f, 0x545CF2},
+    {"Cm", 1.69f, 2.00f, 0x785CE3},
+    {"Bk", 1.50f, 2.00f, 0x8A4FE3},
+    {"Cf", 1.50f, 2.00f, 0xA136D4},
+    {"Es", 1.50f, 2.00f, 0xB31FD4},
+    {"Fm", 1.50f, 2.00f, 0xB31FBA},
+    {"Md", 1.50f, 2.00f, 0xB30DA6},
+    {"No", 1.50f, 2.00f, 0xBD0D87},
+    {"Lr", 1.50f, 2.00f, 0xC70066},
+    {"Rf", 1.50f, 2.00f, 0xCC0059},
+    {"Db", 1.50f, 2.00f, 0xD1004F},
+    {"Sg", 1.50f, 2.00f, 0xD90045},
+    {"Bh", 1.50f, 2.00f, 0xE00038},
+    {"Hs", 1.50f, 2.00f, 0xE6002E},
+    {"Mt", 1.50f, 2.00f, 0xEB0026},
+    {"Ds", 1.50f, 2.00f, 0xFF1493},
+    {"Rg", 1.50f, 2.00f, 0xFF1493},
+    {"Cn", 1.50f, 2.00f, 0xFF1493},
+    {"Nh", 1.50f, 2.00f, 0xFF1493},
+    {"Fl", 1.50f, 2.00f, 0xFF1493},
+    {"Mc", 1.50f, 2.00f, 0xFF1493},
+    {"Lv", 1.50f, 2.00f, 0xFF1493},
+    {"Ts", 1.50f, 2.00f, 0xFF1493},
+    {"Og", 1.50f, 2.00f, 0xFF1493},
+};
+
+} // namespace
+
+const ElementInfo &getElementInfo(int atomicNumber)
+{
+    if (atomicNumber <= 0 || atomicNumber >= ELEMENT_COUNT)
+    {
+        return elementTable[0];
+    }
+    return elementTable[atomicNumber];
+}
+
+int elementFromSymbol(std::string_view symbol)
+{
+    // Trim surrounding whitespace (fixed-column formats pad symbols)
+    while (!symbol.empty() && std::isspace(static_cast<unsigned char>(symbol.front())))
+        symbol.remove_prefix(1);
+    while (!symbol.empty() && std::isspace(static_cast<unsigned char>(symbol.back())))
+        symbol.remove_suffix(1);
+
+    if (symbol.empty() || symbol.size() > 2)
+    {
+        return 0;
+    }
+
+    for (int z = 1; z < ELEMENT_COUNT; ++z)
+    {
+        const char *candidate = elementTable[z].symbol;
+        bool match = true;
+        size_t i = 0;
+        for (; i < symbol.size() && candidate[i] != '\0'; ++i)
+        {
+            if (std::tolower(static_cast<unsigned char>(symbol[i])) !=
+                std::tolower(static_cast<unsigned char>(candidate[i])))
+            {
+                match = false;
+                break;
+            }
+        }
+        if (match && i == symbol.size() && candidate[i] == '\0')
+        {
+            return z;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,331 @@
+#include "frame_capture.h"
+#include "cpu_profiler.h"
+#include "image_writer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <thread>
+
+namespace {
+
+// Client waits are split into short timeouts so a lost context can't hang the loop forever
+constexpr GLuint64 FENCE_WAIT_NS = 100 * 1000 * 1000;
+
+bool waitForFence(GLsync fence)
+{
+    for (int attempt = 0; attempt < 50; ++attempt)
+    {
+        GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_WAIT_NS);
+        if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+        {
+            return true;
+        }
+        if (status == GL_WAIT_FAILED)
+        {
+            break;
+        }
+    }
+    std::cerr << "Timed out waiting for a capture readback" << std::endl;
+    return false;
+}
+
+} // namespace
+
+FrameCapture::~FrameCapture()
+{
+    // Encoders finish their queued PNGs; the mapped buffers outlive them
+    encoders.reset();
+}
+
+void FrameCapture::destroy()
+{
+    flush();
+    encoders.reset();
+    for (std::unique_ptr<Slot> &slot : slots)
+    {
+        if (slot->buffer)
+        {
+            glUnmapNamedBuffer(slot->buffer);
+            glDeleteBuffers(1, &slot->buffer);
+        }
+    }
+    slots.clear();
+}
+
+bool FrameCapture::capture(const std::string &path, int width, int height, const std::vector<Source> &sources,
+                           const glm::vec3 &background)
+{
+    PROFILE_ZONE("capture readback");
+
+    if (width <= 0 || height <= 0)
+    {
+        return false;
+    }
+
+    Slot *slot = acquireSlot();
+    size_t size = static_cast<size_t>(width) * height * 4;
+    ensureCapacity(*slot, size);
+    if (!slot->mapped)
+    {
+        failed++;
+        return false;
+    }
+
+    // Uncovered areas (sidebar, status bar) get the background
+    uint8_t clearColor[4] = {static_cast<uint8_t>(std::clamp(background.r, 0.0f, 1.0f) * 255.0f + 0.5f),
+                             static_cast<uint8_t>(std::clamp(background.g, 0.0f, 1.0f) * 255.0f + 0.5f),
+                             static_cast<uint8_t>(std::clamp(background.b, 0.0f, 1.0f) * 255.0f + 0.5f), 255};
+    glClearNamedBufferSubData(slot->buffer, GL_RGBA8, 0, static_cast<GLsizeiptr>(size), GL_RGBA,
+                              GL_UNSIGNED_BYTE, clearColor);
+
+    // The buffer holds the image bottom row first, as GL packs it; the encoder writes rows in reverse
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->buffer);
+    glPixelStorei(GL_PACK_ROW_LENGTH, width);
+    for (const Source &source : sources)
+    {
+        if (source.x < 0 || source.y < 0 || source.x >= width || source.y >= height)
+        {
+            continue;
+        }
+        int copyWidth = std::min(source.width, width - source.x);
+        int copyHeight = std::min(source.height, height - source.y);
+
+        // Cropped at the bottom of the image: keep the top rows of the source
+        size_t offset = (static_cast<size_t>(height - source.y - copyHeight) * width + source.x) * 4;
+        glGetTextureSubImage(source.texture, 0, 0, source.height - copyHeight, source.layer, copyWidth, copyHeight,
+                             1, GL_RGBA, GL_UNSIGNED_BYTE, static_cast<GLsizei>(size - offset),
+                             reinterpret_cast<void *>(offset));
+    }
+    glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot->path = path;
+    slot->width = width;
+    slot->height = height;
+    slot->sequence = captureCount++;
+    slot->state.store(Reading, std::memory_order_release);
+    requested++;
+
+    // Submit now, so the copy overlaps the rest of the frame instead of waiting for the swap
+    glFlush();
+    return true;
+}
+
+FrameCapture::Slot *FrameCapture::acquireSlot()
+{
+    if (!encoders)
+    {
+        encoders = std::make_unique<ThreadPool>(0, "png encoder");
+        size_t slotCount = encoders->getThreadCount() + EXTRA_SLOTS;
+        for (size_t i = 0; i < slotCount; ++i)
+        {
+            slots.push_back(std::make_unique<Slot>());
+        }
+    }
+
+    bool stalled = false;
+    while (true)
+    {
+        update();
+        for (std::unique_ptr<Slot> &slot : slots)
+        {
+            if (slot->state.load(std::memory_order_acquire) == Free)
+            {
+                return slot.get();
+            }
+        }
+
+        // Every buffer is busy: the encoders or the GPU are behind the capture rate
+        if (!stalled)
+        {
+            stalled = true;
+            stalls++;
+        }
+        PROFILE_ZONE("capture stall");
+
+        Slot *oldestReading = nullptr;
+        for (std::unique_ptr<Slot> &slot : slots)
+        {
+            if (slot->state.load(std::memory_order_acquire) == Reading &&
+                (!oldestReading || slot->sequence < oldestReading->sequence))
+            {
+                oldestReading = slot.get();
+            }
+        }
+        if (oldestReading)
+        {
+            completeReadback(*oldestReading);
+        }
+        else
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+        }
+    }
+}
+
+void FrameCapture::ensureCapacity(Slot &slot, size_t size)
+{
+    if (slot.capacity >= size)
+    {
+        return;
+    }
+    if (slot.buffer)
+    {
+        glUnmapNamedBuffer(slot.buffer);
+        glDeleteBuffers(1, &slot.buffer);
+        slot.buffer = 0;
+        slot.mapped = nullptr;
+    }
+
+    // Persistent coherent mapping: encoders read the pixels in place once the fence signals
+    GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glCreateBuffers(1, &slot.buffer);
+    glNamedBufferStorage(slot.buffer, static_cast<GLsizeiptr>(size), nullptr, flags);
+    slot.mapped = static_cast<const uint8_t *>(glMapNamedBufferRange(slot.buffer, 0, static_cast<GLsizeiptr>(size), flags));
+    slot.capacity = slot.mapped ? size : 0;
+    if (!slot.mapped)
+    {
+        std::cerr << "Failed to map a " << size << " byte capture buffer" << std::endl;
+    }
+}
+
+void FrameCapture::update()
+{
+    // Fences signal in submission order, so stop at the first one still pending
+    while (true)
+    {
+        Slot *oldest = nullptr;
+        for (std::unique_ptr<Slot> &slot : slots)
+        {
+            if (slot->state.load(std::memory_order_acquire) == Reading && (!oldest || slot->sequence < oldest->sequence))
+            {
+                oldest = slot.get();
+            }
+        }
+        if (!oldest)
+        {
+            return;
+        }
+
+        GLenum status = glClientWaitSync(oldest->fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+        {
+            return;
+        }
+        startEncoding(*oldest);
+    }
+}
+
+void FrameCapture::startEncoding(Slot &slot)
+{
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+    slot.state.store(Encoding, std::memory_order_release);
+    encoders->submit([this, &slot]() { encode(slot); });
+}
+
+void FrameCapture::completeReadback(Slot &slot)
+{
+    if (waitForFence(slot.fence))
+    {
+        startEncoding(slot);
+        return;
+    }
+
+    // The copy never finished; give the buffer back rather than encode garbage
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+    slot.state.store(Free, std::memory_order_release);
+    failed++;
+}
+
+void FrameCapture::encode(Slot &slot)
+{
+    PROFILE_ZONE("png encode");
+    auto start = std::chrono::steady_clock::now();
+
+    PngWriter writer;
+    writer.compressionLevel = compressionLevel;
+    bool ok = writer.open(slot.path, slot.width, slot.height);
+    size_t rowBytes = static_cast<size_t>(slot.width) * 4;
+    for (int y = slot.height - 1; ok && y >= 0; --y)
+    {
+        ok = writer.writeRows(slot.mapped + y * rowBytes, 1);
+    }
+    ok = writer.close() && ok;
+
+    lastEncodeMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    (ok ? written : failed)++;
+    slot.state.store(Free, std::memory_order_release);
+}
+
+void FrameCapture::flush()
+{
+    while (hasPendingReadbacks())
+    {
+        for (std::unique_ptr<Slot> &slot : slots)
+        {
+            if (slot->state.load(std::memory_order_acquire) == Reading)
+            {
+                completeReadback(*slot);
+            }
+        }
+    }
+    if (encoders)
+    {
+        encoders->waitIdle();
+    }
+}
+
+bool FrameCapture::hasPendingReadbacks() const
+{
+    for (const std::unique_ptr<Slot> &slot : slots)
+    {
+        if (slot->state.load(std::memory_order_acquire) == Reading)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool FrameCapture::startSequence(const std::string &directory)
+{
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error)
+    {
+        std::cerr << "Failed to create " << directory << ": " << error.message() << std::endl;
+        return false;
+    }
+    sequenceDirectory = directory;
+    sequenceFrame = 0;
+    recording = true;
+    return true;
+}
+
+void FrameCapture::stopSequence()
+{
+    recording = false;
+}
+
+std::string FrameCapture::nextSequencePath()
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "frame_%06llu.png", static_cast<unsigned long long>(sequenceFrame++));
+    return sequenceDirectory + "/" + name;
+}
+
+FrameCapture::Stats FrameCapture::getStats() const
+{
+    Stats stats;
+    stats.requested = requested;
+    stats.written = written;
+    stats.failed = failed;
+    stats.stalls = stalls;
+    stats.lastEncodeMs = lastEncodeMs;
+    return stats;
+}
@@ -0,0 +1,113 @@
+#include "frame_index.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace {
+
+constexpr char INDEX_MAGIC[4] = {'M', 'V', 'T', 'I'};
+constexpr uint32_t INDEX_VERSION = 1;
+
+struct IndexHeader {
+    char magic[4];
+    uint32_t version;
+    char format[8];        // Reader that built the index, zero padded
+    uint64_t sourceBytes;  // Size and modification time of the trajectory
+    int64_t sourceModified;
+    uint64_t atomCount;
+    uint64_t offsetCount;
+};
+
+bool sourceState(const std::string &trajectoryPath, uint64_t &bytes, int64_t &modified)
+{
+    std::error_code error;
+    bytes = std::filesystem::file_size(trajectoryPath, error);
+    if (error)
+        return false;
+    auto time = std::filesystem::last_write_time(trajectoryPath, error);
+    modified = static_cast<int64_t>(time.time_since_epoch().count());
+    return !error;
+}
+
+void copyFormat(char (&target)[8], const std::string &format)
+{
+    std::memset(target, 0, sizeof(target));
+    std::memcpy(target, format.data(), std::min(format.size(), sizeof(target)));
+}
+
+} // namespace
+
+std::string FrameIndex::sidecarPath(const std::string &trajectoryPath)
+{
+    return trajectoryPath + ".mvidx";
+}
+
+bool FrameIndex::load(const std::string &trajectoryPath, const std::string &format)
+{
+    uint64_t bytes;
+    int64_t modified;
+    if (!sourceState(trajectoryPath, bytes, modified))
+    {
+        return false;
+    }
+
+    std::ifstream file(sidecarPath(trajectoryPath), std::ios::binary);
+    IndexHeader header;
+    char expectedFormat[8];
+    copyFormat(expectedFormat, format);
+    if (!file || !file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 || header.version != INDEX_VERSION ||
+        std::memcmp(header.format, expectedFormat, sizeof(expectedFormat)) != 0 || header.sourceBytes != bytes ||
+        header.sourceModified != modified || header.offsetCount < 2)
+    {
+        return false;
+    }
+
+    offsets.resize(header.offsetCount);
+    if (!file.read(reinterpret_cast<char *>(offsets.data()), offsets.size() * sizeof(uint64_t)) ||
+        offsets.back() > bytes)
+    {
+        offsets.clear();
+        return false;
+    }
+    atomCount = header.atomCount;
+    return true;
+}
+
+void FrameIndex::save(const std::string &trajectoryPath, const std::string &format) const
+{
+    IndexHeader header;
+    std::memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    header.version = INDEX_VERSION;
+    copyFormat(header.format, format);
+    if (offsets.size() < 2 || !sourceState(trajectoryPath, header.sourceBytes, header.sourceModified))
+    {
+        return;
+    }
+    header.atomCount = atomCount;
+    header.offsetCount = offsets.size();
+
+    // Another viewer may be indexing the same file: write a private file, then rename it into place
+    std::string path = sidecarPath(trajectoryPath);
+    std::string temporaryPath =
+        path + "." + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + ".tmp";
+    std::error_code error;
+    {
+        std::ofstream file(temporaryPath, std::ios::binary);
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(offsets.data()), offsets.size() * sizeof(uint64_t));
+        if (!file)
+        {
+            file.close();
+            std::filesystem::remove(temporaryPath, error);
+            return;
+        }
+    }
+    std::filesystem::rename(temporaryPath, path, error);
+    if (error)
+    {
+        std::filesystem::remove(temporaryPath, error);
+    }
+}
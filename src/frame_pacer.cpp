@@ -0,0 +1,149 @@
+#include "frame_pacer.h"
+#include "app_data.h"
+#include "cpu_profiler.h"
+#include <GLFW/glfw3.h>
+
+namespace {
+
+FramePacer *pacerFor(GLFWwindow *window)
+{
+    AppData *appData = static_cast<AppData *>(glfwGetWindowUserPointer(window));
+    return appData ? appData->framePacer : nullptr;
+}
+
+// Any input means the UI may change; render a few frames
+void redrawOnInput(GLFWwindow *window)
+{
+    if (FramePacer *pacer = pacerFor(window))
+    {
+        pacer->requestRedraw();
+    }
+}
+
+void onMouseButton(GLFWwindow *window, int, int, int) { redrawOnInput(window); }
+void onCursorPos(GLFWwindow *window, double, double) { redrawOnInput(window); }
+void onScroll(GLFWwindow *window, double, double) { redrawOnInput(window); }
+void onKey(GLFWwindow *window, int, int, int, int) { redrawOnInput(window); }
+void onChar(GLFWwindow *window, unsigned int) { redrawOnInput(window); }
+void onRefresh(GLFWwindow *window) { redrawOnInput(window); }
+void onFocus(GLFWwindow *window, int) { redrawOnInput(window); }
+void onCursorEnter(GLFWwindow *window, int) { redrawOnInput(window); }
+
+} // namespace
+
+FramePacer::FramePacer(GLFWwindow *window) : window(window)
+{
+}
+
+void FramePacer::installCallbacks()
+{
+    glfwSetMouseButtonCallback(window, onMouseButton);
+    glfwSetCursorPosCallback(window, onCursorPos);
+    glfwSetScrollCallback(window, onScroll);
+    glfwSetKeyCallback(window, onKey);
+    glfwSetCharCallback(window, onChar);
+    glfwSetWindowRefreshCallback(window, onRefresh);
+    glfwSetWindowFocusCallback(window, onFocus);
+    glfwSetCursorEnterCallback(window, onCursorEnter);
+}
+
+void FramePacer::requestRedraw(int frames)
+{
+    if (frames > pendingFrames)
+    {
+        pendingFrames = frames;
+    }
+}
+
+void FramePacer::scheduleRedraw(double seconds)
+{
+    double time = glfwGetTime() + seconds;
+    if (scheduledRedrawTime == 0.0 || time < scheduledRedrawTime)
+    {
+        scheduledRedrawTime = time;
+    }
+}
+
+void FramePacer::wake()
+{
+    wakeRequested.store(true, std::memory_order_release);
+    glfwPostEmptyEvent();
+}
+
+void FramePacer::setContinuous(Reason reason, bool active)
+{
+    if (active)
+    {
+        continuousReasons |= reason;
+    }
+    else if (continuousReasons & reason)
+    {
+        continuousReasons &= ~reason;
+        // One more frame so the final state is shown
+        requestRedraw(1);
+    }
+}
+
+void FramePacer::waitForEvents()
+{
+    if (pendingFrames > 0)
+    {
+        pendingFrames--;
+    }
+
+    if (isContinuous() || pendingFrames > 0)
+    {
+        glfwPollEvents();
+        wakeRequested.store(false, std::memory_order_relaxed);
+        scheduledRedrawTime = 0.0;
+        return;
+    }
+
+    // Idle: sleep until input (callbacks raise pendingFrames), a background
+    // wake-up, a scheduled frame or the heartbeat timeout
+    PROFILE_ZONE(IDLE_ZONE);
+    double deadline = glfwGetTime() + idleTimeout;
+    if (scheduledRedrawTime != 0.0 && scheduledRedrawTime < deadline)
+    {
+        deadline = scheduledRedrawTime;
+    }
+    scheduledRedrawTime = 0.0;
+    while (pendingFrames == 0 && !isContinuous() && !glfwWindowShouldClose(window))
+    {
+        if (wakeRequested.exchange(false, std::memory_order_acquire))
+        {
+            pendingFrames = 1;
+            break;
+        }
+
+        double remaining = deadline - glfwGetTime();
+        if (remaining <= 0.0)
+        {
+            // Scheduled frame, or a heartbeat so clocks and polled state in the UI stay fresh
+            break;
+        }
+        glfwWaitEventsTimeout(remaining);
+    }
+}
+
+std::string FramePacer::getModeDescription() const
+{
+    if (!isContinuous())
+    {
+        return pendingFrames > 0 ? "On-demand" : "On-demand (idle)";
+    }
+
+    std::string description = "Continuous (";
+    bool first = true;
+    auto append = [&](Reason reason, const char *name) {
+        if (continuousReasons & reason)
+        {
+            description += first ? name : std::string(", ") + name;
+            first = false;
+        }
+    };
+    append(Interaction, "interaction");
+    append(Playback, "playback");
+    append(Animation, "animation");
+    return description + ")";
+}
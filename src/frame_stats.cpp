@@ -0,0 +1,162 @@
+#include "frame_stats.h"
+#include "cpu_profiler.h"
+#include "frame_pacer.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+void FrameStats::addFrame(float ms, double time)
+{
+    history[frameCount % HISTORY_LENGTH] = ms;
+    frameCount++;
+    totalMs += ms;
+
+    // Judge the frame against the median before it joins the percentiles
+    float median = summary.p50;
+    updateSummary();
+
+    if (isOverBudget(ms))
+    {
+        overBudgetCount++;
+        if (frameCount > HISTORY_LENGTH / 10 && ms > median * stutterFactor)
+        {
+            stutterCount++;
+            if (stutters.size() == STUTTER_HISTORY)
+            {
+                stutters.erase(stutters.begin());
+            }
+            stutters.push_back({frameCount, ms, findStutterCause(), time});
+        }
+    }
+
+    if (!metricsPath.empty() && time - lastMetricsTime >= metricsInterval)
+    {
+        lastMetricsTime = time;
+        writeMetrics(metricsPath);
+    }
+}
+
+void FrameStats::updateSummary()
+{
+    size_t count = static_cast<size_t>(std::min<uint64_t>(frameCount, HISTORY_LENGTH));
+    sorted.assign(history.begin(), history.begin() + count);
+    if (sorted.empty())
+    {
+        summary = Summary();
+        return;
+    }
+
+    // Nearest-rank percentiles; nth_element keeps this linear
+    auto percentile = [&](float fraction) {
+        size_t rank = std::min(count - 1, static_cast<size_t>(fraction * count));
+        std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+        return sorted[rank];
+    };
+    summary.p50 = percentile(0.50f);
+    summary.p95 = percentile(0.95f);
+    summary.p99 = percentile(0.99f);
+    summary.max = *std::max_element(sorted.begin(), sorted.end());
+    summary.samples = count;
+}
+
+std::string FrameStats::findStutterCause()
+{
+    uint64_t frameStart = 0, frameEnd = 0;
+    std::vector<CpuProfiler::Event> events = CpuProfiler::instance().getLastFrame(frameStart, frameEnd);
+
+    // The zone with the most self time (its duration minus its direct children)
+    const CpuProfiler::Event *worst = nullptr;
+    uint64_t worstSelf = 0;
+    for (const CpuProfiler::Event &event : events)
+    {
+        if (event.name == FramePacer::IDLE_ZONE)
+        {
+            continue;
+        }
+
+        uint64_t self = event.endNs - event.startNs;
+        for (const CpuProfiler::Event &child : events)
+        {
+            bool nested = child.depth == event.depth + 1 && child.startNs >= event.startNs && child.endNs <= event.endNs;
+            if (nested)
+            {
+                self -= std::min(self, child.endNs - child.startNs);
+            }
+        }
+        if (self > worstSelf)
+        {
+            worst = &event;
+            worstSelf = self;
+        }
+    }
+    return worst ? worst->name : "unknown";
+}
+
+void FrameStats::setRefreshRate(double hz)
+{
+    if (hz > 0.0)
+    {
+        budgetMs = static_cast<float>(1000.0 / hz);
+    }
+}
+
+void FrameStats::setMetricsFile(const std::string &path, double intervalSeconds)
+{
+    metricsPath = path;
+    metricsInterval = intervalSeconds;
+}
+
+bool FrameStats::writeMetrics(const std::string &path) const
+{
+    // Write to a temporary file and rename, so a scraper never sees a partial file
+    std::string temporaryPath = path + ".tmp";
+    {
+        std::ofstream file(temporaryPath);
+        if (!file)
+        {
+            std::cerr << "Failed to open " << temporaryPath << " for writing" << std::endl;
+            return false;
+        }
+
+        // Quantiles over the recent frames; _sum and _count cover every frame, as Prometheus expects
+        file << "# HELP molview_frame_time_ms Frame time, quantiles over the last " << summary.samples << " frames\n"
+             << "# TYPE molview_frame_time_ms summary\n"
+             << "molview_frame_time_ms{quantile=\"0.5\"} " << summary.p50 << "\n"
+             << "molview_frame_time_ms{quantile=\"0.95\"} " << summary.p95 << "\n"
+             << "molview_frame_time_ms{quantile=\"0.99\"} " << summary.p99 << "\n"
+             << "molview_frame_time_ms{quantile=\"1\"} " << summary.max << "\n"
+             << "molview_frame_time_ms_sum " << totalMs << "\n"
+             << "molview_frame_time_ms_count " << frameCount << "\n"
+             << "# HELP molview_frame_budget_ms Frame budget\n"
+             << "# TYPE molview_frame_budget_ms gauge\n"
+             << "molview_frame_budget_ms " << budgetMs << "\n"
+             << "# HELP molview_frames_total Frames rendered\n"
+             << "# TYPE molview_frames_total counter\n"
+             << "molview_frames_total " << frameCount << "\n"
+             << "# HELP molview_frames_over_budget_total Frames slower than the budget\n"
+             << "# TYPE molview_frames_over_budget_total counter\n"
+             << "molview_frames_over_budget_total " << overBudgetCount << "\n"
+             << "# HELP molview_stutters_total Frames over budget and far above the median\n"
+             << "# TYPE molview_stutters_total counter\n"
+             << "molview_stutters_total " << stutterCount << "\n";
+        if (!stutters.empty())
+        {
+            const Stutter &last = stutters.back();
+            file << "# HELP molview_last_stutter_ms Duration of the most recent stutter, labelled with its cause\n"
+                 << "# TYPE molview_last_stutter_ms gauge\n"
+                 << "molview_last_stutter_ms{cause=\"" << last.cause << "\"} " << last.ms << "\n";
+        }
+        if (!file)
+        {
+            return false;
+        }
+    }
+
+    if (std::rename(temporaryPath.c_str(), path.c_str()) != 0)
+    {
+        std::cerr << "Failed to replace " << path << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,141 @@
+#include "framebuffer_pool.h"
+#include "cpu_profiler.h"
+#include <algorithm>
+#include <iostream>
+
+int FramebufferPool::roundToBucket(int pixels)
+{
+    pixels = std::max(1, pixels);
+    return ((pixels + BUCKET_SIZE - 1) / BUCKET_SIZE) * BUCKET_SIZE;
+}
+
+FramebufferPool::Attachment FramebufferPool::acquire()
+{
+    if (freeLayers.empty())
+    {
+        // Grow geometrically so a layout of many views does not recreate the array per view
+        size_t oldCount = layerFbos.size();
+        recreate(width, height, std::max<size_t>(4, oldCount * 2));
+        for (size_t layer = oldCount; layer < layerFbos.size(); ++layer)
+        {
+            freeLayers.push_back(static_cast<int>(layer));
+        }
+    }
+
+    // Lowest free layer first keeps the used layers packed
+    auto lowest = std::min_element(freeLayers.begin(), freeLayers.end());
+    Attachment attachment;
+    attachment.layer = *lowest;
+    attachment.fbo = layerFbos[attachment.layer];
+    freeLayers.erase(lowest);
+    return attachment;
+}
+
+void FramebufferPool::release(const Attachment &attachment)
+{
+    if (attachment.layer >= 0 && static_cast<size_t>(attachment.layer) < layerFbos.size())
+    {
+        freeLayers.push_back(attachment.layer);
+    }
+}
+
+bool FramebufferPool::reserve(int minWidth, int minHeight)
+{
+    int bucketWidth = std::max(width, roundToBucket(minWidth));
+    int bucketHeight = std::max(height, roundToBucket(minHeight));
+    if (bucketWidth == width && bucketHeight == height)
+    {
+        return false;
+    }
+    recreate(bucketWidth, bucketHeight, layerFbos.size());
+    return true;
+}
+
+bool FramebufferPool::resize(int newWidth, int newHeight)
+{
+    int bucketWidth = roundToBucket(newWidth);
+    int bucketHeight = roundToBucket(newHeight);
+    if (bucketWidth == width && bucketHeight == height)
+    {
+        return false;
+    }
+    recreate(bucketWidth, bucketHeight, layerFbos.size());
+    return true;
+}
+
+void FramebufferPool::clear()
+{
+    if (stateCache)
+    {
+        for (unsigned int fbo : layerFbos)
+        {
+            stateCache->forgetFramebuffer(fbo);
+        }
+    }
+    glDeleteFramebuffers(static_cast<GLsizei>(layerFbos.size()), layerFbos.data());
+    deleteArrays();
+    layerFbos.clear();
+    freeLayers.clear();
+    generation++;
+}
+
+void FramebufferPool::recreate(int newWidth, int newHeight, size_t layerCount)
+{
+    PROFILE_ZONE("framebuffer storage resize");
+
+    width = newWidth;
+    height = newHeight;
+    generation++;
+
+    deleteArrays();
+    if (layerCount == 0)
+    {
+        return;
+    }
+
+    // Immutable color storage, one layer per region
+    GLsizei layers = static_cast<GLsizei>(layerCount);
+    glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &colorArray);
+    glTextureStorage3D(colorArray, 1, GL_RGBA8, width, height, layers);
+    glTextureParameteri(colorArray, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTextureParameteri(colorArray, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTextureParameteri(colorArray, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(colorArray, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    // Immutable depth storage
+    glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &depthArray);
+    glTextureStorage3D(depthArray, 1, GL_DEPTH_COMPONENT24, width, height, layers);
+
+    // Framebuffer names stay the same for existing layers, only the attachments change
+    while (layerFbos.size() < layerCount)
+    {
+        unsigned int fbo = 0;
+        glCreateFramebuffers(1, &fbo);
+        layerFbos.push_back(fbo);
+    }
+    for (size_t layer = 0; layer < layerFbos.size(); ++layer)
+    {
+        unsigned int fbo = layerFbos[layer];
+        glNamedFramebufferTextureLayer(fbo, GL_COLOR_ATTACHMENT0, colorArray, 0, static_cast<GLint>(layer));
+        glNamedFramebufferTextureLayer(fbo, GL_DEPTH_ATTACHMENT, depthArray, 0, static_cast<GLint>(layer));
+        if (glCheckNamedFramebufferStatus(fbo, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            std::cerr << "Framebuffer layer " << layer << " is not complete (" << width << "x" << height << ")" << std::endl;
+        }
+    }
+
+    std::cout << "Allocated framebuffer array " << width << "x" << height << " x " << layerCount << " layers" << std::endl;
+}
+
+void FramebufferPool::deleteArrays()
+{
+    // The compositor keeps the color array bound; a new array may get the same name
+    if (stateCache)
+    {
+        stateCache->forgetTexture(colorArray);
+        stateCache->forgetTexture(depthArray);
+    }
+    glDeleteTextures(1, &colorArray);
+    glDeleteTextures(1, &depthArray);
+    colorArray = depthArray = 0;
+}
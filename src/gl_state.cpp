@@ -0,0 +1,165 @@
+#include "gl_state.h"
+
+void GLStateCache::invalidate()
+{
+    validBits = 0;
+    depthTest = blend = cullFace = lineSmooth = UNKNOWN;
+}
+
+void GLStateCache::beginFrame()
+{
+    lastFrame = frame;
+    frame = Counters();
+}
+
+void GLStateCache::useProgram(GLuint id)
+{
+    if (apply(!isValid(PROGRAM_BIT) || program != id))
+    {
+        glUseProgram(id);
+        program = id;
+        validBits |= PROGRAM_BIT;
+    }
+}
+
+void GLStateCache::bindVertexArray(GLuint vao)
+{
+    if (apply(!isValid(VERTEX_ARRAY_BIT) || vertexArray != vao))
+    {
+        glBindVertexArray(vao);
+        vertexArray = vao;
+        validBits |= VERTEX_ARRAY_BIT;
+    }
+}
+
+void GLStateCache::bindFramebuffer(GLuint fbo)
+{
+    if (apply(!isValid(FRAMEBUFFER_BIT) || framebuffer != fbo))
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        framebuffer = fbo;
+        validBits |= FRAMEBUFFER_BIT;
+    }
+}
+
+void GLStateCache::bindTexture(GLuint unit, GLuint texture)
+{
+    if (unit >= TEXTURE_UNITS)
+    {
+        // Not shadowed
+        glBindTextureUnit(unit, texture);
+        apply(true);
+        return;
+    }
+
+    uint32_t bit = TEXTURE_BIT << unit;
+    if (apply(!isValid(bit) || textures[unit] != texture))
+    {
+        glBindTextureUnit(unit, texture);
+        textures[unit] = texture;
+        validBits |= bit;
+    }
+}
+
+void GLStateCache::forgetTexture(GLuint texture)
+{
+    for (GLuint unit = 0; unit < TEXTURE_UNITS; ++unit)
+    {
+        if (texture != 0 && textures[unit] == texture)
+        {
+            textures[unit] = 0;
+        }
+    }
+}
+
+void GLStateCache::forgetFramebuffer(GLuint fbo)
+{
+    if (fbo != 0 && framebuffer == fbo)
+    {
+        framebuffer = 0;
+    }
+}
+
+void GLStateCache::viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    bool same = isValid(VIEWPORT_BIT) && viewportRect[0] == x && viewportRect[1] == y &&
+                viewportRect[2] == width && viewportRect[3] == height;
+    if (apply(!same))
+    {
+        glViewport(x, y, width, height);
+        viewportRect[0] = x;
+        viewportRect[1] = y;
+        viewportRect[2] = width;
+        viewportRect[3] = height;
+        validBits |= VIEWPORT_BIT;
+    }
+}
+
+void GLStateCache::setCapability(Toggle &current, GLenum capability, bool enabled)
+{
+    Toggle wanted = enabled ? ON : OFF;
+    if (apply(current != wanted))
+    {
+        if (enabled)
+            glEnable(capability);
+        else
+            glDisable(capability);
+        current = wanted;
+    }
+}
+
+void GLStateCache::setDepthTest(bool enabled)
+{
+    setCapability(depthTest, GL_DEPTH_TEST, enabled);
+}
+
+void GLStateCache::setBlend(bool enabled)
+{
+    setCapability(blend, GL_BLEND, enabled);
+}
+
+void GLStateCache::setCullFace(bool enabled)
+{
+    setCapability(cullFace, GL_CULL_FACE, enabled);
+}
+
+void GLStateCache::setLineSmooth(bool enabled)
+{
+    setCapability(lineSmooth, GL_LINE_SMOOTH, enabled);
+}
+
+void GLStateCache::blendFunc(GLenum source, GLenum destination)
+{
+    if (apply(!isValid(BLEND_FUNC_BIT) || blendSource != source || blendDestination != destination))
+    {
+        glBlendFunc(source, destination);
+        blendSource = source;
+        blendDestination = destination;
+        validBits |= BLEND_FUNC_BIT;
+    }
+}
+
+void GLStateCache::lineWidth(float width)
+{
+    if (apply(!isValid(LINE_WIDTH_BIT) || currentLineWidth != width))
+    {
+        glLineWidth(width);
+        currentLineWidth = width;
+        validBits |= LINE_WIDTH_BIT;
+    }
+}
+
+void GLStateCache::clearColor(float r, float g, float b, float a)
+{
+    bool same = isValid(CLEAR_COLOR_BIT) && clearRgba[0] == r && clearRgba[1] == g &&
+                clearRgba[2] == b && clearRgba[3] == a;
+    if (apply(!same))
+    {
+        glClearColor(r, g, b, a);
+        clearRgba[0] = r;
+        clearRgba[1] = g;
+        clearRgba[2] = b;
+        clearRgba[3] = a;
+        validBits |= CLEAR_COLOR_BIT;
+    }
+}
@@ -0,0 +1,186 @@
+#include "gpu_profiler.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+void GpuProfiler::destroy()
+{
+    for (FrameQueries &frame : frames)
+    {
+        for (const PendingQuery &pending : frame.queries)
+        {
+            freeQueries.push_back(pending.query);
+        }
+        frame.queries.clear();
+    }
+    if (!freeQueries.empty())
+    {
+        glDeleteQueries(static_cast<GLsizei>(freeQueries.size()), freeQueries.data());
+    }
+    freeQueries.clear();
+    activeZone = -1;
+    frameOpen = false;
+}
+
+void GpuProfiler::beginFrame()
+{
+    end();
+
+    // This slot was recorded FRAME_LATENCY frames ago; its results are (almost always) ready
+    frameCounter++;
+    FrameQueries &frame = frames[frameCounter % FRAME_LATENCY];
+    collect(frame);
+    frame.frame = frameCounter;
+    frameOpen = enabled;
+}
+
+void GpuProfiler::begin(const std::string &zoneName)
+{
+    if (!frameOpen)
+    {
+        return;
+    }
+    if (activeZone >= 0)
+    {
+        // TIME_ELAPSED queries cannot nest; close the open zone
+        end();
+    }
+
+    activeZone = findZone(zoneName);
+    GLuint query = takeQuery();
+    glBeginQuery(GL_TIME_ELAPSED, query);
+    frames[frameCounter % FRAME_LATENCY].queries.push_back({activeZone, query});
+}
+
+void GpuProfiler::end()
+{
+    if (activeZone < 0)
+    {
+        return;
+    }
+    glEndQuery(GL_TIME_ELAPSED);
+    activeZone = -1;
+}
+
+int GpuProfiler::getHistoryCount() const
+{
+    return static_cast<int>(std::min<uint64_t>(collectedFrames, HISTORY_LENGTH));
+}
+
+int GpuProfiler::findZone(const std::string &zoneName)
+{
+    auto it = zoneIndices.find(zoneName);
+    if (it != zoneIndices.end())
+    {
+        return it->second;
+    }
+
+    Zone zone;
+    zone.name = zoneName;
+    zone.history.assign(HISTORY_LENGTH, 0.0f);
+    zones.push_back(std::move(zone));
+    int index = static_cast<int>(zones.size()) - 1;
+    zoneIndices.emplace(zoneName, index);
+    return index;
+}
+
+GLuint GpuProfiler::takeQuery()
+{
+    if (freeQueries.empty())
+    {
+        GLuint query = 0;
+        glGenQueries(1, &query);
+        return query;
+    }
+    GLuint query = freeQueries.back();
+    freeQueries.pop_back();
+    return query;
+}
+
+void GpuProfiler::collect(FrameQueries &frame)
+{
+    if (frame.queries.empty())
+    {
+        return;
+    }
+
+    // Queries finish in order, so the last one being available means all are
+    GLint available = 0;
+    glGetQueryObjectiv(frame.queries.back().query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (available)
+    {
+        std::vector<float> zoneMs(zones.size(), 0.0f);
+        std::vector<bool> zoneRan(zones.size(), false);
+        float totalMs = 0.0f;
+        for (const PendingQuery &pending : frame.queries)
+        {
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(pending.query, GL_QUERY_RESULT, &nanoseconds);
+            float ms = static_cast<float>(nanoseconds) * 1e-6f;
+            zoneMs[pending.zone] += ms;
+            zoneRan[pending.zone] = true;
+            totalMs += ms;
+        }
+
+        // Zones that did not run this frame (e.g. an unchanged region) record 0
+        size_t slot = collectedFrames % HISTORY_LENGTH;
+        for (size_t i = 0; i < zones.size(); ++i)
+        {
+            Zone &zone = zones[i];
+            zone.history[slot] = zoneMs[i];
+            if (zoneRan[i])
+            {
+                zone.lastMs = zoneMs[i];
+                zone.averageMs = zone.averageMs == 0.0f ? zoneMs[i] : zone.averageMs * 0.95f + zoneMs[i] * 0.05f;
+            }
+        }
+        frameHistory[slot] = totalMs;
+        frameNumbers[slot] = frame.frame;
+        collectedFrames++;
+    }
+    else
+    {
+        // Waiting would stall the pipeline; drop the sample instead
+        droppedFrames++;
+    }
+
+    for (const PendingQuery &pending : frame.queries)
+    {
+        freeQueries.push_back(pending.query);
+    }
+    frame.queries.clear();
+}
+
+bool GpuProfiler::exportCsv(const std::string &path) const
+{
+    std::ofstream file(path);
+    if (!file)
+    {
+        std::cerr << "Failed to open " << path << " for writing" << std::endl;
+        return false;
+    }
+
+    file << "frame";
+    for (const Zone &zone : zones)
+    {
+        file << "," << zone.name << "_ms";
+    }
+    file << ",total_ms\n";
+
+    // Oldest sample first
+    int count = getHistoryCount();
+    int start = collectedFrames > HISTORY_LENGTH ? getHistoryOffset() : 0;
+    for (int i = 0; i < count; ++i)
+    {
+        size_t slot = static_cast<size_t>((start + i) % HISTORY_LENGTH);
+        file << frameNumbers[slot];
+        for (const Zone &zone : zones)
+        {
+            file << "," << zone.history[slot];
+        }
+        file << "," << frameHistory[slot] << "\n";
+    }
+
+    std::cout << "Wrote " << count << " frames of GPU timings to " << path << std::endl;
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,616 @@
+#include "gromacs_trajectory.h"
+#include "frame_index.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define XTC_SSE2 1
+#endif
+
+namespace {
+
+constexpr float ANGSTROM_PER_NM = 10.0f;
+
+constexpr int32_t XTC_MAGIC = 1995;
+constexpr int32_t XTC_MAGIC_64BIT_SIZE = 2023; // Frames of more than 2^31 compressed bytes
+constexpr int32_t TRR_MAGIC = 1993;
+
+// XTC frame layout: magic, atoms, step, time, 3x3 box, atoms again, then the coordinates
+constexpr size_t XTC_COORDINATES = 56;
+// Compressed coordinates: precision, minimum and maximum integer coordinates, initial small index, byte count
+constexpr size_t XTC_BYTE_COUNT = XTC_COORDINATES + 4 + 12 + 12 + 4;
+// Up to 9 atoms are stored as plain floats
+constexpr size_t XTC_MAX_UNCOMPRESSED_ATOMS = 9;
+
+uint32_t readBig32(const char *data)
+{
+    uint8_t bytes[4];
+    std::memcpy(bytes, data, sizeof(bytes));
+    return (uint32_t(bytes[0]) << 24) | (uint32_t(bytes[1]) << 16) | (uint32_t(bytes[2]) << 8) | uint32_t(bytes[3]);
+}
+
+uint64_t readBig64(const char *data)
+{
+    return (uint64_t(readBig32(data)) << 32) | readBig32(data + 4);
+}
+
+int32_t readInt(const char *data)
+{
+    return static_cast<int32_t>(readBig32(data));
+}
+
+float readFloat(const char *data)
+{
+    uint32_t bits = readBig32(data);
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+double readDouble(const char *data)
+{
+    uint64_t bits = readBig64(data);
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+uint64_t padded(uint64_t bytes)
+{
+    return (bytes + 3) & ~uint64_t(3);
+}
+
+// ---- XTC coordinate decompression (the xdr3dfcoord scheme of GROMACS) ----
+
+// Bit sizes of the small deltas between neighbouring atoms; index 9 is the smallest used
+constexpr int MAGIC_INTS[] = {
+    0,        0,        0,       0,       0,       0,       0,       0,       0,       8,        10,
+    12,       16,       20,      25,      32,      40,      50,      64,      80,      101,      128,
+    161,      203,      256,     322,     406,     512,     645,     812,     1024,    1290,     1625,
+    2048,     2580,     3250,    4096,    5060,    6501,    8192,    10321,   13003,   16384,    20642,
+    26007,    32768,    41285,   52015,   65536,   82570,   104031,  131072,  165140,  208063,   262144,
+    330280,   416127,   524287,  660561,  832255,  1048576, 1321122, 1664510, 2097152, 2642245,  3329021,
+    4194304,  5284491,  6658042, 8388607, 10568983, 13316085, 16777216};
+constexpr int FIRST_MAGIC_INDEX = 9;
+constexpr int MAGIC_INT_COUNT = static_cast<int>(sizeof(MAGIC_INTS) / sizeof(MAGIC_INTS[0]));
+
+// Most significant bit first, refilled a 64-bit word at a time instead of byte by byte
+class BitReader {
+public:
+    BitReader(const uint8_t *begin, const uint8_t *end) : data(begin), end(end), bitsAvailable(8 * uint64_t(end - begin))
+    {
+    }
+
+    // count <= 32
+    uint32_t read(int count)
+    {
+        if (count == 0)
+            return 0;
+        if (bits < count)
+            refill();
+        uint32_t value = static_cast<uint32_t>(buffer >> (64 - count));
+        buffer <<= count;
+        bits -= count;
+        bitsRead += count;
+        return value;
+    }
+
+    // Read past the data (the zeros padded in were used)
+    bool overran() const { return bitsRead > bitsAvailable; }
+
+private:
+    void refill()
+    {
+        if (end - data >= 8)
+        {
+            uint64_t word = 0;
+            for (int i = 0; i < 8; ++i)
+                word = (word << 8) | data[i];
+            buffer |= word >> bits;
+            data += (63 - bits) >> 3;
+            bits |= 56;
+            return;
+        }
+        while (bits <= 56)
+        {
+            buffer |= uint64_t(data < end ? *data++ : 0) << (56 - bits);
+            bits += 8;
+        }
+    }
+
+    const uint8_t *data;
+    const uint8_t *end;
+    uint64_t buffer = 0;
+    int bits = 0;
+    uint64_t bitsRead = 0;
+    uint64_t bitsAvailable;
+};
+
+int bitsForInt(uint32_t size)
+{
+    int bits = 0;
+    while (bits < 32 && size >= (uint64_t(1) << bits))
+        ++bits;
+    return bits;
+}
+
+// Bits needed for a number below sizes[0] * sizes[1] * sizes[2]
+int bitsForInts(const uint32_t sizes[3])
+{
+    uint32_t bytes[32] = {1};
+    int byteCount = 1;
+    for (int i = 0; i < 3; ++i)
+    {
+        uint32_t carry = 0;
+        int b = 0;
+        for (; b < byteCount; ++b)
+        {
+            carry = bytes[b] * sizes[i] + carry;
+            bytes[b] = carry & 0xFF;
+            carry >>= 8;
+        }
+        while (carry != 0)
+        {
+            bytes[b++] = carry & 0xFF;
+            carry >>= 8;
+        }
+        byteCount = b;
+    }
+    int bits = 0;
+    uint32_t top = bytes[byteCount - 1];
+    while (top >= (uint32_t(1) << bits))
+        ++bits;
+    return bits + (byteCount - 1) * 8;
+}
+
+// Three integers packed as one number in mixed radix sizes[0..2], stored least significant byte first
+void readInts(BitReader &reader, int bits, const uint32_t sizes[3], int32_t values[3])
+{
+    if (bits <= 64)
+    {
+        // Fits a machine word: two divisions instead of the byte-wise long division
+        uint64_t number = 0;
+        int shift = 0;
+        for (; bits > 8; bits -= 8, shift += 8)
+            number |= uint64_t(reader.read(8)) << shift;
+        if (bits > 0)
+            number |= uint64_t(reader.read(bits)) << shift;
+        values[2] = static_cast<int32_t>(number % sizes[2]);
+        number /= sizes[2];
+        values[1] = static_cast<int32_t>(number % sizes[1]);
+        values[0] = static_cast<int32_t>(number / sizes[1]);
+        return;
+    }
+
+    uint32_t bytes[32] = {};
+    int byteCount = 0;
+    for (; bits > 8; bits -= 8)
+        bytes[byteCount++] = reader.read(8);
+    if (bits > 0)
+        bytes[byteCount++] = reader.read(bits);
+    for (int i = 2; i > 0; --i)
+    {
+        uint32_t remainder = 0;
+        for (int b = byteCount - 1; b >= 0; --b)
+        {
+            uint64_t number = (uint64_t(remainder) << 8) | bytes[b];
+            bytes[b] = static_cast<uint32_t>(number / sizes[i]);
+            remainder = static_cast<uint32_t>(number % sizes[i]);
+        }
+        values[i] = static_cast<int32_t>(remainder);
+    }
+    values[0] = static_cast<int32_t>(bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (bytes[3] << 24));
+}
+
+// Decode the integer coordinates of a compressed frame into `coordinates` (3 per atom)
+bool decompressXtc(const char *frame, size_t atomCount, const uint8_t *data, const uint8_t *dataEnd,
+                   int32_t *coordinates)
+{
+    int32_t minimum[3], maximum[3];
+    uint32_t sizes[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        minimum[i] = readInt(frame + XTC_COORDINATES + 4 + 4 * i);
+        maximum[i] = readInt(frame + XTC_COORDINATES + 16 + 4 * i);
+        int64_t size = int64_t(maximum[i]) - minimum[i] + 1;
+        if (size <= 0 || size > UINT32_MAX)
+        {
+            return false;
+        }
+        sizes[i] = static_cast<uint32_t>(size);
+    }
+    int smallIndex = readInt(frame + XTC_COORDINATES + 28);
+    if (smallIndex < FIRST_MAGIC_INDEX || smallIndex >= MAGIC_INT_COUNT)
+    {
+        return false;
+    }
+
+    // Very large ranges are stored as three separate numbers
+    bool separate = (sizes[0] | sizes[1] | sizes[2]) > 0xFFFFFF;
+    int separateBits[3] = {bitsForInt(sizes[0]), bitsForInt(sizes[1]), bitsForInt(sizes[2])};
+    int packedBits = separate ? 0 : bitsForInts(sizes);
+
+    int smaller = MAGIC_INTS[std::max(FIRST_MAGIC_INDEX, smallIndex - 1)] / 2;
+    int smallNumber = MAGIC_INTS[smallIndex] / 2;
+    uint32_t smallSizes[3];
+    std::fill(smallSizes, smallSizes + 3, static_cast<uint32_t>(MAGIC_INTS[smallIndex]));
+
+    BitReader reader(data, dataEnd);
+    int32_t *out = coordinates;
+    int32_t *outEnd = coordinates + 3 * atomCount;
+    int run = 0;
+    while (out < outEnd)
+    {
+        int32_t current[3];
+        if (separate)
+        {
+            for (int i = 0; i < 3; ++i)
+                current[i] = static_cast<int32_t>(reader.read(separateBits[i]));
+        }
+        else
+        {
+            readInts(reader, packedBits, sizes, current);
+        }
+        for (int i = 0; i < 3; ++i)
+            current[i] += minimum[i];
+
+        // A run of atoms close to this one follows, stored as small deltas. Without the flag the last run length repeats.
+        int sizeChange = 0;
+        if (reader.read(1))
+        {
+            run = static_cast<int>(reader.read(5));
+            sizeChange = run % 3;
+            run -= sizeChange;
+            sizeChange--;
+        }
+        if (outEnd - out < 3 + run)
+        {
+            return false;
+        }
+
+        if (run == 0)
+        {
+            std::copy(current, current + 3, out);
+            out += 3;
+        }
+        for (int k = 0; k < run; k += 3)
+        {
+            int32_t next[3];
+            readInts(reader, smallIndex, smallSizes, next);
+            for (int i = 0; i < 3; ++i)
+                next[i] += current[i] - smallNumber;
+            if (k == 0)
+            {
+                // The first two atoms are stored swapped (water oxygens compress better that way)
+                std::swap(next[0], current[0]);
+                std::swap(next[1], current[1]);
+                std::swap(next[2], current[2]);
+                std::copy(current, current + 3, out);
+                out += 3;
+            }
+            else
+            {
+                std::copy(next, next + 3, current);
+            }
+            std::copy(next, next + 3, out);
+            out += 3;
+        }
+
+        smallIndex += sizeChange;
+        if (smallIndex < FIRST_MAGIC_INDEX || smallIndex >= MAGIC_INT_COUNT)
+        {
+            return false;
+        }
+        if (sizeChange < 0)
+        {
+            smallNumber = smaller;
+            smaller = smallIndex > FIRST_MAGIC_INDEX ? MAGIC_INTS[smallIndex - 1] / 2 : 0;
+        }
+        else if (sizeChange > 0)
+        {
+            smaller = smallNumber;
+            smallNumber = MAGIC_INTS[smallIndex] / 2;
+        }
+        std::fill(smallSizes, smallSizes + 3, static_cast<uint32_t>(MAGIC_INTS[smallIndex]));
+    }
+    return !reader.overran();
+}
+
+// Integer coordinates times scale into xyz0 positions. `coordinates` has one int of padding after the last atom.
+void dequantize(const int32_t *coordinates, size_t atomCount, float scale, glm::vec4 *positions)
+{
+#if XTC_SSE2
+    const __m128 factor = _mm_set1_ps(scale);
+    const __m128 keepXyz = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+    for (size_t atom = 0; atom < atomCount; ++atom)
+    {
+        __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i *>(coordinates + 3 * atom));
+        __m128 position = _mm_and_ps(_mm_mul_ps(_mm_cvtepi32_ps(values), factor), keepXyz);
+        _mm_storeu_ps(&positions[atom].x, position);
+    }
+#else
+    for (size_t atom = 0; atom < atomCount; ++atom)
+    {
+        const int32_t *c = coordinates + 3 * atom;
+        positions[atom] = glm::vec4(c[0] * scale, c[1] * scale, c[2] * scale, 0.0f);
+    }
+#endif
+}
+
+} // namespace
+
+// ---- XTC ----
+
+bool XtcTrajectory::open(const std::string &path)
+{
+    close();
+    if (!file.open(path))
+    {
+        return false;
+    }
+
+    bool sidecar = file.size() >= FRAME_INDEX_MIN_FILE_BYTES;
+    FrameIndex index;
+    if (sidecar && index.load(path, "xtc"))
+    {
+        offsets = std::move(index.offsets);
+        atomCount = static_cast<size_t>(index.atomCount);
+        return true;
+    }
+    if (!buildIndex())
+    {
+        close();
+        return false;
+    }
+    if (sidecar)
+    {
+        index.offsets = offsets;
+        index.atomCount = atomCount;
+        index.save(path, "xtc");
+    }
+    return true;
+}
+
+bool XtcTrajectory::buildIndex()
+{
+    // Only the headers are touched; the compressed data in between is skipped
+    const char *data = file.data();
+    uint64_t size = file.size();
+    uint64_t offset = 0;
+    while (offset + XTC_COORDINATES <= size)
+    {
+        int32_t magic = readInt(data + offset);
+        int32_t frameAtoms = readInt(data + offset + 4);
+        if ((magic != XTC_MAGIC && magic != XTC_MAGIC_64BIT_SIZE) || frameAtoms <= 0 ||
+            (!offsets.empty() && static_cast<size_t>(frameAtoms) != atomCount))
+        {
+            std::cerr << "Damaged XTC frame " << offsets.size() + 1 << " in " << getPath() << std::endl;
+            break;
+        }
+        atomCount = static_cast<size_t>(frameAtoms);
+
+        uint64_t frameBytes = 0;
+        if (atomCount <= XTC_MAX_UNCOMPRESSED_ATOMS)
+        {
+            frameBytes = XTC_COORDINATES + 12 * atomCount;
+        }
+        else if (magic == XTC_MAGIC && offset + XTC_BYTE_COUNT + 4 <= size)
+        {
+            frameBytes = XTC_BYTE_COUNT + 4 + padded(readBig32(data + offset + XTC_BYTE_COUNT));
+        }
+        else if (magic == XTC_MAGIC_64BIT_SIZE && offset + XTC_BYTE_COUNT + 8 <= size)
+        {
+            frameBytes = XTC_BYTE_COUNT + 8 + padded(readBig64(data + offset + XTC_BYTE_COUNT));
+        }
+        if (frameBytes == 0 || offset + frameBytes > size)
+        {
+            std::cerr << "Frame " << offsets.size() + 1 << " of " << getPath() << " is incomplete" << std::endl;
+            break;
+        }
+        offsets.push_back(offset);
+        offset += frameBytes;
+    }
+    if (offsets.empty())
+    {
+        std::cerr << "No frames in " << getPath() << std::endl;
+        return false;
+    }
+    offsets.push_back(offset);
+    return true;
+}
+
+void XtcTrajectory::close()
+{
+    file.close();
+    offsets.clear();
+    atomCount = 0;
+}
+
+bool XtcTrajectory::readPositions(size_t frame, glm::vec4 *positions) const
+{
+    const char *start = file.data() + offsets[frame];
+    if (atomCount <= XTC_MAX_UNCOMPRESSED_ATOMS)
+    {
+        for (size_t atom = 0; atom < atomCount; ++atom)
+        {
+            const char *xyz = start + XTC_COORDINATES + 12 * atom;
+            positions[atom] = glm::vec4(readFloat(xyz), readFloat(xyz + 4), readFloat(xyz + 8), 0.0f) * ANGSTROM_PER_NM;
+        }
+        return true;
+    }
+
+    float precision = readFloat(start + XTC_COORDINATES);
+    bool wideCount = readInt(start) == XTC_MAGIC_64BIT_SIZE;
+    const uint8_t *data = reinterpret_cast<const uint8_t *>(start + XTC_BYTE_COUNT + (wideCount ? 8 : 4));
+    const uint8_t *dataEnd = reinterpret_cast<const uint8_t *>(file.data() + offsets[frame + 1]);
+
+    // Per thread, so prefetching threads decode frames side by side without reallocating
+    thread_local std::vector<int32_t> coordinates;
+    coordinates.resize(3 * atomCount + 1);
+    if (precision <= 0.0f || !decompressXtc(start, atomCount, data, dataEnd, coordinates.data()))
+    {
+        std::cerr << "Damaged XTC frame " << frame + 1 << " in " << getPath() << std::endl;
+        return false;
+    }
+    dequantize(coordinates.data(), atomCount, ANGSTROM_PER_NM / precision, positions);
+    return true;
+}
+
+// ---- TRR ----
+
+namespace {
+
+// Sizes from a TRR frame header
+struct TrrHeader {
+    uint64_t headerBytes = 0;
+    uint64_t boxBytes = 0, virialBytes = 0, pressureBytes = 0;
+    uint64_t coordinateBytes = 0, velocityBytes = 0, forceBytes = 0;
+    size_t atomCount = 0;
+    size_t realBytes = 0; // 4 or 8
+
+    uint64_t frameBytes() const
+    {
+        return headerBytes + boxBytes + virialBytes + pressureBytes + coordinateBytes + velocityBytes + forceBytes;
+    }
+};
+
+bool readTrrHeader(const char *data, uint64_t available, TrrHeader &header)
+{
+    // magic, version string (length + 1, then an XDR string), 13 sizes and counts, then time and lambda
+    if (available < 12 || readInt(data) != TRR_MAGIC)
+        return false;
+    uint64_t versionBytes = padded(readBig32(data + 8));
+    uint64_t sizes = 12 + versionBytes;
+    if (available < sizes + 13 * 4)
+        return false;
+    auto field = [&](int index) { return static_cast<uint64_t>(readBig32(data + sizes + 4 * index)); };
+    header.boxBytes = field(2);
+    header.virialBytes = field(3);
+    header.pressureBytes = field(4);
+    header.coordinateBytes = field(7);
+    header.velocityBytes = field(8);
+    header.forceBytes = field(9);
+    header.atomCount = static_cast<size_t>(field(10));
+
+    // Precision follows from whichever block is present
+    uint64_t vectorValues = 3 * uint64_t(header.atomCount);
+    if (header.boxBytes)
+        header.realBytes = header.boxBytes / 9;
+    else if (header.coordinateBytes && vectorValues)
+        header.realBytes = header.coordinateBytes / vectorValues;
+    else if (header.velocityBytes && vectorValues)
+        header.realBytes = header.velocityBytes / vectorValues;
+    else if (header.forceBytes && vectorValues)
+        header.realBytes = header.forceBytes / vectorValues;
+    if (header.realBytes != 4 && header.realBytes != 8)
+        return false;
+    header.headerBytes = sizes + 13 * 4 + 2 * header.realBytes;
+    return true;
+}
+
+} // namespace
+
+bool TrrTrajectory::open(const std::string &path)
+{
+    close();
+    if (!file.open(path))
+    {
+        return false;
+    }
+
+    bool sidecar = file.size() >= FRAME_INDEX_MIN_FILE_BYTES;
+    FrameIndex index;
+    if (sidecar && index.load(path, "trr"))
+    {
+        offsets = std::move(index.offsets);
+        atomCount = static_cast<size_t>(index.atomCount);
+        return true;
+    }
+    if (!buildIndex())
+    {
+        close();
+        return false;
+    }
+    if (sidecar)
+    {
+        index.offsets = offsets;
+        index.atomCount = atomCount;
+        index.save(path, "trr");
+    }
+    return true;
+}
+
+bool TrrTrajectory::buildIndex()
+{
+    const char *data = file.data();
+    uint64_t size = file.size();
+    uint64_t offset = 0;
+    size_t frameNumber = 0;
+    while (offset < size)
+    {
+        ++frameNumber;
+        TrrHeader header;
+        if (!readTrrHeader(data + offset, size - offset, header) ||
+            (atomCount != 0 && header.atomCount != atomCount))
+        {
+            std::cerr << "Damaged TRR frame " << frameNumber << " in " << getPath() << std::endl;
+            break;
+        }
+        if (offset + header.frameBytes() > size)
+        {
+            std::cerr << "Frame " << frameNumber << " of " << getPath() << " is incomplete" << std::endl;
+            break;
+        }
+        atomCount = header.atomCount;
+        if (header.coordinateBytes > 0)
+        {
+            offsets.push_back(offset);
+        }
+        offset += header.frameBytes();
+    }
+    if (offsets.empty())
+    {
+        std::cerr << "No frames with coordinates in " << getPath() << std::endl;
+        return false;
+    }
+    offsets.push_back(offset);
+    return true;
+}
+
+void TrrTrajectory::close()
+{
+    file.close();
+    offsets.clear();
+    atomCount = 0;
+}
+
+bool TrrTrajectory::readPositions(size_t frame, glm::vec4 *positions) const
+{
+    TrrHeader header;
+    const char *start = file.data() + offsets[frame];
+    if (!readTrrHeader(start, file.size() - offsets[frame], header) || header.atomCount != atomCount)
+    {
+        std::cerr << "Damaged TRR frame " << frame + 1 << " in " << getPath() << std::endl;
+        return false;
+    }
+
+    const char *values = start + header.headerBytes + header.boxBytes + header.virialBytes + header.pressureBytes;
+    for (size_t atom = 0; atom < atomCount; ++atom)
+    {
+        if (header.realBytes == 4)
+        {
+            const char *xyz = values + 12 * atom;
+            positions[atom] = glm::vec4(readFloat(xyz), readFloat(xyz + 4), readFloat(xyz + 8), 0.0f);
+        }
+        else
+        {
+            const char *xyz = values + 24 * atom;
+            positions[atom] = glm::vec4(static_cast<float>(readDouble(xyz)), static_cast<float>(readDouble(xyz + 8)),
+                                        static_cast<float>(readDouble(xyz + 16)), 0.0f);
+        }
+        positions[atom] *= ANGSTROM_PER_NM;
+    }
+    return true;
+}
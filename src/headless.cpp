@@ -0,0 +1,537 @@
+#include "headless.h"
+#include "cpu_profiler.h"
+#include "molecule_io.h"
+#include "ui_manager.h"
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+// Region placement and fixed viewpoint (yaw and pitch in radians) of each layout view
+struct LayoutView {
+    const char *region;
+    float x, y, width, height;
+    float yaw, pitch;
+};
+
+const LayoutView singleLayout[] = {
+    {"view", 0.0f, 0.0f, 1.0f, 1.0f, 0.6f, 0.4f},
+};
+
+const LayoutView quadLayout[] = {
+    {"quad_tl", 0.0f, 0.0f, 0.5f, 0.5f, 0.0f, 0.0f},      // Front
+    {"quad_tr", 0.5f, 0.0f, 0.5f, 0.5f, 1.5708f, 0.0f},   // Side
+    {"quad_bl", 0.0f, 0.5f, 0.5f, 0.5f, 0.0f, 1.5608f},   // Top (just short of the pole)
+    {"quad_br", 0.5f, 0.5f, 0.5f, 0.5f, 0.6f, 0.4f},      // Perspective
+};
+
+bool parseSize(const std::string &text, int &width, int &height)
+{
+    char separator = 0;
+    std::istringstream stream(text);
+    return static_cast<bool>(stream >> width >> separator >> height) && (separator == 'x' || separator == 'X') &&
+           width > 0 && height > 0;
+}
+
+bool parseColor(const std::string &text, glm::vec3 &color)
+{
+    // "#rrggbb" or "r,g,b" with components in 0..1
+    if (text.size() == 7 && text[0] == '#')
+    {
+        unsigned int rgb = 0;
+        if (std::sscanf(text.c_str() + 1, "%06x", &rgb) != 1)
+        {
+            return false;
+        }
+        color = glm::vec3((rgb >> 16) & 0xFF, (rgb >> 8) & 0xFF, rgb & 0xFF) / 255.0f;
+        return true;
+    }
+    char comma1 = 0, comma2 = 0;
+    std::istringstream stream(text);
+    return static_cast<bool>(stream >> color.r >> comma1 >> color.g >> comma2 >> color.b) && comma1 == ',' &&
+           comma2 == ',';
+}
+
+bool parseRenderMode(const std::string &text, RenderMode &mode)
+{
+    if (text == "ball-and-stick")
+        mode = RenderMode::BallAndStick;
+    else if (text == "space-filling")
+        mode = RenderMode::SpaceFilling;
+    else if (text == "wireframe")
+        mode = RenderMode::Wireframe;
+    else if (text == "ribbon")
+        mode = RenderMode::Ribbon;
+    else
+        return false;
+    return true;
+}
+
+bool readInputList(const std::string &listPath, std::vector<std::string> &inputs)
+{
+    std::ifstream file;
+    if (listPath != "-")
+    {
+        file.open(listPath);
+        if (!file)
+        {
+            std::cerr << "Failed to open input list " << listPath << std::endl;
+            return false;
+        }
+    }
+    std::istream &stream = listPath == "-" ? std::cin : file;
+
+    std::string line;
+    while (std::getline(stream, line))
+    {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (!line.empty() && line[0] != '#')
+            inputs.push_back(line);
+    }
+    return true;
+}
+
+std::string outputPathFor(const std::string &directory, const std::string &input, const std::string &extension)
+{
+    size_t slash = input.find_last_of("/\\");
+    std::string name = slash == std::string::npos ? input : input.substr(slash + 1);
+    size_t dot = name.find_last_of('.');
+    if (dot != std::string::npos && dot > 0)
+    {
+        name = name.substr(0, dot);
+    }
+    name += "." + extension;
+    return directory.empty() || directory == "." ? name : directory + "/" + name;
+}
+
+bool hasDisplay()
+{
+#if defined(_WIN32) || defined(__APPLE__)
+    return true;
+#else
+    return std::getenv("DISPLAY") || std::getenv("WAYLAND_DISPLAY");
+#endif
+}
+
+// One attempt at a context; leaves GLFW terminated on failure so the next attempt can change init hints
+GLFWwindow *tryCreateContext(int contextApi, bool nullPlatform, int width, int height)
+{
+#ifdef GLFW_PLATFORM_NULL
+    glfwInitHint(GLFW_PLATFORM, nullPlatform ? GLFW_PLATFORM_NULL : GLFW_ANY_PLATFORM);
+#else
+    if (nullPlatform)
+    {
+        return nullptr; // GLFW < 3.4 has no display-less platform
+    }
+#endif
+    if (!glfwInit())
+    {
+        return nullptr;
+    }
+
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_CONTEXT_CREATION_API, contextApi);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_FOCUSED, GLFW_FALSE);
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+
+    // The window is never shown; its size only sets the default framebuffer the region sizes derive from
+    GLFWwindow *window = glfwCreateWindow(width, height, "Molecular Viewer (headless)", nullptr, nullptr);
+    if (!window)
+    {
+        glfwTerminate();
+    }
+    return window;
+}
+
+GLFWwindow *createHeadlessContext(const HeadlessOptions &options, int width, int height)
+{
+#ifndef _WIN32
+    // Mesa's software rasterizers implement the 4.6 features we use but may advertise an older version.
+    // Don't override a user's own setting.
+    setenv("MESA_GL_VERSION_OVERRIDE", "4.6", 0);
+    setenv("MESA_GLSL_VERSION_OVERRIDE", "460", 0);
+#endif
+
+    struct Attempt {
+        const char *name;
+        int api;
+        bool nullPlatform;
+    };
+    std::vector<Attempt> attempts;
+    bool display = hasDisplay();
+    if (options.context == "hidden" || (options.context == "auto" && display))
+        attempts.push_back({"hidden window", GLFW_NATIVE_CONTEXT_API, false});
+    if (options.context == "egl" || options.context == "auto")
+        attempts.push_back({"EGL", GLFW_EGL_CONTEXT_API, !display});
+    if (options.context == "osmesa" || options.context == "auto")
+        attempts.push_back({"OSMesa", GLFW_OSMESA_CONTEXT_API, !display});
+
+    for (const Attempt &attempt : attempts)
+    {
+        GLFWwindow *window = tryCreateContext(attempt.api, attempt.nullPlatform, width, height);
+        if (window)
+        {
+            std::cout << "Headless context: " << attempt.name << (attempt.nullPlatform ? " (no display)" : "") << std::endl;
+            return window;
+        }
+        std::cerr << "Could not create a " << attempt.name << " context" << std::endl;
+    }
+    return nullptr;
+}
+
+// CPU path: no context, window or renderer; the layout only supplies the viewpoint
+int runHeadlessRayTrace(const HeadlessOptions &options)
+{
+    bool quad = options.layout == "quad";
+    const LayoutView *views = quad ? quadLayout : singleLayout;
+    size_t viewCount = quad ? std::size(quadLayout) : std::size(singleLayout);
+    const LayoutView *view = options.region.empty() ? views : nullptr;
+    for (size_t i = 0; i < viewCount && !view; ++i)
+    {
+        if (options.region == views[i].region)
+        {
+            view = &views[i];
+        }
+    }
+    if (!view)
+    {
+        std::cerr << "Region " << options.region << " is not part of the " << options.layout << " layout" << std::endl;
+        return -1;
+    }
+
+    RayTraceOptions traceOptions;
+    traceOptions.width = options.width;
+    traceOptions.height = options.height;
+    traceOptions.samples = options.samples;
+    traceOptions.timeLimit = options.timeLimit;
+    traceOptions.compressionLevel = options.compressionLevel;
+    // Nothing else runs here, so every core traces
+    traceOptions.threadCount = options.threads > 0 ? static_cast<size_t>(options.threads)
+                                                   : std::max(1u, std::thread::hardware_concurrency());
+
+    RepresentationStyle style = getRepresentationStyle(options.mode);
+    RayTraceScene scene;
+    scene.atomRadiusScale = style.atomRadiusScale;
+    scene.bondRadius = style.bondRadius;
+    scene.palette = AtomRenderer::elementPalette();
+    scene.background = options.background;
+    scene.camera.yaw = view->yaw;
+    scene.camera.pitch = view->pitch;
+
+    RayTracer rayTracer;
+    size_t written = 0, skipped = 0, failed = 0;
+    auto batchStart = std::chrono::steady_clock::now();
+    for (const std::string &input : options.inputs)
+    {
+        PROFILE_FRAME();
+        std::string outputPath = outputPathFor(options.outputDirectory, input, options.format);
+        if (options.skipExisting && std::ifstream(outputPath).good())
+        {
+            skipped++;
+            continue;
+        }
+
+        {
+            PROFILE_ZONE("load");
+            if (!loadMolecule(input, scene.molecule))
+            {
+                failed++;
+                continue;
+            }
+        }
+        glm::vec3 minCorner, maxCorner;
+        scene.molecule.getBounds(minCorner, maxCorner);
+        scene.camera.frame(minCorner, maxCorner);
+        (rayTracer.render(scene, traceOptions, outputPath) ? written : failed)++;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - batchStart).count();
+    std::cout << "Ray traced " << written << " images in " << seconds << " s, " << skipped << " skipped, " << failed
+              << " failed" << std::endl;
+    return failed == 0 ? 0 : 1;
+}
+
+} // namespace
+
+void printHeadlessUsage()
+{
+    std::cout << "Usage: MolecularViewer --headless [options] <structure>...\n"
+                 "  --list <file>          Read input paths from a file, one per line (- for stdin)\n"
+                 "  --output <dir>         Output directory (default: current directory)\n"
+                 "  --size <W>x<H>         Image size in pixels (default: 512x512)\n"
+                 "  --layout single|quad   One view, or front/side/top/perspective views (default: single)\n"
+                 "  --region <name>        Write only one region of the layout, e.g. quad_br\n"
+                 "  --mode <mode>          ball-and-stick, space-filling, wireframe or ribbon\n"
+                 "  --background <color>   #rrggbb or r,g,b in 0..1\n"
+                 "  --context <api>        auto, hidden, egl or osmesa (default: auto)\n"
+                 "  --poster               Render tiled at the full --size, beyond the GL texture size limit\n"
+                 "  --raytrace             Ray trace on the CPU with shadows and ambient occlusion (no GPU needed)\n"
+                 "  --samples <n>          Ray tracing samples per pixel (default: 64)\n"
+                 "  --time-limit <s>       Stop refining a ray traced image after this many seconds\n"
+                 "  --threads <n>          Ray tracing threads (default: all cores)\n"
+                 "  --format png|tiff      Poster or ray traced image file format (default: png)\n"
+                 "  --compression <0-9>    PNG compression level (default: 1)\n"
+                 "  --skip-existing        Don't re-render structures whose image exists\n";
+}
+
+bool parseHeadlessArguments(const std::vector<std::string> &arguments, HeadlessOptions &options)
+{
+    for (size_t i = 0; i < arguments.size(); ++i)
+    {
+        const std::string &argument = arguments[i];
+        bool hasValue = i + 1 < arguments.size();
+        auto value = [&]() -> const std::string & { return arguments[++i]; };
+
+        bool ok = true;
+        if (argument == "--headless")
+            continue;
+        else if (argument == "--skip-existing")
+            options.skipExisting = true;
+        else if (argument == "--poster")
+            options.poster = true;
+        else if (argument == "--raytrace")
+            options.rayTrace = true;
+        else if (argument == "--help" || argument == "-h")
+            return false;
+        else if (argument.rfind("--", 0) == 0 && !hasValue)
+            ok = false;
+        else if (argument == "--list")
+            ok = readInputList(value(), options.inputs);
+        else if (argument == "--output")
+            options.outputDirectory = value();
+        else if (argument == "--size")
+            ok = parseSize(value(), options.width, options.height);
+        else if (argument == "--layout")
+        {
+            options.layout = value();
+            ok = options.layout == "single" || options.layout == "quad";
+        }
+        else if (argument == "--region")
+            options.region = value();
+        else if (argument == "--mode")
+            ok = parseRenderMode(value(), options.mode);
+        else if (argument == "--background")
+            ok = parseColor(value(), options.background);
+        else if (argument == "--context")
+        {
+            options.context = value();
+            ok = options.context == "auto" || options.context == "hidden" || options.context == "egl" ||
+                 options.context == "osmesa";
+        }
+        else if (argument == "--format")
+        {
+            options.format = value();
+            ok = options.format == "png" || options.format == "tiff";
+        }
+        else if (argument == "--samples")
+        {
+            options.samples = std::atoi(value().c_str());
+            ok = options.samples > 0;
+        }
+        else if (argument == "--time-limit")
+        {
+            options.timeLimit = static_cast<float>(std::atof(value().c_str()));
+            ok = options.timeLimit > 0.0f;
+        }
+        else if (argument == "--threads")
+        {
+            options.threads = std::atoi(value().c_str());
+            ok = options.threads > 0;
+        }
+        else if (argument == "--compression")
+        {
+            options.compressionLevel = std::atoi(value().c_str());
+            ok = options.compressionLevel >= 0 && options.compressionLevel <= 9;
+        }
+        else if (argument.rfind("--", 0) == 0)
+            ok = false;
+        else
+            options.inputs.push_back(argument);
+
+        if (!ok)
+        {
+            std::cerr << "Invalid headless argument: " << argument << std::endl;
+            return false;
+        }
+    }
+
+    if (options.inputs.empty())
+    {
+        std::cerr << "No input structures given" << std::endl;
+        return false;
+    }
+    if (options.poster && options.rayTrace)
+    {
+        std::cerr << "Choose either --poster or --raytrace" << std::endl;
+        return false;
+    }
+    if (!options.poster && !options.rayTrace && options.format != "png")
+    {
+        std::cerr << "Only posters and ray traced images can be written as " << options.format << std::endl;
+        return false;
+    }
+    if ((options.poster || options.rayTrace) && options.layout == "quad" && options.region.empty())
+    {
+        std::cerr << (options.poster ? "A poster" : "A ray traced image") << " shows one view; choose one with --region"
+                  << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int runHeadless(const HeadlessOptions &options)
+{
+    if (options.rayTrace)
+    {
+        return runHeadlessRayTrace(options);
+    }
+
+    // Posters render through their own tile framebuffer, so their window stays tiny
+    GLFWwindow *window = options.poster ? createHeadlessContext(options, 64, 64)
+                                        : createHeadlessContext(options, options.width, options.height);
+    if (!window)
+    {
+        std::cerr << "Failed to create an offscreen GL context" << std::endl;
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    {
+        std::cerr << "Failed to initialize GLAD" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+
+    int width, height;
+    glfwGetFramebufferSize(window, &width, &height);
+    if (!options.poster && (width != options.width || height != options.height))
+    {
+        std::cerr << "Offscreen framebuffer is " << width << "x" << height << ", not the requested "
+                  << options.width << "x" << options.height << std::endl;
+    }
+
+    Renderer renderer(window);
+    if (!renderer.initialized)
+    {
+        std::cerr << "Failed to initialize renderer" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+
+    // Same region machinery as the interactive layout, without the sidebar and status bar
+    UIManager uiManager(width, height);
+    bool quad = options.layout == "quad";
+    const LayoutView *views = quad ? quadLayout : singleLayout;
+    size_t viewCount = quad ? std::size(quadLayout) : std::size(singleLayout);
+    for (size_t i = 0; i < viewCount; ++i)
+    {
+        uiManager.addRegion(views[i].region, views[i].x, views[i].y, views[i].width, views[i].height);
+        Camera &camera = renderer.cameras[views[i].region];
+        camera.yaw = views[i].yaw;
+        camera.pitch = views[i].pitch;
+    }
+    if (!options.region.empty() && !uiManager.getRegion(options.region))
+    {
+        std::cerr << "Region " << options.region << " is not part of the " << options.layout << " layout" << std::endl;
+        renderer.cleanup();
+        glfwTerminate();
+        return -1;
+    }
+
+    renderer.setUIManager(&uiManager);
+    renderer.setRenderMode(options.mode);
+    renderer.setBackgroundColor(options.background.r, options.background.g, options.background.b);
+    if (!options.poster)
+    {
+        for (const auto &region : uiManager.getRegions())
+        {
+            renderer.createFramebufferForRegion(region);
+        }
+    }
+
+    PosterOptions posterOptions;
+    posterOptions.width = options.width;
+    posterOptions.height = options.height;
+    posterOptions.compressionLevel = options.compressionLevel;
+    std::string posterRegion = options.region.empty() ? uiManager.getRegions().front().name : options.region;
+
+    // Encoding runs on the capture threads, overlapping the next structure's load and render
+    renderer.frameCapture.compressionLevel = options.compressionLevel;
+    size_t skipped = 0, loadFailures = 0, posters = 0, posterFailures = 0;
+    auto batchStart = std::chrono::steady_clock::now();
+    Molecule molecule;
+    for (const std::string &input : options.inputs)
+    {
+        PROFILE_FRAME();
+        std::string outputPath = outputPathFor(options.outputDirectory, input, options.format);
+        if (options.skipExisting && std::ifstream(outputPath).good())
+        {
+            skipped++;
+            continue;
+        }
+
+        {
+            PROFILE_ZONE("load");
+            if (!loadMolecule(input, molecule))
+            {
+                loadFailures++;
+                continue;
+            }
+        }
+
+        PROFILE_ZONE("render");
+        renderer.glState.beginFrame();
+        renderer.setMolecule(molecule);
+        renderer.frameMolecule();
+        if (options.poster)
+        {
+            (renderer.savePoster(posterRegion, outputPath, posterOptions) ? posters : posterFailures)++;
+            continue;
+        }
+        for (const auto &region : uiManager.getRegions())
+        {
+            if (options.region.empty() || region.name == options.region)
+            {
+                renderer.renderRegion(region);
+            }
+        }
+        if (options.region.empty() ? renderer.captureLayout(outputPath)
+                                   : renderer.captureRegion(options.region, outputPath))
+        {
+            std::cout << outputPath << " (" << molecule.getAtomCount() << " atoms, "
+                      << molecule.getBondCount() << " bonds)" << std::endl;
+        }
+        renderer.frameCapture.update();
+    }
+    renderer.frameCapture.flush();
+
+    FrameCapture::Stats stats = renderer.frameCapture.getStats();
+    size_t written = stats.written + posters;
+    size_t failed = loadFailures + stats.failed + posterFailures;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - batchStart).count();
+    std::cout << "Wrote " << written << " images in " << seconds << " s";
+    if (written > 0 && seconds > 0.0)
+    {
+        std::cout << " (" << static_cast<long>(written * 3600.0 / seconds) << " per hour)";
+    }
+    std::cout << ", " << skipped << " skipped, " << failed << " failed" << std::endl;
+
+    renderer.cleanup();
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,518 @@
+#include "image_writer.h"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstring>
+#include <iostream>
+
+#ifdef MOLVIEW_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace {
+
+// Flush compressed data to an IDAT chunk once this much is pending
+constexpr size_t IDAT_CHUNK_SIZE = 256 * 1024;
+
+// Built once on first use; PNGs are written from several threads at a time
+const std::array<uint32_t, 256> &crcTable()
+{
+    static const std::array<uint32_t, 256> table = []() {
+        std::array<uint32_t, 256> entries;
+        for (uint32_t n = 0; n < 256; ++n)
+        {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            entries[n] = c;
+        }
+        return entries;
+    }();
+    return table;
+}
+
+uint32_t updateCrc(uint32_t crc, const uint8_t *data, size_t size)
+{
+    const std::array<uint32_t, 256> &table = crcTable();
+    for (size_t i = 0; i < size; ++i)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return crc;
+}
+
+#ifndef MOLVIEW_HAVE_ZLIB
+// Largest stored deflate block
+constexpr size_t STORED_BLOCK_SIZE = 65535;
+
+uint32_t updateAdler(uint32_t adler, const uint8_t *data, size_t size)
+{
+    uint32_t a = adler & 0xFFFF, b = adler >> 16;
+    while (size > 0)
+    {
+        // 5552 bytes is the most that can be summed before the modulo overflows
+        size_t block = std::min<size_t>(size, 5552);
+        for (size_t i = 0; i < block; ++i)
+        {
+            a += data[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+        data += block;
+        size -= block;
+    }
+    return (b << 16) | a;
+}
+#endif
+
+void putBigEndian(uint8_t *out, uint32_t value)
+{
+    out[0] = static_cast<uint8_t>(value >> 24);
+    out[1] = static_cast<uint8_t>(value >> 16);
+    out[2] = static_cast<uint8_t>(value >> 8);
+    out[3] = static_cast<uint8_t>(value);
+}
+
+} // namespace
+
+PngWriter::~PngWriter()
+{
+    if (file)
+    {
+        std::fclose(file);
+    }
+#ifdef MOLVIEW_HAVE_ZLIB
+    if (zstream)
+    {
+        deflateEnd(static_cast<z_stream *>(zstream));
+        delete static_cast<z_stream *>(zstream);
+    }
+#endif
+}
+
+bool PngWriter::open(const std::string &filePath, int imageWidth, int imageHeight, int imageChannels)
+{
+    if (imageWidth <= 0 || imageHeight <= 0 || (imageChannels != 3 && imageChannels != 4))
+    {
+        std::cerr << "Invalid PNG dimensions for " << filePath << std::endl;
+        return false;
+    }
+
+    path = filePath;
+    file = std::fopen(path.c_str(), "wb");
+    if (!file)
+    {
+        std::cerr << "Failed to open " << path << " for writing" << std::endl;
+        return false;
+    }
+    width = imageWidth;
+    height = imageHeight;
+    channels = imageChannels;
+    rowsWritten = 0;
+    failed = false;
+    filteredRow.resize(1 + static_cast<size_t>(width) * channels);
+    idat.clear();
+
+    static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    failed = std::fwrite(signature, 1, sizeof(signature), file) != sizeof(signature);
+
+    uint8_t header[13];
+    putBigEndian(header, static_cast<uint32_t>(width));
+    putBigEndian(header + 4, static_cast<uint32_t>(height));
+    header[8] = 8;                      // Bit depth
+    header[9] = channels == 4 ? 6 : 2;  // Color type: RGBA or RGB
+    header[10] = header[11] = header[12] = 0; // Deflate, adaptive filtering, no interlace
+    writeChunk("IHDR", header, sizeof(header));
+
+#ifdef MOLVIEW_HAVE_ZLIB
+    z_stream *stream = new z_stream();
+    if (deflateInit(stream, std::clamp(compressionLevel, 0, 9)) != Z_OK)
+    {
+        delete stream;
+        std::cerr << "Failed to initialize zlib for " << path << std::endl;
+        return false;
+    }
+    zstream = stream;
+#else
+    // zlib stream header (deflate, 32K window, no dictionary, fastest)
+    idat.push_back(0x78);
+    idat.push_back(0x01);
+    adler = 1;
+#endif
+    return !failed;
+}
+
+bool PngWriter::writeRows(const uint8_t *rows, int rowCount)
+{
+    if (!file || failed)
+    {
+        return false;
+    }
+
+    size_t rowBytes = static_cast<size_t>(width) * channels;
+    for (int r = 0; r < rowCount && rowsWritten < height; ++r)
+    {
+        const uint8_t *row = rows + r * rowBytes;
+#ifdef MOLVIEW_HAVE_ZLIB
+        // Sub filter: cheap and helps deflate on flat backgrounds
+        filteredRow[0] = 1;
+        std::memcpy(filteredRow.data() + 1, row, std::min<size_t>(channels, rowBytes));
+        for (size_t i = channels; i < rowBytes; ++i)
+        {
+            filteredRow[1 + i] = static_cast<uint8_t>(row[i] - row[i - channels]);
+        }
+#else
+        filteredRow[0] = 0;
+        std::memcpy(filteredRow.data() + 1, row, rowBytes);
+#endif
+        rowsWritten++;
+        if (!deflateRow(filteredRow.data(), filteredRow.size(), rowsWritten == height))
+        {
+            failed = true;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool PngWriter::deflateRow(const uint8_t *filtered, size_t size, bool last)
+{
+#ifdef MOLVIEW_HAVE_ZLIB
+    z_stream *stream = static_cast<z_stream *>(zstream);
+    stream->next_in = const_cast<Bytef *>(filtered);
+    stream->avail_in = static_cast<uInt>(size);
+    uint8_t buffer[64 * 1024];
+    int result = Z_OK;
+    do
+    {
+        stream->next_out = buffer;
+        stream->avail_out = sizeof(buffer);
+        result = deflate(stream, last ? Z_FINISH : Z_NO_FLUSH);
+        if (result == Z_STREAM_ERROR)
+        {
+            std::cerr << "zlib error while writing " << path << std::endl;
+            return false;
+        }
+        idat.insert(idat.end(), buffer, buffer + (sizeof(buffer) - stream->avail_out));
+    } while (stream->avail_out == 0 || (last && result != Z_STREAM_END));
+#else
+    // Stored blocks: the raw bytes framed by 5-byte block headers; close()
+    // appends the final empty block and the Adler-32 trailer
+    adler = updateAdler(adler, filtered, size);
+    for (size_t offset = 0; offset < size; offset += STORED_BLOCK_SIZE)
+    {
+        uint16_t length = static_cast<uint16_t>(std::min(STORED_BLOCK_SIZE, size - offset));
+        uint8_t blockHeader[5] = {0x00, static_cast<uint8_t>(length), static_cast<uint8_t>(length >> 8),
+                                  static_cast<uint8_t>(~length), static_cast<uint8_t>(~length >> 8)};
+        idat.insert(idat.end(), blockHeader, blockHeader + 5);
+        idat.insert(idat.end(), filtered + offset, filtered + offset + length);
+    }
+    (void)last;
+#endif
+    return idat.size() < IDAT_CHUNK_SIZE || flushIdat();
+}
+
+bool PngWriter::flushIdat()
+{
+    bool ok = idat.empty() || writeChunk("IDAT", idat.data(), idat.size());
+    idat.clear();
+    return ok;
+}
+
+bool PngWriter::close()
+{
+    if (!file)
+    {
+        return false;
+    }
+    if (rowsWritten != height)
+    {
+        std::cerr << "PNG " << path << " closed after " << rowsWritten << " of " << height << " rows" << std::endl;
+        failed = true;
+    }
+
+    if (!failed)
+    {
+#ifndef MOLVIEW_HAVE_ZLIB
+        // Empty final block, then the Adler-32 of the uncompressed data
+        uint8_t trailer[9] = {0x01, 0x00, 0x00, 0xFF, 0xFF};
+        putBigEndian(trailer + 5, adler);
+        idat.insert(idat.end(), trailer, trailer + 9);
+#endif
+        failed = !flushIdat() || !writeChunk("IEND", nullptr, 0);
+    }
+
+    bool ok = std::fclose(file) == 0 && !failed;
+    file = nullptr;
+    return ok;
+}
+
+bool PngWriter::writeChunk(const char type[4], const uint8_t *data, size_t size)
+{
+    uint8_t header[8];
+    putBigEndian(header, static_cast<uint32_t>(size));
+    std::memcpy(header + 4, type, 4);
+
+    uint32_t crc = updateCrc(0xFFFFFFFFu, header + 4, 4);
+    if (size > 0)
+        crc = updateCrc(crc, data, size);
+    uint8_t trailer[4];
+    putBigEndian(trailer, crc ^ 0xFFFFFFFFu);
+
+    bool ok = std::fwrite(header, 1, 8, file) == 8 &&
+              (size == 0 || std::fwrite(data, 1, size, file) == size) &&
+              std::fwrite(trailer, 1, 4, file) == 4;
+    if (!ok)
+    {
+        std::cerr << "Failed to write " << path << std::endl;
+        failed = true;
+    }
+    return ok;
+}
+
+bool writePng(const std::string &path, const Image &image)
+{
+    PngWriter writer;
+    return writer.open(path, image.width, image.height, 4) &&
+           writer.writeRows(image.pixels.data(), image.height) &&
+           writer.close();
+}
+
+namespace {
+
+// Offset of the pixel data, after the (BigTIFF-sized) header
+constexpr uint64_t TIFF_DATA_OFFSET = 16;
+// Target strip size; readers handle many small strips better than one huge one
+constexpr size_t TIFF_STRIP_BYTES = 256 * 1024;
+
+enum TiffType : uint16_t {
+    TiffShort = 3,
+    TiffLong = 4,
+    TiffRational = 5,
+    TiffLong8 = 16,
+};
+
+struct TiffEntry {
+    uint16_t tag;
+    uint16_t type;
+    uint64_t count;
+    std::vector<uint8_t> data; // Little-endian values
+};
+
+void appendLittleEndian(std::vector<uint8_t> &out, uint64_t value, int bytes)
+{
+    for (int i = 0; i < bytes; ++i)
+    {
+        out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+TiffEntry makeEntry(uint16_t tag, uint16_t type, const std::vector<uint64_t> &values)
+{
+    int size = type == TiffShort ? 2 : type == TiffLong ? 4 : 8;
+    TiffEntry entry{tag, type, values.size(), {}};
+    for (uint64_t value : values)
+    {
+        appendLittleEndian(entry.data, value, size);
+    }
+    return entry;
+}
+
+} // namespace
+
+TiffWriter::~TiffWriter()
+{
+    if (file)
+    {
+        std::fclose(file);
+    }
+}
+
+int TiffWriter::getRowsPerStrip() const
+{
+    size_t rowBytes = static_cast<size_t>(width) * channels;
+    return static_cast<int>(std::clamp<size_t>(TIFF_STRIP_BYTES / rowBytes, 1, static_cast<size_t>(height)));
+}
+
+bool TiffWriter::open(const std::string &filePath, int imageWidth, int imageHeight, int imageChannels)
+{
+    if (imageWidth <= 0 || imageHeight <= 0 || (imageChannels != 3 && imageChannels != 4))
+    {
+        std::cerr << "Invalid TIFF dimensions for " << filePath << std::endl;
+        return false;
+    }
+
+    path = filePath;
+    file = std::fopen(path.c_str(), "wb");
+    if (!file)
+    {
+        std::cerr << "Failed to open " << path << " for writing" << std::endl;
+        return false;
+    }
+    width = imageWidth;
+    height = imageHeight;
+    channels = imageChannels;
+    rowsWritten = 0;
+
+    // Classic TIFF offsets are 32-bit; leave room for the directory after the pixels
+    uint64_t dataBytes = static_cast<uint64_t>(width) * height * channels;
+    bigTiff = TIFF_DATA_OFFSET + dataBytes + (1u << 20) > 0xFFFFFFFFull;
+
+    // Header with a zero directory offset, patched by close(); zero padding up to the pixel data
+    uint8_t header[TIFF_DATA_OFFSET] = {'I', 'I'};
+    header[2] = bigTiff ? 43 : 42;
+    if (bigTiff)
+    {
+        header[4] = 8; // Offset size
+    }
+    failed = std::fwrite(header, 1, sizeof(header), file) != sizeof(header);
+    return !failed;
+}
+
+bool TiffWriter::writeRows(const uint8_t *rows, int rowCount)
+{
+    if (!file || failed)
+    {
+        return false;
+    }
+    rowCount = std::min(rowCount, height - rowsWritten);
+    size_t bytes = static_cast<size_t>(rowCount) * width * channels;
+    if (std::fwrite(rows, 1, bytes, file) != bytes)
+    {
+        std::cerr << "Failed to write " << path << std::endl;
+        failed = true;
+        return false;
+    }
+    rowsWritten += rowCount;
+    return true;
+}
+
+bool TiffWriter::close()
+{
+    if (!file)
+    {
+        return false;
+    }
+    if (rowsWritten != height)
+    {
+        std::cerr << "TIFF " << path << " closed after " << rowsWritten << " of " << height << " rows" << std::endl;
+        failed = true;
+    }
+    if (!failed)
+    {
+        failed = !writeDirectory();
+    }
+
+    bool ok = std::fclose(file) == 0 && !failed;
+    file = nullptr;
+    return ok;
+}
+
+bool TiffWriter::writeDirectory()
+{
+    size_t rowBytes = static_cast<size_t>(width) * channels;
+    uint64_t offset = TIFF_DATA_OFFSET + rowBytes * height;
+
+    // Directories start on a word boundary
+    if (offset % 2)
+    {
+        std::fputc(0, file);
+        offset++;
+    }
+
+    int rowsPerStrip = getRowsPerStrip();
+    std::vector<uint64_t> stripOffsets, stripByteCounts;
+    for (int row = 0; row < height; row += rowsPerStrip)
+    {
+        stripOffsets.push_back(TIFF_DATA_OFFSET + row * rowBytes);
+        stripByteCounts.push_back(std::min(rowsPerStrip, height - row) * rowBytes);
+    }
+    uint16_t offsetType = bigTiff ? TiffLong8 : TiffLong;
+    uint64_t resolution = static_cast<uint64_t>(std::max(1.0f, dotsPerInch) * 100.0f + 0.5f);
+
+    // Tags in ascending order, as the format requires
+    std::vector<TiffEntry> entries = {
+        makeEntry(256, TiffLong, {static_cast<uint64_t>(width)}),
+        makeEntry(257, TiffLong, {static_cast<uint64_t>(height)}),
+        makeEntry(258, TiffShort, std::vector<uint64_t>(channels, 8)), // Bits per sample
+        makeEntry(259, TiffShort, {1}),                                // No compression
+        makeEntry(262, TiffShort, {2}),                                // RGB
+        makeEntry(273, offsetType, stripOffsets),
+        makeEntry(277, TiffShort, {static_cast<uint64_t>(channels)}),
+        makeEntry(278, TiffLong, {static_cast<uint64_t>(rowsPerStrip)}),
+        makeEntry(279, offsetType, stripByteCounts),
+        makeEntry(282, TiffLong, {resolution, 100}), // X resolution (rational)
+        makeEntry(283, TiffLong, {resolution, 100}), // Y resolution (rational)
+        makeEntry(284, TiffShort, {1}),              // Chunky pixels
+        makeEntry(296, TiffShort, {2}),              // Resolution in inches
+    };
+    entries[9].type = entries[10].type = TiffRational;
+    entries[9].count = entries[10].count = 1;
+    if (channels == 4)
+    {
+        entries.push_back(makeEntry(338, TiffShort, {2})); // Unassociated alpha
+    }
+
+    // Values that don't fit in an entry go after the directory
+    size_t inlineBytes = bigTiff ? 8 : 4;
+    size_t countBytes = bigTiff ? 8 : 2;
+    size_t entryBytes = bigTiff ? 20 : 12;
+    uint64_t externalOffset = offset + countBytes + entries.size() * entryBytes + inlineBytes;
+
+    std::vector<uint8_t> directory;
+    std::vector<uint8_t> external;
+    appendLittleEndian(directory, entries.size(), static_cast<int>(countBytes));
+    for (const TiffEntry &entry : entries)
+    {
+        appendLittleEndian(directory, entry.tag, 2);
+        appendLittleEndian(directory, entry.type, 2);
+        appendLittleEndian(directory, entry.count, static_cast<int>(inlineBytes));
+        if (entry.data.size() <= inlineBytes)
+        {
+            std::vector<uint8_t> value = entry.data;
+            value.resize(inlineBytes, 0);
+            directory.insert(directory.end(), value.begin(), value.end());
+        }
+        else
+        {
+            appendLittleEndian(directory, externalOffset + external.size(), static_cast<int>(inlineBytes));
+            external.insert(external.end(), entry.data.begin(), entry.data.end());
+            if (external.size() % 2)
+            {
+                external.push_back(0);
+            }
+        }
+    }
+    appendLittleEndian(directory, 0, static_cast<int>(inlineBytes)); // No further directories
+
+    bool ok = std::fwrite(directory.data(), 1, directory.size(), file) == directory.size() &&
+              (external.empty() || std::fwrite(external.data(), 1, external.size(), file) == external.size());
+
+    // Point the header at the directory
+    std::vector<uint8_t> directoryOffset;
+    appendLittleEndian(directoryOffset, offset, static_cast<int>(inlineBytes));
+    ok = ok && std::fseek(file, bigTiff ? 8 : 4, SEEK_SET) == 0 &&
+         std::fwrite(directoryOffset.data(), 1, directoryOffset.size(), file) == directoryOffset.size();
+    if (!ok)
+    {
+        std::cerr << "Failed to write " << path << std::endl;
+    }
+    return ok;
+}
+
+std::unique_ptr<ImageStreamWriter> createImageWriter(const std::string &path, int compressionLevel)
+{
+    size_t dot = path.find_last_of('.');
+    std::string extension = dot == std::string::npos ? "" : path.substr(dot + 1);
+    for (char &c : extension)
+    {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    if (extension == "tif" || extension == "tiff")
+    {
+        return std::make_unique<TiffWriter>();
+    }
+
+    auto writer = std::make_unique<PngWriter>();
+    writer->compressionLevel = compressionLevel;
+    return writer;
+}
@@ -1,6 +1,16 @@
 #include "imgui_manager.h"
 #include "ui_manager.h"
 #include "renderer.h"
+#include "app_data.h"
+#include "frame_pacer.h"
+#include "gpu_profiler.h"
+#include "cpu_profiler.h"
+#include "frame_stats.h"
+#include "frame_capture.h"
+#include "molecule_io.h"
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
 #include <iostream>
 
 GLFWmousebuttonfun ImGuiManager::OrigMouseButtonCallback = nullptr;
@@ -74,15 +84,6 @@ void ImGuiManager::ImGuiCharCallback(GLFWwindow *window, unsigned int c)
     }
 }
 
-// Forward declaration of AppData structure from main.cpp
-struct AppData
-{
-    UIManager *uiManager;
-    Renderer *renderer;
-    ImGuiManager *imguiManager;
-    bool mousePressed = false;
-};
-
 ImGuiManager::ImGuiManager(GLFWwindow *window) : window(window)
 {
 }
@@ -174,6 +175,7 @@ void ImGuiManager::newFrame()
                     if (appData->uiManager->startDragging(mouseX, mouseY))
                     {
                         appData->mousePressed = true;
+                        appData->renderer->beginDeferredResize();
                     }
                 }
                 else
@@ -181,7 +183,8 @@ void ImGuiManager::newFrame()
                     // Continue dragging if already dragging
                     appData->uiManager->updateDragging(mouseX, mouseY);
 
-                    // Update framebuffers after dragging
+                    // Update framebuffers after dragging (cheap: storage is only
+                    // reallocated when a region outgrows it)
                     for (const auto &region : appData->uiManager->getRegions())
                     {
                         if (region.name != "sidebar" && region.name != "status")
@@ -198,6 +201,7 @@ void ImGuiManager::newFrame()
                 // Mouse button released
                 appData->mousePressed = false;
                 appData->uiManager->endDragging();
+                appData->renderer->endDeferredResize();
             }
             else
             {
@@ -268,6 +272,9 @@ void ImGuiManager::render()
 
 void ImGuiManager::shutdown()
 {
+    // The loading and streaming threads wake the window, so they stop before GLFW goes away
+    moleculeLoader.stop();
+    trajectoryStreamer.close();
     if (initialized)
     {
         ImGui_ImplOpenGL3_Shutdown();
@@ -329,12 +336,212 @@ void ImGuiManager::renderSidebarUI()
         {
             if (ImGui::Button("Open Molecule", ImVec2(-1, 0)))
             {
-                // Will implement file loading later
+                ImGui::OpenPopup("Open Molecule");
+            }
+            if (ImGui::BeginPopupModal("Open Molecule", nullptr, ImGuiWindowFlags_AlwaysAutoResize))
+            {
+                ImGui::Text("Structure (XYZ, extended XYZ, PDB, mmCIF)");
+                ImGui::Text("or trajectory for the open structure (DCD, XTC, TRR)");
+                ImGui::SetNextItemWidth(400.0f);
+                bool submitted = ImGui::InputText("Path", openPath, sizeof(openPath), ImGuiInputTextFlags_EnterReturnsTrue);
+                if (ImGui::Button("Open") || submitted)
+                {
+                    openMolecule(openPath);
+                    ImGui::CloseCurrentPopup();
+                }
+                ImGui::SameLine();
+                if (ImGui::Button("Cancel"))
+                {
+                    ImGui::CloseCurrentPopup();
+                }
+                ImGui::EndPopup();
+            }
+
+            // Staged progress of the file being loaded
+            if (isLoading())
+            {
+                const LoadProgress &progress = moleculeLoader.getProgress();
+                ImGui::ProgressBar(progress.getFraction(), ImVec2(-1, 0), LoadProgress::stageName(progress.getStage()));
+                if (ImGui::Button("Cancel Loading", ImVec2(-1, 0)))
+                {
+                    moleculeLoader.cancel();
+                }
+            }
+
+            // Random access to any frame of the open trajectory, and playback
+            int frameCount = static_cast<int>(trajectoryStreamer.getFrameCount());
+            if (frameCount > 1)
+            {
+                int frame = trajectoryFrame;
+                ImGui::SliderInt("Frame", &frame, 0, frameCount - 1);
+                if (ImGui::ArrowButton("##previousFrame", ImGuiDir_Left))
+                    frame--;
+                ImGui::SameLine();
+                if (ImGui::ArrowButton("##nextFrame", ImGuiDir_Right))
+                    frame++;
+                ImGui::SameLine();
+                if (ImGui::Button(playing ? "Pause" : "Play"))
+                {
+                    playing = !playing;
+                    lastFrameAdvance = glfwGetTime();
+                }
+                ImGui::SameLine();
+                ImGui::Checkbox("Reverse", &playBackwards);
+                ImGui::SameLine();
+                ImGui::Text("%d frames", frameCount);
+                frame = std::clamp(frame, 0, frameCount - 1);
+                if (frame != trajectoryFrame)
+                {
+                    showTrajectoryFrame(static_cast<size_t>(frame), frame < trajectoryFrame ? -1 : 1);
+                }
+                ImGui::SliderFloat("Frames/s", &playbackFps, 1.0f, 120.0f, "%.0f");
+                if (ImGui::SliderInt("Frame cache (MB)", &frameCacheMegabytes, 64, 16384, "%d",
+                                     ImGuiSliderFlags_Logarithmic))
+                {
+                    trajectoryStreamer.setMemoryBudget(static_cast<size_t>(frameCacheMegabytes) << 20);
+                }
             }
 
             if (ImGui::Button("Save Image", ImVec2(-1, 0)))
             {
-                // Will implement screenshot saving later
+                // The region framebuffers hold this frame's images, composited as on screen;
+                // the readback and encoding finish in the background
+                AppData *appData = static_cast<AppData *>(glfwGetWindowUserPointer(window));
+                if (appData && appData->renderer && appData->renderer->captureLayout("screenshot.png"))
+                {
+                    setAppStatus("Saving screenshot.png");
+                }
+                else
+                {
+                    setAppStatus("Failed to save screenshot.png");
+                }
+            }
+
+            // Every rendered frame becomes a numbered PNG (movies of trajectory playback)
+            AppData *captureData = static_cast<AppData *>(glfwGetWindowUserPointer(window));
+            if (captureData && captureData->renderer)
+            {
+                FrameCapture &capture = captureData->renderer->frameCapture;
+                if (!capture.isRecording())
+                {
+                    if (ImGui::Button("Record Image Sequence", ImVec2(-1, 0)))
+                    {
+                        char stamp[32];
+                        std::time_t now = std::time(nullptr);
+                        std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", std::localtime(&now));
+                        std::string directory = std::string("capture-") + stamp;
+                        setAppStatus(capture.startSequence(directory) ? "Recording to " + directory
+                                                                      : "Failed to create " + directory);
+                    }
+                }
+                else
+                {
+                    if (ImGui::Button("Stop Recording", ImVec2(-1, 0)))
+                    {
+                        capture.stopSequence();
+                        setAppStatus("Recorded " + std::to_string(capture.getSequenceFrames()) + " frames to " +
+                                     capture.getSequenceDirectory());
+                    }
+                    FrameCapture::Stats stats = capture.getStats();
+                    ImGui::Text("%llu frames, %llu written, %llu stalls",
+                                static_cast<unsigned long long>(capture.getSequenceFrames()),
+                                static_cast<unsigned long long>(stats.written),
+                                static_cast<unsigned long long>(stats.stalls));
+                }
+            }
+
+            // Publication-size render of one view, tiled beyond the GL texture limits
+            if (captureData && captureData->renderer && ImGui::TreeNode("Poster"))
+            {
+                static int posterSize[2] = {16384, 16384};
+                static int posterFormat = 0;
+                static int posterView = 0;
+                const char *formats[] = {"PNG", "TIFF"};
+                ImGui::InputInt2("Size", posterSize);
+                posterSize[0] = std::clamp(posterSize[0], 16, 65536);
+                posterSize[1] = std::clamp(posterSize[1], 16, 65536);
+                ImGui::Combo("Format", &posterFormat, formats, IM_ARRAYSIZE(formats));
+
+                // Views that render 3D content
+                std::vector<const char *> views;
+                for (const auto &pair : captureData->renderer->framebuffers)
+                {
+                    views.push_back(pair.first.c_str());
+                }
+                posterView = std::clamp(posterView, 0, std::max(0, static_cast<int>(views.size()) - 1));
+                if (!views.empty())
+                {
+                    ImGui::Combo("View", &posterView, views.data(), static_cast<int>(views.size()));
+                }
+
+                if (ImGui::Button("Save Poster", ImVec2(-1, 0)) && !views.empty())
+                {
+                    PosterOptions options;
+                    options.width = posterSize[0];
+                    options.height = posterSize[1];
+                    std::string path = posterFormat == 0 ? "poster.png" : "poster.tiff";
+                    bool saved = captureData->renderer->savePoster(views[posterView], path, options);
+                    setAppStatus(saved ? "Saved " + path : "Failed to save " + path);
+                }
+                ImGui::TreePop();
+            }
+
+            // CPU ray traced image of one view with shadows and ambient occlusion, refined in the background
+            if (captureData && captureData->renderer)
+            {
+                RayTracer &rayTracer = captureData->renderer->rayTracer;
+                RayTracer::Progress progress = rayTracer.getProgress();
+                static bool rayTracing = false;
+                if (rayTracing && !progress.running)
+                {
+                    rayTracing = false;
+                    setAppStatus(progress.succeeded ? "Saved " + progress.path : "Ray tracing stopped");
+                }
+
+                if (ImGui::TreeNode("Ray Traced Image"))
+                {
+                    static int rayTraceSize[2] = {1920, 1080};
+                    static int rayTraceSamples = 64;
+                    static int rayTraceView = 0;
+                    ImGui::InputInt2("Size", rayTraceSize);
+                    rayTraceSize[0] = std::clamp(rayTraceSize[0], 16, 16384);
+                    rayTraceSize[1] = std::clamp(rayTraceSize[1], 16, 16384);
+                    ImGui::SliderInt("Samples", &rayTraceSamples, 1, 1024, "%d", ImGuiSliderFlags_Logarithmic);
+
+                    std::vector<const char *> views;
+                    for (const auto &pair : captureData->renderer->framebuffers)
+                    {
+                        views.push_back(pair.first.c_str());
+                    }
+                    rayTraceView = std::clamp(rayTraceView, 0, std::max(0, static_cast<int>(views.size()) - 1));
+                    if (!views.empty())
+                    {
+                        ImGui::Combo("View", &rayTraceView, views.data(), static_cast<int>(views.size()));
+                    }
+
+                    if (progress.running)
+                    {
+                        float fraction =
+                            progress.samples > 0 ? static_cast<float>(progress.samplesDone) / progress.samples : 0.0f;
+                        std::string overlay = std::to_string(progress.samplesDone) + "/" +
+                                              std::to_string(progress.samples) + " samples";
+                        ImGui::ProgressBar(fraction, ImVec2(-1, 0), overlay.c_str());
+                        if (ImGui::Button("Cancel", ImVec2(-1, 0)))
+                        {
+                            rayTracer.cancel();
+                        }
+                    }
+                    else if (ImGui::Button("Save Ray Traced Image", ImVec2(-1, 0)) && !views.empty())
+                    {
+                        RayTraceOptions options;
+                        options.width = rayTraceSize[0];
+                        options.height = rayTraceSize[1];
+                        options.samples = rayTraceSamples;
+                        rayTracing = captureData->renderer->startRayTrace(views[rayTraceView], "raytrace.png", options);
+                        setAppStatus(rayTracing ? "Ray tracing raytrace.png" : "Failed to start ray tracing");
+                    }
+                    ImGui::TreePop();
+                }
             }
         }
 
@@ -343,7 +550,14 @@ void ImGuiManager::renderSidebarUI()
         {
             const char *renderModes[] = {"Ball and Stick", "Space Filling", "Wireframe", "Ribbon"};
             static int renderModeIndex = 0;
-            ImGui::Combo("Render Mode", &renderModeIndex, renderModes, IM_ARRAYSIZE(renderModes));
+            if (ImGui::Combo("Render Mode", &renderModeIndex, renderModes, IM_ARRAYSIZE(renderModes)))
+            {
+                AppData *appData = static_cast<AppData *>(glfwGetWindowUserPointer(window));
+                if (appData && appData->renderer)
+                {
+                    appData->renderer->setRenderMode(static_cast<RenderMode>(renderModeIndex));
+                }
+            }
 
             // Color schemes
             const char *colorSchemes[] = {"Element", "Residue", "Chain", "Temperature"};
@@ -354,7 +568,11 @@ void ImGuiManager::renderSidebarUI()
             static ImVec4 bgColor = ImVec4(0.2f, 0.3f, 0.3f, 1.0f); // Default bg color
             if (ImGui::ColorEdit3("Background", (float *)&bgColor))
             {
-                // Will update background color later
+                AppData *appData = static_cast<AppData *>(glfwGetWindowUserPointer(window));
+                if (appData && appData->renderer)
+                {
+                    appData->renderer->setBackgroundColor(bgColor.x, bgColor.y, bgColor.z);
+                }
             }
         }
 
@@ -389,6 +607,25 @@ void ImGuiManager::renderSidebarUI()
             }
         }
 
+        // Renderer statistics
+        if (ImGui::CollapsingHeader("Performance"))
+        {
+            AppData *appData = static_cast<AppData *>(glfwGetWindowUserPointer(window));
+            if (appData && appData->renderer)
+            {
+                const GLStateCache::Counters &stateChanges = appData->renderer->glState.getLastFrame();
+                ImGui::Text("GL state changes: %llu applied", static_cast<unsigned long long>(stateChanges.applied));
+                ImGui::Text("Redundant changes skipped: %llu", static_cast<unsigned long long>(stateChanges.skipped));
+
+                const FramebufferPool &pool = appData->renderer->framebufferPool;
+                ImGui::Text("View layers: %zu/%zu (%dx%d)", pool.getUsedLayerCount(), pool.getLayerCount(),
+                            pool.getWidth(), pool.getHeight());
+
+                renderGpuTimings(appData->renderer->gpuProfiler);
+            }
+            renderCpuFlameView();
+        }
+
         // Settings
         if (ImGui::CollapsingHeader("Settings"))
         {
@@ -451,25 +688,99 @@ void ImGuiManager::renderStatusUI()
 
     ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2(10, 3));
 
-    if (ImGui::Begin("StatusBar", nullptr, statusFlags))
+    if (!ImGui::Begin("StatusBar", nullptr, statusFlags))
+    {
+        ImGui::End();
+        ImGui::PopStyleVar();
+        return;
+    }
+
+    // Left side - status message
+    ImGui::Text("%s", appStatus.c_str());
+
+    // The items after it flow left to right and are dropped when they would run into the fps counter
+    float fpsX = ImGui::GetWindowWidth() - 120;
+    char text[160];
+
+    AppData *appData = static_cast<AppData *>(ptr);
+
+    // Trajectory streaming: cache hit rate of requested frames and decode time; cache fill on hover
+    if (trajectoryStreamer.getFrameCount() > 1)
     {
-        // Left side - status message
-        ImGui::Text("%s", appStatus.c_str());
+        TrajectoryStreamer::Stats stats = trajectoryStreamer.getStats();
+        std::snprintf(text, sizeof(text), "Frames: %.0f%% cached, decode %.1f ms", stats.getHitRate() * 100.0f,
+                 stats.decodeMs);
+        if (placeStatusItem(text, fpsX))
+        {
+            ImGui::TextUnformatted(text);
+            if (ImGui::IsItemHovered() && ImGui::BeginTooltip())
+            {
+                ImGui::Text("%llu of %llu requested frames from the cache", static_cast<unsigned long long>(stats.hits),
+                            static_cast<unsigned long long>(stats.requests));
+                ImGui::Text("%llu frames decoded, last %.2f ms", static_cast<unsigned long long>(stats.decoded),
+                            stats.lastDecodeMs);
+                ImGui::Text("Cache: %zu frames, %.0f of %.0f MB", stats.cachedFrames, stats.cachedBytes / 1048576.0,
+                            stats.memoryBudget / 1048576.0);
+                ImGui::EndTooltip();
+            }
+        }
+    }
 
-        // Right side - fps counter
-        ImGui::SameLine(ImGui::GetWindowWidth() - 120);
-        ImGui::Text("FPS: %.1f", ImGui::GetIO().Framerate);
+    // Render loop mode
+    if (appData && appData->framePacer)
+    {
+        std::snprintf(text, sizeof(text), "Render: %s", appData->framePacer->getModeDescription().c_str());
+        if (placeStatusItem(text, fpsX))
+        {
+            ImGui::TextUnformatted(text);
+        }
     }
 
-    // Debug info
-    ImGui::SameLine(ImGui::GetWindowWidth() - 480);
-    ImGuiIO &io = ImGui::GetIO();
-    ImGui::Text("ImGui WantCaptureMouse: %s", io.WantCaptureMouse ? "true" : "false");
+    // Frame-time percentiles, the first item to go when space runs out; details (history, stutters) on hover
+    if (appData && appData->frameStats)
+    {
+        const FrameStats &stats = *appData->frameStats;
+        const FrameStats::Summary &summary = stats.getSummary();
+        std::snprintf(text, sizeof(text), "Frame ms p50 %.1f  p95 %.1f  p99 %.1f  max %.1f  over budget: %llu",
+                      summary.p50, summary.p95, summary.p99, summary.max,
+                      static_cast<unsigned long long>(stats.getOverBudgetCount()));
+        if (placeStatusItem(text, fpsX))
+        {
+            ImVec4 color = stats.isOverBudget(summary.p99) ? ImVec4(1.0f, 0.6f, 0.2f, 1.0f) : ImVec4(0.7f, 0.9f, 0.7f, 1.0f);
+            ImGui::TextColored(color, "%s", text);
+            if (ImGui::IsItemHovered() && ImGui::BeginTooltip())
+            {
+                ImGui::PlotLines("##frametimes", stats.getHistory().data(), static_cast<int>(stats.getHistory().size()),
+                                 static_cast<int>(stats.getHistoryOffset()), "frame time (ms)", 0.0f,
+                                 stats.budgetMs * 3.0f, ImVec2(360, 80));
+                ImGui::Text("Budget %.2f ms, %llu stutters", stats.budgetMs,
+                            static_cast<unsigned long long>(stats.getStutterCount()));
+                const std::vector<FrameStats::Stutter> &stutters = stats.getStutters();
+                for (auto it = stutters.rbegin(); it != stutters.rend() && it - stutters.rbegin() < 8; ++it)
+                {
+                    ImGui::BulletText("%.1f ms at %.1f s (frame %llu): %s", it->ms, it->time,
+                                      static_cast<unsigned long long>(it->frame), it->cause.c_str());
+                }
+                ImGui::TextDisabled("ImGui WantCaptureMouse: %s", ImGui::GetIO().WantCaptureMouse ? "true" : "false");
+                ImGui::EndTooltip();
+            }
+        }
+    }
+
+    // Right side - fps counter
+    ImGui::SameLine(fpsX);
+    ImGui::Text("FPS: %.1f", ImGui::GetIO().Framerate);
 
     ImGui::End();
     ImGui::PopStyleVar();
 }
 
+bool ImGuiManager::placeStatusItem(const char *text, float rightEdge)
+{
+    ImGui::SameLine(0.0f, 24.0f);
+    return ImGui::GetCursorPosX() + ImGui::CalcTextSize(text).x <= rightEdge - 24.0f;
+}
+
 void ImGuiManager::setMoleculeInfo(const std::string &name, int atoms, float radius)
 {
     moleculeInfo.name = name;
@@ -477,6 +788,221 @@ void ImGuiManager::setMoleculeInfo(const std::string &name, int atoms, float rad
     moleculeInfo.radius = radius;
 }
 
+bool ImGuiManager::openMolecule(const std::string &path)
+{
+    AppData *appData = static_cast<AppData *>(glfwGetWindowUserPointer(window));
+    if (!appData || !appData->renderer)
+    {
+        return false;
+    }
+    if (isLoading())
+    {
+        setAppStatus("Still loading " + moleculeLoader.getPath());
+        return false;
+    }
+    if (!moleculeLoader.start(path))
+    {
+        setAppStatus("Failed to start loading " + path);
+        return false;
+    }
+    setAppStatus("Loading " + path);
+    return true;
+}
+
+bool ImGuiManager::isLoading() const
+{
+    AppData *appData = static_cast<AppData *>(glfwGetWindowUserPointer(window));
+    return moleculeLoader.isRunning() || (appData && appData->renderer && appData->renderer->isUploadingMolecule());
+}
+
+void ImGuiManager::updateLoading()
+{
+    AppData *appData = static_cast<AppData *>(glfwGetWindowUserPointer(window));
+    if (!appData || !appData->renderer)
+    {
+        return;
+    }
+    Renderer &renderer = *appData->renderer;
+    LoadProgress &progress = moleculeLoader.getProgress();
+
+    if (std::unique_ptr<MoleculeLoader::Result> result = moleculeLoader.takeResult())
+    {
+        publishLoad(*result);
+    }
+
+    if (renderer.isUploadingMolecule())
+    {
+        if (progress.isCancelled())
+        {
+            renderer.cancelMoleculeUpload();
+            pendingTrajectory.reset();
+            setAppStatus("Cancelled loading " + pendingPath);
+        }
+        else if (renderer.continueMoleculeUpload(Renderer::MOLECULE_UPLOAD_BYTES_PER_FRAME))
+        {
+            finishMoleculeUpload();
+        }
+        else
+        {
+            progress.update(renderer.getMoleculeUploadProgress());
+            if (appData->framePacer)
+            {
+                appData->framePacer->requestRedraw(1);
+            }
+        }
+    }
+
+    if (isLoading())
+    {
+        char percent[16];
+        std::snprintf(percent, sizeof(percent), " %.0f%%", progress.getFraction() * 100.0f);
+        setAppStatus("Loading " + moleculeLoader.getPath() + ": " + LoadProgress::stageName(progress.getStage()) +
+                     percent);
+    }
+}
+
+void ImGuiManager::publishLoad(MoleculeLoader::Result &result)
+{
+    AppData *appData = static_cast<AppData *>(glfwGetWindowUserPointer(window));
+    const std::string &path = result.path;
+    if (!result.succeeded)
+    {
+        setAppStatus(result.cancelled ? "Cancelled loading " + path : "Failed to open " + path);
+        return;
+    }
+
+    if (result.trajectoryOnly)
+    {
+        // Coordinates only: they need the structure on screen to have the same atoms
+        size_t atomCount = appData->renderer->currentMolecule.getAtomCount();
+        size_t frameAtoms = result.trajectory->getAtomCount(0);
+        if (frameAtoms != atomCount)
+        {
+            setAppStatus(path + " has " + std::to_string(frameAtoms) + " atoms, the structure " +
+                         std::to_string(atomCount));
+            return;
+        }
+        size_t frameCount = result.trajectory->getFrameCount();
+        playing = false;
+        trajectoryStreamer.open(std::move(result.trajectory));
+        showTrajectoryFrame(0);
+        setAppStatus("Opened " + path + ", " + std::to_string(frameCount) + " frames");
+        return;
+    }
+
+    // Uploaded over the next frames; the structure on screen stays until all of it is on the GPU
+    pendingTrajectory = std::move(result.trajectory);
+    pendingPath = path;
+    moleculeLoader.getProgress().begin(LoadProgress::Stage::Upload);
+    appData->renderer->beginMoleculeUpload(std::move(result.molecule));
+}
+
+void ImGuiManager::finishMoleculeUpload()
+{
+    AppData *appData = static_cast<AppData *>(glfwGetWindowUserPointer(window));
+    const Molecule &molecule = appData->renderer->currentMolecule;
+
+    size_t frameCount = pendingTrajectory ? pendingTrajectory->getFrameCount() : 1;
+    playing = false;
+    trajectoryStreamer.close();
+    if (pendingTrajectory)
+    {
+        trajectoryStreamer.open(std::move(pendingTrajectory));
+    }
+    trajectoryFrame = 0;
+    framePending = false;
+
+    glm::vec3 minCorner, maxCorner;
+    molecule.getBounds(minCorner, maxCorner);
+    setMoleculeInfo(molecule.name, static_cast<int>(molecule.getAtomCount()), 0.5f * glm::length(maxCorner - minCorner));
+    std::string frameText = frameCount > 1 ? ", " + std::to_string(frameCount) + " frames" : "";
+    setAppStatus("Opened " + pendingPath + frameText);
+}
+
+bool ImGuiManager::showTrajectoryFrame(size_t frame, int direction)
+{
+    if (frame >= trajectoryStreamer.getFrameCount())
+    {
+        return false;
+    }
+    trajectoryStreamer.request(frame, direction);
+    trajectoryFrame = static_cast<int>(frame);
+    framePending = true;
+    return true;
+}
+
+void ImGuiManager::updateTrajectoryPlayback()
+{
+    AppData *appData = static_cast<AppData *>(glfwGetWindowUserPointer(window));
+    if (std::shared_ptr<const StreamedFrame> frame = trajectoryStreamer.takeFrame())
+    {
+        applyTrajectoryFrame(*frame);
+        framePending = framePending && frame->index != static_cast<size_t>(trajectoryFrame);
+    }
+
+    size_t frameCount = trajectoryStreamer.getFrameCount();
+    playing = playing && frameCount > 1;
+    if (appData && appData->framePacer)
+    {
+        appData->framePacer->setContinuous(FramePacer::Playback, playing);
+    }
+    if (!playing)
+    {
+        return;
+    }
+
+    // Next frame once this one is on screen and its time is up: slow decoding slows
+    // playback down instead of stalling the render loop
+    double now = glfwGetTime();
+    if (framePending || now - lastFrameAdvance < 1.0 / playbackFps)
+    {
+        return;
+    }
+    lastFrameAdvance = now;
+    int direction = playBackwards ? -1 : 1;
+    size_t next = (static_cast<size_t>(trajectoryFrame) + frameCount + direction) % frameCount;
+    showTrajectoryFrame(next, direction);
+}
+
+void ImGuiManager::applyTrajectoryFrame(const StreamedFrame &frame)
+{
+    AppData *appData = static_cast<AppData *>(glfwGetWindowUserPointer(window));
+    if (!appData || !appData->renderer)
+    {
+        return;
+    }
+    Renderer &renderer = *appData->renderer;
+
+    const Molecule &current = renderer.currentMolecule;
+    bool read = !frame.failed;
+    bool sameAtoms = frame.positions.size() == current.getAtomCount();
+    if (read && frame.topology &&
+        (!sameAtoms || frame.topology->elements != current.elements || frame.topology->bonds != current.bonds))
+    {
+        // The frame's own topology (read and bonded on the streaming thread) differs from the
+        // one on screen, e.g. atoms exchanged in a grand canonical run. The view stays where
+        // the user put it.
+        Molecule molecule = *frame.topology;
+        molecule.positions = frame.positions;
+        molecule.name = current.name;
+        renderer.setMolecule(molecule);
+        moleculeInfo.atoms = static_cast<int>(molecule.getAtomCount());
+    }
+    else if (read && sameAtoms)
+    {
+        // Same atoms as on screen: only the positions move
+        renderer.updateAtomPositions(frame.positions.data(), frame.positions.size());
+    }
+    else
+    {
+        read = false;
+    }
+    if (!read)
+    {
+        setAppStatus("Failed to read frame " + std::to_string(frame.index + 1));
+    }
+}
+
 void ImGuiManager::setAppStatus(const std::string &status)
 {
     appStatus = status;
@@ -487,4 +1013,175 @@ void ImGuiManager::framebufferSizeCallback(GLFWwindow *window, int width, int he
     // This callback will be called in addition to the main app's framebuffer callback
     // GLFW will call both the original callback and this one
     glViewport(0, 0, width, height);
-}
\ No newline at end of file
+}
+
+void ImGuiManager::renderGpuTimings(GpuProfiler &profiler)
+{
+    if (!ImGui::TreeNode("GPU Timings"))
+    {
+        return;
+    }
+
+    ImGui::Checkbox("Enable GPU Queries", &profiler.enabled);
+
+    const std::vector<GpuProfiler::Zone> &zones = profiler.getZones();
+    if (ImGui::BeginTable("GpuZones", 3))
+    {
+        ImGui::TableSetupColumn("Zone");
+        ImGui::TableSetupColumn("Last (ms)");
+        ImGui::TableSetupColumn("Avg (ms)");
+        ImGui::TableHeadersRow();
+        for (const GpuProfiler::Zone &zone : zones)
+        {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%s", zone.name.c_str());
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", zone.lastMs);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", zone.averageMs);
+        }
+        ImGui::EndTable();
+    }
+
+    // Timeline: one line per zone over the kept history
+    int offset = profiler.getHistoryOffset();
+    if (ImPlot::BeginPlot("GPU Time per Frame", ImVec2(-1, 180), ImPlotFlags_NoMouseText))
+    {
+        ImPlot::SetupAxes("frame", "ms", ImPlotAxisFlags_NoTickLabels, ImPlotAxisFlags_AutoFit);
+        ImPlot::SetupAxisLimits(ImAxis_X1, 0, GpuProfiler::HISTORY_LENGTH, ImPlotCond_Always);
+        ImPlot::SetupLegend(ImPlotLocation_NorthWest);
+        for (const GpuProfiler::Zone &zone : zones)
+        {
+            ImPlot::PlotLine(zone.name.c_str(), zone.history.data(), GpuProfiler::HISTORY_LENGTH, 1.0, 0.0, 0, offset);
+        }
+        ImPlot::EndPlot();
+    }
+
+    // Distribution of the total GPU time per frame
+    int count = profiler.getHistoryCount();
+    if (count > 0 && ImPlot::BeginPlot("GPU Frame Time Histogram", ImVec2(-1, 140), ImPlotFlags_NoLegend | ImPlotFlags_NoMouseText))
+    {
+        ImPlot::SetupAxes("ms", "frames", ImPlotAxisFlags_AutoFit, ImPlotAxisFlags_AutoFit);
+        ImPlot::PlotHistogram("total", profiler.getFrameHistory().data(), count);
+        ImPlot::EndPlot();
+    }
+
+    if (profiler.getDroppedFrames() > 0)
+    {
+        ImGui::TextDisabled("%llu frames dropped (results not ready)", static_cast<unsigned long long>(profiler.getDroppedFrames()));
+    }
+
+    if (ImGui::Button("Export GPU Timings (CSV)", ImVec2(-1, 0)))
+    {
+        if (profiler.exportCsv("gpu_timings.csv"))
+        {
+            setAppStatus("GPU timings written to gpu_timings.csv");
+        }
+    }
+
+    ImGui::TreePop();
+}
+
+void ImGuiManager::renderCpuFlameView()
+{
+    if (!ImGui::TreeNode("CPU Zones"))
+    {
+        return;
+    }
+
+#ifndef MOLVIEW_PROFILING
+    ImGui::TextDisabled("Built without ENABLE_PROFILING");
+#endif
+
+    // Keep showing the same frame while paused so it can be inspected
+    static bool paused = false;
+    static std::vector<CpuProfiler::Event> events;
+    static uint64_t frameStart = 0, frameEnd = 0, idleNs = 0;
+    ImGui::Checkbox("Pause", &paused);
+    if (!paused)
+    {
+        events = CpuProfiler::instance().getLastFrame(frameStart, frameEnd);
+
+        // The pacer's sleep between frames is not work: cut it out of the frame and the zones around it
+        idleNs = 0;
+        auto idle = std::find_if(events.begin(), events.end(), [](const CpuProfiler::Event &event) {
+            return event.name == FramePacer::IDLE_ZONE;
+        });
+        if (idle != events.end())
+        {
+            CpuProfiler::Event sleep = *idle;
+            events.erase(idle);
+            idleNs = sleep.endNs - sleep.startNs;
+            for (CpuProfiler::Event &event : events)
+            {
+                if (event.startNs <= sleep.startNs && event.endNs >= sleep.endNs)
+                {
+                    event.endNs -= idleNs;
+                }
+                else if (event.startNs >= sleep.endNs)
+                {
+                    event.startNs -= idleNs;
+                    event.endNs -= idleNs;
+                }
+            }
+            frameEnd -= idleNs;
+        }
+    }
+
+    if (events.empty() || frameEnd <= frameStart)
+    {
+        ImGui::TextDisabled("No frame recorded yet");
+    }
+    else
+    {
+        ImGui::Text("Frame: %.2f ms, idle %.2f ms (not shown)", (frameEnd - frameStart) * 1e-6, idleNs * 1e-6);
+
+        uint32_t maxDepth = 0;
+        for (const CpuProfiler::Event &event : events)
+        {
+            maxDepth = std::max(maxDepth, event.depth);
+        }
+
+        // One row per nesting level, time on the x axis
+        ImDrawList *drawList = ImGui::GetWindowDrawList();
+        ImVec2 origin = ImGui::GetCursorScreenPos();
+        float width = std::max(ImGui::GetContentRegionAvail().x, 1.0f);
+        float rowHeight = ImGui::GetTextLineHeight() + 4.0f;
+        double pixelsPerNs = width / static_cast<double>(frameEnd - frameStart);
+        for (const CpuProfiler::Event &event : events)
+        {
+            float x0 = origin.x + static_cast<float>((event.startNs - frameStart) * pixelsPerNs);
+            float x1 = std::max(x0 + 1.0f, origin.x + static_cast<float>((event.endNs - frameStart) * pixelsPerNs));
+            float y0 = origin.y + event.depth * rowHeight;
+            ImVec2 min(x0, y0), max(x1, y0 + rowHeight - 1.0f);
+
+            // Stable color per zone name
+            size_t hash = std::hash<const void *>()(event.name);
+            ImU32 color = IM_COL32(90 + hash % 120, 90 + (hash >> 8) % 120, 90 + (hash >> 16) % 120, 255);
+            drawList->AddRectFilled(min, max, color);
+
+            if (x1 - x0 > 20.0f)
+            {
+                drawList->PushClipRect(min, max, true);
+                drawList->AddText(ImVec2(x0 + 2.0f, y0 + 2.0f), IM_COL32(0, 0, 0, 255), event.name);
+                drawList->PopClipRect();
+            }
+            if (ImGui::IsMouseHoveringRect(min, max))
+            {
+                ImGui::SetTooltip("%s: %.3f ms", event.name, (event.endNs - event.startNs) * 1e-6);
+            }
+        }
+        ImGui::Dummy(ImVec2(width, (maxDepth + 1) * rowHeight));
+    }
+
+    if (ImGui::Button("Write Chrome Trace", ImVec2(-1, 0)))
+    {
+        if (CpuProfiler::instance().writeChromeTrace("trace.json"))
+        {
+            setAppStatus("CPU trace written to trace.json (F12 writes a timestamped one)");
+        }
+    }
+
+    ImGui::TreePop();
+}
@@ -1,22 +1,25 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <iostream>
+#include <string>
+#include <vector>
+#include <ctime>
 #include "renderer.h"
 #include "ui_manager.h"
 #include "imgui_manager.h"
-
-struct AppData
-{
-    UIManager *uiManager;
-    Renderer *renderer;
-    ImGuiManager *imguiManager;
-    bool mousePressed = false;
-};
+#include "app_data.h"
+#include "frame_pacer.h"
+#include "cpu_profiler.h"
+#include "frame_stats.h"
+#include "headless.h"
 
 // Window dimensions
 const unsigned int SCR_WIDTH = 1200;
 const unsigned int SCR_HEIGHT = 900;
 
+// Redraw rate of the animated placeholder shown before a structure is loaded
+const double PLACEHOLDER_FPS = 10.0;
+
 // GLFW error callback
 void error_callback(int error, const char *description)
 {
@@ -26,14 +29,17 @@ void error_callback(int error, const char *description)
 // Callback function for window resize
 void framebuffer_size_callback(GLFWwindow *window, int width, int height)
 {
-    glViewport(0, 0, width, height);
-
     // Update UI manager with new dimensions
     void *ptr = glfwGetWindowUserPointer(window);
     if (ptr)
     {
         AppData *appData = static_cast<AppData *>(ptr);
+        appData->renderer->glState.viewport(0, 0, width, height);
         appData->uiManager->updateScreenSize(width, height);
+        if (appData->framePacer)
+        {
+            appData->framePacer->requestRedraw();
+        }
 
         // Resize framebuffers for all regions
         for (const auto &region : appData->uiManager->getRegions())
@@ -43,9 +49,20 @@ void framebuffer_size_callback(GLFWwindow *window, int width, int height)
     }
 }
 
+// Timestamped file name for traces written from the hotkey
+std::string traceFileName()
+{
+    char stamp[32];
+    std::time_t now = std::time(nullptr);
+    std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", std::localtime(&now));
+    return std::string("trace-") + stamp + ".json";
+}
+
 // Process input
 void processInput(GLFWwindow *window)
 {
+    PROFILE_ZONE("processInput");
+
     // Add a static variable to track if key was pressed last frame
     static bool escapePressed = false;
     bool currentEscapeState = glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS;
@@ -58,13 +75,73 @@ void processInput(GLFWwindow *window)
 
     // Update key state for next frame
     escapePressed = currentEscapeState;
+
+    // F12 dumps the buffered CPU zones as a Chrome trace
+    static bool tracePressed = false;
+    bool currentTraceState = glfwGetKey(window, GLFW_KEY_F12) == GLFW_PRESS;
+    if (currentTraceState && !tracePressed)
+    {
+        CpuProfiler::instance().writeChromeTrace(traceFileName());
+    }
+    tracePressed = currentTraceState;
 }
 
-int main()
+int main(int argc, char **argv)
 {
+    // --trace [file]: write a Chrome trace of the session on exit
+    // --metrics [file]: keep a Prometheus-format frame-time summary up to date
+    // --headless ...: render structures to PNG files without a window (see printHeadlessUsage)
+    // A structure file on its own is opened in the viewer
+    std::string tracePath;
+    std::string metricsPath;
+    std::vector<std::string> headlessArguments;
+    bool headless = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+        if (argument == "--trace")
+        {
+            tracePath = (i + 1 < argc && argv[i + 1][0] != '-') ? argv[++i] : "trace.json";
+        }
+        else if (argument.rfind("--trace=", 0) == 0)
+        {
+            tracePath = argument.substr(8);
+        }
+        else if (argument == "--metrics")
+        {
+            metricsPath = (i + 1 < argc && argv[i + 1][0] != '-') ? argv[++i] : "molview_metrics.prom";
+        }
+        else if (argument.rfind("--metrics=", 0) == 0)
+        {
+            metricsPath = argument.substr(10);
+        }
+        else
+        {
+            headless = headless || argument == "--headless";
+            headlessArguments.push_back(argument);
+        }
+    }
+    PROFILE_THREAD("main");
+
     // Set error callback
     glfwSetErrorCallback(error_callback);
 
+    if (headless)
+    {
+        HeadlessOptions options;
+        if (!parseHeadlessArguments(headlessArguments, options))
+        {
+            printHeadlessUsage();
+            return -1;
+        }
+        int result = runHeadless(options);
+        if (!tracePath.empty())
+        {
+            CpuProfiler::instance().writeChromeTrace(tracePath);
+        }
+        return result;
+    }
+
     // Initialize GLFW
     if (!glfwInit())
     {
@@ -144,8 +221,18 @@ int main()
     // Give the renderer access to the UIManager
     renderer.setUIManager(&uiManager);
 
+    // Input callbacks that wake the render loop; installed first so ImGui chains to them
+    FramePacer framePacer(window);
+    framePacer.installCallbacks();
+
+    // Ray traced images report each refinement pass, so the sidebar progress stays current while idle
+    renderer.rayTracer.onProgress = [&framePacer]() { framePacer.wake(); };
+
     // Initialize ImGui Manager
     ImGuiManager imguiManager(window);
+    // Streamed trajectory frames and load progress are picked up at the start of the next frame
+    imguiManager.trajectoryStreamer.onFrameReady = [&framePacer]() { framePacer.wake(); };
+    imguiManager.moleculeLoader.getProgress().onChange = [&framePacer]() { framePacer.wake(); };
     if (!imguiManager.init())
     {
         std::cerr << "Failed to initialize ImGui. Continuing without ImGui support." << std::endl;
@@ -153,9 +240,6 @@ int main()
     else
     {
         std::cout << "ImGui initialized successfully." << std::endl;
-
-        // Add example molecule info
-        imguiManager.setMoleculeInfo("Caffeine", 24, 1.2f);
         imguiManager.setAppStatus("Ready to analyze molecules");
     }
 
@@ -164,34 +248,88 @@ int main()
     appData.uiManager = &uiManager;
     appData.renderer = &renderer;
     appData.imguiManager = &imguiManager;
+    appData.framePacer = &framePacer;
+
+    // Frame-time percentiles and stutter tracking for the status bar
+    FrameStats frameStats;
+    frameStats.setMetricsFile(metricsPath);
+    if (const GLFWvidmode *videoMode = glfwGetVideoMode(glfwGetPrimaryMonitor()))
+    {
+        frameStats.setRefreshRate(videoMode->refreshRate);
+    }
+    appData.frameStats = &frameStats;
     glfwSetWindowUserPointer(window, &appData);
 
+    // Structure given on the command line
+    if (headlessArguments.size() == 1 && headlessArguments[0][0] != '-')
+    {
+        imguiManager.openMolecule(headlessArguments[0]);
+    }
+
     // Enable vsync
     glfwSwapInterval(1);
 
     // Enable depth testing
-    glEnable(GL_DEPTH_TEST);
+    renderer.glState.setDepthTest(true);
 
-    // Create framebuffers for all regions
+    // Create framebuffers for all rendered regions
     for (const auto &region : uiManager.getRegions())
     {
+        // ImGui regions are drawn directly to the window
+        if (region.name == "sidebar" || region.name == "status")
+            continue;
+
         renderer.createFramebufferForRegion(region);
     }
 
     // Render loop
     while (!glfwWindowShouldClose(window))
     {
+        PROFILE_FRAME();
+        double frameStart = glfwGetTime();
+
         // Process keyboard input only (mouse is handled by ImGui)
         processInput(window);
 
+        // Render every frame while a mouse button is held (drags, sliders)
+        bool mouseHeld = false;
+        for (int button = GLFW_MOUSE_BUTTON_1; button <= GLFW_MOUSE_BUTTON_LAST; ++button)
+        {
+            mouseHeld = mouseHeld || glfwGetMouseButton(window, button) == GLFW_PRESS;
+        }
+        framePacer.setContinuous(FramePacer::Interaction, mouseHeld);
+        // The pulsing placeholder in the main view animates at a low rate until a structure is loaded
+        if (!renderer.hasMolecule())
+        {
+            framePacer.scheduleRedraw(1.0 / PLACEHOLDER_FPS);
+        }
+
+        // Per-frame state change counters start over; GPU timings from earlier frames are collected
+        renderer.glState.beginFrame();
+        renderer.gpuProfiler.beginFrame();
+
         // Clear the screen
-        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        renderer.clearFrame(0.1f, 0.1f, 0.1f, 1.0f);
 
         // Start ImGui frame - mouse event handling now happens in here
-        imguiManager.newFrame();
+        {
+            PROFILE_ZONE("imgui newFrame");
+            imguiManager.newFrame();
+        }
+
+        // Finished loads, their GPU upload (a slice per frame) and the newest streamed
+        // trajectory frame; none of it waits for a file
+        {
+            PROFILE_ZONE("loading");
+            imguiManager.updateLoading();
+        }
+        {
+            PROFILE_ZONE("trajectory playback");
+            imguiManager.updateTrajectoryPlayback();
+        }
 
-        // Render quad regions to their framebuffers
+        // Render quad regions to their framebuffers (regions whose content, camera
+        // and size are unchanged keep their cached image)
         for (const auto &region : uiManager.getRegions())
         {
             // Skip ImGui regions
@@ -201,25 +339,52 @@ int main()
             renderer.renderRegion(region);
         }
 
-        // Render all framebuffers to the screen
-        for (const auto &region : uiManager.getRegions())
+        // While recording, every rendered frame goes to the image sequence; finished
+        // readbacks move on to the encoder threads
+        if (renderer.frameCapture.isRecording())
         {
-            // Skip ImGui regions
-            if (region.name == "sidebar" || region.name == "status")
-                continue;
-
-            renderer.renderFramebufferToScreen(region);
+            renderer.captureLayout(renderer.frameCapture.nextSequencePath());
         }
+        renderer.frameCapture.update();
+
+        // Composite all region framebuffers to the screen in one draw
+        renderer.compositeRegions();
 
         // Draw grid lines on top
         renderer.drawGridLines();
 
         // Render ImGui
-        imguiManager.render();
+        {
+            PROFILE_ZONE("imgui render");
+            renderer.gpuProfiler.begin("imgui");
+            imguiManager.render();
+            renderer.gpuProfiler.end();
+        }
 
-        // Swap buffers and poll events
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        // Captures in flight are handed to the encoders on the next frame, so don't go idle yet
+        if (renderer.frameCapture.hasPendingReadbacks())
+        {
+            framePacer.requestRedraw(1);
+        }
+
+        // Cost of this frame up to the swap; the swap blocks on vsync, which is not frame work
+        frameStats.addFrame(static_cast<float>((glfwGetTime() - frameStart) * 1000.0), frameStart);
+
+        // Swap buffers, then sleep until there is something new to draw
+        {
+            PROFILE_ZONE("swapBuffers");
+            glfwSwapBuffers(window);
+        }
+        {
+            // Input callbacks run in here
+            PROFILE_ZONE("waitForEvents");
+            framePacer.waitForEvents();
+        }
+    }
+
+    if (!tracePath.empty())
+    {
+        CpuProfiler::instance().writeChromeTrace(tracePath);
     }
 
     // Clean up
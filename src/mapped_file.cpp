@@ -0,0 +1,193 @@
+#include "mapped_file.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <utility>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+{
+    *this = std::move(other);
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept
+{
+    if (this != &other)
+    {
+        close();
+        path = std::move(other.path);
+        bytes = std::exchange(other.bytes, nullptr);
+        length = std::exchange(other.length, 0);
+        opened = std::exchange(other.opened, false);
+#if defined(_WIN32)
+        fileHandle = std::exchange(other.fileHandle, nullptr);
+        mappingHandle = std::exchange(other.mappingHandle, nullptr);
+#endif
+    }
+    return *this;
+}
+
+#if defined(_WIN32)
+
+bool MappedFile::open(const std::string &filePath)
+{
+    close();
+    path = filePath;
+
+    HANDLE file = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        std::cerr << "Failed to open " << filePath << " (error " << GetLastError() << ")" << std::endl;
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize))
+    {
+        std::cerr << "Failed to get the size of " << filePath << " (error " << GetLastError() << ")" << std::endl;
+        CloseHandle(file);
+        return false;
+    }
+    fileHandle = file;
+    length = static_cast<size_t>(fileSize.QuadPart);
+    opened = true;
+    if (length == 0)
+    {
+        // Zero-length files can't be mapped
+        return true;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    const void *view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view)
+    {
+        std::cerr << "Failed to map " << filePath << " (error " << GetLastError() << ")" << std::endl;
+        if (mapping)
+            CloseHandle(mapping);
+        close();
+        return false;
+    }
+    mappingHandle = mapping;
+    bytes = static_cast<const char *>(view);
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (bytes)
+        UnmapViewOfFile(bytes);
+    if (mappingHandle)
+        CloseHandle(mappingHandle);
+    if (fileHandle)
+        CloseHandle(fileHandle);
+    bytes = nullptr;
+    mappingHandle = fileHandle = nullptr;
+    length = 0;
+    opened = false;
+}
+
+void MappedFile::advise(Access) const
+{
+    // No per-mapping access hints on Windows; the cache manager detects sequential reads itself
+}
+
+void MappedFile::willNeed(size_t offset, size_t count) const
+{
+    if (!bytes || offset >= length)
+        return;
+    WIN32_MEMORY_RANGE_ENTRY range;
+    range.VirtualAddress = const_cast<char *>(bytes + offset);
+    range.NumberOfBytes = std::min(count, length - offset);
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+
+#else
+
+bool MappedFile::open(const std::string &filePath)
+{
+    close();
+    path = filePath;
+
+    int descriptor = ::open(filePath.c_str(), O_RDONLY);
+    if (descriptor < 0)
+    {
+        std::cerr << "Failed to open " << filePath << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    struct stat status;
+    if (fstat(descriptor, &status) != 0)
+    {
+        std::cerr << "Failed to get the size of " << filePath << ": " << std::strerror(errno) << std::endl;
+        ::close(descriptor);
+        return false;
+    }
+    length = static_cast<size_t>(status.st_size);
+    opened = true;
+    if (length == 0)
+    {
+        // Zero-length files can't be mapped
+        ::close(descriptor);
+        return true;
+    }
+
+    void *view = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    // The mapping keeps the file referenced
+    ::close(descriptor);
+    if (view == MAP_FAILED)
+    {
+        std::cerr << "Failed to map " << filePath << ": " << std::strerror(errno) << std::endl;
+        length = 0;
+        opened = false;
+        return false;
+    }
+    bytes = static_cast<const char *>(view);
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (bytes)
+    {
+        munmap(const_cast<char *>(bytes), length);
+    }
+    bytes = nullptr;
+    length = 0;
+    opened = false;
+}
+
+void MappedFile::advise(Access access) const
+{
+    if (!bytes)
+        return;
+    int advice = access == Access::Sequential ? MADV_SEQUENTIAL : access == Access::Random ? MADV_RANDOM : MADV_NORMAL;
+    madvise(const_cast<char *>(bytes), length, advice);
+}
+
+void MappedFile::willNeed(size_t offset, size_t count) const
+{
+    if (!bytes || offset >= length)
+        return;
+    // madvise wants a page-aligned start
+    size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t start = offset - offset % pageSize;
+    size_t end = std::min(offset + count, length);
+    madvise(const_cast<char *>(bytes + start), end - start, MADV_WILLNEED);
+}
+
+#endif
@@ -0,0 +1,100 @@
+#include "mesh_cache.h"
+
+const MeshCache::Mesh *MeshCache::find(const std::string &key, uint64_t version) const
+{
+    auto it = meshes.find(key);
+    if (it == meshes.end() || it->second.version != version)
+    {
+        return nullptr;
+    }
+    return &it->second;
+}
+
+const MeshCache::Mesh &MeshCache::upload(const std::string &key, uint64_t version,
+                                         const float *vertices, int vertexCount, int stride,
+                                         std::initializer_list<Attribute> layout)
+{
+    auto it = meshes.find(key);
+    bool created = false;
+    if (it == meshes.end())
+    {
+        it = meshes.emplace(key, Mesh{}).first;
+        created = true;
+    }
+
+    Mesh &mesh = it->second;
+    if (!created && mesh.version == version)
+    {
+        return mesh;
+    }
+
+    size_t bytes = static_cast<size_t>(vertexCount) * stride * sizeof(float);
+
+    // Direct state access: uploads never disturb the bound VAO or buffers
+    if (created)
+    {
+        glCreateVertexArrays(1, &mesh.vao);
+        glCreateBuffers(1, &mesh.vbo);
+
+        glVertexArrayVertexBuffer(mesh.vao, 0, mesh.vbo, 0, stride * sizeof(float));
+        for (const Attribute &attribute : layout)
+        {
+            glEnableVertexArrayAttrib(mesh.vao, attribute.location);
+            glVertexArrayAttribFormat(mesh.vao, attribute.location, attribute.components, GL_FLOAT, GL_FALSE,
+                                      attribute.offset * sizeof(float));
+            glVertexArrayAttribBinding(mesh.vao, attribute.location, 0);
+        }
+    }
+
+    if (bytes > mesh.capacityBytes)
+    {
+        // Grow the storage; geometry that changed once is likely to change again
+        glNamedBufferData(mesh.vbo, bytes, vertices, created ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW);
+        mesh.capacityBytes = bytes;
+    }
+    else if (bytes > 0)
+    {
+        // Reuse the existing storage
+        glNamedBufferSubData(mesh.vbo, 0, bytes, vertices);
+    }
+
+    mesh.vertexCount = vertexCount;
+    mesh.version = version;
+    uploadCount++;
+    return mesh;
+}
+
+void MeshCache::release(const std::string &key)
+{
+    auto it = meshes.find(key);
+    if (it == meshes.end())
+    {
+        return;
+    }
+    glDeleteVertexArrays(1, &it->second.vao);
+    glDeleteBuffers(1, &it->second.vbo);
+    meshes.erase(it);
+}
+
+void MeshCache::clear()
+{
+    for (auto &pair : meshes)
+    {
+        glDeleteVertexArrays(1, &pair.second.vao);
+        glDeleteBuffers(1, &pair.second.vbo);
+    }
+    meshes.clear();
+}
+
+uint64_t MeshCache::hashContent(const void *data, size_t bytes, uint64_t seed)
+{
+    // FNV-1a, plenty for a few hundred bytes of line vertices
+    const unsigned char *p = static_cast<const unsigned char *>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < bytes; ++i)
+    {
+        hash ^= p[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
@@ -0,0 +1,166 @@
+#include "molecule_io.h"
+#include "bond_perception.h"
+#include "dcd_trajectory.h"
+#include "elements.h"
+#include "gromacs_trajectory.h"
+#include "structure_cache.h"
+#include "structure_reader.h"
+#include "xyz_trajectory.h"
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <limits>
+#include <iostream>
+
+namespace {
+
+std::string lowercaseExtension(const std::string &path)
+{
+    size_t dot = path.find_last_of('.');
+    size_t slash = path.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+    {
+        return "";
+    }
+    std::string extension = path.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return extension;
+}
+
+std::string fileStem(const std::string &path)
+{
+    size_t slash = path.find_last_of("/\\");
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+    size_t dot = name.find_last_of('.');
+    return dot == std::string::npos || dot == 0 ? name : name.substr(0, dot);
+}
+
+} // namespace
+
+bool readXyz(const std::string &path, Molecule &molecule)
+{
+    XyzTrajectory trajectory;
+    return trajectory.open(path, 1) && trajectory.readFrame(0, molecule);
+}
+
+bool loadMolecule(const std::string &path, Molecule &molecule, XyzTrajectory *trajectory, LoadProgress *progress)
+{
+    std::string extension = lowercaseExtension(path);
+    if (trajectory)
+    {
+        trajectory->close();
+    }
+    bool xyz = extension == "xyz" || extension == "extxyz";
+    bool pdb = extension == "pdb" || extension == "ent";
+    bool mmcif = extension == "cif" || extension == "mmcif";
+    if (!xyz && !pdb && !mmcif)
+    {
+        std::cerr << "Unsupported file format: " << path << std::endl;
+        return false;
+    }
+
+    // Large structures come from the binary cache next to the file when it is current
+    std::error_code error;
+    uint64_t fileBytes = std::filesystem::file_size(path, error);
+    bool cacheable = !error && fileBytes >= STRUCTURE_CACHE_MIN_FILE_BYTES;
+    if (progress)
+    {
+        progress->begin(LoadProgress::Stage::Map);
+    }
+    bool cached = cacheable && loadStructureCache(path, molecule);
+
+    bool loaded = false;
+    if (xyz && trajectory)
+    {
+        // The other frames stay reachable through the trajectory either way
+        loaded = trajectory->open(path, std::numeric_limits<size_t>::max(), progress);
+        if (loaded && !cached)
+        {
+            if (progress)
+            {
+                progress->begin(LoadProgress::Stage::Parse);
+            }
+            loaded = trajectory->readFrame(0, molecule);
+        }
+    }
+    else if (cached)
+    {
+        loaded = true;
+    }
+    else if (xyz)
+    {
+        loaded = readXyz(path, molecule);
+    }
+    else if (pdb)
+    {
+        loaded = readPdb(path, molecule, 0, progress);
+    }
+    else
+    {
+        loaded = readMmcif(path, molecule, 0, progress);
+    }
+    if (!loaded || (progress && progress->isCancelled()))
+    {
+        if (trajectory)
+        {
+            trajectory->close();
+        }
+        return false;
+    }
+
+    molecule.name = fileStem(path);
+    if (cached)
+    {
+        return true;
+    }
+    if (molecule.bonds.empty())
+    {
+        if (progress)
+        {
+            progress->begin(LoadProgress::Stage::Bonds);
+        }
+        perceiveBonds(molecule, progress);
+        if (progress && progress->isCancelled())
+        {
+            if (trajectory)
+            {
+                trajectory->close();
+            }
+            return false;
+        }
+    }
+    if (cacheable)
+    {
+        saveStructureCache(path, molecule);
+    }
+    return true;
+}
+
+std::unique_ptr<Trajectory> openTrajectory(const std::string &path)
+{
+    std::string extension = lowercaseExtension(path);
+    if (extension == "dcd")
+    {
+        auto trajectory = std::make_unique<DcdTrajectory>();
+        return trajectory->open(path) ? std::move(trajectory) : nullptr;
+    }
+    if (extension == "xtc")
+    {
+        auto trajectory = std::make_unique<XtcTrajectory>();
+        return trajectory->open(path) ? std::move(trajectory) : nullptr;
+    }
+    if (extension == "trr")
+    {
+        auto trajectory = std::make_unique<TrrTrajectory>();
+        return trajectory->open(path) ? std::move(trajectory) : nullptr;
+    }
+    std::cerr << "Unsupported trajectory format: " << path << std::endl;
+    return nullptr;
+}
+
+bool isTrajectoryFile(const std::string &path)
+{
+    std::string extension = lowercaseExtension(path);
+    return extension == "dcd" || extension == "xtc" || extension == "trr";
+}
@@ -0,0 +1,89 @@
+#include "molecule_loader.h"
+#include "cpu_profiler.h"
+#include "molecule_io.h"
+#include "xyz_trajectory.h"
+#include <iostream>
+
+MoleculeLoader::~MoleculeLoader()
+{
+    stop();
+}
+
+bool MoleculeLoader::start(const std::string &filePath)
+{
+    if (isRunning())
+    {
+        std::cerr << "Still loading " << path << std::endl;
+        return false;
+    }
+    if (thread.joinable())
+    {
+        thread.join();
+    }
+    {
+        std::lock_guard<std::mutex> lock(resultMutex);
+        result.reset();
+    }
+    path = filePath;
+    progress.reset();
+    running = true;
+    thread = std::thread([this, filePath]() {
+        PROFILE_THREAD("file loader");
+        std::unique_ptr<Result> loaded = load(filePath);
+        {
+            std::lock_guard<std::mutex> lock(resultMutex);
+            result = std::move(loaded);
+        }
+        running = false;
+        // Wake the UI to pick up the result
+        progress.update(1.0f);
+    });
+    return true;
+}
+
+void MoleculeLoader::cancel()
+{
+    progress.cancel();
+}
+
+void MoleculeLoader::stop()
+{
+    progress.cancel();
+    if (thread.joinable())
+    {
+        thread.join();
+    }
+}
+
+std::unique_ptr<MoleculeLoader::Result> MoleculeLoader::takeResult()
+{
+    std::lock_guard<std::mutex> lock(resultMutex);
+    return std::move(result);
+}
+
+std::unique_ptr<MoleculeLoader::Result> MoleculeLoader::load(const std::string &filePath)
+{
+    PROFILE_ZONE("load file");
+    auto loaded = std::make_unique<Result>();
+    loaded->path = filePath;
+    if (isTrajectoryFile(filePath))
+    {
+        // The readers index while opening; they report no fraction of their own
+        loaded->trajectoryOnly = true;
+        progress.begin(LoadProgress::Stage::Index);
+        loaded->trajectory = openTrajectory(filePath);
+        loaded->succeeded = loaded->trajectory != nullptr;
+    }
+    else
+    {
+        auto frames = std::make_unique<XyzTrajectory>();
+        loaded->succeeded = loadMolecule(filePath, loaded->molecule, frames.get(), &progress);
+        if (loaded->succeeded && frames->getFrameCount() > 1)
+        {
+            loaded->trajectory = std::move(frames);
+        }
+    }
+    loaded->cancelled = progress.isCancelled();
+    loaded->succeeded = loaded->succeeded && !loaded->cancelled;
+    return loaded;
+}
@@ -0,0 +1,136 @@
+#include "poster_renderer.h"
+#include "renderer.h"
+#include "cpu_profiler.h"
+#include "image_writer.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+void PosterRenderer::destroy()
+{
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteTextures(1, &colorTexture);
+    glDeleteTextures(1, &depthTexture);
+    framebuffer = colorTexture = depthTexture = 0;
+    targetWidth = targetHeight = 0;
+}
+
+void PosterRenderer::ensureTarget(int width, int height)
+{
+    if (width <= targetWidth && height <= targetHeight)
+    {
+        return;
+    }
+    destroy();
+    targetWidth = width;
+    targetHeight = height;
+
+    glCreateTextures(GL_TEXTURE_2D, 1, &colorTexture);
+    glTextureStorage2D(colorTexture, 1, GL_RGBA8, width, height);
+    glCreateTextures(GL_TEXTURE_2D, 1, &depthTexture);
+    glTextureStorage2D(depthTexture, 1, GL_DEPTH_COMPONENT24, width, height);
+
+    glCreateFramebuffers(1, &framebuffer);
+    glNamedFramebufferTexture(framebuffer, GL_COLOR_ATTACHMENT0, colorTexture, 0);
+    glNamedFramebufferTexture(framebuffer, GL_DEPTH_ATTACHMENT, depthTexture, 0);
+    if (glCheckNamedFramebufferStatus(framebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cerr << "Poster tile framebuffer is not complete (" << width << "x" << height << ")" << std::endl;
+    }
+}
+
+bool PosterRenderer::render(Renderer &renderer, const UIRegion &region, const std::string &path,
+                            const PosterOptions &options)
+{
+    PROFILE_ZONE("renderPoster");
+
+    if (!renderer.hasMolecule())
+    {
+        std::cerr << "Nothing to render for a poster: no structure loaded" << std::endl;
+        return false;
+    }
+    if (options.width <= 0 || options.height <= 0)
+    {
+        std::cerr << "Invalid poster size " << options.width << "x" << options.height << std::endl;
+        return false;
+    }
+
+    // Tiles (with their guard band) must fit a texture and a viewport; queried once per poster
+    GLint maxTextureSize = 0;
+    GLint maxViewport[2] = {0, 0};
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+    glGetIntegerv(GL_MAX_VIEWPORT_DIMS, maxViewport);
+    int guard = std::max(0, options.guardBand);
+    int maxTile = std::min({maxTextureSize, maxViewport[0], maxViewport[1]}) - 2 * guard;
+    int tileWidth = std::clamp(options.tileWidth, 16, std::max(16, maxTile));
+    int tileHeight = std::clamp(options.tileHeight, 16, std::max(16, maxTile));
+    ensureTarget(tileWidth + 2 * guard, tileHeight + 2 * guard);
+
+    std::unique_ptr<ImageStreamWriter> writer = createImageWriter(path, options.compressionLevel);
+    if (TiffWriter *tiff = dynamic_cast<TiffWriter *>(writer.get()))
+    {
+        tiff->dotsPerInch = options.dotsPerInch;
+    }
+    if (!writer->open(path, options.width, options.height, 4))
+    {
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    int width = options.width;
+    int height = options.height;
+
+    // Two band buffers: one is encoded while the next renders. Bands hold rows bottom first, as GL packs them.
+    size_t bandBytes = static_cast<size_t>(width) * tileHeight * 4;
+    std::vector<uint8_t> bands[2] = {std::vector<uint8_t>(bandBytes), std::vector<uint8_t>(bandBytes)};
+    ThreadPool encoder(1, "poster encoder");
+    std::atomic<bool> encoded{true};
+
+    renderer.glState.bindFramebuffer(framebuffer);
+    glPixelStorei(GL_PACK_ROW_LENGTH, width);
+    int bandIndex = 0;
+    for (int top = 0; top < height && encoded; top += tileHeight, ++bandIndex)
+    {
+        int bandHeight = std::min(tileHeight, height - top);
+        int bandBottom = height - top - bandHeight; // In GL (bottom-up) image rows
+        std::vector<uint8_t> &band = bands[bandIndex % 2];
+
+        for (int left = 0; left < width; left += tileWidth)
+        {
+            int columns = std::min(tileWidth, width - left);
+
+            // Render the tile and its guard band, keep only the tile
+            renderer.glState.viewport(0, 0, columns + 2 * guard, bandHeight + 2 * guard);
+            renderer.renderRegionTile(region, width, height, left - guard, bandBottom - guard,
+                                      columns + 2 * guard, bandHeight + 2 * guard);
+            glGetTextureSubImage(colorTexture, 0, guard, guard, 0, columns, bandHeight, 1, GL_RGBA,
+                                 GL_UNSIGNED_BYTE, static_cast<GLsizei>(bandBytes - left * 4), band.data() + left * 4);
+        }
+
+        // Bands must reach the file in order: wait for the previous one, then hand this one over
+        encoder.waitIdle();
+        encoder.submit([&writer, &encoded, &band, width, bandHeight]() {
+            PROFILE_ZONE("poster band encode");
+            size_t rowBytes = static_cast<size_t>(width) * 4;
+            for (int y = bandHeight - 1; y >= 0 && encoded; --y)
+            {
+                encoded = writer->writeRows(band.data() + y * rowBytes, 1);
+            }
+        });
+    }
+    glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+    renderer.unbindFramebuffer();
+
+    encoder.waitIdle();
+    bool ok = writer->close() && encoded;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (ok)
+    {
+        std::cout << "Wrote " << width << "x" << height << " poster " << path << " in " << seconds << " s ("
+                  << bandIndex << " bands of " << tileWidth << "x" << tileHeight << " tiles)" << std::endl;
+    }
+    return ok;
+}
@@ -0,0 +1,872 @@
+#include "ray_tracer.h"
+#include "cpu_profiler.h"
+#include "elements.h"
+#include "image_writer.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <numeric>
+
+namespace {
+
+constexpr int MAX_LEAF_SIZE = 4;
+constexpr int SAH_BINS = 16;
+// Subtrees at least this large are built on their own thread
+constexpr uint32_t PARALLEL_BUILD_SIZE = 64 * 1024;
+constexpr int PARALLEL_BUILD_DEPTH = 6;
+// Past this depth the build splits at the median, which bounds the tree depth (and the traversal stack)
+constexpr int MEDIAN_SPLIT_DEPTH = 64;
+constexpr int TRAVERSAL_STACK_SIZE = 96;
+// Secondary rays start this far (Angstrom) off the surface so they don't hit it again
+constexpr float RAY_OFFSET = 1e-3f;
+
+// Shading weights, close to the impostor shaders' headlight model
+constexpr float AMBIENT = 0.35f;
+constexpr float DIFFUSE = 0.75f;
+constexpr float SPECULAR = 0.3f;
+constexpr float SHININESS = 32.0f;
+constexpr float PI = 3.14159265f;
+
+struct Sphere {
+    glm::vec3 center;
+    float radius;
+    uint32_t color;
+};
+
+struct Cylinder {
+    glm::vec3 start;
+    glm::vec3 end;
+    uint32_t startColor;
+    uint32_t endColor;
+};
+
+struct Aabb {
+    glm::vec3 min = glm::vec3(FLT_MAX);
+    glm::vec3 max = glm::vec3(-FLT_MAX);
+
+    void grow(const glm::vec3 &point)
+    {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+    void grow(const Aabb &box)
+    {
+        min = glm::min(min, box.min);
+        max = glm::max(max, box.max);
+    }
+    float area() const
+    {
+        glm::vec3 extent = max - min;
+        return extent.x < 0.0f ? 0.0f : extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+    }
+};
+
+// 32 bytes, two per cache line. Inner nodes have count 0 and their children at first, first + 1.
+struct BvhNode {
+    glm::vec3 min;
+    uint32_t first;
+    glm::vec3 max;
+    uint32_t count;
+};
+
+struct Ray {
+    glm::vec3 origin;
+    glm::vec3 direction;
+    glm::vec3 inverseDirection;
+    float tMin;
+    float tMax;
+
+    Ray(const glm::vec3 &origin, const glm::vec3 &direction, float tMin, float tMax)
+        : origin(origin), direction(direction), tMin(tMin), tMax(tMax)
+    {
+        // No infinities from axis-aligned directions (they would turn into NaN in the slab test)
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            float d = direction[axis];
+            inverseDirection[axis] = 1.0f / (std::fabs(d) > 1e-12f ? d : std::copysign(1e-12f, d));
+        }
+    }
+};
+
+struct Hit {
+    glm::vec3 normal;
+    uint32_t color;
+};
+
+// Per pixel and sample, so the image doesn't depend on which thread traced which tile
+struct Random {
+    uint32_t state;
+
+    static uint32_t hash(uint32_t x)
+    {
+        x ^= x >> 16;
+        x *= 0x7feb352du;
+        x ^= x >> 15;
+        x *= 0x846ca68bu;
+        x ^= x >> 16;
+        return x;
+    }
+
+    Random(uint32_t pixel, uint32_t sample) : state(hash(pixel ^ hash(sample + 0x9e3779b9u))) {}
+
+    float next()
+    {
+        state = state * 747796405u + 2891336453u;
+        return static_cast<float>(hash(state) >> 8) * (1.0f / 16777216.0f);
+    }
+};
+
+// Orthonormal basis around a unit vector (Duff et al. 2017)
+void buildBasis(const glm::vec3 &n, glm::vec3 &tangent, glm::vec3 &bitangent)
+{
+    float sign = std::copysign(1.0f, n.z);
+    float a = -1.0f / (sign + n.z);
+    float b = n.x * n.y * a;
+    tangent = glm::vec3(1.0f + sign * n.x * n.x * a, sign * b, -sign * n.x);
+    bitangent = glm::vec3(b, sign + n.y * n.y * a, -n.y);
+}
+
+glm::vec3 sampleCosineHemisphere(const glm::vec3 &normal, float u, float v)
+{
+    glm::vec3 tangent, bitangent;
+    buildBasis(normal, tangent, bitangent);
+    float r = std::sqrt(u);
+    float phi = 2.0f * PI * v;
+    return tangent * (r * std::cos(phi)) + bitangent * (r * std::sin(phi)) + normal * std::sqrt(1.0f - u);
+}
+
+glm::vec3 sampleCone(const glm::vec3 &axis, float cosMax, float u, float v)
+{
+    glm::vec3 tangent, bitangent;
+    buildBasis(axis, tangent, bitangent);
+    float cosTheta = 1.0f - u * (1.0f - cosMax);
+    float sinTheta = std::sqrt(std::max(0.0f, 1.0f - cosTheta * cosTheta));
+    float phi = 2.0f * PI * v;
+    return tangent * (sinTheta * std::cos(phi)) + bitangent * (sinTheta * std::sin(phi)) + axis * cosTheta;
+}
+
+// Atom spheres and bond cylinders of one structure, with the BVH over both
+class Geometry {
+public:
+    void build(const RayTraceScene &scene);
+
+    // Closest hit in (tMin, tMax); shortens ray.tMax to it
+    bool intersect(Ray &ray, Hit &hit) const;
+    // Any hit in (tMin, tMax)
+    bool occluded(const Ray &ray) const;
+
+    size_t getPrimitiveCount() const { return indices.size(); }
+
+private:
+    void buildNode(uint32_t nodeIndex, uint32_t first, uint32_t count, int depth);
+    void makeLeaf(BvhNode &node, const Aabb &bounds, uint32_t first, uint32_t count);
+    float intersectBox(const BvhNode &node, const Ray &ray, float tMax) const;
+    // Intersect primitive `index`; on a hit closer than `tMax` returns its distance, otherwise tMax
+    float intersectPrimitive(uint32_t index, const Ray &ray, float tMax, Hit *hit) const;
+
+    std::vector<Sphere> spheres;
+    std::vector<Cylinder> cylinders;
+    float bondRadius = 0.0f;
+
+    // Primitive i < spheres.size() is a sphere, the rest are cylinders
+    std::vector<uint32_t> indices;
+    std::vector<BvhNode> nodes;
+    std::atomic<uint32_t> nodeCount{0};
+
+    // Build inputs only
+    std::vector<Aabb> primitiveBounds;
+    std::vector<glm::vec3> centroids;
+};
+
+void Geometry::build(const RayTraceScene &scene)
+{
+    PROFILE_ZONE("ray tracer BVH build");
+    const Molecule &molecule = scene.molecule;
+    uint32_t paletteSize = static_cast<uint32_t>(std::max<size_t>(scene.palette.size(), 1));
+    auto colorOf = [&](uint32_t atom) -> uint32_t {
+        uint32_t element = atom < molecule.elements.size() ? molecule.elements[atom] : 0;
+        return element < paletteSize ? element : 0;
+    };
+
+    if (scene.atomRadiusScale > 0.0f)
+    {
+        spheres.resize(molecule.getAtomCount());
+        for (uint32_t i = 0; i < spheres.size(); ++i)
+        {
+            int element = i < molecule.elements.size() ? molecule.elements[i] : 0;
+            spheres[i] = {glm::vec3(molecule.positions[i]), getElementInfo(element).vdwRadius * scene.atomRadiusScale,
+                          colorOf(i)};
+        }
+    }
+    if (scene.bondRadius > 0.0f)
+    {
+        bondRadius = scene.bondRadius;
+        cylinders.reserve(molecule.getBondCount());
+        for (size_t i = 0; i + 1 < molecule.bonds.size(); i += 2)
+        {
+            uint32_t a = molecule.bonds[i], b = molecule.bonds[i + 1];
+            if (a < molecule.getAtomCount() && b < molecule.getAtomCount() && a != b)
+            {
+                cylinders.push_back({glm::vec3(molecule.positions[a]), glm::vec3(molecule.positions[b]), colorOf(a),
+                                     colorOf(b)});
+            }
+        }
+    }
+
+    uint32_t primitiveCount = static_cast<uint32_t>(spheres.size() + cylinders.size());
+    primitiveBounds.resize(primitiveCount);
+    centroids.resize(primitiveCount);
+    for (uint32_t i = 0; i < spheres.size(); ++i)
+    {
+        const Sphere &sphere = spheres[i];
+        primitiveBounds[i] = {sphere.center - glm::vec3(sphere.radius), sphere.center + glm::vec3(sphere.radius)};
+        centroids[i] = sphere.center;
+    }
+    uint32_t sphereCount = static_cast<uint32_t>(spheres.size());
+    for (uint32_t i = 0; i < cylinders.size(); ++i)
+    {
+        // Exact box of a capped cylinder: the cap disks extend r * sqrt(1 - axis_i^2) along each axis
+        const Cylinder &cylinder = cylinders[i];
+        glm::vec3 axis = cylinder.end - cylinder.start;
+        glm::vec3 axisSq = axis * axis / std::max(glm::dot(axis, axis), 1e-12f);
+        glm::vec3 extent(bondRadius * std::sqrt(std::max(0.0f, 1.0f - axisSq.x)),
+                         bondRadius * std::sqrt(std::max(0.0f, 1.0f - axisSq.y)),
+                         bondRadius * std::sqrt(std::max(0.0f, 1.0f - axisSq.z)));
+        Aabb &box = primitiveBounds[sphereCount + i];
+        box.min = glm::min(cylinder.start, cylinder.end) - extent;
+        box.max = glm::max(cylinder.start, cylinder.end) + extent;
+        centroids[sphereCount + i] = (cylinder.start + cylinder.end) * 0.5f;
+    }
+
+    indices.resize(primitiveCount);
+    std::iota(indices.begin(), indices.end(), 0u);
+    if (primitiveCount > 0)
+    {
+        // A binary tree with single-primitive leaves has 2n - 1 nodes; the SAH build uses fewer
+        nodes.resize(2 * static_cast<size_t>(primitiveCount) - 1);
+        nodeCount = 1;
+        buildNode(0, 0, primitiveCount, 0);
+        nodes.resize(nodeCount);
+        nodes.shrink_to_fit();
+    }
+
+    primitiveBounds = std::vector<Aabb>();
+    centroids = std::vector<glm::vec3>();
+}
+
+void Geometry::makeLeaf(BvhNode &node, const Aabb &bounds, uint32_t first, uint32_t count)
+{
+    node.min = bounds.min;
+    node.max = bounds.max;
+    node.first = first;
+    node.count = count;
+}
+
+void Geometry::buildNode(uint32_t nodeIndex, uint32_t first, uint32_t count, int depth)
+{
+    BvhNode &node = nodes[nodeIndex];
+    Aabb bounds, centroidBounds;
+    for (uint32_t i = first; i < first + count; ++i)
+    {
+        bounds.grow(primitiveBounds[indices[i]]);
+        centroidBounds.grow(centroids[indices[i]]);
+    }
+    if (count <= MAX_LEAF_SIZE)
+    {
+        makeLeaf(node, bounds, first, count);
+        return;
+    }
+
+    glm::vec3 extent = centroidBounds.max - centroidBounds.min;
+    int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+    uint32_t middle = first + count / 2;
+    auto begin = indices.begin() + first;
+    auto end = begin + count;
+
+    if (extent[axis] > 0.0f && depth < MEDIAN_SPLIT_DEPTH)
+    {
+        // Binned SAH: bin the centroids along the widest axis, pick the cheapest bin boundary
+        float scale = SAH_BINS / extent[axis];
+        float origin = centroidBounds.min[axis];
+        auto binOf = [&](uint32_t primitive) {
+            return std::min(SAH_BINS - 1, static_cast<int>((centroids[primitive][axis] - origin) * scale));
+        };
+
+        Aabb binBounds[SAH_BINS];
+        uint32_t binCounts[SAH_BINS] = {};
+        for (uint32_t i = first; i < first + count; ++i)
+        {
+            int bin = binOf(indices[i]);
+            binCounts[bin]++;
+            binBounds[bin].grow(primitiveBounds[indices[i]]);
+        }
+
+        float leftCost[SAH_BINS - 1];
+        Aabb accumulated;
+        uint32_t accumulatedCount = 0;
+        for (int split = 0; split < SAH_BINS - 1; ++split)
+        {
+            accumulated.grow(binBounds[split]);
+            accumulatedCount += binCounts[split];
+            leftCost[split] = accumulated.area() * accumulatedCount;
+        }
+        accumulated = Aabb();
+        accumulatedCount = 0;
+        float bestCost = FLT_MAX;
+        int bestSplit = -1;
+        for (int split = SAH_BINS - 1; split > 0; --split)
+        {
+            accumulated.grow(binBounds[split]);
+            accumulatedCount += binCounts[split];
+            float cost = leftCost[split - 1] + accumulated.area() * accumulatedCount;
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestSplit = split;
+            }
+        }
+
+        // Small nodes stay leaves when splitting wouldn't make rays cheaper
+        if (count <= 4 * MAX_LEAF_SIZE && bestCost >= bounds.area() * count)
+        {
+            makeLeaf(node, bounds, first, count);
+            return;
+        }
+        middle = static_cast<uint32_t>(
+            std::partition(begin, end, [&](uint32_t primitive) { return binOf(primitive) < bestSplit; }) -
+            indices.begin());
+    }
+    if (middle == first || middle == first + count)
+    {
+        // Coincident centroids or a degenerate SAH split: halve at the median
+        middle = first + count / 2;
+        std::nth_element(begin, indices.begin() + middle, end, [&](uint32_t a, uint32_t b) {
+            return centroids[a][axis] < centroids[b][axis];
+        });
+    }
+
+    uint32_t children = nodeCount.fetch_add(2, std::memory_order_relaxed);
+    node.min = bounds.min;
+    node.max = bounds.max;
+    node.first = children;
+    node.count = 0;
+
+    // The top of the tree fans out over threads; subtrees write disjoint nodes and index ranges
+    if (count >= PARALLEL_BUILD_SIZE && depth < PARALLEL_BUILD_DEPTH)
+    {
+        std::future<void> left = std::async(std::launch::async, [this, children, first, middle, depth]() {
+            buildNode(children, first, middle - first, depth + 1);
+        });
+        buildNode(children + 1, middle, first + count - middle, depth + 1);
+        left.get();
+    }
+    else
+    {
+        buildNode(children, first, middle - first, depth + 1);
+        buildNode(children + 1, middle, first + count - middle, depth + 1);
+    }
+}
+
+float Geometry::intersectBox(const BvhNode &node, const Ray &ray, float tMax) const
+{
+    glm::vec3 t0 = (node.min - ray.origin) * ray.inverseDirection;
+    glm::vec3 t1 = (node.max - ray.origin) * ray.inverseDirection;
+    glm::vec3 tNear = glm::min(t0, t1);
+    glm::vec3 tFar = glm::max(t0, t1);
+    float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, ray.tMin));
+    float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, tMax));
+    return enter <= exit ? enter : FLT_MAX;
+}
+
+float Geometry::intersectPrimitive(uint32_t index, const Ray &ray, float tMax, Hit *hit) const
+{
+    if (index < spheres.size())
+    {
+        const Sphere &sphere = spheres[index];
+        glm::vec3 offset = ray.origin - sphere.center;
+        float b = glm::dot(offset, ray.direction);
+        float discriminant = b * b - glm::dot(offset, offset) + sphere.radius * sphere.radius;
+        if (discriminant < 0.0f)
+        {
+            return tMax;
+        }
+        float root = std::sqrt(discriminant);
+        float t = -b - root;
+        if (t <= ray.tMin)
+        {
+            t = -b + root;
+        }
+        if (t <= ray.tMin || t >= tMax)
+        {
+            return tMax;
+        }
+        if (hit)
+        {
+            hit->normal = (offset + ray.direction * t) / sphere.radius;
+            hit->color = sphere.color;
+        }
+        return t;
+    }
+
+    // Capped cylinder, as in the bond impostor shader (positions along the axis scaled by |axis|^2)
+    const Cylinder &cylinder = cylinders[index - spheres.size()];
+    glm::vec3 axis = cylinder.end - cylinder.start;
+    glm::vec3 offset = ray.origin - cylinder.start;
+    float axisLengthSq = glm::dot(axis, axis);
+    float axisDotRay = glm::dot(axis, ray.direction);
+    float axisDotOffset = glm::dot(axis, offset);
+
+    float k2 = axisLengthSq - axisDotRay * axisDotRay;
+    float k1 = axisLengthSq * glm::dot(offset, ray.direction) - axisDotOffset * axisDotRay;
+    float k0 = axisLengthSq * glm::dot(offset, offset) - axisDotOffset * axisDotOffset -
+               bondRadius * bondRadius * axisLengthSq;
+    float h = k1 * k1 - k2 * k0;
+    if (h < 0.0f)
+    {
+        return tMax;
+    }
+    h = std::sqrt(h);
+
+    float t = (-k1 - h) / k2;
+    float y = axisDotOffset + t * axisDotRay;
+    glm::vec3 normal;
+    if (y > 0.0f && y < axisLengthSq)
+    {
+        normal = (offset + ray.direction * t - axis * (y / axisLengthSq)) / bondRadius;
+    }
+    else
+    {
+        // One of the flat caps
+        t = ((y < 0.0f ? 0.0f : axisLengthSq) - axisDotOffset) / axisDotRay;
+        if (std::fabs(k1 + k2 * t) >= h)
+        {
+            return tMax;
+        }
+        y = std::clamp(y, 0.0f, axisLengthSq);
+        normal = axis * ((y < 0.5f * axisLengthSq ? -1.0f : 1.0f) / std::sqrt(axisLengthSq));
+    }
+    if (t <= ray.tMin || t >= tMax)
+    {
+        return tMax;
+    }
+    if (hit)
+    {
+        hit->normal = normal;
+        hit->color = y < 0.5f * axisLengthSq ? cylinder.startColor : cylinder.endColor;
+    }
+    return t;
+}
+
+bool Geometry::intersect(Ray &ray, Hit &hit) const
+{
+    if (nodes.empty() || intersectBox(nodes[0], ray, ray.tMax) == FLT_MAX)
+    {
+        return false;
+    }
+
+    bool found = false;
+    uint32_t stack[TRAVERSAL_STACK_SIZE];
+    int stackSize = 0;
+    uint32_t nodeIndex = 0;
+    while (true)
+    {
+        const BvhNode &node = nodes[nodeIndex];
+        if (node.count > 0)
+        {
+            for (uint32_t i = node.first; i < node.first + node.count; ++i)
+            {
+                float t = intersectPrimitive(indices[i], ray, ray.tMax, &hit);
+                if (t < ray.tMax)
+                {
+                    ray.tMax = t;
+                    found = true;
+                }
+            }
+        }
+        else
+        {
+            // Nearer child first; the farther one is revisited only if it still starts before the closest hit
+            float nearT = intersectBox(nodes[node.first], ray, ray.tMax);
+            float farT = intersectBox(nodes[node.first + 1], ray, ray.tMax);
+            uint32_t nearChild = node.first, farChild = node.first + 1;
+            if (farT < nearT)
+            {
+                std::swap(nearT, farT);
+                std::swap(nearChild, farChild);
+            }
+            if (nearT != FLT_MAX)
+            {
+                if (farT != FLT_MAX)
+                {
+                    stack[stackSize++] = farChild;
+                }
+                nodeIndex = nearChild;
+                continue;
+            }
+        }
+
+        // Pop the next subtree that can still hold a closer hit
+        bool next = false;
+        while (stackSize > 0 && !next)
+        {
+            nodeIndex = stack[--stackSize];
+            next = intersectBox(nodes[nodeIndex], ray, ray.tMax) != FLT_MAX;
+        }
+        if (!next)
+        {
+            return found;
+        }
+    }
+}
+
+bool Geometry::occluded(const Ray &ray) const
+{
+    if (nodes.empty())
+    {
+        return false;
+    }
+
+    uint32_t stack[TRAVERSAL_STACK_SIZE];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0)
+    {
+        const BvhNode &node = nodes[stack[--stackSize]];
+        if (intersectBox(node, ray, ray.tMax) == FLT_MAX)
+        {
+            continue;
+        }
+        if (node.count > 0)
+        {
+            for (uint32_t i = node.first; i < node.first + node.count; ++i)
+            {
+                if (intersectPrimitive(indices[i], ray, ray.tMax, nullptr) < ray.tMax)
+                {
+                    return true;
+                }
+            }
+        }
+        else
+        {
+            stack[stackSize++] = node.first + 1;
+            stack[stackSize++] = node.first;
+        }
+    }
+    return false;
+}
+
+// A worker's share of the tiles; once its own share is done it takes from the others'
+struct alignas(64) TileQueue {
+    std::atomic<int> next{0};
+    int end = 0;
+};
+
+} // namespace
+
+RayTracer::~RayTracer()
+{
+    cancel();
+}
+
+bool RayTracer::render(const RayTraceScene &scene, const RayTraceOptions &options, const std::string &path)
+{
+    if (isRunning())
+    {
+        std::cerr << "A ray traced image is already being rendered" << std::endl;
+        return false;
+    }
+    if (thread.joinable())
+    {
+        thread.join();
+    }
+    {
+        std::lock_guard<std::mutex> lock(progressMutex);
+        progress = Progress();
+        progress.running = true;
+        progress.samples = options.samples;
+        progress.path = path;
+    }
+    cancelRequested = false;
+    bool ok = run(scene, options, path);
+    {
+        std::lock_guard<std::mutex> lock(progressMutex);
+        progress.running = false;
+        progress.succeeded = ok;
+    }
+    return ok;
+}
+
+bool RayTracer::start(RayTraceScene scene, const RayTraceOptions &options, const std::string &path)
+{
+    if (isRunning())
+    {
+        std::cerr << "A ray traced image is already being rendered" << std::endl;
+        return false;
+    }
+    if (thread.joinable())
+    {
+        thread.join();
+    }
+    {
+        std::lock_guard<std::mutex> lock(progressMutex);
+        progress = Progress();
+        progress.running = true;
+        progress.samples = options.samples;
+        progress.path = path;
+    }
+    cancelRequested = false;
+    thread = std::thread([this, scene = std::move(scene), options, path]() {
+        PROFILE_THREAD("ray tracer");
+        bool ok = run(scene, options, path);
+        {
+            std::lock_guard<std::mutex> lock(progressMutex);
+            progress.running = false;
+            progress.succeeded = ok;
+        }
+        if (onProgress)
+        {
+            onProgress();
+        }
+    });
+    return true;
+}
+
+void RayTracer::cancel()
+{
+    cancelRequested = true;
+    if (thread.joinable())
+    {
+        thread.join();
+    }
+}
+
+bool RayTracer::isRunning() const
+{
+    std::lock_guard<std::mutex> lock(progressMutex);
+    return progress.running;
+}
+
+RayTracer::Progress RayTracer::getProgress() const
+{
+    std::lock_guard<std::mutex> lock(progressMutex);
+    return progress;
+}
+
+void RayTracer::reportProgress(int samplesDone, float seconds)
+{
+    {
+        std::lock_guard<std::mutex> lock(progressMutex);
+        progress.samplesDone = samplesDone;
+        progress.seconds = seconds;
+    }
+    if (onProgress)
+    {
+        onProgress();
+    }
+}
+
+bool RayTracer::run(const RayTraceScene &scene, const RayTraceOptions &options, const std::string &path)
+{
+    PROFILE_ZONE("ray trace");
+    int width = options.width;
+    int height = options.height;
+    if (width <= 0 || height <= 0 || options.samples <= 0)
+    {
+        std::cerr << "Invalid ray tracing size " << width << "x" << height << " or sample count " << options.samples
+                  << std::endl;
+        return false;
+    }
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed = [&start]() {
+        return std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    Geometry geometry;
+    geometry.build(scene);
+    float buildSeconds = elapsed();
+
+    std::vector<glm::vec3> palette(std::max<size_t>(scene.palette.size(), 1), glm::vec3(1.0f));
+    for (size_t i = 0; i < scene.palette.size(); ++i)
+    {
+        palette[i] = glm::vec3(scene.palette[i]);
+    }
+
+    // Same eye, orientation and field of view as the GL view (Camera::getViewMatrix)
+    const Camera &camera = scene.camera;
+    glm::vec3 eye = camera.getPosition();
+    glm::vec3 forward = glm::normalize(camera.target - eye);
+    glm::vec3 right = glm::normalize(glm::cross(forward, glm::vec3(0.0f, 1.0f, 0.0f)));
+    glm::vec3 up = glm::cross(right, forward);
+    float tanHalfFov = std::tan(camera.fovY * 0.5f);
+    float aspect = static_cast<float>(width) / height;
+
+    // Key light above and to the left of the viewer, so it moves with the camera like the headlight
+    glm::vec3 lightDirection = glm::normalize(right * -0.4f + up * 0.6f - forward * 0.7f);
+    float cosLightAngle = std::cos(std::clamp(options.lightAngle, 0.0f, 0.5f * PI));
+    int aoSamples = std::max(0, options.aoSamples);
+
+    int tileSize = std::max(8, options.tileSize);
+    int tilesX = (width + tileSize - 1) / tileSize;
+    int tilesY = (height + tileSize - 1) / tileSize;
+    int tileCount = tilesX * tilesY;
+    std::vector<glm::vec3> accumulation(static_cast<size_t>(width) * height, glm::vec3(0.0f));
+
+    auto traceTile = [&](int tile, uint32_t sample) {
+        int x0 = (tile % tilesX) * tileSize;
+        int y0 = (tile / tilesX) * tileSize;
+        int x1 = std::min(x0 + tileSize, width);
+        int y1 = std::min(y0 + tileSize, height);
+        for (int y = y0; y < y1; ++y)
+        {
+            for (int x = x0; x < x1; ++x)
+            {
+                size_t pixel = static_cast<size_t>(y) * width + x;
+                Random random(static_cast<uint32_t>(pixel), sample);
+
+                // Jittered position in the pixel; rows count from the top of the image
+                float ndcX = 2.0f * (x + random.next()) / width - 1.0f;
+                float ndcY = 1.0f - 2.0f * (y + random.next()) / height;
+                glm::vec3 direction =
+                    glm::normalize(forward + right * (ndcX * tanHalfFov * aspect) + up * (ndcY * tanHalfFov));
+
+                // Clip at the camera's near and far planes, as GL does
+                float depthScale = 1.0f / glm::dot(direction, forward);
+                Ray ray(eye, direction, camera.nearPlane * depthScale, camera.farPlane * depthScale);
+                Hit hit;
+                if (!geometry.intersect(ray, hit))
+                {
+                    accumulation[pixel] += scene.background;
+                    continue;
+                }
+
+                glm::vec3 normal = hit.normal;
+                if (glm::dot(normal, direction) > 0.0f)
+                {
+                    normal = -normal;
+                }
+                glm::vec3 surface = eye + direction * ray.tMax + normal * RAY_OFFSET;
+
+                // Soft shadow: one direction within the light's cone per sample
+                glm::vec3 toLight = sampleCone(lightDirection, cosLightAngle, random.next(), random.next());
+                float diffuse = glm::dot(normal, toLight);
+                float specular = 0.0f;
+                if (diffuse > 0.0f && !geometry.occluded(Ray(surface, toLight, 0.0f, FLT_MAX)))
+                {
+                    glm::vec3 halfway = glm::normalize(toLight - direction);
+                    specular = std::pow(std::max(glm::dot(normal, halfway), 0.0f), SHININESS);
+                }
+                else
+                {
+                    diffuse = 0.0f;
+                }
+
+                // Ambient occlusion: fraction of cosine-weighted rays escaping within aoDistance
+                float ambient = 1.0f;
+                if (aoSamples > 0)
+                {
+                    int open = 0;
+                    for (int i = 0; i < aoSamples; ++i)
+                    {
+                        glm::vec3 aoDirection = sampleCosineHemisphere(normal, random.next(), random.next());
+                        open += !geometry.occluded(Ray(surface, aoDirection, 0.0f, options.aoDistance));
+                    }
+                    ambient = static_cast<float>(open) / aoSamples;
+                }
+
+                accumulation[pixel] += palette[hit.color] * (AMBIENT * ambient + DIFFUSE * diffuse) +
+                                       glm::vec3(SPECULAR * specular);
+            }
+        }
+    };
+
+    // Contiguous shares keep each worker in one part of the image (and of the BVH)
+    ThreadPool workers(options.threadCount, "ray tracer");
+    size_t workerCount = workers.getThreadCount();
+    std::unique_ptr<TileQueue[]> queues(new TileQueue[workerCount]);
+
+    int samplesDone = 0;
+    while (samplesDone < options.samples && !cancelRequested)
+    {
+        PROFILE_ZONE("ray trace pass");
+        for (size_t i = 0; i < workerCount; ++i)
+        {
+            queues[i].next.store(static_cast<int>(tileCount * i / workerCount), std::memory_order_relaxed);
+            queues[i].end = static_cast<int>(tileCount * (i + 1) / workerCount);
+        }
+        uint32_t sample = static_cast<uint32_t>(samplesDone);
+        for (size_t worker = 0; worker < workerCount; ++worker)
+        {
+            workers.submit([&, worker, sample]() {
+                PROFILE_ZONE("ray trace tiles");
+                for (size_t offset = 0; offset < workerCount && !cancelRequested; ++offset)
+                {
+                    TileQueue &queue = queues[(worker + offset) % workerCount];
+                    for (int tile = queue.next.fetch_add(1, std::memory_order_relaxed);
+                         tile < queue.end && !cancelRequested;
+                         tile = queue.next.fetch_add(1, std::memory_order_relaxed))
+                    {
+                        traceTile(tile, sample);
+                    }
+                }
+            });
+        }
+        workers.waitIdle();
+        if (cancelRequested)
+        {
+            break;
+        }
+
+        samplesDone++;
+        reportProgress(samplesDone, elapsed());
+        if (options.timeLimit > 0.0f && elapsed() >= options.timeLimit)
+        {
+            break;
+        }
+    }
+    if (cancelRequested)
+    {
+        std::cout << "Ray tracing " << path << " cancelled" << std::endl;
+        return false;
+    }
+
+    // Average the samples and stream the rows out
+    std::unique_ptr<ImageStreamWriter> writer = createImageWriter(path, options.compressionLevel);
+    if (TiffWriter *tiff = dynamic_cast<TiffWriter *>(writer.get()))
+    {
+        tiff->dotsPerInch = options.dotsPerInch;
+    }
+    if (!writer->open(path, width, height, 4))
+    {
+        return false;
+    }
+    float weight = 1.0f / samplesDone;
+    std::vector<uint8_t> row(static_cast<size_t>(width) * 4);
+    bool ok = true;
+    for (int y = 0; y < height && ok; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            glm::vec3 color = glm::clamp(accumulation[static_cast<size_t>(y) * width + x] * weight, 0.0f, 1.0f);
+            row[x * 4 + 0] = static_cast<uint8_t>(color.r * 255.0f + 0.5f);
+            row[x * 4 + 1] = static_cast<uint8_t>(color.g * 255.0f + 0.5f);
+            row[x * 4 + 2] = static_cast<uint8_t>(color.b * 255.0f + 0.5f);
+            row[x * 4 + 3] = 255;
+        }
+        ok = writer->writeRows(row.data(), 1);
+    }
+    ok = writer->close() && ok;
+
+    if (ok)
+    {
+        std::cout << "Ray traced " << width << "x" << height << " image " << path << ": " << samplesDone
+                  << " samples in " << elapsed() << " s (BVH over " << geometry.getPrimitiveCount() << " primitives in "
+                  << buildSeconds << " s, " << workerCount << " threads)" << std::endl;
+    }
+    return ok;
+}
@@ -1,17 +1,12 @@
 #include "renderer.h"
 #include "ui_manager.h"
+#include "cpu_profiler.h"
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <iterator>
 #include <glm/gtc/type_ptr.hpp>
 
-// Forward declaration of AppData
-struct AppData
-{
-    class UIManager *uiManager;
-    class Renderer *renderer;
-    class ImGuiManager *imguiManager;
-    bool mousePressed = false;
-};
-
 // Basic vertex shader
 const char* basicVertexShaderSource = R"(
     #version 460 core
@@ -62,18 +57,21 @@ const char* triangleFragmentShaderSource = R"(
     } 
 )";
 
-// Framebuffer vertex shader
+// Framebuffer vertex shader: one quad per region, all regions in one draw
 const char *framebufferVertexShaderSource = R"(
     #version 460 core
-    layout (location = 0) in vec3 aPos;
-    layout (location = 1) in vec2 aTexCoord;
-    
+    layout (location = 0) in vec2 aPos;      // Normalized device coordinates
+    layout (location = 1) in vec2 aTexCoord; // Already scaled to the region's corner of its layer
+    layout (location = 2) in float aLayer;
+
     out vec2 TexCoord;
-    
+    flat out float Layer;
+
     void main()
     {
-        gl_Position = vec4(aPos, 1.0);
+        gl_Position = vec4(aPos, 0.0, 1.0);
         TexCoord = aTexCoord;
+        Layer = aLayer;
     }
 )";
 
@@ -81,26 +79,25 @@ const char *framebufferVertexShaderSource = R"(
 const char *framebufferFragmentShaderSource = R"(
     #version 460 core
     out vec4 FragColor;
-    
+
     in vec2 TexCoord;
-    
-    uniform sampler2D framebufferTexture;
-    
+    flat in float Layer;
+
+    uniform sampler2DArray framebufferTexture;
+
     void main()
     {
-        FragColor = texture(framebufferTexture, TexCoord);
+        FragColor = texture(framebufferTexture, vec3(TexCoord, Layer));
     }
 )";
 
-const char *lineVertexShaderSource = R"(
+const std::string lineVertexShaderSource = std::string(R"(
     #version 460 core
     layout (location = 0) in vec3 aPos;
-    
-    uniform mat4 uProjection;
-    
+)") + cameraBlockGlsl + R"(
     void main()
     {
-        gl_Position = uProjection * vec4(aPos, 1.0);
+        gl_Position = camera.viewProjection * vec4(aPos, 1.0);
     }
 )";
 
@@ -117,55 +114,154 @@ const char *lineFragmentShaderSource = R"(
 )";
 
 Renderer::Renderer(GLFWwindow* window) : window(window) {
+    framebufferPool.setStateCache(&glState);
+    auto shaderStart = std::chrono::steady_clock::now();
+    shaderCache.init(ShaderCache::defaultDirectory());
     initShaders();
+    cameraBuffer.init();
+    bool atomsReady = atomRenderer.init() && bondRenderer.init();
+
+    const ShaderCache::Stats &cacheStats = shaderCache.getStats();
+    std::cout << "Shaders ready in "
+              << std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - shaderStart).count()
+              << " ms (" << cacheStats.hits << " from cache, " << cacheStats.misses << " compiled"
+              << (shaderCache.hasParallelCompile() ? " in parallel" : "") << ")" << std::endl;
     // This will be a loop over shaders eventually...
-    if (basicShaderProgram != 0 && triangleShaderProgram != 0 &&
-        framebufferShaderProgram != 0 && lineShaderProgram != 0)
-        initialized = true;
-    initialized = true;
+    initialized = basicShader.isValid() && triangleShader.isValid() &&
+                  framebufferShader.isValid() && lineShader.isValid() && atomsReady;
 }
 
 void Renderer::cleanup() {
-    // TODO: Obviously should write a shader abstraction and get an array of Shaders.
-    // Delete shader programs if they're valid IDs
-    if (basicShaderProgram > 0)
-    {
-        glDeleteProgram(basicShaderProgram);
-    }
-
-    if (triangleShaderProgram > 0)
-    {
-        glDeleteProgram(triangleShaderProgram);
-    }
-
-    if (framebufferShaderProgram > 0)
-    {
-        glDeleteProgram(framebufferShaderProgram);
-    }
-
-    if (lineShaderProgram > 0)
-    {
-        glDeleteProgram(lineShaderProgram);
-    }
+    basicShader.destroy();
+    triangleShader.destroy();
+    framebufferShader.destroy();
+    lineShader.destroy();
+    cameraBuffer.destroy();
+    atomRenderer.destroy();
+    bondRenderer.destroy();
+
+    // Queued captures still read from the framebuffers
+    frameCapture.destroy();
+    rayTracer.cancel();
+    posterRenderer.destroy();
 
     // Clean up framebuffers
     cleanupFramebuffers();
+
+    // Release retained geometry
+    meshCache.clear();
+    gpuProfiler.destroy();
 }
 
 void Renderer::initShaders() {
-    basicShaderProgram = createShaderProgram(basicVertexShaderSource, basicFragmentShaderSource);
-    triangleShaderProgram = createShaderProgram(triangleVertexShaderSource, triangleFragmentShaderSource);
-    framebufferShaderProgram = createShaderProgram(framebufferVertexShaderSource, framebufferFragmentShaderSource);
-    lineShaderProgram = createShaderProgram(lineVertexShaderSource, lineFragmentShaderSource);
+    PROFILE_ZONE("initShaders");
+
+    // Submit every program before waiting on any, so cache misses compile side by side
+    basicShader.begin("basic", basicVertexShaderSource, basicFragmentShaderSource, &shaderCache);
+    triangleShader.begin("triangle", triangleVertexShaderSource, triangleFragmentShaderSource, &shaderCache);
+    framebufferShader.begin("framebuffer", framebufferVertexShaderSource, framebufferFragmentShaderSource,
+                            &shaderCache);
+    lineShader.begin("line", lineVertexShaderSource.c_str(), lineFragmentShaderSource, &shaderCache);
+    atomRenderer.beginShader(&shaderCache);
+    bondRenderer.beginShader(&shaderCache);
+
+    // The impostor programs are finished by their renderers' init()
+    basicShader.finish();
+    triangleShader.finish();
+    framebufferShader.finish();
+    lineShader.finish();
+
+    // Resolve uniform handles once; nothing on the render path looks them up by name
+    triangleColorUniform = triangleShader.uniform<glm::vec4>("u_Color");
+    framebufferTextureUniform = framebufferShader.uniform<int>("framebufferTexture");
+    lineColorUniform = lineShader.uniform<glm::vec4>("uColor");
+
+    // The composite shader always samples unit 0
+    framebufferShader.set(framebufferTextureUniform, 0);
+}
+
+void Renderer::bindCameraForRegion(const UIRegion &region, int width, int height)
+{
+    Camera &camera = cameras[region.name];
+    float aspect = static_cast<float>(std::max(1, width)) / static_cast<float>(std::max(1, height));
+
+    CameraUniforms uniforms;
+    uniforms.view = camera.getViewMatrix();
+    uniforms.projection = camera.getProjectionMatrix(aspect);
+    uniforms.viewProjection = uniforms.projection * uniforms.view;
+    uniforms.viewport = glm::vec4(0.0f, 0.0f, static_cast<float>(width), static_cast<float>(height));
+
+    int slot = cameraBuffer.getSlot(region.name);
+    cameraBuffer.update(slot, uniforms);
+    cameraBuffer.bind(slot);
+}
+
+void Renderer::bindScreenCamera(int width, int height)
+{
+    // Pixel-space orthographic camera for overlays drawn over the whole window
+    CameraUniforms uniforms;
+    uniforms.view = glm::mat4(1.0f);
+    uniforms.projection = glm::ortho(0.0f, static_cast<float>(width),
+                                     static_cast<float>(height), 0.0f, -1.0f, 1.0f);
+    uniforms.viewProjection = uniforms.projection;
+    uniforms.viewport = glm::vec4(0.0f, 0.0f, static_cast<float>(width), static_cast<float>(height));
+
+    int slot = cameraBuffer.getSlot("screen");
+    cameraBuffer.update(slot, uniforms);
+    cameraBuffer.bind(slot);
 }
 
 void Renderer::clearFrame(float r, float g, float b, float a) {
-    glClearColor(r, g, b, a);
+    glState.clearColor(r, g, b, a);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 }
 
 void Renderer::setBackgroundColor(float r, float g, float b) {
     backgroundColor = glm::vec3(r, g, b);
+    invalidateAll();
+}
+
+void Renderer::setRenderMode(RenderMode mode)
+{
+    if (mode != renderMode)
+    {
+        renderMode = mode;
+        invalidateAll();
+    }
+}
+
+void Renderer::invalidateRegion(const std::string &regionName)
+{
+    regionStates[regionName].contentVersion++;
+}
+
+void Renderer::invalidateCamera(const std::string &regionName)
+{
+    regionStates[regionName].cameraVersion++;
+}
+
+void Renderer::invalidateAll()
+{
+    sceneVersion++;
+}
+
+bool Renderer::needsRender(const UIRegion &region)
+{
+    // The animated placeholder changes every frame (main schedules frames for it at a low rate)
+    if (region.name == "main_view" && !hasMolecule())
+    {
+        return true;
+    }
+
+    const RegionRenderState &state = regionStates[region.name];
+    const FramebufferObject &fbo = framebuffers[region.name];
+    return state.renderedSceneVersion != sceneVersion ||
+           state.renderedContentVersion != state.contentVersion ||
+           state.renderedCameraVersion != state.cameraVersion ||
+           state.renderedLayer != fbo.storage.layer ||
+           state.renderedStorageGeneration != framebufferPool.getGeneration() || // Storage recreated (blank)
+           state.renderedWidth != fbo.width ||
+           state.renderedHeight != fbo.height;
 }
 
 void Renderer::renderBoundaryLines(const std::vector<UIRegion> &regions, float lineWidth, glm::vec3 lineColor) {
@@ -173,45 +269,23 @@ void Renderer::renderBoundaryLines(const std::vector<UIRegion> &regions, float l
     int windowWidth, windowHeight;
     glfwGetFramebufferSize(window, &windowWidth, &windowHeight);
 
-    // Save current OpenGL state
-    GLboolean depthTestEnabled;
-    glGetBooleanv(GL_DEPTH_TEST, &depthTestEnabled);
-    GLfloat originalLineWidth;
-    glGetFloatv(GL_LINE_WIDTH, &originalLineWidth);
+    // The shadowed state is known, so it is restored without querying the driver
+    bool depthTestEnabled = glState.isDepthTestEnabled();
 
     // Disable depth testing for 2D lines and set line width
-    glDisable(GL_DEPTH_TEST);
-    glLineWidth(lineWidth);
+    glState.setDepthTest(false);
+    glState.lineWidth(lineWidth);
 
     // Use line shader program
-    glUseProgram(lineShaderProgram);
+    lineShader.use(glState);
 
-    // Set up orthographic projection matrix (2D)
-    glm::mat4 projection = glm::ortho(0.0f, static_cast<float>(windowWidth),
-                                      static_cast<float>(windowHeight), 0.0f,
-                                      -1.0f, 1.0f);
+    // Orthographic (2D) projection comes from the shared camera block
+    bindScreenCamera(windowWidth, windowHeight);
+    lineShader.set(lineColorUniform, glm::vec4(lineColor, 1.0f));
 
-    // Set shader uniforms
-    unsigned int projectionLoc = glGetUniformLocation(lineShaderProgram, "uProjection");
-    unsigned int colorLoc = glGetUniformLocation(lineShaderProgram, "uColor");
-
-    glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
-    glUniform3fv(colorLoc, 1, glm::value_ptr(lineColor));
-
-    // Create VAO and VBO for lines
-    unsigned int lineVAO, lineVBO;
-    glGenVertexArrays(1, &lineVAO);
-    glGenBuffers(1, &lineVBO);
-
-    // Bind VAO and VBO
-    glBindVertexArray(lineVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, lineVBO);
-
-    // Configure vertex attributes
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
-    glEnableVertexAttribArray(0);
-
-    // For each region, draw its boundaries
+    // Build the outline of every region (4 lines, 8 vertices each) into one vertex array
+    std::vector<float> lines;
+    lines.reserve(regions.size() * 8 * 3);
     for (const auto &region : regions)
     {
         // Calculate screen coordinates
@@ -221,7 +295,7 @@ void Renderer::renderBoundaryLines(const std::vector<UIRegion> &regions, float l
         float y2 = (region.y + region.height) * windowHeight;
 
         // Define the 4 lines of the rectangle (8 vertices, 4 lines)
-        float lines[] = {
+        float edges[] = {
             // Line 1: top edge
             x1, y1, 0.0f,
             x2, y1, 0.0f,
@@ -238,40 +312,75 @@ void Renderer::renderBoundaryLines(const std::vector<UIRegion> &regions, float l
             x1, y2, 0.0f,
             x1, y1, 0.0f};
 
-        // Upload line data
-        glBufferData(GL_ARRAY_BUFFER, sizeof(lines), lines, GL_DYNAMIC_DRAW);
-
-        // Draw lines
-        glDrawArrays(GL_LINES, 0, 8);
+        lines.insert(lines.end(), std::begin(edges), std::end(edges));
     }
 
-    // Clean up
-    glBindVertexArray(0);
-    glDeleteVertexArrays(1, &lineVAO);
-    glDeleteBuffers(1, &lineVBO);
+    // Only re-upload when the layout (or window size) actually changed
+    uint64_t version = MeshCache::hashContent(lines.data(), lines.size() * sizeof(float));
+    const MeshCache::Mesh &mesh = meshCache.upload("boundary_lines", version, lines.data(),
+                                                   static_cast<int>(lines.size() / 3), 3, {{0, 3, 0}});
 
-    // Restore original OpenGL state
-    if (depthTestEnabled)
-    {
-        glEnable(GL_DEPTH_TEST);
-    }
-    glLineWidth(originalLineWidth);
+    // Draw all outlines at once
+    glState.bindVertexArray(mesh.vao);
+    glDrawArrays(GL_LINES, 0, mesh.vertexCount);
+
+    // Restore depth testing; line width is set by whoever draws lines next
+    glState.setDepthTest(depthTestEnabled);
 }
 
 void Renderer::renderRegion(const UIRegion& region) {
+    RegionRenderState &state = regionStates[region.name];
+    // Zone names are built once per region, not every frame
+    if (!state.profileZoneName)
+    {
+        state.profileZoneName = CpuProfiler::instance().intern("renderRegion " + region.name);
+        state.gpuZoneName = "region " + region.name;
+    }
+    PROFILE_ZONE(state.profileZoneName);
+
     // Check if a framebuffer exists for this region, create one if not
     if (framebuffers.find(region.name) == framebuffers.end())
     {
         createFramebufferForRegion(region);
     }
 
+    // Nothing changed: keep compositing the cached color texture
+    if (!needsRender(region))
+    {
+        return;
+    }
+
+    // Record what the framebuffer is about to show
+    const FramebufferObject &target = framebuffers[region.name];
+    state.renderedSceneVersion = sceneVersion;
+    state.renderedContentVersion = state.contentVersion;
+    state.renderedCameraVersion = state.cameraVersion;
+    state.renderedLayer = target.storage.layer;
+    state.renderedStorageGeneration = framebufferPool.getGeneration();
+    state.renderedWidth = target.width;
+    state.renderedHeight = target.height;
+
     // Bind the framebuffer for this region
+    gpuProfiler.begin(state.gpuZoneName);
     bindFramebufferForRegion(region.name);
 
-    // Clear the framebuffer
-    glClearColor(backgroundColor.r, backgroundColor.g, backgroundColor.b, 1.0f);
+    // Clear the framebuffer (the 3D content needs depth testing, whatever the overlays left behind)
+    glState.setDepthTest(true);
+    glState.clearColor(backgroundColor.r, backgroundColor.g, backgroundColor.b, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+    // Camera for everything drawn into this region
+    bindCameraForRegion(region, target.width, target.height);
+
+    // Once a structure is loaded it replaces the placeholder content in every view
+    if (hasMolecule() && region.name != "sidebar" && region.name != "status")
+    {
+        renderMolecule();
+        gpuProfiler.end();
+        unbindFramebuffer();
+        return;
+    }
+
     // Render content to the framebuffer
     if (region.name == "main_view")
     {
@@ -283,36 +392,10 @@ void Renderer::renderRegion(const UIRegion& region) {
             0.0f, 0.5f, 0.0f
         };
 
-        unsigned int VBO, VAO;
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-
-        glBindVertexArray(VAO);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
-        glEnableVertexAttribArray(0);
-
-        glUseProgram(triangleShaderProgram);
-
-        // Set time and rotation direction (clockwise)
-        float timeValue = glfwGetTime();
-        int timeLocation = glGetUniformLocation(triangleShaderProgram, "u_Time");
-        int directionLocation = glGetUniformLocation(triangleShaderProgram, "u_Direction");
-        glUniform1f(timeLocation, timeValue);
-        glUniform1f(directionLocation, 1.0f);
-
         // Set color to green with animation
+        float timeValue = glfwGetTime();
         float greenPulse = (sin(timeValue) / 5.0f) + 0.7f; // Pulse between 0.5 and 0.9
-        int colorLocation = glGetUniformLocation(triangleShaderProgram, "u_Color");
-        glUniform4f(colorLocation, 0.0f, greenPulse, 0.2f, 1.0f);
-
-        glDrawArrays(GL_TRIANGLES, 0, 3);
-
-        // Clean up
-        glBindVertexArray(0);
-        glDeleteVertexArrays(1, &VAO);
-        glDeleteBuffers(1, &VBO);
+        drawPlaceholderTriangle(region.name, vertices, glm::vec4(0.0f, greenPulse, 0.2f, 1.0f));
     }
     if (region.name == "quad_tl")
     {
@@ -322,28 +405,7 @@ void Renderer::renderRegion(const UIRegion& region) {
             0.5f, -0.5f, 0.0f,
             0.0f, 0.5f, 0.0f};
 
-        unsigned int VBO, VAO;
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-
-        glBindVertexArray(VAO);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
-        glEnableVertexAttribArray(0);
-
-        glUseProgram(triangleShaderProgram);
-
-        // Set color to green
-        int colorLocation = glGetUniformLocation(triangleShaderProgram, "u_Color");
-        glUniform4f(colorLocation, 0.0f, 0.8f, 0.2f, 1.0f);
-
-        glDrawArrays(GL_TRIANGLES, 0, 3);
-
-        // Clean up
-        glBindVertexArray(0);
-        glDeleteVertexArrays(1, &VAO);
-        glDeleteBuffers(1, &VBO);
+        drawPlaceholderTriangle(region.name, vertices, glm::vec4(0.0f, 0.8f, 0.2f, 1.0f));
     }
     else if (region.name == "quad_tr")
     {
@@ -353,28 +415,7 @@ void Renderer::renderRegion(const UIRegion& region) {
             -0.5f, -0.5f, 0.0f,
             0.5f, 0.0f, 0.0f};
 
-        unsigned int VBO, VAO;
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-
-        glBindVertexArray(VAO);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
-        glEnableVertexAttribArray(0);
-
-        glUseProgram(triangleShaderProgram);
-
-        // Set color to red
-        int colorLocation = glGetUniformLocation(triangleShaderProgram, "u_Color");
-        glUniform4f(colorLocation, 0.9f, 0.1f, 0.1f, 1.0f);
-
-        glDrawArrays(GL_TRIANGLES, 0, 3);
-
-        // Clean up
-        glBindVertexArray(0);
-        glDeleteVertexArrays(1, &VAO);
-        glDeleteBuffers(1, &VBO);
+        drawPlaceholderTriangle(region.name, vertices, glm::vec4(0.9f, 0.1f, 0.1f, 1.0f));
     }
     else if (region.name == "quad_bl")
     {
@@ -384,28 +425,7 @@ void Renderer::renderRegion(const UIRegion& region) {
             0.5f, 0.5f, 0.0f,
             0.0f, -0.5f, 0.0f};
 
-        unsigned int VBO, VAO;
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-
-        glBindVertexArray(VAO);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
-        glEnableVertexAttribArray(0);
-
-        glUseProgram(triangleShaderProgram);
-
-        // Set color to blue
-        int colorLocation = glGetUniformLocation(triangleShaderProgram, "u_Color");
-        glUniform4f(colorLocation, 0.1f, 0.3f, 0.9f, 1.0f);
-
-        glDrawArrays(GL_TRIANGLES, 0, 3);
-
-        // Clean up
-        glBindVertexArray(0);
-        glDeleteVertexArrays(1, &VAO);
-        glDeleteBuffers(1, &VBO);
+        drawPlaceholderTriangle(region.name, vertices, glm::vec4(0.1f, 0.3f, 0.9f, 1.0f));
     }
     else if (region.name == "quad_br")
     {
@@ -415,103 +435,159 @@ void Renderer::renderRegion(const UIRegion& region) {
             0.5f, -0.5f, 0.0f,
             -0.5f, 0.0f, 0.0f};
 
-        unsigned int VBO, VAO;
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-
-        glBindVertexArray(VAO);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
-        glEnableVertexAttribArray(0);
-
-        glUseProgram(triangleShaderProgram);
-
-        // Set color to yellow
-        int colorLocation = glGetUniformLocation(triangleShaderProgram, "u_Color");
-        glUniform4f(colorLocation, 0.9f, 0.9f, 0.1f, 1.0f);
-
-        glDrawArrays(GL_TRIANGLES, 0, 3);
-
-        // Clean up
-        glBindVertexArray(0);
-        glDeleteVertexArrays(1, &VAO);
-        glDeleteBuffers(1, &VBO);
+        drawPlaceholderTriangle(region.name, vertices, glm::vec4(0.9f, 0.9f, 0.1f, 1.0f));
     }
     else if (region.name == "sidebar")
     {
         // Clear with background color - ImGui will render on top later
-        glClearColor(backgroundColor.r, backgroundColor.g, backgroundColor.b, 1.0f);
+        glState.clearColor(backgroundColor.r, backgroundColor.g, backgroundColor.b, 1.0f);
     }
     else if (region.name == "status")
     {
         // Clear with background color - ImGui will render on top later
-        glClearColor(backgroundColor.r, backgroundColor.g, backgroundColor.b, 1.0f);
+        glState.clearColor(backgroundColor.r, backgroundColor.g, backgroundColor.b, 1.0f);
     }
 
     // Unbind the framebuffer when done
+    gpuProfiler.end();
     unbindFramebuffer();
 
     // This is just placeholder drawing code
     // Later we'll replace with actual geometry rendering
 }
 
-unsigned int Renderer::compileShader(unsigned int type, const char* source) {
-    unsigned int shader = glCreateShader(type);
-    if (shader == 0) {
-        std::cerr << "Failed to create shader" << std::endl;
-        return 0;
+RepresentationStyle getRepresentationStyle(RenderMode mode)
+{
+    RepresentationStyle style;
+    switch (mode)
+    {
+    case RenderMode::SpaceFilling:
+        style.atomRadiusScale = 1.0f;
+        break;
+    case RenderMode::BallAndStick:
+    case RenderMode::Ribbon: // No secondary structure yet, show atoms instead
+        style.atomRadiusScale = 0.25f;
+        style.bondRadius = 0.15f;
+        break;
+    case RenderMode::Wireframe:
+        style.bondRadius = 0.06f;
+        break;
+    }
+    return style;
+}
+
+void Renderer::renderMolecule()
+{
+    RepresentationStyle style = getRepresentationStyle(renderMode);
+    if (style.atomRadiusScale > 0.0f)
+    {
+        atomRenderer.draw(glState, style.atomRadiusScale);
     }
-    
-    glShaderSource(shader, 1, &source, NULL);
-    glCompileShader(shader);
-    
-    // Check for compilation errors
-    int success;
-    char infoLog[512];
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-    
-    if (!success) {
-        glGetShaderInfoLog(shader, 512, NULL, infoLog);
-        std::cerr << "ERROR::SHADER::COMPILATION_FAILED\n" << infoLog << std::endl;
-        glDeleteShader(shader);
-        return 0;
+    if (style.bondRadius > 0.0f)
+    {
+        bondRenderer.draw(glState, atomRenderer.getPositionBuffer(), atomRenderer.getAttributeBuffer(),
+                          atomRenderer.getPaletteBuffer(), style.bondRadius);
     }
-    
-    return shader;
 }
 
-unsigned int Renderer::createShaderProgram(const char* vertexSource, const char* fragmentSource) {
-    unsigned int vertexShader = 0, fragmentShader = 0, shaderProgram = 0;
-    int success;
-    char infoLog[512];
-    
-    // Compile vertex and fragment shaders
-    vertexShader = compileShader(GL_VERTEX_SHADER, vertexSource);
-    fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentSource);
-
-    // Create actual shader program
-    shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-
-    // Check for linking errors
-    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-    if (success != 1) {
-        glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
-        std::cerr << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
-        glDeleteShader(vertexShader);
-        glDeleteShader(fragmentShader);
-        glDeleteProgram(shaderProgram);
-        return 0;
+void Renderer::updateAtomPositions(const glm::vec4 *positions, size_t count)
+{
+    // Bonds read the same position buffer, so nothing else needs updating
+    atomRenderer.updatePositions(positions, count);
+    if (count == currentMolecule.positions.size())
+    {
+        std::copy(positions, positions + count, currentMolecule.positions.begin());
     }
-    
-    // Delete shaders as they're linked into the program and no longer necessary
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
-    
-    return shaderProgram;
+    invalidateAll();
+}
+
+void Renderer::setMolecule(const Molecule &molecule)
+{
+    atomRenderer.setAtoms(molecule);
+    bondRenderer.setBonds(molecule.bonds);
+    currentMolecule = molecule;
+    invalidateAll();
+}
+
+void Renderer::frameMolecule()
+{
+    if (currentMolecule.positions.empty() || !uiManager)
+    {
+        return;
+    }
+
+    // Frame the structure in every view
+    glm::vec3 minCorner, maxCorner;
+    currentMolecule.getBounds(minCorner, maxCorner);
+    for (const auto &region : uiManager->getRegions())
+    {
+        cameras[region.name].frame(minCorner, maxCorner);
+        invalidateCamera(region.name);
+    }
+}
+
+void Renderer::beginMoleculeUpload(Molecule molecule)
+{
+    cancelMoleculeUpload();
+    pendingMolecule = std::move(molecule);
+    atomRenderer.beginUpload(pendingMolecule);
+    bondRenderer.beginUpload(pendingMolecule.bonds);
+    moleculeUploading = true;
+}
+
+bool Renderer::continueMoleculeUpload(size_t maxBytes)
+{
+    if (!moleculeUploading)
+    {
+        return false;
+    }
+    PROFILE_ZONE("molecule upload");
+    size_t uploaded = atomRenderer.uploadNext(maxBytes);
+    if (uploaded < maxBytes)
+    {
+        bondRenderer.uploadNext(maxBytes - uploaded);
+    }
+    if (!atomRenderer.isUploadDone() || !bondRenderer.isUploadDone())
+    {
+        return false;
+    }
+
+    // Everything is on the GPU: atoms, bonds and the CPU copy change together
+    atomRenderer.commitUpload();
+    bondRenderer.commitUpload();
+    currentMolecule = std::move(pendingMolecule);
+    pendingMolecule = Molecule();
+    moleculeUploading = false;
+    invalidateAll();
+    frameMolecule();
+    return true;
+}
+
+void Renderer::cancelMoleculeUpload()
+{
+    atomRenderer.cancelUpload();
+    bondRenderer.cancelUpload();
+    pendingMolecule = Molecule();
+    moleculeUploading = false;
+}
+
+float Renderer::getMoleculeUploadProgress() const
+{
+    size_t total = atomRenderer.getUploadTotalBytes() + bondRenderer.getUploadTotalBytes();
+    size_t uploaded = atomRenderer.getUploadedBytes() + bondRenderer.getUploadedBytes();
+    return total > 0 ? static_cast<float>(uploaded) / static_cast<float>(total) : 1.0f;
+}
+
+void Renderer::drawPlaceholderTriangle(const std::string &regionName, const float (&vertices)[9], const glm::vec4 &color)
+{
+    // The placeholder geometry never changes, so version 1 is uploaded once and reused every frame
+    const MeshCache::Mesh &mesh = meshCache.upload(regionName + "/tri", 1, vertices, 3, 3, {{0, 3, 0}});
+
+    triangleShader.use(glState);
+    triangleShader.set(triangleColorUniform, color);
+
+    glState.bindVertexArray(mesh.vao);
+    glDrawArrays(GL_TRIANGLES, 0, mesh.vertexCount);
 }
 
 void Renderer::createFramebufferForRegion(const UIRegion &region)
@@ -521,41 +597,16 @@ void Renderer::createFramebufferForRegion(const UIRegion &region)
     glfwGetFramebufferSize(window, &windowWidth, &windowHeight);
 
     // Calculate framebuffer dimensions based on region size
-    int fbWidth = static_cast<int>(region.width * windowWidth);
-    int fbHeight = static_cast<int>(region.height * windowHeight);
+    int fbWidth = std::max(1, static_cast<int>(region.width * windowWidth));
+    int fbHeight = std::max(1, static_cast<int>(region.height * windowHeight));
 
-    // Create a new framebuffer object
+    // Take a layer of the pooled array; the region renders into its top-left corner
+    framebufferPool.reserve(fbWidth, fbHeight);
     FramebufferObject fbo;
+    fbo.storage = framebufferPool.acquire();
     fbo.width = fbWidth;
     fbo.height = fbHeight;
 
-    // Generate and bind the framebuffer
-    glGenFramebuffers(1, &fbo.fbo);
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo.fbo);
-
-    // Create a color attachment texture
-    glGenTextures(1, &fbo.colorTexture);
-    glBindTexture(GL_TEXTURE_2D, fbo.colorTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, fbWidth, fbHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, fbo.colorTexture, 0);
-
-    // Create a renderbuffer object for depth
-    glGenRenderbuffers(1, &fbo.depthRbo);
-    glBindRenderbuffer(GL_RENDERBUFFER, fbo.depthRbo);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, fbWidth, fbHeight);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, fbo.depthRbo);
-
-    // Check if framebuffer is complete
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-    {
-        std::cerr << "Framebuffer is not complete for region: " << region.name << std::endl;
-    }
-
-    // Unbind the framebuffer
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
     // Store the framebuffer in our map
     framebuffers[region.name] = fbo;
 
@@ -568,275 +619,320 @@ void Renderer::bindFramebufferForRegion(const std::string &regionName)
     auto it = framebuffers.find(regionName);
     if (it != framebuffers.end())
     {
-        glBindFramebuffer(GL_FRAMEBUFFER, it->second.fbo);
-        glViewport(0, 0, it->second.width, it->second.height);
+        // Render into the region-sized corner of the (possibly larger) pooled attachment
+        glState.bindFramebuffer(it->second.storage.fbo);
+        glState.viewport(0, 0, it->second.width, it->second.height);
     }
     else
     {
         std::cerr << "No framebuffer exists for region: " << regionName << std::endl;
-        glBindFramebuffer(GL_FRAMEBUFFER, 0); // Bind default framebuffer
+        glState.bindFramebuffer(0); // Bind default framebuffer
     }
 }
 
 void Renderer::unbindFramebuffer()
 {
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glState.bindFramebuffer(0);
     // Restore default viewport
     int width, height;
     glfwGetFramebufferSize(window, &width, &height);
-    glViewport(0, 0, width, height);
+    glState.viewport(0, 0, width, height);
 }
 
-void Renderer::renderFramebufferToScreen(const UIRegion &region)
+void Renderer::compositeRegions()
 {
-    auto it = framebuffers.find(region.name);
-    if (it == framebuffers.end())
-    {
-        std::cerr << "No framebuffer exists for region: " << region.name << std::endl;
-        return;
-    }
+    PROFILE_ZONE("compositeRegions");
 
-    // Skip rendering for ImGui regions since they're handled differently
-    if (region.name == "sidebar" || region.name == "status")
+    if (!uiManager || framebuffers.empty() || framebufferPool.getColorArray() == 0)
     {
         return;
     }
 
-    // Get window dimensions
     int windowWidth, windowHeight;
     glfwGetFramebufferSize(window, &windowWidth, &windowHeight);
+    if (windowWidth <= 0 || windowHeight <= 0)
+    {
+        return;
+    }
 
-    // Calculate viewport based on region dimensions
-    int x = static_cast<int>(region.x * windowWidth);
-    int y = static_cast<int>((1.0f - region.y - region.height) * windowHeight); // Flip Y coordinate
-    int width = static_cast<int>(region.width * windowWidth);
-    int height = static_cast<int>(region.height * windowHeight);
-
-    // Ensure we don't have zero-sized viewports
-    width = std::max(1, width);
-    height = std::max(1, height);
-
-    // Set viewport to the region
-    glViewport(x, y, width, height);
-
-    // Disable depth testing temporarily for 2D rendering
-    GLboolean depthTestEnabled;
-    glGetBooleanv(GL_DEPTH_TEST, &depthTestEnabled);
-    glDisable(GL_DEPTH_TEST);
-
-    // Enable blending for transparent regions
-    GLboolean blendEnabled;
-    glGetBooleanv(GL_BLEND, &blendEnabled);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-    // Simple fullscreen quad for rendering the texture
-    static unsigned int quadVAO = 0;
-    static unsigned int quadVBO;
-
-    if (quadVAO == 0)
-    {
-        float quadVertices[] = {
-            // positions        // texture coords
-            -1.0f,
-            1.0f,
-            0.0f,
-            0.0f,
-            1.0f,
-            -1.0f,
-            -1.0f,
-            0.0f,
-            0.0f,
-            0.0f,
-            1.0f,
-            1.0f,
-            0.0f,
-            1.0f,
-            1.0f,
-            1.0f,
-            -1.0f,
-            0.0f,
-            1.0f,
-            0.0f,
-        };
-
-        glGenVertexArrays(1, &quadVAO);
-        glGenBuffers(1, &quadVBO);
-        glBindVertexArray(quadVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *)0);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *)(3 * sizeof(float)));
+    // One quad (two triangles) per region with a framebuffer, in window NDC:
+    // position (2), texture coordinate (2), layer (1)
+    float storageWidth = static_cast<float>(framebufferPool.getWidth());
+    float storageHeight = static_cast<float>(framebufferPool.getHeight());
+    std::vector<float> vertices;
+    vertices.reserve(framebuffers.size() * 6 * 5);
+    for (const auto &region : uiManager->getRegions())
+    {
+        auto it = framebuffers.find(region.name);
+        if (it == framebuffers.end() || region.width <= 0.0f || region.height <= 0.0f)
+        {
+            continue;
+        }
+
+        // Region rectangle (UI y grows downwards, NDC y upwards)
+        float x0 = region.x * 2.0f - 1.0f;
+        float x1 = (region.x + region.width) * 2.0f - 1.0f;
+        float y0 = 1.0f - (region.y + region.height) * 2.0f;
+        float y1 = 1.0f - region.y * 2.0f;
+
+        // Only the rendered corner of the layer is valid
+        const FramebufferObject &fbo = it->second;
+        float u = fbo.width / storageWidth;
+        float v = fbo.height / storageHeight;
+        float layer = static_cast<float>(fbo.storage.layer);
+
+        float quad[] = {
+            x0, y0, 0.0f, 0.0f, layer,
+            x1, y0, u, 0.0f, layer,
+            x1, y1, u, v, layer,
+            x0, y0, 0.0f, 0.0f, layer,
+            x1, y1, u, v, layer,
+            x0, y1, 0.0f, v, layer};
+        vertices.insert(vertices.end(), std::begin(quad), std::end(quad));
+    }
+    if (vertices.empty())
+    {
+        return;
     }
 
-    // Use the framebuffer shader program
-    glUseProgram(framebufferShaderProgram);
+    // The layout only changes on resizes and boundary drags
+    uint64_t version = MeshCache::hashContent(vertices.data(), vertices.size() * sizeof(float));
+    const MeshCache::Mesh &mesh = meshCache.upload("composite", version, vertices.data(),
+                                                   static_cast<int>(vertices.size() / 5), 5,
+                                                   {{0, 2, 0}, {1, 2, 2}, {2, 1, 4}});
+
+    // 2D compositing over the whole window: no depth test, blending for transparent regions
+    glState.viewport(0, 0, windowWidth, windowHeight);
+    glState.setDepthTest(false);
+    glState.setBlend(true);
+    glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    // Every region samples the same array texture (sampler is bound to unit 0 at init)
+    gpuProfiler.begin("composite");
+    framebufferShader.use(glState);
+    glState.bindTexture(0, framebufferPool.getColorArray());
+    glState.bindVertexArray(mesh.vao);
+    glDrawArrays(GL_TRIANGLES, 0, mesh.vertexCount);
+    gpuProfiler.end();
+}
 
-    // Set the texture uniform
-    glUniform1i(glGetUniformLocation(framebufferShaderProgram, "framebufferTexture"), 0);
+bool Renderer::captureLayout(const std::string &path)
+{
+    if (!uiManager)
+    {
+        return false;
+    }
 
-    // Bind the texture from the framebuffer
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, it->second.colorTexture);
+    int windowWidth, windowHeight;
+    glfwGetFramebufferSize(window, &windowWidth, &windowHeight);
 
-    // Draw quad
-    glBindVertexArray(quadVAO);
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    glBindVertexArray(0);
+    // Same placement as compositeRegions, in image coordinates (y down)
+    std::vector<FrameCapture::Source> sources;
+    for (const auto &region : uiManager->getRegions())
+    {
+        auto it = framebuffers.find(region.name);
+        if (it == framebuffers.end())
+        {
+            continue;
+        }
+        sources.push_back({framebufferPool.getColorArray(), it->second.storage.layer,
+                           static_cast<int>(region.x * windowWidth), static_cast<int>(region.y * windowHeight),
+                           it->second.width, it->second.height});
+    }
+    return frameCapture.capture(path, windowWidth, windowHeight, sources, backgroundColor);
+}
 
-    // Restore blend state
-    if (!blendEnabled)
+bool Renderer::captureRegion(const std::string &regionName, const std::string &path)
+{
+    auto it = framebuffers.find(regionName);
+    if (it == framebuffers.end())
     {
-        glDisable(GL_BLEND);
+        std::cerr << "No framebuffer to capture for region: " << regionName << std::endl;
+        return false;
     }
 
-    // Restore depth testing state
-    if (depthTestEnabled)
+    const FramebufferObject &fbo = it->second;
+    FrameCapture::Source source = {framebufferPool.getColorArray(), fbo.storage.layer, 0, 0, fbo.width, fbo.height};
+    return frameCapture.capture(path, fbo.width, fbo.height, {source}, backgroundColor);
+}
+
+bool Renderer::savePoster(const std::string &regionName, const std::string &path, const PosterOptions &options)
+{
+    const UIRegion *region = uiManager ? uiManager->getRegion(regionName) : nullptr;
+    if (!region)
     {
-        glEnable(GL_DEPTH_TEST);
+        std::cerr << "No region named " << regionName << " for a poster" << std::endl;
+        return false;
     }
+    return posterRenderer.render(*this, *region, path, options);
+}
+
+bool Renderer::startRayTrace(const std::string &regionName, const std::string &path, const RayTraceOptions &options)
+{
+    if (!hasMolecule())
+    {
+        std::cerr << "Nothing to ray trace: no structure loaded" << std::endl;
+        return false;
+    }
+
+    // Snapshot of what the view shows now; the view stays interactive while the image renders
+    RepresentationStyle style = getRepresentationStyle(renderMode);
+    RayTraceScene scene;
+    scene.molecule = currentMolecule;
+    scene.atomRadiusScale = style.atomRadiusScale;
+    scene.bondRadius = style.bondRadius;
+    scene.palette = atomRenderer.getPalette();
+    scene.camera = cameras[regionName];
+    scene.background = backgroundColor;
+    return rayTracer.start(std::move(scene), options, path);
+}
+
+void Renderer::renderRegionTile(const UIRegion &region, int imageWidth, int imageHeight,
+                                int tileX, int tileY, int tileWidth, int tileHeight)
+{
+    // The tile's window of the full image's near plane (computed in double: posters reach 32k pixels)
+    auto toNdc = [](int pixel, int size) { return static_cast<float>(2.0 * pixel / size - 1.0); };
+    glm::vec2 ndcMin(toNdc(tileX, imageWidth), toNdc(tileY, imageHeight));
+    glm::vec2 ndcMax(toNdc(tileX + tileWidth, imageWidth), toNdc(tileY + tileHeight, imageHeight));
+
+    Camera &camera = cameras[region.name];
+    CameraUniforms uniforms;
+    uniforms.view = camera.getViewMatrix();
+    uniforms.projection = camera.getTileProjectionMatrix(static_cast<float>(imageWidth) / imageHeight, ndcMin, ndcMax);
+    uniforms.viewProjection = uniforms.projection * uniforms.view;
+    // The whole image's viewport in tile coordinates, so gl_FragCoord.xy - viewport.xy is the image pixel
+    uniforms.viewport = glm::vec4(static_cast<float>(-tileX), static_cast<float>(-tileY),
+                                  static_cast<float>(imageWidth), static_cast<float>(imageHeight));
+
+    int slot = cameraBuffer.getSlot("poster tile");
+    cameraBuffer.update(slot, uniforms);
+    cameraBuffer.bind(slot);
+
+    glState.setDepthTest(true);
+    glState.clearColor(backgroundColor.r, backgroundColor.g, backgroundColor.b, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    renderMolecule();
 }
 
 void Renderer::resizeFramebuffer(const UIRegion* region, int windowWidth, int windowHeight)
 {
-    auto it = framebuffers.find(region->name);
-    if (it == framebuffers.end())
+    if (!region)
     {
+        std::cerr << "Could not find region" << std::endl;
         return;
     }
 
-    if (!region)
+    auto it = framebuffers.find(region->name);
+    if (it == framebuffers.end())
     {
-        std::cerr << "Could not find region" << std::endl;
         return;
     }
 
     // Calculate new framebuffer size
-    int newWidth = static_cast<int>(region->width * windowWidth);
-    int newHeight = static_cast<int>(region->height * windowHeight);
+    int newWidth = std::max(1, static_cast<int>(region->width * windowWidth));
+    int newHeight = std::max(1, static_cast<int>(region->height * windowHeight));
 
     // If size hasn't changed, do nothing
-    if (newWidth == it->second.width && newHeight == it->second.height)
+    FramebufferObject &fbo = it->second;
+    if (newWidth == fbo.width && newHeight == fbo.height)
     {
         return;
     }
 
-    // Clean up old framebuffer resources
-    glDeleteTextures(1, &it->second.colorTexture);
-    glDeleteRenderbuffers(1, &it->second.depthRbo);
-    glDeleteFramebuffers(1, &it->second.fbo);
-
-    // Create new framebuffer with updated size
-    FramebufferObject &fbo = it->second;
+    // Usually the new size still fits the pooled storage and only the viewport changes
     fbo.width = newWidth;
     fbo.height = newHeight;
 
-    // Generate and bind the framebuffer
-    glGenFramebuffers(1, &fbo.fbo);
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo.fbo);
+    bool exceedsStorage = newWidth > framebufferPool.getWidth() || newHeight > framebufferPool.getHeight();
+    if (exceedsStorage)
+    {
+        // While dragging, grow with headroom so the next few mouse moves fit as well
+        int headroom = deferResize ? FRAMEBUFFER_DRAG_HEADROOM : 0;
+        framebufferPool.reserve(headroom ? newWidth + newWidth / headroom : newWidth,
+                                headroom ? newHeight + newHeight / headroom : newHeight);
+    }
+    else if (!deferResize && isWastingStorage())
+    {
+        fitFramebufferStorage();
+    }
+}
 
-    // Create a color attachment texture
-    glGenTextures(1, &fbo.colorTexture);
-    glBindTexture(GL_TEXTURE_2D, fbo.colorTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, newWidth, newHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, fbo.colorTexture, 0);
+bool Renderer::isWastingStorage() const
+{
+    // Hysteresis band: keep storage until it is more than FRAMEBUFFER_SHRINK_SLACK buckets
+    // larger than the largest region needs
+    int maxWidth = 1, maxHeight = 1;
+    for (const auto &pair : framebuffers)
+    {
+        maxWidth = std::max(maxWidth, pair.second.width);
+        maxHeight = std::max(maxHeight, pair.second.height);
+    }
 
-    // Create a renderbuffer object for depth
-    glGenRenderbuffers(1, &fbo.depthRbo);
-    glBindRenderbuffer(GL_RENDERBUFFER, fbo.depthRbo);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, newWidth, newHeight);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, fbo.depthRbo);
+    int slack = FRAMEBUFFER_SHRINK_SLACK * FramebufferPool::BUCKET_SIZE;
+    return framebufferPool.getWidth() - FramebufferPool::roundToBucket(maxWidth) > slack ||
+           framebufferPool.getHeight() - FramebufferPool::roundToBucket(maxHeight) > slack;
+}
 
-    // Check if framebuffer is complete
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+void Renderer::fitFramebufferStorage()
+{
+    int maxWidth = 1, maxHeight = 1;
+    for (const auto &pair : framebuffers)
     {
-        std::cerr << "Resized framebuffer is not complete for region: " << region->name << std::endl;
+        maxWidth = std::max(maxWidth, pair.second.width);
+        maxHeight = std::max(maxHeight, pair.second.height);
     }
 
-    // Unbind the framebuffer
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    // Regions notice the new storage generation and re-render
+    if (framebufferPool.resize(maxWidth, maxHeight))
+    {
+        std::cout << "Resized framebuffer storage to " << framebufferPool.getWidth() << "x"
+                  << framebufferPool.getHeight() << " for " << framebuffers.size() << " regions" << std::endl;
+    }
+}
 
-    std::cout << "Resized framebuffer for region: " << region->name
-              << " to " << newWidth << "x" << newHeight << std::endl;
+void Renderer::beginDeferredResize()
+{
+    deferResize = true;
+}
+
+void Renderer::endDeferredResize()
+{
+    deferResize = false;
+
+    // Settle the storage on a tight bucket now that the drag is over
+    fitFramebufferStorage();
 }
 
 void Renderer::cleanupFramebuffers()
 {
     for (auto &pair : framebuffers)
     {
-        FramebufferObject &fbo = pair.second;
-        glDeleteTextures(1, &fbo.colorTexture);
-        glDeleteRenderbuffers(1, &fbo.depthRbo);
-        glDeleteFramebuffers(1, &fbo.fbo);
+        framebufferPool.release(pair.second.storage);
     }
     framebuffers.clear();
+    framebufferPool.clear();
 }
 
 void Renderer::drawGridLines() {
+    PROFILE_ZONE("drawGridLines");
 
-    if (!uiManager)
+    if (!uiManager || !lineShader.isValid())
         return;
 
-    // Disable depth testing temporarily
-    GLboolean depthTestEnabled;
-    glGetBooleanv(GL_DEPTH_TEST, &depthTestEnabled);
-    glDisable(GL_DEPTH_TEST);
-
-    // Save current viewport
-    GLint viewport[4];
-    glGetIntegerv(GL_VIEWPORT, viewport);
+    // Overlay: no depth testing
+    glState.setDepthTest(false);
 
     // Set viewport to entire window
     int width, height;
     glfwGetFramebufferSize(window, &width, &height);
-    glViewport(0, 0, width, height);
-
-    // Create line shader if it doesn't exist
-    if (lineShaderProgram == 0)
-    {
-        const char *lineVertexShaderSource = R"(
-            #version 460 core
-            layout (location = 0) in vec2 aPos;
-            
-            uniform mat4 uProjection;
-            
-            void main() {
-                gl_Position = uProjection * vec4(aPos, 0.0, 1.0);
-            }
-        )";
-
-        const char *lineFragmentShaderSource = R"(
-            #version 460 core
-            out vec4 FragColor;
-            
-            uniform vec4 uColor;
-            
-            void main() {
-                FragColor = uColor;
-            }
-        )";
-
-        lineShaderProgram = createShaderProgram(lineVertexShaderSource, lineFragmentShaderSource);
-    }
-
-    // Set up orthographic projection
-    glm::mat4 projection = glm::ortho(0.0f, static_cast<float>(width),
-                                      static_cast<float>(height), 0.0f, -1.0f, 1.0f);
-
-    // Use line shader
-    glUseProgram(lineShaderProgram);
-
-    // Set projection matrix
-    GLint projLoc = glGetUniformLocation(lineShaderProgram, "uProjection");
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
+    glState.viewport(0, 0, width, height);
+
+    // Use line shader with a pixel-space projection
+    lineShader.use(glState);
+    bindScreenCamera(width, height);
 
     // Set line color (white with some transparency)
-    GLint colorLoc = glGetUniformLocation(lineShaderProgram, "uColor");
-    glUniform4f(colorLoc, 1.0f, 1.0f, 1.0f, 1.0f);
+    lineShader.set(lineColorUniform, glm::vec4(1.0f, 1.0f, 1.0f, 1.0f));
 
     // Get the boundaries from the regions
     const auto &regions = uiManager->getRegions();
@@ -849,67 +945,33 @@ void Renderer::drawGridLines() {
     const UIRegion *sidebarRegion = uiManager->getRegion("sidebar");
     const UIRegion *statusRegion = uiManager->getRegion("status");
 
-    // Set up VAO/VBO for lines
-    unsigned int lineVAO, lineVBO;
-    glGenVertexArrays(1, &lineVAO);
-    glGenBuffers(1, &lineVBO);
-
-    glBindVertexArray(lineVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, lineVBO);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void *)0);
-    glEnableVertexAttribArray(0);
-
     // Enable blending for transparent lines
-    GLboolean blendEnabled;
-    glGetBooleanv(GL_BLEND, &blendEnabled);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glState.setBlend(true);
+    glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     // Enable line smoothing and set line width
-    glEnable(GL_LINE_SMOOTH);
-    glLineWidth(2.0f);
+    glState.setLineSmooth(true);
+    glState.lineWidth(2.0f);
 
-    // Draw vertical line - use the sidebox region to determine max height
+    // Vertical line - use the sidebox region to determine max height
     float maxHeight = (statusRegion ? statusRegion->y * height : height);
-    float verticalLineVertices[] = {
-        verticalBoundaryX, 0.0f,
-        verticalBoundaryX, static_cast<float>(height)};
-
-    glBufferData(GL_ARRAY_BUFFER, sizeof(verticalLineVertices), verticalLineVertices, GL_STATIC_DRAW);
-    glDrawArrays(GL_LINES, 0, 2);
-
-    // Draw horizontal line - use the sidebar region to determine max width
+    // Horizontal line - use the sidebar region to determine max width
     float maxWidth = (sidebarRegion ? sidebarRegion->x * width : width);
-    float horizontalLineVertices[] = {
+    float gridLineVertices[] = {
+        verticalBoundaryX, 0.0f,
+        verticalBoundaryX, static_cast<float>(height),
         0.0f, horizontalBoundaryY,
         static_cast<float>(width), horizontalBoundaryY};
 
-    glBufferData(GL_ARRAY_BUFFER, sizeof(horizontalLineVertices), horizontalLineVertices, GL_STATIC_DRAW);
-    glDrawArrays(GL_LINES, 0, 2);
-
-    // Clean up
-    glBindVertexArray(0);
-    glDeleteVertexArrays(1, &lineVAO);
-    glDeleteBuffers(1, &lineVBO);
+    // The grid only changes while a boundary is dragged or the window is resized
+    uint64_t version = MeshCache::hashContent(gridLineVertices, sizeof(gridLineVertices));
+    const MeshCache::Mesh &mesh = meshCache.upload("grid_lines", version, gridLineVertices, 4, 2, {{0, 2, 0}});
 
-    // Restore line width
-    glLineWidth(1.0f);
+    gpuProfiler.begin("grid lines");
+    glState.bindVertexArray(mesh.vao);
+    glDrawArrays(GL_LINES, 0, mesh.vertexCount);
+    gpuProfiler.end();
 
-    // Disable line smoothing
-    glDisable(GL_LINE_SMOOTH);
-
-    // Restore blend state
-    if (!blendEnabled)
-    {
-        glDisable(GL_BLEND);
-    }
-
-    // Restore viewport
-    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
-
-    // Restore depth testing
-    if (depthTestEnabled)
-    {
-        glEnable(GL_DEPTH_TEST);
-    }
+    // Line smoothing only applies to the overlay
+    glState.setLineSmooth(false);
 }
\ No newline at end of file
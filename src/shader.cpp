@@ -0,0 +1,323 @@
+#include "shader.h"
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+bool isSamplerType(GLenum type)
+{
+    switch (type)
+    {
+    case GL_SAMPLER_1D:
+    case GL_SAMPLER_2D:
+    case GL_SAMPLER_3D:
+    case GL_SAMPLER_CUBE:
+    case GL_SAMPLER_2D_ARRAY:
+    case GL_SAMPLER_2D_MULTISAMPLE:
+    case GL_SAMPLER_BUFFER:
+    case GL_INT_SAMPLER_2D:
+    case GL_INT_SAMPLER_BUFFER:
+    case GL_UNSIGNED_INT_SAMPLER_2D:
+    case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+        return true;
+    default:
+        return false;
+    }
+}
+
+} // namespace
+
+unsigned int Shader::compileStage(unsigned int type, const char *source)
+{
+    unsigned int shader = glCreateShader(type);
+    if (shader == 0)
+    {
+        std::cerr << "Failed to create shader" << std::endl;
+        return 0;
+    }
+
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+
+    // Check for compilation errors
+    int success;
+    char infoLog[512];
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+
+    if (!success)
+    {
+        glGetShaderInfoLog(shader, 512, NULL, infoLog);
+        std::cerr << "ERROR::SHADER::COMPILATION_FAILED\n" << infoLog << std::endl;
+        glDeleteShader(shader);
+        return 0;
+    }
+
+    return shader;
+}
+
+bool Shader::create(const std::string &programName, const char *vertexSource, const char *fragmentSource,
+                    ShaderCache *shaderCache)
+{
+    begin(programName, vertexSource, fragmentSource, shaderCache);
+    return finish();
+}
+
+void Shader::begin(const std::string &programName, const char *vertexSource, const char *fragmentSource,
+                   ShaderCache *shaderCache)
+{
+    destroy();
+    name = programName;
+    cache = shaderCache;
+    pending = true;
+
+    if (cache)
+    {
+        sourceHash = ShaderCache::hashSources(vertexSource, fragmentSource);
+        program = cache->load(name, sourceHash);
+        fromCache = program != 0;
+        if (fromCache)
+        {
+            return;
+        }
+    }
+
+    // No status queries here: with parallel shader compile the driver works on this
+    // program while the caller submits the next one
+    vertexShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertexShader, 1, &vertexSource, NULL);
+    glCompileShader(vertexShader);
+    fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragmentShader, 1, &fragmentSource, NULL);
+    glCompileShader(fragmentShader);
+
+    program = glCreateProgram();
+    if (cache && cache->isEnabled())
+    {
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    glAttachShader(program, vertexShader);
+    glAttachShader(program, fragmentShader);
+    glLinkProgram(program);
+}
+
+bool Shader::finish()
+{
+    if (!pending)
+    {
+        return isValid();
+    }
+    pending = false;
+    if (fromCache)
+    {
+        fromCache = false;
+        reflect();
+        return true;
+    }
+
+    // Blocks until the driver is done with this program
+    int success;
+    char infoLog[512];
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (success != 1)
+    {
+        // A stage that failed to compile explains the failed link better than the link log
+        struct Stage {
+            unsigned int shader;
+            const char *type;
+        };
+        bool stageFailed = false;
+        for (const Stage &stage : {Stage{vertexShader, "VERTEX"}, Stage{fragmentShader, "FRAGMENT"}})
+        {
+            int compiled = 0;
+            glGetShaderiv(stage.shader, GL_COMPILE_STATUS, &compiled);
+            if (!compiled)
+            {
+                glGetShaderInfoLog(stage.shader, 512, NULL, infoLog);
+                std::cerr << "ERROR::SHADER::" << stage.type << "::COMPILATION_FAILED (" << name << ")\n"
+                          << infoLog << std::endl;
+                stageFailed = true;
+            }
+        }
+        if (!stageFailed)
+        {
+            glGetProgramInfoLog(program, 512, NULL, infoLog);
+            std::cerr << "ERROR::SHADER::PROGRAM::LINKING_FAILED (" << name << ")\n" << infoLog << std::endl;
+        }
+    }
+
+    // Shaders are linked into the program and no longer necessary
+    glDetachShader(program, vertexShader);
+    glDetachShader(program, fragmentShader);
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+    vertexShader = fragmentShader = 0;
+
+    if (success != 1)
+    {
+        glDeleteProgram(program);
+        program = 0;
+        return false;
+    }
+
+    if (cache)
+    {
+        cache->store(name, sourceHash, program);
+    }
+    reflect();
+    return true;
+}
+
+void Shader::destroy()
+{
+    if (program != 0)
+    {
+        glDeleteProgram(program);
+        program = 0;
+    }
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+    vertexShader = fragmentShader = 0;
+    pending = fromCache = false;
+    uniforms.clear();
+    uniformIndex.clear();
+    blocks.clear();
+    shadowValues.clear();
+    shadowValid.clear();
+}
+
+void Shader::reflect()
+{
+    // Active uniforms in the default block
+    GLint uniformCount = 0, maxNameLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &uniformCount);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+    std::vector<char> nameBuffer(std::max(maxNameLength, 1));
+    for (GLint i = 0; i < uniformCount; ++i)
+    {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(program, i, static_cast<GLsizei>(nameBuffer.size()), &length, &size, &type, nameBuffer.data());
+
+        std::string uniformName(nameBuffer.data(), length);
+        GLint location = glGetUniformLocation(program, uniformName.c_str());
+        if (location < 0)
+        {
+            // Members of uniform blocks have no location
+            continue;
+        }
+
+        // Arrays are reported as "name[0]", index them by their plain name
+        size_t bracket = uniformName.find('[');
+        if (bracket != std::string::npos)
+        {
+            uniformName.resize(bracket);
+        }
+
+        uniformIndex[uniformName] = uniforms.size();
+        uniforms.push_back({uniformName, location, type, size});
+    }
+
+    shadowValues.assign(uniforms.size() * 16, 0.0f);
+    shadowValid.assign(uniforms.size(), false);
+
+    // Active uniform blocks; bind the well-known ones to their fixed binding points
+    GLint blockCount = 0, maxBlockNameLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxBlockNameLength);
+
+    nameBuffer.assign(std::max(maxBlockNameLength, 1), '\0');
+    for (GLint i = 0; i < blockCount; ++i)
+    {
+        GLsizei length = 0;
+        glGetActiveUniformBlockName(program, i, static_cast<GLsizei>(nameBuffer.size()), &length, nameBuffer.data());
+        std::string blockName(nameBuffer.data(), length);
+        blocks[blockName] = static_cast<GLuint>(i);
+
+        if (blockName == "CameraBlock")
+        {
+            glUniformBlockBinding(program, i, CAMERA_BLOCK_BINDING);
+        }
+    }
+}
+
+const Shader::UniformInfo *Shader::findUniform(const std::string &uniformName, GLenum expectedType) const
+{
+    auto it = uniformIndex.find(uniformName);
+    if (it == uniformIndex.end())
+    {
+        std::cerr << "Shader '" << name << "' has no active uniform: " << uniformName << std::endl;
+        return nullptr;
+    }
+
+    const UniformInfo &info = uniforms[it->second];
+    bool matches = info.type == expectedType || (expectedType == GL_INT && isSamplerType(info.type));
+    if (!matches)
+    {
+        std::cerr << "Shader '" << name << "' uniform " << uniformName
+                  << " has a different type than the handle requested" << std::endl;
+        return nullptr;
+    }
+    return &info;
+}
+
+GLuint Shader::uniformBlock(const std::string &blockName) const
+{
+    auto it = blocks.find(blockName);
+    return it != blocks.end() ? it->second : GL_INVALID_INDEX;
+}
+
+bool Shader::changed(int slot, const float *value, int count)
+{
+    float *shadow = &shadowValues[static_cast<size_t>(slot) * 16];
+    if (shadowValid[slot] && std::memcmp(shadow, value, count * sizeof(float)) == 0)
+    {
+        return false;
+    }
+    std::memcpy(shadow, value, count * sizeof(float));
+    shadowValid[slot] = true;
+    return true;
+}
+
+void Shader::set(const Uniform<int> &handle, int value)
+{
+    if (!handle.isValid())
+        return;
+    float bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    if (changed(handle.slot, &bits, 1))
+        glProgramUniform1i(program, handle.location, value);
+}
+
+void Shader::set(const Uniform<float> &handle, float value)
+{
+    if (handle.isValid() && changed(handle.slot, &value, 1))
+        glProgramUniform1f(program, handle.location, value);
+}
+
+void Shader::set(const Uniform<glm::vec2> &handle, const glm::vec2 &value)
+{
+    if (handle.isValid() && changed(handle.slot, glm::value_ptr(value), 2))
+        glProgramUniform2fv(program, handle.location, 1, glm::value_ptr(value));
+}
+
+void Shader::set(const Uniform<glm::vec3> &handle, const glm::vec3 &value)
+{
+    if (handle.isValid() && changed(handle.slot, glm::value_ptr(value), 3))
+        glProgramUniform3fv(program, handle.location, 1, glm::value_ptr(value));
+}
+
+void Shader::set(const Uniform<glm::vec4> &handle, const glm::vec4 &value)
+{
+    if (handle.isValid() && changed(handle.slot, glm::value_ptr(value), 4))
+        glProgramUniform4fv(program, handle.location, 1, glm::value_ptr(value));
+}
+
+void Shader::set(const Uniform<glm::mat4> &handle, const glm::mat4 &value)
+{
+    if (handle.isValid() && changed(handle.slot, glm::value_ptr(value), 16))
+        glProgramUniformMatrix4fv(program, handle.location, 1, GL_FALSE, glm::value_ptr(value));
+}
@@ -0,0 +1,211 @@
+#include "shader_cache.h"
+#include "mesh_cache.h"
+#include <GLFW/glfw3.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+constexpr char ENTRY_MAGIC[4] = {'M', 'V', 'P', 'B'};
+constexpr uint32_t ENTRY_VERSION = 1;
+
+struct EntryHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t driverHash;
+    uint64_t sourceHash;
+    uint32_t format;
+    uint32_t length;
+};
+
+// glad is generated without extensions; the one entry point we need is loaded by hand
+using MaxShaderCompilerThreadsProc = void(APIENTRY *)(GLuint count);
+
+bool hasExtension(const char *extension)
+{
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; ++i)
+    {
+        const char *name = reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, i));
+        if (name && std::strcmp(name, extension) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string glString(GLenum name)
+{
+    const char *value = reinterpret_cast<const char *>(glGetString(name));
+    return value ? value : "";
+}
+
+} // namespace
+
+void ShaderCache::init(const std::string &cacheDirectory)
+{
+    directory = cacheDirectory;
+
+    // Any change in the driver invalidates every entry
+    std::string driver = glString(GL_VENDOR) + "\n" + glString(GL_RENDERER) + "\n" + glString(GL_VERSION) + "\n" +
+                         glString(GL_SHADING_LANGUAGE_VERSION);
+    driverHash = MeshCache::hashContent(driver.data(), driver.size());
+
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    enabled = !directory.empty() && formats > 0;
+
+    // Let the driver use as many compiler threads as it likes
+    const char *threadsFunction = hasExtension("GL_KHR_parallel_shader_compile")   ? "glMaxShaderCompilerThreadsKHR"
+                                  : hasExtension("GL_ARB_parallel_shader_compile") ? "glMaxShaderCompilerThreadsARB"
+                                                                                   : nullptr;
+    MaxShaderCompilerThreadsProc maxCompilerThreads =
+        threadsFunction ? reinterpret_cast<MaxShaderCompilerThreadsProc>(glfwGetProcAddress(threadsFunction)) : nullptr;
+    parallelCompile = maxCompilerThreads != nullptr;
+    if (maxCompilerThreads)
+    {
+        maxCompilerThreads(0xFFFFFFFFu);
+    }
+}
+
+std::string ShaderCache::entryPath(const std::string &programName, uint64_t sourceHash) const
+{
+    char key[17];
+    uint64_t entryHash = MeshCache::hashContent(&driverHash, sizeof(driverHash), sourceHash);
+    std::snprintf(key, sizeof(key), "%016llx", static_cast<unsigned long long>(entryHash));
+    return directory + "/" + programName + "-" + key + ".bin";
+}
+
+GLuint ShaderCache::load(const std::string &programName, uint64_t sourceHash)
+{
+    if (!enabled)
+    {
+        return 0;
+    }
+
+    std::string path = entryPath(programName, sourceHash);
+    std::ifstream file(path, std::ios::binary);
+    EntryHeader header;
+    if (!file || !file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, ENTRY_MAGIC, sizeof(ENTRY_MAGIC)) != 0 || header.version != ENTRY_VERSION ||
+        header.driverHash != driverHash || header.sourceHash != sourceHash)
+    {
+        stats.misses++;
+        return 0;
+    }
+    std::vector<char> binary(header.length);
+    if (!file.read(binary.data(), header.length))
+    {
+        stats.misses++;
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, header.format, binary.data(), static_cast<GLsizei>(header.length));
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (linked != GL_TRUE)
+    {
+        // Same driver strings but the binary is refused (e.g. a different GPU with the same driver): rebuild
+        glDeleteProgram(program);
+        file.close();
+        std::error_code error;
+        std::filesystem::remove(path, error);
+        stats.misses++;
+        return 0;
+    }
+    stats.hits++;
+    return program;
+}
+
+void ShaderCache::store(const std::string &programName, uint64_t sourceHash, GLuint program)
+{
+    if (!enabled)
+    {
+        return;
+    }
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+    {
+        return;
+    }
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &length, &format, binary.data());
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error)
+    {
+        std::cerr << "Failed to create shader cache " << directory << ": " << error.message() << std::endl;
+        enabled = false;
+        return;
+    }
+
+    // Several viewers may start at once: write a private file, then rename it into place
+    std::string path = entryPath(programName, sourceHash);
+    std::string temporaryPath =
+        path + "." + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + ".tmp";
+    {
+        EntryHeader header;
+        std::memcpy(header.magic, ENTRY_MAGIC, sizeof(ENTRY_MAGIC));
+        header.version = ENTRY_VERSION;
+        header.driverHash = driverHash;
+        header.sourceHash = sourceHash;
+        header.format = format;
+        header.length = static_cast<uint32_t>(length);
+
+        std::ofstream file(temporaryPath, std::ios::binary);
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(binary.data(), length);
+        if (!file)
+        {
+            file.close();
+            std::filesystem::remove(temporaryPath, error);
+            return;
+        }
+    }
+    std::filesystem::rename(temporaryPath, path, error);
+    if (error)
+    {
+        std::filesystem::remove(temporaryPath, error);
+        return;
+    }
+    stats.stores++;
+}
+
+uint64_t ShaderCache::hashSources(const char *vertexSource, const char *fragmentSource)
+{
+    // Include the terminators so moving text between the stages changes the hash
+    uint64_t hash = MeshCache::hashContent(vertexSource, std::strlen(vertexSource) + 1);
+    return MeshCache::hashContent(fragmentSource, std::strlen(fragmentSource) + 1, hash);
+}
+
+std::string ShaderCache::defaultDirectory()
+{
+#if defined(_WIN32)
+    const char *base = std::getenv("LOCALAPPDATA");
+    return base ? std::string(base) + "/MolecularViewer/ShaderCache" : "";
+#elif defined(__APPLE__)
+    const char *home = std::getenv("HOME");
+    return home ? std::string(home) + "/Library/Caches/MolecularViewer/shaders" : "";
+#else
+    const char *cacheHome = std::getenv("XDG_CACHE_HOME");
+    if (cacheHome && *cacheHome)
+    {
+        return std::string(cacheHome) + "/molecular-viewer/shaders";
+    }
+    const char *home = std::getenv("HOME");
+    return home ? std::string(home) + "/.cache/molecular-viewer/shaders" : "";
+#endif
+}
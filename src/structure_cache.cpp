@@ -0,0 +1,280 @@
+#include "structure_cache.h"
+#include "mapped_file.h"
+#include "mesh_cache.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace {
+
+constexpr char CACHE_MAGIC[4] = {'M', 'V', 'M', 'C'};
+constexpr uint32_t CACHE_VERSION = 1;
+constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+constexpr uint64_t SECTION_ALIGNMENT = 64;
+// Bytes hashed at each end of the source
+constexpr uint64_t HASH_SAMPLE_BYTES = 1ull << 20;
+
+// One section per column, in this order in the section table
+enum Section : uint32_t {
+    POSITIONS,
+    ELEMENTS,
+    BONDS,
+    ATOM_RESIDUES,
+    RESIDUE_NAMES,
+    RESIDUE_NUMBERS,
+    RESIDUE_CHAINS,
+    CHAIN_NAME_OFFSETS, // Start of each chain name in CHAIN_NAME_TEXT, then the end of the last
+    CHAIN_NAME_TEXT,
+    SECTION_COUNT,
+};
+
+struct CacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t byteOrder; // BYTE_ORDER_MARK in the writer's byte order
+    uint32_t sectionCount;
+    uint64_t sourceBytes; // Size, modification time and sampled hash of the source
+    int64_t sourceModified;
+    uint64_t sourceHash;
+};
+
+struct SectionEntry {
+    uint64_t offset; // From the start of the file
+    uint64_t count;  // Elements
+    uint32_t elementBytes;
+    uint32_t reserved;
+};
+
+// Column to write: raw bytes of a vector
+struct ColumnData {
+    const void *data;
+    uint64_t count;
+    uint32_t elementBytes;
+};
+
+template <typename T, typename Allocator>
+ColumnData column(const std::vector<T, Allocator> &values)
+{
+    return {values.data(), values.size(), static_cast<uint32_t>(sizeof(T))};
+}
+
+bool isLittleEndian()
+{
+    uint32_t mark = BYTE_ORDER_MARK;
+    unsigned char first;
+    std::memcpy(&first, &mark, 1);
+    return first == 0x04;
+}
+
+uint64_t alignUp(uint64_t offset)
+{
+    return (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+}
+
+// Hashing the whole source would read it on every load and defeat the cache; its
+// ends still catch rewrites that keep size and modification time (copies with
+// preserved timestamps, tools that reset them)
+bool sourceState(const std::string &sourcePath, uint64_t &bytes, int64_t &modified, uint64_t &hash)
+{
+    std::error_code error;
+    bytes = std::filesystem::file_size(sourcePath, error);
+    if (error)
+        return false;
+    auto time = std::filesystem::last_write_time(sourcePath, error);
+    if (error)
+        return false;
+    modified = static_cast<int64_t>(time.time_since_epoch().count());
+
+    std::ifstream file(sourcePath, std::ios::binary);
+    uint64_t headBytes = std::min(bytes, HASH_SAMPLE_BYTES);
+    uint64_t tailBytes = std::min(bytes - headBytes, HASH_SAMPLE_BYTES);
+    std::vector<char> sample(headBytes + tailBytes);
+    if (!file.read(sample.data(), headBytes) || !file.seekg(bytes - tailBytes) ||
+        !file.read(sample.data() + headBytes, tailBytes))
+    {
+        return false;
+    }
+    hash = MeshCache::hashContent(sample.data(), sample.size(), MeshCache::hashContent(&bytes, sizeof(bytes)));
+    return true;
+}
+
+template <typename T, typename Allocator>
+bool readColumn(const MappedFile &file, const SectionEntry &section, std::vector<T, Allocator> &values)
+{
+    if (section.elementBytes != sizeof(T) || section.offset % SECTION_ALIGNMENT != 0 || section.offset > file.size() ||
+        section.count > (file.size() - section.offset) / sizeof(T))
+    {
+        return false;
+    }
+    // Sections are aligned in the mapping, so this is one block copy per column
+    const T *begin = reinterpret_cast<const T *>(file.data() + section.offset);
+    values.assign(begin, begin + section.count);
+    return true;
+}
+
+// Every index must point inside its target table, or the renderers would read out of bounds
+template <typename T, typename Allocator>
+bool indicesBelow(const std::vector<T, Allocator> &indices, size_t limit)
+{
+    return indices.empty() || static_cast<size_t>(*std::max_element(indices.begin(), indices.end())) < limit;
+}
+
+} // namespace
+
+std::string structureCachePath(const std::string &sourcePath)
+{
+    return sourcePath + ".mvmol";
+}
+
+bool loadStructureCache(const std::string &sourcePath, Molecule &molecule)
+{
+    std::string path = structureCachePath(sourcePath);
+    std::error_code error;
+    uint64_t bytes, hash;
+    int64_t modified;
+    if (!isLittleEndian() || !std::filesystem::exists(path, error) || !sourceState(sourcePath, bytes, modified, hash))
+    {
+        return false;
+    }
+
+    MappedFile file;
+    if (!file.open(path) || file.size() < sizeof(CacheHeader) + SECTION_COUNT * sizeof(SectionEntry))
+    {
+        return false;
+    }
+    file.advise(MappedFile::Access::Sequential);
+
+    CacheHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.version != CACHE_VERSION ||
+        header.byteOrder != BYTE_ORDER_MARK || header.sectionCount != SECTION_COUNT || header.sourceBytes != bytes ||
+        header.sourceModified != modified || header.sourceHash != hash)
+    {
+        return false;
+    }
+    SectionEntry sections[SECTION_COUNT];
+    std::memcpy(sections, file.data() + sizeof(header), sizeof(sections));
+
+    Molecule cached;
+    std::vector<uint64_t> chainNameOffsets;
+    std::vector<char> chainNameText;
+    if (!readColumn(file, sections[POSITIONS], cached.positions) ||
+        !readColumn(file, sections[ELEMENTS], cached.elements) || !readColumn(file, sections[BONDS], cached.bonds) ||
+        !readColumn(file, sections[ATOM_RESIDUES], cached.atomResidues) ||
+        !readColumn(file, sections[RESIDUE_NAMES], cached.residueNames) ||
+        !readColumn(file, sections[RESIDUE_NUMBERS], cached.residueNumbers) ||
+        !readColumn(file, sections[RESIDUE_CHAINS], cached.residueChains) ||
+        !readColumn(file, sections[CHAIN_NAME_OFFSETS], chainNameOffsets) ||
+        !readColumn(file, sections[CHAIN_NAME_TEXT], chainNameText))
+    {
+        return false;
+    }
+
+    // A damaged cache is a miss, not a crash later on
+    size_t atomCount = cached.positions.size();
+    size_t residueCount = cached.residueNames.size();
+    size_t chainCount = chainNameOffsets.empty() ? 0 : chainNameOffsets.size() - 1;
+    bool consistent = cached.elements.size() == atomCount && cached.bonds.size() % 2 == 0 &&
+                      indicesBelow(cached.bonds, atomCount) &&
+                      (cached.atomResidues.empty() || cached.atomResidues.size() == atomCount) &&
+                      indicesBelow(cached.atomResidues, residueCount) &&
+                      cached.residueNumbers.size() == residueCount && cached.residueChains.size() == residueCount &&
+                      indicesBelow(cached.residueChains, chainCount) &&
+                      std::is_sorted(chainNameOffsets.begin(), chainNameOffsets.end()) &&
+                      (chainNameOffsets.empty() || (chainNameOffsets.front() == 0 && chainNameOffsets.back() == chainNameText.size()));
+    if (!consistent)
+    {
+        return false;
+    }
+    cached.chainNames.reserve(chainCount);
+    for (size_t chain = 0; chain < chainCount; ++chain)
+    {
+        cached.chainNames.emplace_back(chainNameText.data() + chainNameOffsets[chain],
+                                       chainNameOffsets[chain + 1] - chainNameOffsets[chain]);
+    }
+
+    cached.name = molecule.name;
+    molecule = std::move(cached);
+    return true;
+}
+
+void saveStructureCache(const std::string &sourcePath, const Molecule &molecule)
+{
+    CacheHeader header;
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = CACHE_VERSION;
+    header.byteOrder = BYTE_ORDER_MARK;
+    header.sectionCount = SECTION_COUNT;
+    if (!isLittleEndian() || !sourceState(sourcePath, header.sourceBytes, header.sourceModified, header.sourceHash))
+    {
+        return;
+    }
+
+    std::vector<uint64_t> chainNameOffsets;
+    std::string chainNameText;
+    if (!molecule.chainNames.empty())
+    {
+        chainNameOffsets.push_back(0);
+        for (const std::string &chainName : molecule.chainNames)
+        {
+            chainNameText += chainName;
+            chainNameOffsets.push_back(chainNameText.size());
+        }
+    }
+
+    ColumnData columns[SECTION_COUNT] = {
+        column(molecule.positions),
+        column(molecule.elements),
+        column(molecule.bonds),
+        column(molecule.atomResidues),
+        column(molecule.residueNames),
+        column(molecule.residueNumbers),
+        column(molecule.residueChains),
+        column(chainNameOffsets),
+        {chainNameText.data(), chainNameText.size(), 1},
+    };
+    SectionEntry sections[SECTION_COUNT];
+    uint64_t end = sizeof(header) + sizeof(sections);
+    for (uint32_t i = 0; i < SECTION_COUNT; ++i)
+    {
+        sections[i].offset = alignUp(end);
+        sections[i].count = columns[i].count;
+        sections[i].elementBytes = columns[i].elementBytes;
+        sections[i].reserved = 0;
+        end = sections[i].offset + columns[i].count * columns[i].elementBytes;
+    }
+
+    // Another viewer may be caching the same file: write a private file, then rename it into place
+    std::string path = structureCachePath(sourcePath);
+    std::string temporaryPath =
+        path + "." + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + ".tmp";
+    std::error_code error;
+    {
+        std::ofstream file(temporaryPath, std::ios::binary);
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(sections), sizeof(sections));
+        uint64_t written = sizeof(header) + sizeof(sections);
+        const char padding[SECTION_ALIGNMENT] = {};
+        for (uint32_t i = 0; i < SECTION_COUNT; ++i)
+        {
+            file.write(padding, sections[i].offset - written);
+            uint64_t sectionBytes = columns[i].count * columns[i].elementBytes;
+            file.write(static_cast<const char *>(columns[i].data), sectionBytes);
+            written = sections[i].offset + sectionBytes;
+        }
+        if (!file)
+        {
+            file.close();
+            std::filesystem::remove(temporaryPath, error);
+            return;
+        }
+    }
+    std::filesystem::rename(temporaryPath, path, error);
+    if (error)
+    {
+        std::filesystem::remove(temporaryPath, error);
+    }
+}
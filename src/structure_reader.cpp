@@ -0,0 +1,617 @@
+#include "structure_reader.h"
+#include "elements.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+#include <memory>
+
+namespace {
+
+// Smaller files are parsed in one piece; starting threads would cost more than they save
+constexpr size_t MIN_CHUNK_BYTES = 1 << 20;
+// Chunks per thread, so a thread that finishes early picks up more work
+constexpr size_t CHUNKS_PER_THREAD = 4;
+// Larger files get more chunks than that, so progress and cancellation stay responsive
+constexpr size_t MAX_CHUNK_BYTES = 64 << 20;
+
+// A residue as one chunk sees it, before the tables of all chunks are merged
+struct ChunkResidue {
+    ResidueName name{};
+    ResidueName chain{}; // Chain ID, in the same inline storage
+    int32_t number = 0;
+    char insertionCode = ' ';
+    bool startsChain = false; // Follows a TER record
+};
+
+struct Chunk {
+    const char *begin = nullptr;
+    const char *end = nullptr;
+
+    std::vector<glm::vec4> positions;
+    std::vector<uint8_t> elements;
+    std::vector<uint32_t> atomResidues; // Into this chunk's residues
+    std::vector<ChunkResidue> residues;
+
+    bool chainBreak = false; // TER since the last atom
+    bool stopped = false;    // Reached the end of the first model or of the atom records
+    std::string error;
+
+    void addAtom(const glm::vec4 &position, uint8_t element, const ChunkResidue &residue)
+    {
+        if (residues.empty() || chainBreak || residue.number != residues.back().number ||
+            residue.insertionCode != residues.back().insertionCode || residue.name != residues.back().name ||
+            residue.chain != residues.back().chain)
+        {
+            residues.push_back(residue);
+            residues.back().startsChain = chainBreak;
+            chainBreak = false;
+        }
+        positions.push_back(position);
+        elements.push_back(element);
+        atomResidues.push_back(static_cast<uint32_t>(residues.size() - 1));
+    }
+
+    void fail(std::string_view what, std::string_view line)
+    {
+        error = std::string(what) + ": " + std::string(line.substr(0, 80));
+    }
+};
+
+std::string_view trim(std::string_view text)
+{
+    while (!text.empty() && std::isspace(static_cast<unsigned char>(text.front())))
+        text.remove_prefix(1);
+    while (!text.empty() && std::isspace(static_cast<unsigned char>(text.back())))
+        text.remove_suffix(1);
+    return text;
+}
+
+bool parseFloat(std::string_view text, float &value)
+{
+    text = trim(text);
+    if (!text.empty() && text.front() == '+')
+        text.remove_prefix(1);
+    std::from_chars_result result = std::from_chars(text.data(), text.data() + text.size(), value);
+    return result.ec == std::errc() && result.ptr == text.data() + text.size();
+}
+
+bool parseInt(std::string_view text, int32_t &value)
+{
+    text = trim(text);
+    std::from_chars_result result = std::from_chars(text.data(), text.data() + text.size(), value);
+    return result.ec == std::errc() && result.ptr == text.data() + text.size();
+}
+
+uint8_t elementNumber(std::string_view symbol)
+{
+    return static_cast<uint8_t>(elementFromSymbol(symbol));
+}
+
+// Line-aligned pieces of [begin, end), about the same size each
+std::vector<Chunk> splitChunks(const char *begin, const char *end, size_t maxChunks)
+{
+    size_t size = static_cast<size_t>(end - begin);
+    size_t count = std::clamp<size_t>(size / MIN_CHUNK_BYTES, 1, std::max<size_t>(maxChunks, 1));
+    count = std::max(count, (size + MAX_CHUNK_BYTES - 1) / MAX_CHUNK_BYTES);
+
+    std::vector<Chunk> chunks;
+    const char *start = begin;
+    for (size_t i = 1; i <= count && start < end; ++i)
+    {
+        const char *cut = i == count ? end : std::max(start, begin + size / count * i);
+        if (cut < end)
+        {
+            const char *newline = static_cast<const char *>(std::memchr(cut, '\n', static_cast<size_t>(end - cut)));
+            cut = newline ? newline + 1 : end;
+        }
+        chunks.emplace_back();
+        chunks.back().begin = start;
+        chunks.back().end = cut;
+        start = cut;
+    }
+    return chunks;
+}
+
+// Parse the chunks of [begin, end) in parallel, then merge them into `molecule` in file order
+template <typename ParseChunk>
+bool readChunks(const std::string &path, const char *begin, const char *end, size_t threadCount,
+                const ParseChunk &parseChunk, Molecule &molecule, LoadProgress *progress)
+{
+    if (progress)
+    {
+        progress->begin(LoadProgress::Stage::Index);
+    }
+    size_t threads = threadCount > 0 ? threadCount : ThreadPool::defaultThreadCount();
+    std::vector<Chunk> chunks = splitChunks(begin, end, threads * CHUNKS_PER_THREAD);
+    threads = std::min(threads, chunks.size());
+    std::unique_ptr<ThreadPool> pool = threads > 1 ? std::make_unique<ThreadPool>(threads, "structure parser") : nullptr;
+    auto forEachChunk = [&pool](size_t count, const auto &job) {
+        if (!pool)
+        {
+            for (size_t i = 0; i < count; ++i)
+                job(i);
+            return;
+        }
+        for (size_t i = 0; i < count; ++i)
+            pool->submit([&job, i]() { job(i); });
+        pool->waitIdle();
+    };
+
+    if (progress)
+    {
+        progress->begin(LoadProgress::Stage::Parse);
+    }
+    std::atomic<size_t> chunksDone{0};
+    forEachChunk(chunks.size(), [&](size_t i) {
+        if (progress && progress->isCancelled())
+            return;
+        parseChunk(chunks[i]);
+        if (progress)
+            progress->update(static_cast<float>(++chunksDone) / chunks.size());
+    });
+    if (progress && progress->isCancelled())
+    {
+        return false;
+    }
+
+    // Chunks after the one that reached the end of the first model hold nothing we want
+    size_t used = 0;
+    size_t atomCount = 0;
+    std::vector<size_t> atomOffsets;
+    while (used < chunks.size())
+    {
+        const Chunk &chunk = chunks[used++];
+        if (!chunk.error.empty())
+        {
+            std::cerr << "Failed to read " << path << ": " << chunk.error << std::endl;
+            return false;
+        }
+        atomOffsets.push_back(atomCount);
+        atomCount += chunk.positions.size();
+        if (chunk.stopped)
+            break;
+    }
+    if (atomCount == 0)
+    {
+        std::cerr << "No atoms in " << path << std::endl;
+        return false;
+    }
+
+    // Residue and chain tables in file order. A residue cut by a chunk boundary shows up at
+    // the end of one chunk and the start of the next one, and is joined here.
+    molecule.residueNames.clear();
+    molecule.residueNumbers.clear();
+    molecule.residueChains.clear();
+    molecule.chainNames.clear();
+    std::vector<std::vector<uint32_t>> residueMaps(used);
+    const ChunkResidue *previous = nullptr;
+    bool chainBreak = false;
+    for (size_t i = 0; i < used; ++i)
+    {
+        residueMaps[i].reserve(chunks[i].residues.size());
+        for (const ChunkResidue &residue : chunks[i].residues)
+        {
+            bool newChain = !previous || chainBreak || residue.startsChain || residue.chain != previous->chain;
+            bool newResidue = newChain || residue.number != previous->number ||
+                              residue.insertionCode != previous->insertionCode || residue.name != previous->name;
+            if (newChain)
+            {
+                molecule.chainNames.emplace_back(residue.chain.data());
+            }
+            if (newResidue)
+            {
+                molecule.residueNames.push_back(residue.name);
+                molecule.residueNumbers.push_back(residue.number);
+                molecule.residueChains.push_back(static_cast<uint32_t>(molecule.chainNames.size() - 1));
+            }
+            residueMaps[i].push_back(static_cast<uint32_t>(molecule.residueNames.size() - 1));
+            previous = &residue;
+            chainBreak = false;
+        }
+        chainBreak = chainBreak || chunks[i].chainBreak;
+    }
+
+    // Atom columns, each chunk copied into place by its own job
+    molecule.positions.resize(atomCount);
+    molecule.elements.resize(atomCount);
+    molecule.atomResidues.resize(atomCount);
+    molecule.bonds.clear();
+    forEachChunk(used, [&](size_t i) {
+        const Chunk &chunk = chunks[i];
+        size_t offset = atomOffsets[i];
+        std::copy(chunk.positions.begin(), chunk.positions.end(), molecule.positions.begin() + offset);
+        std::copy(chunk.elements.begin(), chunk.elements.end(), molecule.elements.begin() + offset);
+        const std::vector<uint32_t> &residueMap = residueMaps[i];
+        for (size_t atom = 0; atom < chunk.atomResidues.size(); ++atom)
+        {
+            molecule.atomResidues[offset + atom] = residueMap[chunk.atomResidues[atom]];
+        }
+    });
+    return true;
+}
+
+// Calls `parseLine` for every line of the chunk (without the line break) until the chunk stops or fails
+template <typename ParseLine>
+void forEachLine(Chunk &chunk, const ParseLine &parseLine)
+{
+    const char *p = chunk.begin;
+    while (p < chunk.end && !chunk.stopped && chunk.error.empty())
+    {
+        const char *newline = static_cast<const char *>(std::memchr(p, '\n', static_cast<size_t>(chunk.end - p)));
+        const char *lineEnd = newline ? newline : chunk.end;
+        std::string_view line(p, static_cast<size_t>(lineEnd - p));
+        if (!line.empty() && line.back() == '\r')
+            line.remove_suffix(1);
+        parseLine(line);
+        p = newline ? newline + 1 : chunk.end;
+    }
+}
+
+// ---- PDB ----
+
+// Fixed columns [first, last) of a PDB record, cut short on short lines
+std::string_view column(std::string_view line, size_t first, size_t last)
+{
+    if (first >= line.size())
+        return {};
+    return line.substr(first, std::min(last, line.size()) - first);
+}
+
+std::string_view recordName(std::string_view line)
+{
+    return trim(column(line, 0, 6));
+}
+
+// Residue numbers past 9999 are written in hybrid-36 (A000..ZZZZ, then a000..zzzz)
+bool parseResidueNumber(std::string_view text, int32_t &number)
+{
+    text = trim(text);
+    if (parseInt(text, number))
+        return true;
+    if (text.size() != 4)
+        return false;
+
+    bool upper = std::isupper(static_cast<unsigned char>(text[0])) != 0;
+    int32_t value = 0;
+    for (char c : text)
+    {
+        int digit;
+        if (c >= '0' && c <= '9')
+            digit = c - '0';
+        else if (upper && c >= 'A' && c <= 'Z')
+            digit = c - 'A' + 10;
+        else if (!upper && c >= 'a' && c <= 'z')
+            digit = c - 'a' + 10;
+        else
+            return false;
+        value = value * 36 + digit;
+    }
+    constexpr int32_t block = 36 * 36 * 36;
+    number = value - 10 * block + 10000 + (upper ? 0 : 26 * block);
+    return true;
+}
+
+void parsePdbChunk(Chunk &chunk)
+{
+    chunk.positions.reserve(static_cast<size_t>(chunk.end - chunk.begin) / 81);
+    forEachLine(chunk, [&chunk](std::string_view line) {
+        std::string_view record = recordName(line);
+        if (record == "ATOM" || record == "HETATM")
+        {
+            float x, y, z;
+            if (!parseFloat(column(line, 30, 38), x) || !parseFloat(column(line, 38, 46), y) ||
+                !parseFloat(column(line, 46, 54), z))
+            {
+                chunk.fail("Malformed coordinates", line);
+                return;
+            }
+
+            ChunkResidue residue;
+            residue.name = makeResidueName(trim(column(line, 17, 20)));
+            residue.chain = makeResidueName(trim(column(line, 21, 22)));
+            parseResidueNumber(column(line, 22, 26), residue.number);
+            residue.insertionCode = line.size() > 26 ? line[26] : ' ';
+
+            // Old files have no element column. One-letter elements start in column 14
+            // (" CA " is carbon), two-letter ones in column 13 ("FE  "), except that four-character
+            // names of H, C, N, O and S atoms start there too ("HG11" is hydrogen). A single-atom
+            // residue named like its atom is an ion ("CA  " in residue CA is calcium).
+            std::string_view symbol = trim(column(line, 76, 78));
+            if (symbol.empty())
+            {
+                std::string_view name = column(line, 12, 16);
+                if (name.size() < 2 || name[0] == ' ' || std::isdigit(static_cast<unsigned char>(name[0])))
+                {
+                    symbol = column(name, 1, 2);
+                }
+                else
+                {
+                    bool organic = std::string_view("HCNOS").find(name[0]) != std::string_view::npos &&
+                                   std::isalpha(static_cast<unsigned char>(name[1]));
+                    bool ion = trim(name) == trim(column(line, 17, 20));
+                    symbol = name.substr(0, organic && !ion ? 1 : 2);
+                }
+            }
+            chunk.addAtom(glm::vec4(x, y, z, 0.0f), elementNumber(symbol), residue);
+        }
+        else if (record == "TER")
+        {
+            chunk.chainBreak = true;
+        }
+        else if (record == "ENDMDL" || record == "END")
+        {
+            chunk.stopped = true;
+        }
+    });
+}
+
+// ---- PDBx/mmCIF ----
+
+// What an _atom_site column is used for
+enum class SiteColumn : uint8_t {
+    Unused,
+    Element,
+    AtomName,
+    ResidueName,
+    Chain,
+    ResidueNumber,
+    InsertionCode,
+    X,
+    Y,
+    Z,
+    Model,
+    Count,
+};
+
+struct SiteLayout {
+    std::vector<SiteColumn> columns; // Up to the last column used
+    int firstModel = 0;
+};
+
+inline bool isBlank(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+inline bool isUnknown(std::string_view value)
+{
+    return value.empty() || value == "." || value == "?";
+}
+
+// The values of the used columns of one row, located in place. Returns false for a short or unterminated row.
+bool splitRow(std::string_view line, const SiteLayout &layout,
+              std::string_view (&values)[static_cast<size_t>(SiteColumn::Count)])
+{
+    size_t p = 0;
+    for (SiteColumn column : layout.columns)
+    {
+        while (p < line.size() && isBlank(line[p]))
+            ++p;
+        if (p == line.size())
+            return false;
+
+        size_t start = p, end;
+        char quote = line[p];
+        if (quote == '\'' || quote == '"')
+        {
+            // A quote only closes the value when followed by a blank ("C1'" stays intact)
+            end = start + 1;
+            while (end < line.size() && !(line[end] == quote && (end + 1 == line.size() || isBlank(line[end + 1]))))
+                ++end;
+            if (end == line.size())
+                return false;
+            ++start;
+            p = end + 1;
+        }
+        else
+        {
+            end = start;
+            while (end < line.size() && !isBlank(line[end]))
+                ++end;
+            p = end;
+        }
+        values[static_cast<size_t>(column)] = line.substr(start, end - start);
+    }
+    return true;
+}
+
+// Lines that end the _atom_site loop
+bool endsLoop(std::string_view line)
+{
+    return line[0] == '#' || line[0] == '_' || line.compare(0, 5, "loop_") == 0 || line.compare(0, 5, "data_") == 0 ||
+           line.compare(0, 5, "stop_") == 0;
+}
+
+void parseMmcifChunk(Chunk &chunk, const SiteLayout &layout)
+{
+    chunk.positions.reserve(static_cast<size_t>(chunk.end - chunk.begin) / 90);
+    forEachLine(chunk, [&chunk, &layout](std::string_view line) {
+        std::string_view row = line;
+        while (!row.empty() && isBlank(row.front()))
+            row.remove_prefix(1);
+        if (row.empty())
+        {
+            return;
+        }
+        if (endsLoop(row))
+        {
+            chunk.stopped = true;
+            return;
+        }
+
+        std::string_view values[static_cast<size_t>(SiteColumn::Count)];
+        if (!splitRow(row, layout, values))
+        {
+            chunk.fail("Malformed _atom_site row", line);
+            return;
+        }
+        auto value = [&values](SiteColumn column) { return values[static_cast<size_t>(column)]; };
+
+        int32_t model = layout.firstModel;
+        if (!isUnknown(value(SiteColumn::Model)) && parseInt(value(SiteColumn::Model), model) &&
+            model != layout.firstModel)
+        {
+            chunk.stopped = true;
+            return;
+        }
+
+        float x, y, z;
+        if (!parseFloat(value(SiteColumn::X), x) || !parseFloat(value(SiteColumn::Y), y) ||
+            !parseFloat(value(SiteColumn::Z), z))
+        {
+            chunk.fail("Malformed coordinates", line);
+            return;
+        }
+
+        ChunkResidue residue;
+        residue.name = makeResidueName(value(SiteColumn::ResidueName));
+        if (!isUnknown(value(SiteColumn::Chain)))
+            residue.chain = makeResidueName(value(SiteColumn::Chain));
+        if (!isUnknown(value(SiteColumn::ResidueNumber)))
+            parseInt(value(SiteColumn::ResidueNumber), residue.number);
+        if (!isUnknown(value(SiteColumn::InsertionCode)))
+            residue.insertionCode = value(SiteColumn::InsertionCode)[0];
+
+        std::string_view symbol = value(SiteColumn::Element);
+        if (isUnknown(symbol))
+        {
+            // No type_symbol: the leading letter of the atom name
+            symbol = value(SiteColumn::AtomName).substr(0, 1);
+        }
+        chunk.addAtom(glm::vec4(x, y, z, 0.0f), elementNumber(symbol), residue);
+    });
+}
+
+// Find the _atom_site loop header. Returns the first data row, or nullptr (after printing the reason).
+const char *readSiteLayout(const std::string &path, const char *begin, const char *end, SiteLayout &layout)
+{
+    std::string_view text(begin, static_cast<size_t>(end - begin));
+    size_t header = text.compare(0, 11, "_atom_site.") == 0 ? 0 : text.find("\n_atom_site.");
+    if (header == std::string_view::npos)
+    {
+        std::cerr << "No _atom_site records in " << path << std::endl;
+        return nullptr;
+    }
+    header += text[header] == '\n' ? 1 : 0;
+
+    // Column names, one per line, in the order of the row values
+    std::vector<std::string_view> names;
+    size_t p = header;
+    while (p < text.size() && text[p] == '_')
+    {
+        size_t lineEnd = std::min(text.find('\n', p), text.size());
+        std::string_view name = trim(text.substr(p, lineEnd - p));
+        if (name.compare(0, 11, "_atom_site.") != 0 || name.find_first_of(" \t") != std::string_view::npos)
+        {
+            // A value after the name: _atom_site written as single key-value pairs, not a loop
+            std::cerr << "Unsupported _atom_site layout in " << path << " (not a loop)" << std::endl;
+            return nullptr;
+        }
+        names.push_back(name.substr(11));
+        p = lineEnd + 1;
+    }
+    if (p >= text.size())
+    {
+        std::cerr << "No _atom_site rows in " << path << std::endl;
+        return nullptr;
+    }
+
+    // Preferred source first: author chain and residue numbering match the PDB format and the literature
+    auto find = [&names](std::initializer_list<std::string_view> candidates) {
+        for (std::string_view candidate : candidates)
+        {
+            auto it = std::find(names.begin(), names.end(), candidate);
+            if (it != names.end())
+                return static_cast<int>(it - names.begin());
+        }
+        return -1;
+    };
+    struct {
+        SiteColumn use;
+        int index;
+    } used[] = {
+        {SiteColumn::Element, find({"type_symbol"})},
+        {SiteColumn::AtomName, find({"label_atom_id", "auth_atom_id"})},
+        {SiteColumn::ResidueName, find({"label_comp_id", "auth_comp_id"})},
+        {SiteColumn::Chain, find({"auth_asym_id", "label_asym_id"})},
+        {SiteColumn::ResidueNumber, find({"auth_seq_id", "label_seq_id"})},
+        {SiteColumn::InsertionCode, find({"pdbx_PDB_ins_code"})},
+        {SiteColumn::X, find({"Cartn_x"})},
+        {SiteColumn::Y, find({"Cartn_y"})},
+        {SiteColumn::Z, find({"Cartn_z"})},
+        {SiteColumn::Model, find({"pdbx_PDB_model_num"})},
+    };
+
+    layout.columns.clear();
+    for (const auto &column : used)
+    {
+        if (column.index < 0)
+        {
+            bool required = column.use == SiteColumn::X || column.use == SiteColumn::Y || column.use == SiteColumn::Z;
+            if (required)
+            {
+                std::cerr << "No Cartn_x/y/z columns in the _atom_site loop of " << path << std::endl;
+                return nullptr;
+            }
+            continue;
+        }
+        if (layout.columns.size() <= static_cast<size_t>(column.index))
+            layout.columns.resize(column.index + 1, SiteColumn::Unused);
+        layout.columns[column.index] = column.use;
+    }
+
+    // Rows of later models are skipped, so every chunk needs to know the first one
+    layout.firstModel = 0;
+    size_t rowEnd = std::min(text.find('\n', p), text.size());
+    std::string_view values[static_cast<size_t>(SiteColumn::Count)];
+    if (splitRow(trim(text.substr(p, rowEnd - p)), layout, values))
+    {
+        parseInt(values[static_cast<size_t>(SiteColumn::Model)], layout.firstModel);
+    }
+    return begin + p;
+}
+
+} // namespace
+
+bool readPdb(const std::string &path, Molecule &molecule, size_t threadCount, LoadProgress *progress)
+{
+    if (progress)
+    {
+        progress->begin(LoadProgress::Stage::Map);
+    }
+    MappedFile file;
+    if (!file.open(path))
+    {
+        return false;
+    }
+    file.advise(MappedFile::Access::Sequential);
+    return readChunks(path, file.data(), file.data() + file.size(), threadCount, parsePdbChunk, molecule, progress);
+}
+
+bool readMmcif(const std::string &path, Molecule &molecule, size_t threadCount, LoadProgress *progress)
+{
+    if (progress)
+    {
+        progress->begin(LoadProgress::Stage::Map);
+    }
+    MappedFile file;
+    if (!file.open(path))
+    {
+        return false;
+    }
+    file.advise(MappedFile::Access::Sequential);
+
+    SiteLayout layout;
+    const char *rows = readSiteLayout(path, file.data(), file.data() + file.size(), layout);
+    if (!rows)
+    {
+        return false;
+    }
+    auto parseChunk = [&layout](Chunk &chunk) { parseMmcifChunk(chunk, layout); };
+    return readChunks(path, rows, file.data() + file.size(), threadCount, parseChunk, molecule, progress);
+}
@@ -0,0 +1,89 @@
+#include "thread_pool.h"
+#include "cpu_profiler.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t threadCount, const std::string &name)
+{
+    if (threadCount == 0)
+    {
+        threadCount = defaultThreadCount();
+    }
+    threadNames.reserve(threadCount);
+    for (size_t i = 0; i < threadCount; ++i)
+    {
+        threadNames.push_back(name + " " + std::to_string(i));
+    }
+    for (size_t i = 0; i < threadCount; ++i)
+    {
+        threads.emplace_back([this, i]() {
+            PROFILE_THREAD(threadNames[i].c_str());
+            workerLoop();
+        });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobAvailable.notify_all();
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+}
+
+size_t ThreadPool::defaultThreadCount()
+{
+    unsigned int hardwareThreads = std::thread::hardware_concurrency();
+    return std::max<size_t>(1, hardwareThreads > 1 ? hardwareThreads - 1 : 1);
+}
+
+void ThreadPool::submit(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(std::move(job));
+    }
+    jobAvailable.notify_one();
+}
+
+void ThreadPool::waitIdle()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    jobsDone.wait(lock, [this]() { return jobs.empty() && runningJobs == 0; });
+}
+
+size_t ThreadPool::getPendingCount()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return jobs.size() + runningJobs;
+}
+
+void ThreadPool::workerLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        jobAvailable.wait(lock, [this]() { return stopping || !jobs.empty(); });
+        // Finish queued work before stopping, so nothing submitted is silently lost
+        if (jobs.empty())
+        {
+            return;
+        }
+
+        std::function<void()> job = std::move(jobs.front());
+        jobs.pop_front();
+        runningJobs++;
+        lock.unlock();
+        job();
+        lock.lock();
+        runningJobs--;
+        if (jobs.empty() && runningJobs == 0)
+        {
+            jobsDone.notify_all();
+        }
+    }
+}
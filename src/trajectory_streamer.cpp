@@ -0,0 +1,355 @@
+#include "trajectory_streamer.h"
+#include "bond_perception.h"
+#include "cpu_profiler.h"
+#include <algorithm>
+#include <chrono>
+
+namespace {
+
+// Weight of the newest decode in the moving average
+constexpr float DECODE_AVERAGE_WEIGHT = 0.1f;
+
+// Covalent structures have a little over one bond per atom; used before a frame's topology is known
+constexpr size_t ESTIMATED_BONDS_PER_ATOM = 2;
+
+size_t frameBytes(size_t atomCount)
+{
+    return sizeof(StreamedFrame) + atomCount * sizeof(glm::vec4);
+}
+
+size_t topologyBytes(size_t atomCount, size_t bondCount)
+{
+    return sizeof(Molecule) + atomCount * sizeof(uint8_t) + bondCount * 2 * sizeof(uint32_t);
+}
+
+size_t frameBytes(const StreamedFrame &frame)
+{
+    size_t bytes = frameBytes(frame.positions.size());
+    if (frame.topology)
+    {
+        bytes += topologyBytes(frame.topology->elements.size(), frame.topology->getBondCount());
+    }
+    return bytes;
+}
+
+} // namespace
+
+TrajectoryStreamer::~TrajectoryStreamer()
+{
+    close();
+}
+
+void TrajectoryStreamer::open(std::unique_ptr<Trajectory> frames)
+{
+    close();
+    trajectory = std::move(frames);
+    if (!trajectory)
+    {
+        return;
+    }
+
+    requestSerial = 0;
+    budgetChanged = false;
+    stopping = false;
+    currentPass = 0;
+    requestCount = 0;
+    hitCount = 0;
+    decodedCount = 0;
+    averageDecodeMs = 0.0f;
+    lastDecodeMs = 0.0f;
+    thread = std::thread([this]() { run(); });
+}
+
+void TrajectoryStreamer::close()
+{
+    if (thread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        workAvailable.notify_one();
+        thread.join();
+    }
+    delete ready.exchange(nullptr, std::memory_order_acq_rel);
+    cache.clear();
+    recentFrames.clear();
+    cachedBytes = 0;
+    cachedFrameCount = 0;
+    cachedByteCount = 0;
+    trajectory.reset();
+}
+
+void TrajectoryStreamer::request(size_t frame, int direction)
+{
+    if (!thread.joinable())
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        requestedFrame = frame;
+        requestedDirection = direction < 0 ? -1 : 1;
+        requestSerial++;
+    }
+    workAvailable.notify_one();
+}
+
+std::shared_ptr<const StreamedFrame> TrajectoryStreamer::takeFrame()
+{
+    std::unique_ptr<std::shared_ptr<const StreamedFrame>> slot(ready.exchange(nullptr, std::memory_order_acq_rel));
+    return slot ? std::move(*slot) : nullptr;
+}
+
+void TrajectoryStreamer::setMemoryBudget(size_t bytes)
+{
+    memoryBudget.store(bytes, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        budgetChanged = true;
+    }
+    workAvailable.notify_one();
+}
+
+TrajectoryStreamer::Stats TrajectoryStreamer::getStats() const
+{
+    Stats stats;
+    stats.requests = requestCount.load(std::memory_order_relaxed);
+    stats.hits = hitCount.load(std::memory_order_relaxed);
+    stats.decoded = decodedCount.load(std::memory_order_relaxed);
+    stats.decodeMs = averageDecodeMs.load(std::memory_order_relaxed);
+    stats.lastDecodeMs = lastDecodeMs.load(std::memory_order_relaxed);
+    stats.cachedFrames = cachedFrameCount.load(std::memory_order_relaxed);
+    stats.cachedBytes = cachedByteCount.load(std::memory_order_relaxed);
+    stats.memoryBudget = memoryBudget.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void TrajectoryStreamer::run()
+{
+    PROFILE_THREAD("trajectory streamer");
+
+    // A scan of the frame index, off the render thread
+    variableAtomCount = false;
+    size_t frameCount = trajectory->getFrameCount();
+    for (size_t frame = 1; frame < frameCount && !variableAtomCount; ++frame)
+    {
+        variableAtomCount = trajectory->getAtomCount(frame) != trajectory->getAtomCount(0);
+    }
+
+    uint64_t servedSerial = 0;
+    bool prefetching = false;
+    for (;;)
+    {
+        size_t playhead;
+        int direction;
+        bool newRequest;
+        bool resized;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            workAvailable.wait(lock, [&]() {
+                return stopping || requestSerial != servedSerial || budgetChanged || prefetching;
+            });
+            if (stopping)
+            {
+                return;
+            }
+            playhead = requestedFrame;
+            direction = requestedDirection;
+            newRequest = requestSerial != servedSerial;
+            servedSerial = requestSerial;
+            resized = budgetChanged;
+            budgetChanged = false;
+        }
+
+        if (resized)
+        {
+            // A smaller budget may drop part of the window, a larger one widens it
+            windowFull = false;
+            evict(memoryBudget.load(std::memory_order_relaxed));
+            prefetchStep = 1;
+            prefetching = servedSerial > 0;
+        }
+
+        if (newRequest)
+        {
+            // The requested frame first; everything else only fills the cache
+            currentPass = servedSerial;
+            prefetchStep = 1;
+            windowFull = false;
+            bool hit = false;
+            std::shared_ptr<const StreamedFrame> frame = fetch(playhead, &hit);
+            requestCount.fetch_add(1, std::memory_order_relaxed);
+            if (hit)
+            {
+                hitCount.fetch_add(1, std::memory_order_relaxed);
+            }
+            publish(std::move(frame));
+            prefetching = true;
+            continue;
+        }
+
+        // One frame per pass, so a new request never waits for more than one decode
+        if (prefetching)
+        {
+            prefetching = prefetchNext(playhead, direction);
+        }
+    }
+}
+
+std::shared_ptr<const StreamedFrame> TrajectoryStreamer::fetch(size_t frame, bool *hit)
+{
+    auto it = cache.find(frame);
+    *hit = it != cache.end();
+    if (*hit)
+    {
+        touch(it->second);
+        return it->second.frame;
+    }
+    std::shared_ptr<const StreamedFrame> decoded = decode(frame);
+    insert(decoded);
+    return decoded;
+}
+
+std::shared_ptr<const StreamedFrame> TrajectoryStreamer::decode(size_t frame)
+{
+    PROFILE_ZONE("decode frame");
+    auto start = std::chrono::steady_clock::now();
+
+    auto decoded = std::make_shared<StreamedFrame>();
+    decoded->index = frame;
+    if (frame < trajectory->getFrameCount() && variableAtomCount)
+    {
+        // The render thread may have to replace the structure with this frame's atoms
+        auto topology = std::make_shared<Molecule>();
+        decoded->failed = !trajectory->readFrame(frame, *topology);
+        if (!decoded->failed)
+        {
+            perceiveBonds(*topology);
+            decoded->positions = std::move(topology->positions);
+            topology->positions = AlignedVector<glm::vec4>();
+            decoded->topology = std::move(topology);
+        }
+    }
+    else if (frame < trajectory->getFrameCount())
+    {
+        decoded->positions.resize(trajectory->getAtomCount(frame));
+        decoded->failed = !trajectory->readPositions(frame, decoded->positions.data());
+    }
+    else
+    {
+        decoded->failed = true;
+    }
+    if (decoded->failed)
+    {
+        // Cached all the same, so prefetching doesn't retry a damaged frame forever
+        decoded->positions.clear();
+        decoded->positions.shrink_to_fit();
+    }
+
+    float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    float average = averageDecodeMs.load(std::memory_order_relaxed);
+    bool first = decodedCount.fetch_add(1, std::memory_order_relaxed) == 0;
+    averageDecodeMs.store(first ? ms : average + (ms - average) * DECODE_AVERAGE_WEIGHT, std::memory_order_relaxed);
+    lastDecodeMs.store(ms, std::memory_order_relaxed);
+    return decoded;
+}
+
+void TrajectoryStreamer::touch(CacheEntry &entry)
+{
+    recentFrames.splice(recentFrames.begin(), recentFrames, entry.recent);
+    entry.pass = currentPass;
+}
+
+void TrajectoryStreamer::insert(const std::shared_ptr<const StreamedFrame> &frame)
+{
+    recentFrames.push_front(frame->index);
+    CacheEntry &entry = cache[frame->index];
+    entry.frame = frame;
+    entry.recent = recentFrames.begin();
+    entry.pass = currentPass;
+    cachedBytes += frameBytes(*frame);
+    evict(memoryBudget.load(std::memory_order_relaxed));
+}
+
+void TrajectoryStreamer::evict(size_t budget)
+{
+    // The newest frame stays even if it alone is over budget
+    while (cachedBytes > budget && recentFrames.size() > 1)
+    {
+        auto victim = cache.find(recentFrames.back());
+        windowFull = windowFull || victim->second.pass == currentPass;
+        cachedBytes -= frameBytes(*victim->second.frame);
+        cache.erase(victim);
+        recentFrames.pop_back();
+    }
+    cachedFrameCount.store(cache.size(), std::memory_order_relaxed);
+    cachedByteCount.store(cachedBytes, std::memory_order_relaxed);
+}
+
+bool TrajectoryStreamer::prefetchNext(size_t playhead, int direction)
+{
+    size_t frameCount = trajectory->getFrameCount();
+    if (windowFull || playhead >= frameCount || frameCount < 2)
+    {
+        return false;
+    }
+
+    // As many frames as fit the budget, the requested one included. Frames are charged like
+    // insert() does: with their topology when the trajectory has one per frame, measured on
+    // the cached playhead frame when there is one.
+    size_t atomCount = trajectory->getAtomCount(playhead);
+    size_t bytesPerFrame = frameBytes(atomCount);
+    if (variableAtomCount)
+    {
+        auto current = cache.find(playhead);
+        bool measured = current != cache.end() && !current->second.frame->failed;
+        bytesPerFrame = measured ? frameBytes(*current->second.frame)
+                                 : bytesPerFrame + topologyBytes(atomCount, atomCount * ESTIMATED_BONDS_PER_ATOM);
+    }
+    size_t capacity = memoryBudget.load(std::memory_order_relaxed) / bytesPerFrame;
+    if (capacity < 2)
+    {
+        return false;
+    }
+    size_t window = std::min({capacity - 1, frameCount - 1, MAX_PREFETCH_FRAMES});
+    size_t ahead = std::max<size_t>(1, static_cast<size_t>(window * AHEAD_FRACTION));
+    size_t behind = window - ahead;
+
+    // Nearest first, alternating sides; the window never covers a frame twice.
+    // Steps before prefetchStep are cached already and stay so for this pass.
+    for (; prefetchStep <= std::max(ahead, behind); ++prefetchStep)
+    {
+        size_t step = prefetchStep;
+        for (int side : {direction, -direction})
+        {
+            if (step > (side == direction ? ahead : behind))
+            {
+                continue;
+            }
+            size_t frame = side > 0 ? (playhead + step) % frameCount : (playhead + frameCount - step) % frameCount;
+            auto it = cache.find(frame);
+            if (it != cache.end())
+            {
+                // Keep the window ahead of older frames in the eviction order
+                touch(it->second);
+                continue;
+            }
+            PROFILE_ZONE("prefetch frame");
+            insert(decode(frame));
+            return true;
+        }
+    }
+    return false;
+}
+
+void TrajectoryStreamer::publish(std::shared_ptr<const StreamedFrame> frame)
+{
+    // A frame the render thread hasn't taken yet is replaced by the newer one
+    auto *slot = new std::shared_ptr<const StreamedFrame>(std::move(frame));
+    delete ready.exchange(slot, std::memory_order_acq_rel);
+    if (onFrameReady)
+    {
+        onFrameReady();
+    }
+}
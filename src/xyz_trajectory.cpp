@@ -0,0 +1,424 @@
+#include "xyz_trajectory.h"
+#include "elements.h"
+#include "frame_index.h"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define XYZ_SSE2 1
+#endif
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+namespace {
+
+// Frames indexed between progress reports (and cancellation checks)
+constexpr size_t PROGRESS_FRAMES = 256;
+
+inline int countBits(uint64_t mask)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    // Not __popcnt64: it needs the POPCNT instruction, which MSVC doesn't check for
+    mask = mask - ((mask >> 1) & 0x5555555555555555ull);
+    mask = (mask & 0x3333333333333333ull) + ((mask >> 2) & 0x3333333333333333ull);
+    mask = (mask + (mask >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+    return static_cast<int>((mask * 0x0101010101010101ull) >> 56);
+#else
+    return __builtin_popcountll(mask);
+#endif
+}
+
+inline int lowestBit(uint64_t mask)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(mask);
+#endif
+}
+
+// Position just past the `lines`-th newline at or after p (lines > 0), or nullptr if the data ends first.
+// Frame starts are found by counting newlines, not by parsing lines, so this is the whole cost of indexing.
+const char *skipLines(const char *p, const char *end, uint64_t lines)
+{
+#if XYZ_SSE2
+    const __m128i newline = _mm_set1_epi8('\n');
+    while (end - p >= 64)
+    {
+        uint64_t mask = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 16 * i));
+            uint64_t bits = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline)));
+            mask |= bits << (16 * i);
+        }
+        uint64_t count = static_cast<uint64_t>(countBits(mask));
+        if (count >= lines)
+        {
+            // Drop the newlines before the one we want
+            while (--lines)
+            {
+                mask &= mask - 1;
+            }
+            return p + lowestBit(mask) + 1;
+        }
+        lines -= count;
+        p += 64;
+    }
+#endif
+    // Tail, and the whole range without SSE2 (memchr is vectorized by the C library)
+    while (p < end)
+    {
+        const char *found = static_cast<const char *>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+        if (!found)
+        {
+            return nullptr;
+        }
+        if (--lines == 0)
+        {
+            return found + 1;
+        }
+        p = found + 1;
+    }
+    return nullptr;
+}
+
+inline bool isBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline const char *skipBlanks(const char *p, const char *end)
+{
+    while (p < end && isBlank(*p))
+        ++p;
+    return p;
+}
+
+inline const char *fieldEnd(const char *p, const char *end)
+{
+    while (p < end && !isBlank(*p) && *p != '\n')
+        ++p;
+    return p;
+}
+
+inline bool parseFloat(const char *first, const char *last, float &value)
+{
+    // from_chars takes no leading '+'
+    if (first < last && *first == '+')
+        ++first;
+    std::from_chars_result result = std::from_chars(first, last, value);
+    return result.ec == std::errc() && result.ptr == last;
+}
+
+// Value of a key=value pair in an extended XYZ comment line, quotes removed
+std::string_view commentValue(std::string_view comment, std::string_view key)
+{
+    size_t start = 0;
+    while ((start = comment.find(key, start)) != std::string_view::npos)
+    {
+        bool atFieldStart = start == 0 || isBlank(comment[start - 1]);
+        size_t valueStart = start + key.size();
+        if (atFieldStart && valueStart < comment.size() && comment[valueStart] == '=')
+        {
+            ++valueStart;
+            char quote = valueStart < comment.size() ? comment[valueStart] : '\0';
+            if (quote == '"' || quote == '\'')
+            {
+                size_t close = comment.find(quote, valueStart + 1);
+                return comment.substr(valueStart + 1, close == std::string_view::npos ? close : close - valueStart - 1);
+            }
+            size_t valueEnd = valueStart;
+            while (valueEnd < comment.size() && !isBlank(comment[valueEnd]))
+                ++valueEnd;
+            return comment.substr(valueStart, valueEnd - valueStart);
+        }
+        start = valueStart;
+    }
+    return {};
+}
+
+} // namespace
+
+bool XyzTrajectory::open(const std::string &path, size_t frameLimit, LoadProgress *progress)
+{
+    close();
+    if (progress)
+    {
+        progress->begin(LoadProgress::Stage::Map);
+    }
+    if (!file.open(path))
+    {
+        return false;
+    }
+
+    // Whole-file indexes of big files are kept next to them
+    bool wholeFile = frameLimit == std::numeric_limits<size_t>::max();
+    bool sidecar = wholeFile && file.size() >= FRAME_INDEX_MIN_FILE_BYTES;
+    FrameIndex index;
+    if (sidecar && index.load(path, "xyz"))
+    {
+        frames.reserve(index.getFrameCount());
+        for (size_t frame = 0; frame < index.getFrameCount(); ++frame)
+        {
+            frames.push_back({index.offsets[frame], index.atomCount});
+        }
+        indexedEnd = static_cast<size_t>(index.offsets.back());
+        return true;
+    }
+
+    if (progress)
+    {
+        progress->begin(LoadProgress::Stage::Index);
+    }
+    buildIndex(frameLimit, progress);
+    if (progress && progress->isCancelled())
+    {
+        close();
+        return false;
+    }
+    if (frames.empty())
+    {
+        std::cerr << "No frames in " << path << std::endl;
+        close();
+        return false;
+    }
+
+    // Sidecars hold one atom count for all frames
+    bool fixedAtomCount = std::all_of(frames.begin(), frames.end(),
+                                      [this](const Frame &frame) { return frame.atomCount == frames[0].atomCount; });
+    if (sidecar && fixedAtomCount)
+    {
+        index.atomCount = frames[0].atomCount;
+        index.offsets.reserve(frames.size() + 1);
+        for (const Frame &frame : frames)
+        {
+            index.offsets.push_back(frame.offset);
+        }
+        index.offsets.push_back(indexedEnd);
+        index.save(path, "xyz");
+    }
+    return true;
+}
+
+void XyzTrajectory::buildIndex(size_t frameLimit, LoadProgress *progress)
+{
+    const std::string &path = file.getPath();
+    const char *begin = file.data();
+    const char *end = begin + file.size();
+    const char *p = begin;
+    file.advise(MappedFile::Access::Sequential);
+    while (frames.size() < frameLimit)
+    {
+        // Blank lines after the last frame
+        while (p < end && (isBlank(*p) || *p == '\n'))
+            ++p;
+        if (p == end)
+        {
+            break;
+        }
+
+        const char *countStart = p;
+        uint64_t atomCount = 0;
+        std::from_chars_result result = std::from_chars(p, end, atomCount);
+        if (result.ec != std::errc() || (result.ptr < end && !isBlank(*result.ptr) && *result.ptr != '\n'))
+        {
+            std::cerr << "Expected an atom count at the start of frame " << frames.size() + 1 << " in " << path
+                      << std::endl;
+            break;
+        }
+
+        // Count line, comment line, one line per atom. The last line may lack its line break.
+        const char *next = skipLines(result.ptr, end, atomCount + 2);
+        if (!next)
+        {
+            bool lastLineUnterminated = end > begin && end[-1] != '\n';
+            if (!lastLineUnterminated || skipLines(result.ptr, end, atomCount + 1) == nullptr)
+            {
+                std::cerr << "Frame " << frames.size() + 1 << " of " << path << " is incomplete" << std::endl;
+                break;
+            }
+            next = end;
+        }
+        frames.push_back({static_cast<uint64_t>(countStart - begin), atomCount});
+        p = next;
+        if (progress && frames.size() % PROGRESS_FRAMES == 0)
+        {
+            if (progress->isCancelled())
+                break;
+            progress->update(static_cast<float>(p - begin) / static_cast<float>(end - begin));
+        }
+    }
+    indexedEnd = static_cast<size_t>(p - begin);
+    file.advise(MappedFile::Access::Normal);
+}
+
+void XyzTrajectory::close()
+{
+    file.close();
+    frames.clear();
+    indexedEnd = 0;
+}
+
+size_t XyzTrajectory::atomsOffset(size_t frame) const
+{
+    const char *begin = file.data();
+    const char *end = begin + frameEnd(frame);
+    const char *atoms = skipLines(begin + frames[frame].offset, end, 2);
+    return atoms ? static_cast<size_t>(atoms - begin) : frameEnd(frame);
+}
+
+size_t XyzTrajectory::frameEnd(size_t frame) const
+{
+    return frame + 1 < frames.size() ? frames[frame + 1].offset : indexedEnd;
+}
+
+std::string_view XyzTrajectory::getComment(size_t frame) const
+{
+    const char *begin = file.data();
+    const char *end = begin + frameEnd(frame);
+    const char *comment = skipLines(begin + frames[frame].offset, end, 1);
+    if (!comment)
+    {
+        return {};
+    }
+    const char *commentEnd = begin + atomsOffset(frame);
+    while (commentEnd > comment && (commentEnd[-1] == '\n' || commentEnd[-1] == '\r'))
+        --commentEnd;
+    return std::string_view(comment, static_cast<size_t>(commentEnd - comment));
+}
+
+bool XyzTrajectory::parseColumns(size_t frame, Columns &columns) const
+{
+    columns = Columns();
+    std::string_view properties = commentValue(getComment(frame), "Properties");
+    if (properties.empty())
+    {
+        properties = commentValue(getComment(frame), "properties");
+    }
+    if (properties.empty())
+    {
+        return true;
+    }
+
+    // name:type:count triples; columns are numbered in the order the properties are listed
+    int column = 0;
+    int species = -1, atomicNumber = -1, position = -1;
+    while (!properties.empty())
+    {
+        std::string_view fields[3];
+        for (std::string_view &field : fields)
+        {
+            size_t colon = properties.find(':');
+            field = properties.substr(0, colon);
+            properties = colon == std::string_view::npos ? std::string_view() : properties.substr(colon + 1);
+        }
+        int count = 0;
+        std::from_chars(fields[2].data(), fields[2].data() + fields[2].size(), count);
+        if (count <= 0)
+        {
+            std::cerr << "Malformed Properties in frame " << frame + 1 << " of " << getPath() << std::endl;
+            return false;
+        }
+
+        if (fields[0] == "species" && fields[1] == "S")
+            species = column;
+        else if (fields[0] == "Z" && fields[1] == "I")
+            atomicNumber = column;
+        else if (fields[0] == "pos" && fields[1] == "R" && count == 3)
+            position = column;
+        column += count;
+    }
+    if (position < 0)
+    {
+        std::cerr << "Frame " << frame + 1 << " of " << getPath() << " has no pos:R:3 property" << std::endl;
+        return false;
+    }
+    columns.position = position;
+    columns.species = species >= 0 ? species : atomicNumber;
+    columns.atomicNumbers = species < 0 && atomicNumber >= 0;
+    return true;
+}
+
+bool XyzTrajectory::readAtoms(size_t frame, glm::vec4 *positions, uint8_t *elements) const
+{
+    Columns columns;
+    if (!parseColumns(frame, columns))
+    {
+        return false;
+    }
+    int lastColumn = std::max(columns.position + 2, elements ? columns.species : 0);
+
+    const char *p = file.data() + atomsOffset(frame);
+    const char *end = file.data() + frameEnd(frame);
+    size_t atomCount = frames[frame].atomCount;
+    for (size_t atom = 0; atom < atomCount; ++atom)
+    {
+        float xyz[3];
+        int parsed = 0;
+        for (int column = 0; column <= lastColumn; ++column)
+        {
+            p = skipBlanks(p, end);
+            const char *last = fieldEnd(p, end);
+            if (p == last)
+            {
+                break;
+            }
+            if (column >= columns.position && column < columns.position + 3)
+            {
+                if (!parseFloat(p, last, xyz[column - columns.position]))
+                {
+                    break;
+                }
+                ++parsed;
+            }
+            else if (elements && column == columns.species)
+            {
+                int z = 0;
+                if (columns.atomicNumbers)
+                    std::from_chars(p, last, z);
+                else
+                    z = elementFromSymbol(std::string_view(p, static_cast<size_t>(last - p)));
+                elements[atom] = static_cast<uint8_t>(z > 0 && z < ELEMENT_COUNT ? z : 0);
+            }
+            p = last;
+        }
+        if (parsed != 3)
+        {
+            std::cerr << "Malformed atom " << atom + 1 << " in frame " << frame + 1 << " of " << getPath()
+                      << std::endl;
+            return false;
+        }
+        positions[atom] = glm::vec4(xyz[0], xyz[1], xyz[2], 0.0f);
+
+        // Extra columns (velocities, forces, ...)
+        const char *lineEnd = static_cast<const char *>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+        p = lineEnd ? lineEnd + 1 : end;
+    }
+    return true;
+}
+
+bool XyzTrajectory::readFrame(size_t frame, Molecule &molecule) const
+{
+    size_t atomCount = frames[frame].atomCount;
+    molecule.positions.resize(atomCount);
+    molecule.elements.assign(atomCount, 0);
+    molecule.bonds.clear();
+    molecule.atomResidues.clear();
+    molecule.residueNames.clear();
+    molecule.residueNumbers.clear();
+    molecule.residueChains.clear();
+    molecule.chainNames.clear();
+    return readAtoms(frame, molecule.positions.data(), molecule.elements.data());
+}
+
+bool XyzTrajectory::readPositions(size_t frame, glm::vec4 *positions) const
+{
+    return readAtoms(frame, positions, nullptr);
+}
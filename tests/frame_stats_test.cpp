@@ -0,0 +1,91 @@
+#include "frame_stats.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#define CHECK(condition)                                                                  \
+    do                                                                                    \
+    {                                                                                     \
+        if (!(condition))                                                                 \
+        {                                                                                 \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition "\n"; \
+            return 1;                                                                     \
+        }                                                                                 \
+    } while (0)
+
+// Frames that take one refresh interval of the display are on time
+static int refreshLengthFramesAreOnTime()
+{
+    const double rates[] = {59.94, 60.0, 119.88, 143.86, 144.0};
+    for (double hz : rates)
+    {
+        FrameStats stats;
+        // GLFW reports whole hertz
+        stats.setRefreshRate(static_cast<int>(hz + 0.5));
+        double time = 0.0;
+        for (size_t i = 0; i < FrameStats::HISTORY_LENGTH * 2; ++i)
+        {
+            time += 1.0 / hz;
+            stats.addFrame(static_cast<float>(1000.0 / hz), time);
+        }
+        CHECK(stats.getOverBudgetCount() == 0);
+        CHECK(stats.getStutterCount() == 0);
+        CHECK(!stats.isOverBudget(stats.getSummary().p99));
+    }
+    return 0;
+}
+
+// A dropped frame (two refresh intervals) is over budget and, against a steady median, a stutter
+static int droppedFramesAreCounted()
+{
+    FrameStats stats;
+    stats.setRefreshRate(60);
+    double time = 0.0;
+    for (size_t i = 0; i < FrameStats::HISTORY_LENGTH; ++i)
+    {
+        time += 1.0 / 60.0;
+        stats.addFrame(8.0f, time);
+    }
+    stats.addFrame(2000.0f / 60.0f, time);
+    CHECK(stats.getOverBudgetCount() == 1);
+    CHECK(stats.getStutterCount() == 1);
+    CHECK(stats.getSummary().max > stats.budgetMs);
+    return 0;
+}
+
+// The Prometheus summary carries its quantiles, _sum and _count
+static int metricsFormSummary()
+{
+    FrameStats stats;
+    for (int i = 0; i < 10; ++i)
+    {
+        stats.addFrame(5.0f, i * 0.1);
+    }
+    const char *path = "frame_stats_test.prom";
+    CHECK(stats.writeMetrics(path));
+    std::ifstream file(path);
+    std::stringstream text;
+    text << file.rdbuf();
+    std::remove(path);
+
+    std::string metrics = text.str();
+    CHECK(metrics.find("# TYPE molview_frame_time_ms summary\n") != std::string::npos);
+    CHECK(metrics.find("molview_frame_time_ms{quantile=\"0.5\"} 5\n") != std::string::npos);
+    CHECK(metrics.find("molview_frame_time_ms_sum 50\n") != std::string::npos);
+    CHECK(metrics.find("molview_frame_time_ms_count 10\n") != std::string::npos);
+    return 0;
+}
+
+int main()
+{
+    int failures = 0;
+    failures += refreshLengthFramesAreOnTime();
+    failures += droppedFramesAreCounted();
+    failures += metricsFormSummary();
+    if (failures == 0)
+    {
+        std::cout << "frame_stats_test passed" << std::endl;
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,64 @@
+#include "structure_reader.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+#define CHECK(condition)                                                                  \
+    do                                                                                    \
+    {                                                                                     \
+        if (!(condition))                                                                 \
+        {                                                                                 \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition "\n"; \
+            return 1;                                                                     \
+        }                                                                                 \
+    } while (0)
+
+// One ATOM/HETATM record without the element column (columns 77-78), as in old files
+static std::string pdbAtom(const char *record, int serial, const char *name, const char *residue, int residueNumber)
+{
+    char line[96];
+    std::snprintf(line, sizeof(line), "%-6s%5d %-4s %3s A%4d    %8.3f%8.3f%8.3f%6.2f%6.2f\n", record, serial, name,
+                  residue, residueNumber, serial * 1.5, 0.0, 0.0, 1.0, 0.0);
+    return line;
+}
+
+// Elements from the atom name when there is no element column
+static int elementsFromAtomNames()
+{
+    const char *path = "structure_reader_test.pdb";
+    {
+        std::ofstream file(path);
+        file << pdbAtom("ATOM", 1, " CA ", "VAL", 1)  // Carbon (column 14)
+             << pdbAtom("ATOM", 2, "HG11", "VAL", 1)  // Hydrogen, four-character name from column 13
+             << pdbAtom("ATOM", 3, "1HG2", "VAL", 1)  // Hydrogen, old numbering
+             << pdbAtom("ATOM", 4, "OD1 ", "ASN", 2)  // Oxygen
+             << pdbAtom("HETATM", 5, "FE  ", "HEM", 3) // Iron (column 13)
+             << pdbAtom("HETATM", 6, "CA  ", " CA", 4) // Calcium ion
+             << pdbAtom("HETATM", 7, "HG  ", " HG", 5) // Mercury ion
+             << "END\n";
+    }
+
+    Molecule molecule;
+    bool read = readPdb(path, molecule, 1);
+    std::remove(path);
+    CHECK(read);
+    CHECK(molecule.getAtomCount() == 7);
+
+    const int expected[] = {6, 1, 1, 8, 26, 20, 80};
+    for (size_t i = 0; i < 7; ++i)
+    {
+        CHECK(molecule.elements[i] == expected[i]);
+    }
+    return 0;
+}
+
+int main()
+{
+    int failures = 0;
+    failures += elementsFromAtomNames();
+    if (failures == 0)
+    {
+        std::cout << "structure_reader_test passed" << std::endl;
+    }
+    return failures == 0 ? 0 : 1;
+}